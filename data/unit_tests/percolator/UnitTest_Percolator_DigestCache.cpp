@@ -0,0 +1,135 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the DigestCache class */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "DigestCache.cpp"
+
+class DigestCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    fastaFile = "digest_cache_test.fasta";
+    writeFasta(fastaFile, "MKWVTFISLLLLFSSAYSRGVFRR");
+    fragmentMap["protein_2"] = "protein_1";
+    fragmentMap["protein_3"] = "protein_1";
+    duplicateMap["protein_5"] = "protein_4";
+  }
+  virtual void TearDown() {
+    for (size_t i = 0; i < cacheFiles.size(); ++i) {
+      remove(cacheFiles[i].c_str());
+    }
+    remove(fastaFile.c_str());
+  }
+
+  void writeFasta(const std::string& fileName, const std::string& sequence) {
+    std::ofstream out(fileName.c_str());
+    out << ">protein_1" << std::endl << sequence << std::endl;
+  }
+
+  bool initKey(DigestCache& cache, int minPeptideLength) {
+    bool success = cache.initKey(fastaFile, PercolatorCrux::TRYPSIN,
+        PercolatorCrux::FULL_DIGEST, minPeptideLength, 50, 0, "decoy_", false);
+    cacheFiles.push_back(cache.getCacheFile());
+    return success;
+  }
+
+  std::string fastaFile;
+  std::vector<std::string> cacheFiles;
+  std::map<std::string, std::string> fragmentMap, duplicateMap;
+};
+
+TEST_F(DigestCacheTest, RoundTrip) {
+  DigestCache writer(".");
+  ASSERT_TRUE(initKey(writer, 6));
+  ASSERT_TRUE(writer.store(fragmentMap, duplicateMap, true));
+
+  DigestCache reader(".");
+  ASSERT_TRUE(initKey(reader, 6));
+  EXPECT_EQ(writer.getCacheFile(), reader.getCacheFile());
+  std::map<std::string, std::string> fragments, duplicates;
+  bool hasDecoys = false;
+  ASSERT_TRUE(reader.load(fragments, duplicates, hasDecoys));
+  EXPECT_TRUE(fragments == fragmentMap);
+  EXPECT_TRUE(duplicates == duplicateMap);
+  EXPECT_TRUE(hasDecoys);
+
+  // entries are added to maps that are not empty
+  fragments.clear();
+  fragments["protein_9"] = "protein_8";
+  ASSERT_TRUE(reader.load(fragments, duplicates, hasDecoys));
+  EXPECT_EQ(3u, fragments.size());
+  EXPECT_EQ("protein_8", fragments["protein_9"]);
+}
+
+TEST_F(DigestCacheTest, ChecksumMismatchForcesRebuild) {
+  DigestCache writer(".");
+  ASSERT_TRUE(initKey(writer, 6));
+  ASSERT_TRUE(writer.store(fragmentMap, duplicateMap, false));
+
+  // a modified fasta file has another checksum and thus another cache file
+  writeFasta(fastaFile, "MKWVTFISLLLLFSSAYSRGVFRK");
+  DigestCache reader(".");
+  ASSERT_TRUE(initKey(reader, 6));
+  EXPECT_NE(writer.getCacheFile(), reader.getCacheFile());
+  std::map<std::string, std::string> fragments, duplicates;
+  bool hasDecoys = false;
+  EXPECT_FALSE(reader.load(fragments, duplicates, hasDecoys));
+  EXPECT_TRUE(fragments.empty());
+  EXPECT_TRUE(duplicates.empty());
+}
+
+TEST_F(DigestCacheTest, KeyMismatchForcesRebuild) {
+  DigestCache writer(".");
+  ASSERT_TRUE(initKey(writer, 6));
+  ASSERT_TRUE(writer.store(fragmentMap, duplicateMap, false));
+
+  // other digestion parameters give another key; a cache file written for
+  // another key is rejected even if it has the name of this key
+  DigestCache reader(".");
+  ASSERT_TRUE(initKey(reader, 7));
+  EXPECT_NE(writer.getCacheFile(), reader.getCacheFile());
+  ASSERT_EQ(0, rename(writer.getCacheFile().c_str(), reader.getCacheFile().c_str()));
+  std::map<std::string, std::string> fragments, duplicates;
+  bool hasDecoys = false;
+  EXPECT_FALSE(reader.load(fragments, duplicates, hasDecoys));
+  EXPECT_TRUE(fragments.empty());
+  EXPECT_TRUE(duplicates.empty());
+}
+
+TEST_F(DigestCacheTest, TruncatedFileForcesRebuild) {
+  DigestCache writer(".");
+  ASSERT_TRUE(initKey(writer, 6));
+  ASSERT_TRUE(writer.store(fragmentMap, duplicateMap, false));
+
+  std::ifstream in(writer.getCacheFile().c_str(), std::ios::in | std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream out(writer.getCacheFile().c_str(), std::ios::out | std::ios::binary);
+  out.write(contents.data(), contents.size() - 4);
+  out.close();
+
+  std::map<std::string, std::string> fragments, duplicates;
+  bool hasDecoys = false;
+  EXPECT_FALSE(writer.load(fragments, duplicates, hasDecoys));
+  EXPECT_TRUE(fragments.empty());
+  EXPECT_TRUE(duplicates.empty());
+}
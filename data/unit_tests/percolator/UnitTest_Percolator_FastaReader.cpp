@@ -0,0 +1,97 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the FastaReader class */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "FastaReader.cpp"
+
+class FastaReaderTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    fastaFile = "fasta_reader_test.fasta";
+  }
+  virtual void TearDown() {
+    remove(fastaFile.c_str());
+  }
+
+  void writeFasta(const std::string& contents) {
+    std::ofstream out(fastaFile.c_str(), std::ios::out | std::ios::binary);
+    out << contents;
+  }
+
+  std::string fastaFile;
+};
+
+TEST_F(FastaReaderTest, WrappedRecords) {
+  writeFasta(">protein_1 first protein\r\nMKWVT\r\nFISLL\r\n"
+             ">protein_2\tsecond\nLLFSS AYSR\n\n>protein_3");
+  FastaReader fasta;
+  ASSERT_TRUE(fasta.open(fastaFile));
+  EXPECT_TRUE(fasta.getPreamble() == NULL);
+  ASSERT_EQ(3u, fasta.size());
+
+  std::string sequence;
+  EXPECT_EQ("protein_1", fasta[0].getId());
+  EXPECT_EQ("first protein",
+            std::string(fasta[0].description, fasta[0].descriptionLength));
+  EXPECT_EQ(0u, fasta[0].offset);
+  FastaReader::foldSequence(fasta[0], sequence);
+  EXPECT_EQ("MKWVTFISLL", sequence);
+
+  EXPECT_EQ("protein_2", fasta[1].getId());
+  EXPECT_EQ("second", std::string(fasta[1].description, fasta[1].descriptionLength));
+  FastaReader::foldSequence(fasta[1], sequence);
+  EXPECT_EQ("LLFSSAYSR", sequence);
+
+  // a final header without a line break or sequence
+  EXPECT_EQ("protein_3", fasta[2].getId());
+  EXPECT_EQ(0u, fasta[2].descriptionLength);
+  char buffer[1];
+  EXPECT_EQ(0u, FastaReader::foldSequence(fasta[2], buffer));
+  EXPECT_EQ('\0', buffer[0]);
+}
+
+TEST_F(FastaReaderTest, RecordsPointIntoTheFile) {
+  std::string contents = "\n>protein_1\nMKWVT\nFISLL\n>protein_2\nLLFSS\n";
+  writeFasta(contents);
+  FastaReader fasta;
+  ASSERT_TRUE(fasta.open(fastaFile));
+  ASSERT_EQ(2u, fasta.size());
+  EXPECT_EQ(1u, fasta[0].offset);
+  EXPECT_EQ(contents.find(">protein_2"), fasta[1].offset);
+  EXPECT_EQ("MKWVT\nFISLL\n", std::string(fasta[0].body, fasta[0].bodyLength));
+  // the body of a record ends at the '>' of the next header
+  EXPECT_EQ(fasta[1].id - 1, fasta[0].body + fasta[0].bodyLength);
+}
+
+TEST_F(FastaReaderTest, ContentBeforeFirstHeader) {
+  writeFasta(" \nMKWVT\n>protein_1\nFISLL\n");
+  FastaReader fasta;
+  ASSERT_TRUE(fasta.open(fastaFile));
+  ASSERT_TRUE(fasta.getPreamble() != NULL);
+  EXPECT_EQ('M', *fasta.getPreamble());
+  EXPECT_EQ(1u, fasta.size());
+}
+
+TEST_F(FastaReaderTest, MissingFile) {
+  FastaReader fasta;
+  EXPECT_FALSE(fasta.open("fasta_reader_missing.fasta"));
+  EXPECT_EQ(0u, fasta.size());
+}
@@ -24,6 +24,8 @@
  */
 
 #include "UnitTest_Percolator_Fido.cpp"
+#include "UnitTest_Percolator_DigestCache.cpp"
+#include "UnitTest_Percolator_FastaReader.cpp"
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -369,6 +369,10 @@ bool Caller::parseOptions(int argc, char **argv) {
       "train-fdr-initial",
       "Set the FDR threshold for the first iteration. This is useful in cases where the original features do not display a good separation between targets and decoys. In subsequent iterations, the normal --trainFDR will be used.",
       "value");
+  cmd.defineOption(Option::EXPERIMENTAL_FEATURE,
+      "picked-protein-digest-cache",
+      "Directory in which the result of the in silico digest for picked protein-level FDR estimation is cached. Subsequent runs with the same fasta file and digestion parameters read the protein fragments and duplicates from the cache instead of digesting the fasta file again.",
+      "directory");
   cmd.defineOption(Option::EXPERIMENTAL_FEATURE,
       "parameter-file",
       "Read flags from a parameter file. If flags are specified on the command line as well, these will override the ones in the parameter file.",
@@ -543,13 +547,15 @@ bool Caller::parseOptions(int argc, char **argv) {
       //if (cmd.optionSet("Q")) pickedProteinPvalueCutoff = cmd.getDouble("Q", 0.0, 1.0);
       if (cmd.optionSet("protein-report-fragments")) pickedProteinReportFragmentProteins = true;
       if (cmd.optionSet("protein-report-duplicates")) pickedProteinReportDuplicateProteins = true;
+      std::string pickedProteinDigestCacheDir = "";
+      if (cmd.optionSet("picked-protein-digest-cache")) pickedProteinDigestCacheDir = cmd.options["picked-protein-digest-cache"];
 
       protEstimator_ = new PickedProteinInterface(fastaDatabase,
           pickedProteinPvalueCutoff, pickedProteinReportFragmentProteins,
           pickedProteinReportDuplicateProteins,
           protEstimatorTrivialGrouping, protEstimatorAbsenceRatio,
           protEstimatorOutputEmpirQVal, protEstimatorDecoyPrefix,
-          protEstimatorPeptideQvalThreshold);
+          protEstimatorPeptideQvalThreshold, pickedProteinDigestCacheDir);
     }
   }
 
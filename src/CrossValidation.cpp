@@ -145,6 +145,10 @@ int CrossValidation::preIterationSetup(Scores& fullset, SanityCheck* pCheck,
     for (int set = 0; set < numFolds_; ++set) {
       trainScores_[set].recalculateDescriptionOfCorrect(selectionFdr_);
       testScores_[set].getDOC().copyDOCparameters(trainScores_[set].getDOC());
+    }
+    // the test sets are handled one after the other, the retention times
+    // within each set are predicted in parallel
+    for (int set = 0; set < numFolds_; ++set) {
       testScores_[set].setDOCFeatures(pNorm);
     }
   }
@@ -270,6 +274,10 @@ int CrossValidation::doStep(bool updateDOC, Normalizer* pNorm, double selectionF
       trainScores_[set].recalculateDescriptionOfCorrect(selectionFdr);
       //trainScores_[set].setDOCFeatures(pNorm); // this overwrites features of overlapping training folds...
       testScores_[set].getDOC().copyDOCparameters(trainScores_[set].getDOC());
+    }
+    // the test sets are handled one after the other, the retention times
+    // within each set are predicted in parallel
+    for (int set = 0; set < numFolds_; ++set) {
       testScores_[set].setDOCFeatures(pNorm);
     }
   }
@@ -18,6 +18,7 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <map>
 #include <assert.h>
 #include "Globals.h"
 #include "DataSet.h"
@@ -76,8 +77,12 @@ void DescriptionOfCorrect::trainCorrect() {
 }
 
 void DescriptionOfCorrect::setFeatures(PSMDescription* psm) {
-  assert(DataSet::getFeatureNames().getDocFeatNum() > 0);
   psm->setPredictedRetentionTime(rtModel.estimateRT(psm->getRetentionFeatures()));
+  fillFeatures(psm);
+}
+
+void DescriptionOfCorrect::fillFeatures(PSMDescription* psm) {
+  assert(DataSet::getFeatureNames().getDocFeatNum() > 0);
   size_t docFeatNum = DataSet::getFeatureNames().getDocFeatNum();
   double dm = abs(psm->getMassDiff() - avgDM);
   double drt = abs(psm->getRetentionTime() - psm->getPredictedRetentionTime());
@@ -98,6 +103,10 @@ void DescriptionOfCorrect::setFeatures(PSMDescription* psm) {
 
 void DescriptionOfCorrect::setFeaturesNormalized(PSMDescription* psm, Normalizer* pNorm) {
   setFeatures(psm);
+  normalizeFeatures(psm, pNorm);
+}
+
+void DescriptionOfCorrect::normalizeFeatures(PSMDescription* psm, Normalizer* pNorm) {
   size_t docFeatNum = DataSet::getFeatureNames().getDocFeatNum();
   if (docFeatures & 1) {
     psm->features[docFeatNum] = pNorm->normalize(psm->features[docFeatNum], docFeatNum);
@@ -114,6 +123,74 @@ void DescriptionOfCorrect::setFeaturesNormalized(PSMDescription* psm, Normalizer
   }
 }
 
+// The retention features only depend on the peptide, so the retention time is
+// predicted once per peptide, for all peptides in one batch.
+void DescriptionOfCorrect::setFeaturesNormalized(vector<PSMDescription*>& psms, Normalizer* pNorm) {
+  int numPsms = static_cast<int>(psms.size());
+  map<string, size_t> peptideIx;
+  vector<size_t> predictionIx(numPsms);
+  vector<double*> features;
+  for (int ix = 0; ix < numPsms; ++ix) {
+    pair<map<string, size_t>::iterator, bool> ins = peptideIx.insert(
+        make_pair(psms[ix]->getFullPeptide(), features.size()));
+    if (ins.second) {
+      features.push_back(psms[ix]->getRetentionFeatures());
+    }
+    predictionIx[ix] = ins.first->second;
+  }
+  vector<double> predicted;
+  rtModel.estimateRT(features, predicted);
+  #pragma omp parallel for schedule(static)
+  for (int ix = 0; ix < numPsms; ++ix) {
+    psms[ix]->setPredictedRetentionTime(predicted[predictionIx[ix]]);
+    fillFeatures(psms[ix]);
+    normalizeFeatures(psms[ix], pNorm);
+  }
+}
+
+// The pH values visited by the bisection only depend on the signs of the net
+// charges, so the denominators of every possible step are computed once.
+vector<DescriptionOfCorrect::IsoStep> DescriptionOfCorrect::buildIsoSteps() {
+  double epsilon = 0.01;
+  vector<IsoStep> steps(1);
+  vector<double> low(1, 2.0), high(1, 13.0);
+  steps[0].pH = 6.5;
+  for (size_t st = 0; st < steps.size(); ++st) {
+    double pH = steps[st].pH, pHlow = low[st], pHhigh = high[st];
+    steps[st].done = !((pH - pHlow > epsilon) || (pHhigh - pH > epsilon));
+    if (steps[st].done) {
+      continue;
+    }
+    steps[st].denomN = 1 + pow(10, (pH - pKN));
+    steps[st].denomC = 1 + pow(10, (pKC - pH));
+    steps[st].denomAA.resize(isoAlphabet.size());
+    for (size_t ix = 0; ix < isoAlphabet.size(); ix++) {
+      if (pKiso[ix] > 0) {
+        steps[st].denomAA[ix] = 1 + pow(10, (pH - pKiso[ix]));
+      } else {
+        steps[st].denomAA[ix] = 1 + pow(10, (-pKiso[ix] - pH));
+      }
+    }
+    IsoStep next;
+    next.pH = pH - ((pH - pHlow) / 2);
+    steps[st].next[0] = static_cast<int>(steps.size());
+    steps.push_back(next);
+    low.push_back(pHlow);
+    high.push_back(pH);
+    next.pH = pH + ((pHhigh - pH) / 2);
+    steps[st].next[1] = static_cast<int>(steps.size());
+    steps.push_back(next);
+    low.push_back(pH);
+    high.push_back(pHhigh);
+  }
+  return steps;
+}
+
+const vector<DescriptionOfCorrect::IsoStep>& DescriptionOfCorrect::isoSteps() {
+  static const vector<IsoStep> steps = buildIsoSteps();
+  return steps;
+}
+
 double DescriptionOfCorrect::isoElectricPoint(const string& pep) {
   // Overall amino acid composition features
   string::size_type pos = isoAlphabet.size();
@@ -124,28 +201,22 @@ double DescriptionOfCorrect::isoElectricPoint(const string& pep) {
       numAA[pos]++;
     }
   }
-  double pH = 6.5, pHlow = 2.0, pHhigh = 13.0;
-  double epsilon = 0.01;
-  while ((pH - pHlow > epsilon) || (pHhigh - pH > epsilon)) {
-    double NQ = 1 / (1 + pow(10, (pH - pKN))) - 1 / (1 + pow(10,
-                                                             (pKC - pH)));
+  const vector<IsoStep>& steps = isoSteps();
+  const IsoStep* step = &steps[0];
+  while (!step->done) {
+    double NQ = 1 / step->denomN - 1 / step->denomC;
     for (size_t ix = 0; ix < numAA.size(); ix++) {
       if (numAA[ix] == 0) {
         continue;
       }
       if (pKiso[ix] > 0) {
-        NQ += numAA[ix] / (1 + pow(10, (pH - pKiso[ix])));
+        NQ += numAA[ix] / step->denomAA[ix];
       } else {
-        NQ -= numAA[ix] / (1 + pow(10, (-pKiso[ix] - pH)));
+        NQ -= numAA[ix] / step->denomAA[ix];
       }
     }
-    if (NQ < 0) { //Bisection method
-      pHhigh = pH;
-      pH -= ((pH - pHlow) / 2);
-    } else {
-      pHlow = pH;
-      pH += ((pHhigh - pH) / 2);
-    }
+    //Bisection method
+    step = &steps[step->next[NQ < 0 ? 0 : 1]];
   }
-  return pH;
+  return step->pH;
 }
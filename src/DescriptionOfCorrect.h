@@ -50,10 +50,11 @@ class DescriptionOfCorrect {
     void trainCorrect();
     void setFeatures(PSMDescription* psm);
     void setFeaturesNormalized(PSMDescription* psm, Normalizer* pNorm);
+    void setFeaturesNormalized(vector<PSMDescription*>& psms, Normalizer* pNorm);
     //static size_t totalNumRTFeatures() {return (doKlammer?64:minimumNumRTFeatures() + 20);}
     //static size_t minimumNumRTFeatures() {return 3*10+1+3;}
     void print_10features();
-    svm_model* getModel() {
+    const SharedSVMModel& getModel() {
       return rtModel.getModel();
     }
     size_t getRTFeat() {
@@ -66,6 +67,7 @@ class DescriptionOfCorrect {
       //    avgPI = other.avgPI; avgDM = other.avgDM; rtW = other.rtW; numRTFeat = other.numRTFeat;
       avgPI = other.avgPI;
       avgDM = other.avgDM;
+      // the svr model is shared, not copied
       rtModel.copyModel(other.getModel());
       rtModel.setNumRtFeat(other.getRTFeat());
     }
@@ -74,6 +76,20 @@ class DescriptionOfCorrect {
     }
 
   protected:
+    // one step of the bisection in isoElectricPoint, with the denominators
+    // of the charges of the termini and of each residue in isoAlphabet
+    struct IsoStep {
+      double pH;
+      bool done;
+      double denomN, denomC;
+      vector<double> denomAA; // one per residue of isoAlphabet
+      int next[2]; // next step for a negative and a non-negative charge
+    };
+    static vector<IsoStep> buildIsoSteps();
+    static const vector<IsoStep>& isoSteps();
+    void fillFeatures(PSMDescription* psm);
+    void normalizeFeatures(PSMDescription* psm, Normalizer* pNorm);
+
     double avgPI, avgDM;
     std::vector<PSMDescription*> psms;
     //  vector<double> rtW;
@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include <vector>
+#include <map>
 #include <string>
 #include <cstring>
 #include <cmath>
@@ -237,7 +238,7 @@ static int DEFAULT_FEATURE_GROUPS = 1 + 32 + 128 + 1024 + 2048 + 4096
     + 8192;
 
 RTModel::RTModel() :
-  model(NULL), index_model(NULL), c(INITIAL_C), gamma(INITIAL_GAMMA),
+  index_model(NULL), c(INITIAL_C), gamma(INITIAL_GAMMA),
       epsilon(INITIAL_EPSILON), stepFineGrid(STEP_FINE_GRID),
       noPointsFineGrid(NO_POINTS_FINE_GRID), calibrationFile(""),
       saveCalibration(false), k(DEFAULT_K), gType(NORMAL_GRID),
@@ -745,75 +746,47 @@ void RTModel::calcRetentionFeatures(PSMDescription* psm) {
   //cout << psm << endl;
 }
 
-// calculate the retention features for a vector of PSMs
+// calculate the retention features for a vector of PSMs; the features are computed
+// in parallel, once per distinct peptide, and copied to the other PSMs of the peptide
 void RTModel::calcRetentionFeatures(vector<PSMDescription*> &psms) {
-  vector<PSMDescription*>::iterator it;
   if (VERB > 2) {
     cerr << endl << "Computing retention features..." << endl;
   }
-  for (it = psms.begin(); it != psms.end(); ++it) {
-    calcRetentionFeatures(*it);
+  int noPsms = psms.size();
+  map<string, int> firstPsm;
+  vector<int> source(noPsms, -1);
+  vector<int> distinct;
+  for (int ix = 0; ix < noPsms; ++ix) {
+    if (psms[ix]->getRetentionFeatures() == NULL) {
+      continue;
+    }
+    pair<map<string, int>::iterator, bool> ins =
+        firstPsm.insert(make_pair(psms[ix]->getPeptideSequence(), ix));
+    if (ins.second) {
+      distinct.push_back(ix);
+    } else {
+      source[ix] = ins.first->second;
+    }
+  }
+  int noDistinct = distinct.size();
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int ix = 0; ix < noDistinct; ++ix) {
+    calcRetentionFeatures(psms[distinct[ix]]);
+  }
+  for (int ix = 0; ix < noPsms; ++ix) {
+    if (source[ix] >= 0) {
+      memcpy(psms[ix]->getRetentionFeatures(),
+             psms[source[ix]]->getRetentionFeatures(),
+             noFeaturesToCalc * sizeof(double));
+    } else if (psms[ix]->getRetentionFeatures() == NULL) {
+      calcRetentionFeatures(psms[ix]);
+    }
   }
   if (VERB > 2) {
     cerr << "Done. " << endl;
   }
 }
 
-// save an svm model in the global variable model
-void RTModel::copyModel(svm_model* from) {
-  // destroy an existant model
-  if (model != NULL) {
-    svm_destroy_model(model);
-  }
-  model = (svm_model*)malloc(sizeof(svm_model));
-  model->param = from->param;
-  model->nr_class = from->nr_class;
-  model->l = from->l; // total #SV
-  // _DENSE_REP
-  model->SV = (svm_node*)malloc(sizeof(svm_node) * model->l);
-  for (int i = 0; i < model->l; ++i) {
-    model->SV[i].dim = from->SV[i].dim;
-    model->SV[i].values = (double*)malloc(sizeof(double)
-        * model->SV[i].dim);
-    memcpy(model->SV[i].values, from->SV[i].values, sizeof(double)
-        * model->SV[i].dim);
-  }
-  model->sv_coef = (double**)malloc(sizeof(double*)
-      * (model->nr_class - 1));
-  for (int i = 0; i < model->nr_class - 1; ++i) {
-    model->sv_coef[i] = (double*)malloc(sizeof(double) * (model->l));
-    memcpy(model->sv_coef[i], from->sv_coef[i], sizeof(double)
-        * (model->l));
-  }
-  int n = model->nr_class * (model->nr_class - 1) / 2;
-  if (from->rho) {
-    model->rho = (double*)malloc(sizeof(double) * n);
-    memcpy(model->rho, from->rho, sizeof(double) * n);
-  } else {
-    model->rho = NULL;
-  }
-  if (from->probA) {
-    model->probA = (double*)malloc(sizeof(double) * n);
-    memcpy(model->probA, from->probA, sizeof(double) * n);
-  } else {
-    model->probA = NULL;
-  }
-  if (from->probB) {
-    model->probB = (double*)malloc(sizeof(double) * n);
-    memcpy(model->probB, from->probB, sizeof(double) * n);
-  } else {
-    model->probB = NULL;
-  }
-  assert(from->label == NULL);
-  assert(from->nSV == NULL);
-  // for classification only
-  model->label = NULL; // label of each class (label[k])
-  model->nSV = NULL; // number of SVs for each class (nSV[k])
-  // nSV[0] + nSV[1] + ... + nSV[k-1] = l
-  // XXX
-  model->free_sv = 1; // 1 if svm_model is created by svm_load_mode                        // 0 if svm_model is created by svm_train
-}
-
 // select the first n features from; return the corresponding code
 int RTModel::getSelect(int sel_features, int max, size_t* finalNumFeatures) {
   int noFeat = 0;
@@ -829,12 +802,9 @@ int RTModel::getSelect(int sel_features, int max, size_t* finalNumFeatures) {
   return retValue;
 }
 
-// train the SVM
-void RTModel::trainRetention(vector<PSMDescription*>& trainset,
-                             const double C, const double gamma,
-                             const double epsilon, int noPsms) 
-{
-  // initialize the parameters of the SVM
+// parameters of the SVR
+svm_parameter RTModel::svrParameters(const double C, const double gamma,
+                                     const double epsilon) {
   svm_parameter param;
   param.svm_type = EPSILON_SVR;
   param.kernel_type = RBF;
@@ -851,6 +821,17 @@ void RTModel::trainRetention(vector<PSMDescription*>& trainset,
   param.nr_weight = 0;
   param.weight_label = NULL;
   param.weight = NULL;
+  return param;
+}
+
+// train a SVR with the given parameters; the model is not stored in the current object and
+// has to be destroyed by the caller. The support vectors point to the features of the psms
+svm_model* RTModel::trainModel(const vector<PSMDescription*>& trainset,
+                               const double C, const double gamma,
+                               const double epsilon) const
+{
+  // initialize the parameters of the SVM
+  svm_parameter param = svrParameters(C, gamma, epsilon);
   // initialize a SVM problem
   svm_problem data;
   data.l = trainset.size();
@@ -872,10 +853,19 @@ void RTModel::trainRetention(vector<PSMDescription*>& trainset,
     throw MyException(temp.str());
   }
   svm_model* m = svm_train(&data, &param);
-  // save the model in the current object
-  copyModel(m);
   delete[] data.x;
   delete[] data.y;
+  return m;
+}
+
+// train the SVM
+void RTModel::trainRetention(vector<PSMDescription*>& trainset,
+                             const double C, const double gamma,
+                             const double epsilon, int noPsms) 
+{
+  svm_model* m = trainModel(trainset, C, gamma, epsilon);
+  // save a packed copy of the model in the current object
+  model = SharedSVMModel(m);
   svm_destroy_model(m);
 }
 
@@ -885,34 +875,35 @@ void RTModel::trainRetention(vector<PSMDescription*>& psms) {
   size_t test_frac = 4u;
   if (psms.size() > test_frac * 10u) {
     // If we got enough data, calibrate gamma and C by leaving out a testset
-    std::vector<PSMDescription*> train, test;
-    for (size_t ix = 0; ix < psms.size(); ++ix) {
-      if (ix % test_frac == 0) {
-        test.push_back(psms[ix]);
-      } else {
-        train.push_back(psms[ix]);
-      }
-    }
-    double sizeFactor = ((double)train.size()) / ((double)psms.size());
+    vector<vector<int> > train, test;
+    splitData(psms.size(), test_frac, 1, train, test);
+    double sizeFactor = ((double)train[0].size()) / ((double)psms.size());
     double bestRms = 1e100;
     double gammaV[3] = { gamma / 2, gamma, gamma * 2 };
     double cV[3] = { c / 2. / sizeFactor, c / sizeFactor, c * 2.
         / sizeFactor };
     double epsilonV[3] = { epsilon / 2, epsilon, epsilon * 2 };
+    vector<double> gammas, cs, epsilons, rms;
     for (double* gammaNow = &gammaV[0]; gammaNow != &gammaV[3]; gammaNow++) {
       for (double* cNow = &cV[0]; cNow != &cV[3]; cNow++) {
         for (double* epsilonNow = &epsilonV[0]; epsilonNow != &epsilonV[3]; epsilonNow++) {
-          trainRetention(train,
-                         *cNow,
-                         (*gammaNow) / ((double)psms.size()),
-                         *epsilonNow,
-                         train.size());
-          double rms = testRetention(test);
-          if (rms < bestRms) {
+          gammas.push_back((*gammaNow) / ((double)psms.size()));
+          cs.push_back(*cNow);
+          epsilons.push_back(*epsilonNow);
+        }
+      }
+    }
+    evaluateFolds(psms, train, test, gammas, cs, epsilons, rms);
+    // pick the first combination with the lowest error, as when evaluating them one by one
+    size_t ix = 0;
+    for (double* gammaNow = &gammaV[0]; gammaNow != &gammaV[3]; gammaNow++) {
+      for (double* cNow = &cV[0]; cNow != &cV[3]; cNow++) {
+        for (double* epsilonNow = &epsilonV[0]; epsilonNow != &epsilonV[3]; epsilonNow++, ix++) {
+          if (rms[ix] < bestRms) {
             c = *cNow;
             gamma = *gammaNow;
             epsilon = *epsilonNow;
-            bestRms = rms;
+            bestRms = rms[ix];
           }
         }
       }
@@ -928,38 +919,188 @@ void RTModel::trainRetention(vector<PSMDescription*>& psms) {
                  psms.size());
 }
 
+// split the psms in training and test sets; in fold i, the psms at positions j with (j % modulus) == i
+// are tested and the rest are used for training. The sets hold the positions of the psms
+void RTModel::splitData(const size_t noPsms,
+                        const size_t modulus, const size_t noFolds,
+                        vector<vector<int> >& trainSets,
+                        vector<vector<int> >& testSets) {
+  trainSets.assign(noFolds, vector<int>());
+  testSets.assign(noFolds, vector<int>());
+  for (size_t i = 0; i < noFolds; ++i) {
+    for (size_t j = 0; j < noPsms; ++j) {
+      if ((j % modulus) == i) {
+        testSets[i].push_back(j);
+      } else {
+        trainSets[i].push_back(j);
+      }
+    }
+  }
+}
+
+// train on one training set and return the mean squared prediction error on the test set. If a
+// kernel matrix is given, the model is trained on its rows and then turned back into a model of
+// the original vectors and kernel
+double RTModel::evaluateFold(const vector<svm_node>& x, const vector<double>& y,
+                             const svm_kernel_matrix* km,
+                             const vector<int>& train, const vector<int>& test,
+                             const double C, const double gamma,
+                             const double epsilon) const {
+  svm_parameter param = svrParameters(C, gamma, epsilon);
+  if (km != NULL) {
+    param.kernel_type = PRECOMPUTED;
+  }
+  svm_problem data;
+  data.l = train.size();
+  data.x = new svm_node[data.l];
+  data.y = new double[data.l];
+  for (size_t ix1 = 0; ix1 < train.size(); ix1++) {
+    data.x[ix1] = (km != NULL) ? km->rows[train[ix1]] : x[train[ix1]];
+    data.y[ix1] = y[train[ix1]];
+  }
+  char const *err_msg = svm_check_parameter(&data, &param);
+  if (err_msg != NULL) {
+    delete[] data.x;
+    delete[] data.y;
+    ostringstream temp;
+    temp << "Error : Incorrect parameters for the SVR." << endl
+         << err_msg << endl << "Execution aborted."<< endl;
+    throw MyException(temp.str());
+  }
+  svm_model* m = svm_train(&data, &param);
+  delete[] data.x;
+  delete[] data.y;
+  if (km != NULL) {
+    svm_restore_kernel_matrix_model(km, m);
+  }
+  vector<svm_node> testNodes(test.size());
+  vector<double> predictions(test.size());
+  for (size_t ix1 = 0; ix1 < test.size(); ix1++) {
+    testNodes[ix1] = x[test[ix1]];
+  }
+  if (!test.empty()) {
+    svm_predict_batch(m, &testNodes[0], testNodes.size(), &predictions[0]);
+  }
+  double rms = 0.0;
+  for (size_t ix1 = 0; ix1 < test.size(); ix1++) {
+    double estimatedRT = predictions[ix1];
+    if (!isfinite(estimatedRT)) {
+      estimatedRT = 0.0;
+    }
+    double diff = estimatedRT - y[test[ix1]];
+    rms += diff * diff;
+  }
+  svm_destroy_model(m);
+  return rms / test.size();
+}
+
+// evaluate the combinations (gammas[i], cs[i], epsilons[i]) on the given folds; errors[i] is the
+// mean over the folds of the mean squared prediction error. Each combination and fold is trained
+// as a separate task; all tasks only read the psms, and the errors are summed in the order of the
+// folds so that the result does not depend on the number of threads. The combinations are
+// evaluated gamma by gamma, and unless there are too many psms, or the kernel matrices of
+// concurrent calibrations use up SVM_KERNEL_MATRIX_BUDGET, the kernel matrix of all psms is
+// computed once per gamma and shared by all the tasks of that gamma
+void RTModel::evaluateFolds(const vector<PSMDescription*>& psms,
+                            const vector<vector<int> >& trainSets,
+                            const vector<vector<int> >& testSets,
+                            const vector<double>& gammas,
+                            const vector<double>& cs,
+                            const vector<double>& epsilons,
+                            vector<double>& errors) const {
+  vector<svm_node> x(psms.size());
+  vector<double> y(psms.size());
+  for (size_t ix = 0; ix < psms.size(); ++ix) {
+    x[ix].values = psms[ix]->getRetentionFeatures();
+    x[ix].dim = noFeaturesToCalc;
+    y[ix] = psms[ix]->getRetentionTime();
+  }
+  svm_kernel_matrix* km = NULL;
+  if (!psms.empty() && !gammas.empty()) {
+    int kernelType = svrParameters(cs[0], gammas[0], epsilons[0]).kernel_type;
+    km = svm_create_kernel_matrix(&x[0], x.size(), kernelType);
+  }
+  int noFolds = trainSets.size();
+  vector<double> foldErrors(gammas.size() * noFolds, 0.0);
+  vector<string> taskErrors(gammas.size() * noFolds);
+  vector<bool> done(gammas.size(), false);
+  for (size_t first = 0; first < gammas.size(); ++first) {
+    if (done[first]) {
+      continue;
+    }
+    // the tasks with the same gamma as the first combination not evaluated yet
+    vector<int> tasks;
+    for (size_t point = first; point < gammas.size(); ++point) {
+      if (!done[point] && gammas[point] == gammas[first]) {
+        done[point] = true;
+        for (int fold = 0; fold < noFolds; ++fold) {
+          tasks.push_back(point * noFolds + fold);
+        }
+      }
+    }
+    if (km != NULL && km->kernel_type == RBF) {
+      svm_set_kernel_matrix_gamma(km, gammas[first]);
+    }
+    int noTasks = tasks.size();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int ix = 0; ix < noTasks; ++ix) {
+      int task = tasks[ix];
+      int point = task / noFolds, fold = task % noFolds;
+      try {
+        foldErrors[task] = evaluateFold(x, y, km, trainSets[fold], testSets[fold],
+                                        cs[point], gammas[point], epsilons[point]);
+      } catch (MyException& e) {
+        taskErrors[task] = e.what();
+      }
+    }
+  }
+  svm_destroy_kernel_matrix(km);
+  for (size_t task = 0; task < taskErrors.size(); ++task) {
+    if (!taskErrors[task].empty()) {
+      throw MyException(taskErrors[task]);
+    }
+  }
+  errors.assign(gammas.size(), 0.0);
+  for (size_t point = 0; point < gammas.size(); ++point) {
+    double sumPEs = 0.0;
+    for (int fold = 0; fold < noFolds; ++fold) {
+      sumPEs += foldErrors[point * noFolds + fold];
+    }
+    errors[point] = sumPEs / (double)noFolds;
+  }
+}
+
+// evaluate the combinations of parameters using the evaluation type of the model
+void RTModel::evaluateGrid(const vector<PSMDescription*>& psms,
+                           const vector<double>& gammas,
+                           const vector<double>& cs,
+                           const vector<double>& epsilons,
+                           vector<double>& errors) const {
+  vector<vector<int> > train, test;
+  if (eType == SIMPLE_EVAL) {
+    splitData(psms.size(), 4u, 1u, train, test);
+  } else {
+    splitData(psms.size(), k, k, train, test);
+  }
+  evaluateFolds(psms, train, test, gammas, cs, epsilons, errors);
+}
+
 // perform k-validation and return as estimate of the prediction error CV = 1/k (sum(PE(k))), where PE(k)=(sum(yi - yi_pred)^2)/size
 double RTModel::computeKfoldCV(const vector<PSMDescription*> & psms,
                                const double gamma, const double epsilon,
                                const double c) {
-  vector<PSMDescription*> train, test;
-  unsigned int noPsms;
-  // sum of prediction errors
-  double sumPEs, PEk;
-  noPsms = psms.size();
-  sumPEs = 0;
+  vector<vector<int> > train, test;
+  vector<double> errors;
   if (VERB > 2) {
     cerr << k << " fold cross validation..." << endl;
   }
-  for (unsigned int i = 0; i < k; ++i) {
-    train.clear();
-    test.clear();
-    // get training and testing sets
-    for (unsigned int j = 0; j < noPsms; ++j) {
-      if ((j % k) == i) {
-        test.push_back(psms[j]);
-      } else {
-        train.push_back(psms[j]);
-      }
-    }
-    trainRetention(train, c, gamma, epsilon, noPsms);
-    PEk = testRetention(test);
-    sumPEs += PEk;
-  }
+  splitData(psms.size(), k, k, train, test);
+  evaluateFolds(psms, train, test, vector<double>(1, gamma), vector<double>(1, c),
+               vector<double>(1, epsilon), errors);
   if (VERB > 2) {
     cerr << "Done." << endl;
   }
-  return (sumPEs / (double)k);
+  return errors[0];
 }
 
 // simple evaluation; just divide the data in 4 parts, train on three of them and test on the 4th; return the ms of diff
@@ -968,9 +1109,9 @@ double RTModel::computeSimpleEvaluation(
                                         const double gamma,
                                         const double epsilon,
                                         const double c) {
-  vector<PSMDescription*> train, test;
+  vector<vector<int> > train, test;
+  vector<double> errors;
   unsigned int noPsms;
-  double ms;
   // how many parts will the data be split in
   size_t test_frac;
   test_frac = 4u;
@@ -983,21 +1124,14 @@ double RTModel::computeSimpleEvaluation(
   if (VERB > 2) {
     cerr << "Simple evaluation..." << endl;
   }
-  // build train and test set
-  for (size_t i = 0; i < noPsms; ++i) {
-    if (i % test_frac == 0) {
-      test.push_back(psms[i]);
-    } else {
-      train.push_back(psms[i]);
-    }
-  }
-  // train the model and test it
-  trainRetention(train, c, gamma, epsilon, noPsms);
-  ms = testRetention(test);
+  // build train and test set, train the model and test it
+  splitData(noPsms, test_frac, 1u, train, test);
+  evaluateFolds(psms, train, test, vector<double>(1, gamma), vector<double>(1, c),
+               vector<double>(1, epsilon), errors);
   if (VERB > 2) {
     cerr << "Done." << endl;
   }
-  return ms;
+  return errors[0];
 }
 
 // train the Support Vector Regressor
@@ -1020,6 +1154,7 @@ void RTModel::trainSVM(vector<PSMDescription*> & psms) {
   double gamma = 0.0, epsilon = 0.0, c = 0.0;
   double bestError = 1e100, error;
   vector<double>::iterator it1, it2, it3;
+  vector<double> gammas, cs, epsilons, errors;
   int totalIterations = grids.gridGamma.size() * grids.gridC.size()
       * grids.gridEpsilon.size();
   int step = 0;
@@ -1031,41 +1166,45 @@ void RTModel::trainSVM(vector<PSMDescription*> & psms) {
     cerr << "Calibrating (gamma, epsilon, c)..." << endl;
     cerr << "------------------------------" << endl;
   }
-  // grid search to calibrate parameters
+  if ((VERB >= 2) && (eType == SIMPLE_EVAL) && (noPsms < 40)) {
+    cerr << "Warning: very little data to calibrate parameters (just "
+        << noPsms << "), parameter values may be unreliable" << endl;
+  }
+  // grid search to calibrate parameters; all points of the grid are evaluated in parallel
+  // and reported in the order of the grid
   for (it1 = grids.gridGamma.begin(); it1 != grids.gridGamma.end(); ++it1) {
     for (it2 = grids.gridC.begin(); it2 != grids.gridC.end(); ++it2) {
       for (it3 = grids.gridEpsilon.begin(); it3 != grids.gridEpsilon.end(); ++it3) {
-        ++step;
-        if (VERB > 2) {
-          cerr << "Step " << step << " / " << totalIterations << endl;
-          cerr << "Evaluate = (gamma, C, epsilon) = (" << (*it1) << ", "
-              << (*it2) << ", " << (*it3) << ")" << endl;
-        }
-        if (eType == SIMPLE_EVAL) {
-          error = computeSimpleEvaluation(psms, (*it1), (*it3), (*it2));
-        } else {
-          error = computeKfoldCV(psms, (*it1), (*it3), (*it2));
-        }
-        if (VERB > 2) {
-          cerr << "Error = " << error << endl;
-        }
-        // save info to the calibration file
-        if (saveCalibration) {
-          calFile << (*it1) << "\t" << (*it2) << "\t" << (*it3) << "\t"
-              << error << "\n";
-        }
-        if (error < bestError) {
-          c = (*it2);
-          gamma = (*it1);
-          epsilon = (*it3);
-          bestError = error;
-        }
-        if (VERB > 2) {
-          cerr << endl;
-        }
+        gammas.push_back(*it1);
+        cs.push_back(*it2);
+        epsilons.push_back(*it3);
       }
     }
   }
+  evaluateGrid(psms, gammas, cs, epsilons, errors);
+  for (step = 0; step < totalIterations; ++step) {
+    error = errors[step];
+    if (VERB > 2) {
+      cerr << "Step " << step + 1 << " / " << totalIterations << endl;
+      cerr << "Evaluate = (gamma, C, epsilon) = (" << gammas[step] << ", "
+          << cs[step] << ", " << epsilons[step] << ")" << endl;
+      cerr << "Error = " << error << endl;
+    }
+    // save info to the calibration file
+    if (saveCalibration) {
+      calFile << gammas[step] << "\t" << cs[step] << "\t" << epsilons[step] << "\t"
+          << error << "\n";
+    }
+    if (error < bestError) {
+      c = cs[step];
+      gamma = gammas[step];
+      epsilon = epsilons[step];
+      bestError = error;
+    }
+    if (VERB > 2) {
+      cerr << endl;
+    }
+  }
   if (VERB >= 2) {
     cerr << "Done." << endl;
   }
@@ -1087,35 +1226,35 @@ void RTModel::trainSVM(vector<PSMDescription*> & psms) {
       fGridGamma.push_back(gamma * offset);
     }
     totalIterations = fGridGamma.size() * fGridC.size();
-    step = 0;
-    // fine grid search to calibrate parameters
+    gammas.clear();
+    cs.clear();
     for (it1 = fGridGamma.begin(); it1 != fGridGamma.end(); ++it1) {
       for (it2 = fGridC.begin(); it2 != fGridC.end(); ++it2) {
-        ++step;
-        if (VERB > 2) {
-          cerr << endl << "Step " << step << " / " << totalIterations
-              << endl;
-          cerr << "Evaluate (gamma, c, epsilon) = " << (*it1) << ", "
-              << (*it2) << ", " << epsilon << ")" << endl;
-        }
-        if (eType == SIMPLE_EVAL) {
-          error = computeSimpleEvaluation(psms, (*it1), epsilon, (*it2));
-        } else {
-          error = computeKfoldCV(psms, (*it1), epsilon, (*it2));
-        }
-        if (VERB > 2) {
-          cerr << "Error = " << error << endl;
-        }
-        // save info to the calibration file
-        if (saveCalibration) {
-          calFile << (*it1) << "\t" << (*it2) << "\t" << (*it3) << "\t"
-              << error << "\n";
-        }
-        if (error < bestError) {
-          c = (*it2);
-          gamma = (*it1);
-          bestError = error;
-        }
+        gammas.push_back(*it1);
+        cs.push_back(*it2);
+      }
+    }
+    epsilons.assign(totalIterations, epsilon);
+    // fine grid search to calibrate parameters
+    evaluateGrid(psms, gammas, cs, epsilons, errors);
+    for (step = 0; step < totalIterations; ++step) {
+      error = errors[step];
+      if (VERB > 2) {
+        cerr << endl << "Step " << step + 1 << " / " << totalIterations
+            << endl;
+        cerr << "Evaluate (gamma, c, epsilon) = " << gammas[step] << ", "
+            << cs[step] << ", " << epsilon << ")" << endl;
+        cerr << "Error = " << error << endl;
+      }
+      // save info to the calibration file
+      if (saveCalibration) {
+        calFile << gammas[step] << "\t" << cs[step] << "\t" << epsilon << "\t"
+            << error << "\n";
+      }
+      if (error < bestError) {
+        c = cs[step];
+        gamma = gammas[step];
+        bestError = error;
       }
     }
   }
@@ -1144,10 +1283,28 @@ void RTModel::trainSVM(vector<PSMDescription*> & psms) {
 
 // test the svm on the given test set
 double RTModel::testRetention(vector<PSMDescription*>& testset) {
+  return testModel(model.get(), testset);
+}
+
+// mean squared error of the retention times predicted by the given model
+double RTModel::testModel(const svm_model* m,
+                          const vector<PSMDescription*>& testset) const {
   double rms = 0.0;
   double estimatedRT;
+  vector<svm_node> nodes(testset.size());
+  vector<double> predictions(testset.size());
+  for (size_t ix1 = 0; ix1 < testset.size(); ix1++) {
+    nodes[ix1].values = testset[ix1]->getRetentionFeatures();
+    nodes[ix1].dim = noFeaturesToCalc;
+  }
+  if (!testset.empty()) {
+    svm_predict_batch(m, &nodes[0], nodes.size(), &predictions[0]);
+  }
   for (size_t ix1 = 0; ix1 < testset.size(); ix1++) {
-    estimatedRT = estimateRT(testset[ix1]->getRetentionFeatures());
+    estimatedRT = predictions[ix1];
+    if (!isfinite(estimatedRT)) {
+      estimatedRT = 0.0;
+    }
     double diff = estimatedRT - testset[ix1]->getRetentionTime();
     rms += diff * diff;
   }
@@ -1160,13 +1317,34 @@ double RTModel::estimateRT(double* features) {
   svm_node node;
   node.values = features;
   node.dim = noFeaturesToCalc;
-  predicted_value = svm_predict(model, &node);
+  predicted_value = svm_predict(model.get(), &node);
   if (!isfinite(predicted_value)) {
     predicted_value = 0.0;
   }
   return predicted_value;
 }
 
+// estimate the retention time of a set of feature vectors at once
+void RTModel::estimateRT(const vector<double*>& features,
+                         vector<double>& predicted) {
+  int n = features.size();
+  predicted.resize(n);
+  if (n == 0) {
+    return;
+  }
+  vector<svm_node> nodes(n);
+  for (int ix = 0; ix < n; ++ix) {
+    nodes[ix].values = features[ix];
+    nodes[ix].dim = noFeaturesToCalc;
+  }
+  svm_predict_batch(model.get(), &nodes[0], n, &predicted[0]);
+  for (int ix = 0; ix < n; ++ix) {
+    if (!isfinite(predicted[ix])) {
+      predicted[ix] = 0.0;
+    }
+  }
+}
+
 /*
  * EXPERIMENTAL - try to train a hydrophobicity scale using a linear SVR; the weights will give the "hydrophobicity" of each aa
  * Since it is just an experimental try, everything is put in just one function
@@ -1555,8 +1733,8 @@ string RTModel::getEvaluationType() {
 
 // save the current model to a file
 void RTModel::saveSVRModel(const string modelFile,
-                           Normalizer* theNormalizer) {
-  assert(model != NULL);
+                           Normalizer* theNormalizer, bool binary) {
+  assert(!model.isNull());
   // initializations
   //char *model_file_name = modelFile.c_str();
   double normSub = PSMDescriptionDOC::normSubRT_;
@@ -1565,7 +1743,20 @@ void RTModel::saveSVRModel(const string modelFile,
   double* div = theNormalizer->getDiv();
   size_t* numRetFeatures = theNormalizer->getNumRetFeatures();
   // save only the SVM model
-  svm_save_model(modelFile.c_str(), model);
+  if (binary) {
+    FILE* binaryFp = fopen(modelFile.c_str(), "wb");
+    if (binaryFp == NULL || model.save(binaryFp) != 0) {
+      if (binaryFp != NULL) {
+        fclose(binaryFp);
+      }
+      ostringstream temp;
+      temp << "Error : Unable to save the SVR model to " << modelFile << endl;
+      throw MyException(temp.str());
+    }
+    fclose(binaryFp);
+  } else {
+    svm_save_model(modelFile.c_str(), model.get());
+  }
   // save the rest of the information(normSub, normDiv, sub, div, numRetFeatures, selected features,
   // no_letters_in alphabet, letters in alphabet, our index)
   ofstream fp(modelFile.c_str(), ios::app);
@@ -1596,16 +1787,30 @@ void RTModel::saveSVRModel(const string modelFile,
 void RTModel::loadSVRModel(const string modelFile,
                            Normalizer* theNormalizer) {
   // destroy any previous model
-  if (model != NULL) {
-    svm_destroy_model(model);
-  }
+  model.reset();
   theNormalizer->setNumFeatures(0);
-  // load only the SVM model
-  model = svm_load_model(modelFile.c_str());
+  // load only the SVM model; a binary model is mapped and the rest of the
+  // information follows it
+  size_t binarySize = 0;
+  FILE* binaryFp = fopen(modelFile.c_str(), "rb");
+  bool binary = binaryFp != NULL && SharedSVMModel::isBinary(binaryFp);
+  if (binaryFp != NULL) {
+    fclose(binaryFp);
+  }
+  if (binary) {
+    binarySize = model.load(modelFile);
+  } else {
+    svm_model* m = svm_load_model(modelFile.c_str());
+    if (m != NULL) {
+      model = SharedSVMModel(m);
+      svm_destroy_model(m);
+    }
+  }
   // load the rest of the information(normSub, normDiv, sub, div, numRetFeatures, selected features,
   // no_letters_in alphabet, letters in alphabet, our index)
   string line, label;
-  ifstream fp(modelFile.c_str());
+  ifstream fp(modelFile.c_str(), ios::in | ios::binary);
+  fp.seekg(binarySize);
   fp >> line;
   while (line.find("numNormalizedFeat") == string::npos) {
     fp >> line;
@@ -23,6 +23,7 @@
 #include "PSMDescription.h"
 #include "Normalizer.h"
 #include "svm.h"
+#include "SharedSVMModel.h"
 
 using namespace std;
 
@@ -96,7 +97,7 @@ class RTModel {
                         const double gamma, const double epsilon,
                         int noPsms);
     bool isModelNull() {
-      if (model == NULL) {
+      if (model.isNull()) {
         return true;
       } else {
         return false;
@@ -110,18 +111,29 @@ class RTModel {
     double computeSimpleEvaluation(const vector<PSMDescription*> & psms,
                                    const double gamma,
                                    const double epsilon, const double c);
+    // evaluate several combinations of parameters in parallel
+    void evaluateGrid(const vector<PSMDescription*>& psms,
+                      const vector<double>& gammas, const vector<double>& cs,
+                      const vector<double>& epsilons,
+                      vector<double>& errors) const;
     // estima rt using a trained model
     double testRetention(vector<PSMDescription*>& testset);
     double estimateRT(double* features);
-    // load, save, copy and destroy the svr model
+    void estimateRT(const vector<double*>& features, vector<double>& predicted);
+    // load, save, share and destroy the svr model; the svr model is either
+    // saved in the libsvm text format or in the binary format, which is
+    // memory mapped when it is loaded
     void loadSVRModel(string modelFile, Normalizer* theNormalizer);
-    void saveSVRModel(string modelFile, Normalizer* theNormalizer);
-    void copyModel(svm_model* from);
+    void saveSVRModel(string modelFile, Normalizer* theNormalizer,
+                      bool binary = false);
+    void copyModel(const SharedSVMModel& from) {
+      model = from;
+    }
     void destroyModel() {
-      svm_destroy_model(model);
+      model.reset();
     }
     // get functions
-    svm_model* getModel() {
+    const SharedSVMModel& getModel() {
       return model;
     }
     size_t getRTFeat() {
@@ -196,13 +208,36 @@ class RTModel {
     }
 
   protected:
+    // train a SVR without storing it in the object; the caller destroys the model
+    svm_model* trainModel(const vector<PSMDescription*>& trainset,
+                          const double C, const double gamma,
+                          const double epsilon) const;
+    double testModel(const svm_model* m,
+                     const vector<PSMDescription*>& testset) const;
+    static svm_parameter svrParameters(const double C, const double gamma,
+                                       const double epsilon);
+    static void splitData(const size_t noPsms,
+                          const size_t modulus, const size_t noFolds,
+                          vector<vector<int> >& trainSets,
+                          vector<vector<int> >& testSets);
+    double evaluateFold(const vector<svm_node>& x, const vector<double>& y,
+                        const svm_kernel_matrix* km,
+                        const vector<int>& train, const vector<int>& test,
+                        const double C, const double gamma,
+                        const double epsilon) const;
+    void evaluateFolds(const vector<PSMDescription*>& psms,
+                       const vector<vector<int> >& trainSets,
+                       const vector<vector<int> >& testSets,
+                       const vector<double>& gammas, const vector<double>& cs,
+                       const vector<double>& epsilons,
+                       vector<double>& errors) const;
     // EXPERIMENTAL
     float our_index['Z' - 'A' + 1];
     static float Luna_120_index['Z' - 'A' + 1];
     static float TFA_index['Z' - 'A' + 1];
         
-    // svr model
-    svm_model* model;
+    // svr model, shared with the models copied from this one
+    SharedSVMModel model;
     svm_model* index_model;
     
     // parameters for the SVR
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "FastaReader.h"
+
+/* files smaller than this are scanned for headers by a single thread */
+static const size_t kMinChunkSize = 1 << 20;
+
+FastaReader::FastaReader() : preamble_(NULL) {}
+
+FastaReader::~FastaReader() {
+  close();
+}
+
+void FastaReader::close() {
+  file_.close();
+  preamble_ = NULL;
+  records_.clear();
+}
+
+/*
+ * Headers are '>' characters at the start of a line. The file is cut into
+ * equally sized chunks that are searched independently, a header belongs
+ * to the chunk that contains its '>'.
+ */
+void FastaReader::findRecordStarts(std::vector<size_t>& starts) const {
+  const char* data = file_.data();
+  size_t size = file_.size();
+  int numChunks = 1;
+#ifdef _OPENMP
+  numChunks = omp_get_max_threads() * 4;
+#endif
+  numChunks = (std::min)(numChunks, static_cast<int>(size / kMinChunkSize) + 1);
+
+  std::vector<std::vector<size_t> > chunkStarts(numChunks);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int chunk = 0; chunk < numChunks; ++chunk) {
+    const char* p = data + size / numChunks * chunk;
+    const char* end = (chunk == numChunks - 1) ? data + size :
+                          data + size / numChunks * (chunk + 1);
+    while (p < end && (p = static_cast<const char*>(memchr(p, '>', end - p))) != NULL) {
+      if (p == data || p[-1] == '\n') {
+        chunkStarts[chunk].push_back(p - data);
+      }
+      ++p;
+    }
+  }
+
+  starts.clear();
+  for (int chunk = 0; chunk < numChunks; ++chunk) {
+    starts.insert(starts.end(), chunkStarts[chunk].begin(), chunkStarts[chunk].end());
+  }
+}
+
+/*
+ * Points the id and description of the record [begin, end) to its header
+ * line and the body to the lines that follow it.
+ */
+void FastaReader::indexRecord(size_t begin, size_t end, FastaRecord& record) const {
+  const char* src = file_.data() + begin + 1;
+  const char* stop = file_.data() + end;
+  const char* headerEnd = static_cast<const char*>(memchr(src, '\n', stop - src));
+  if (headerEnd == NULL) headerEnd = stop;
+  const char* lineEnd = headerEnd;
+  if (lineEnd > src && lineEnd[-1] == '\r') --lineEnd;
+  const char* idEnd = src;
+  while (idEnd < lineEnd && *idEnd != ' ' && *idEnd != '\t') ++idEnd;
+
+  record.offset = begin;
+  record.id = src;
+  record.idLength = idEnd - src;
+  if (idEnd < lineEnd) {
+    record.description = idEnd + 1;
+    record.descriptionLength = lineEnd - idEnd - 1;
+  } else {
+    record.description = lineEnd;
+    record.descriptionLength = 0;
+  }
+  record.body = (headerEnd < stop) ? headerEnd + 1 : stop;
+  record.bodyLength = stop - record.body;
+}
+
+bool FastaReader::open(const std::string& fileName) {
+  close();
+  if (!file_.open(fileName)) return false;
+
+  std::vector<size_t> starts;
+  findRecordStarts(starts);
+  size_t firstHeader = starts.empty() ? file_.size() : starts[0];
+  for (const char* p = file_.data(); p < file_.data() + firstHeader; ++p) {
+    if (!isspace((unsigned char)*p)) {
+      preamble_ = p;
+      break;
+    }
+  }
+  records_.resize(starts.size());
+  starts.push_back(file_.size());
+
+  int numRecords = static_cast<int>(records_.size());
+  #pragma omp parallel for schedule(dynamic, 256)
+  for (int i = 0; i < numRecords; ++i) {
+    indexRecord(starts[i], starts[i + 1], records_[i]);
+  }
+  return true;
+}
+
+size_t FastaReader::foldSequence(const FastaRecord& record, char* sequence) {
+  const char* end = record.body + record.bodyLength;
+  char* dst = sequence;
+  for (const char* src = record.body; src < end; ++src) {
+    char c = *src;
+    if (c != '\n' && c != '\r' && c != ' ' && c != '\t') *dst++ = c;
+  }
+  *dst = '\0';
+  return dst - sequence;
+}
+
+void FastaReader::foldSequence(const FastaRecord& record, std::string& sequence) {
+  sequence.resize(record.bodyLength + 1);
+  sequence.resize(foldSequence(record, &sequence[0]));
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class FastaReader, which indexes the records of a
+ * text fasta file through a read-only memory mapping of the file. It is
+ * shared by the converters and the picked-protein database.
+ */
+
+#ifndef FASTAREADER_H_
+#define FASTAREADER_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "MappedFile.h"
+
+/**
+ * A view of a single fasta record. The strings are not NUL terminated and
+ * point into the mapping of the FastaReader, they are valid until the
+ * reader is closed.
+ */
+struct FastaRecord {
+  size_t offset; // byte offset of the '>' of the header in the file
+  const char* id; // header up to the first space or tab
+  size_t idLength;
+  const char* description; // remainder of the header line
+  size_t descriptionLength;
+  const char* body; // the sequence lines as they are in the file
+  size_t bodyLength;
+
+  std::string getId() const { return std::string(id, idLength); }
+};
+
+class FastaReader {
+ public:
+  FastaReader();
+  ~FastaReader();
+
+  /**
+   * Maps the fasta file read-only and builds the record index. The file is
+   * split into chunks that are scanned for headers in parallel; only the
+   * header lines are read, the sequence lines are left in the mapping.
+   * \returns false if the file could not be read.
+   */
+  bool open(const std::string& fileName);
+
+  /**
+   * Releases the mapping, invalidating all records.
+   */
+  void close();
+
+  size_t size() const { return records_.size(); }
+  const FastaRecord& operator[](size_t idx) const { return records_[idx]; }
+
+  /**
+   * Returns the first character before the first header that is not white
+   * space, or NULL if the file starts with a header.
+   */
+  const char* getPreamble() const { return preamble_; }
+
+  /**
+   * Copies the sequence of the record to sequence with the line breaks and
+   * other white space of the wrapped lines removed. sequence needs room for
+   * record.bodyLength + 1 characters, it is NUL terminated.
+   * \returns the length of the sequence.
+   */
+  static size_t foldSequence(const FastaRecord& record, char* sequence);
+  static void foldSequence(const FastaRecord& record, std::string& sequence);
+
+ private:
+  MappedFile file_;
+  const char* preamble_;
+  std::vector<FastaRecord> records_;
+
+  void findRecordStarts(std::vector<size_t>& starts) const;
+  void indexRecord(size_t begin, size_t end, FastaRecord& record) const;
+
+  // not copyable, the records point into the mapping
+  FastaReader(const FastaReader&);
+  FastaReader& operator=(const FastaReader&);
+};
+
+#endif /* FASTAREADER_H_ */
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile() : data_(NULL), size_(0), isMapped_(false) {}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void MappedFile::close() {
+  if (data_ != NULL) {
+#ifndef _MSC_VER
+    if (isMapped_) {
+      munmap(data_, size_);
+    } else {
+      free(data_);
+    }
+#else
+    free(data_);
+#endif
+  }
+  data_ = NULL;
+  size_ = 0;
+  isMapped_ = false;
+}
+
+bool MappedFile::open(const std::string& fileName) {
+  close();
+#ifndef _MSC_VER
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* address = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      data_ = static_cast<char*>(address);
+      isMapped_ = true;
+#ifdef MADV_SEQUENTIAL
+      madvise(address, size_, MADV_SEQUENTIAL);
+#endif
+    }
+  }
+  ::close(fd);
+  if (size_ == 0 || isMapped_) return true;
+#endif
+
+  FILE* fp = fopen(fileName.c_str(), "rb");
+  if (fp == NULL) return false;
+  fseek(fp, 0, SEEK_END);
+  long fileSize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (fileSize < 0) {
+    fclose(fp);
+    return false;
+  }
+  size_ = static_cast<size_t>(fileSize);
+  data_ = static_cast<char*>(malloc(size_ + 1));
+  if (data_ == NULL || fread(data_, 1, size_, fp) != size_) {
+    fclose(fp);
+    free(data_);
+    data_ = NULL;
+    size_ = 0;
+    return false;
+  }
+  fclose(fp);
+  return true;
+}
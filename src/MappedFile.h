@@ -0,0 +1,60 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class MappedFile, which makes the contents of a file
+ * available as a read-only block of memory. Used by the readers of the
+ * text based search result and spectrum formats.
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  /**
+   * Memory maps the file, or reads it into a heap buffer where mapping is
+   * not available.
+   * \returns false if the file could not be read.
+   */
+  bool open(const std::string& fileName);
+
+  /**
+   * Releases the mapping, invalidating all pointers into the data.
+   */
+  void close();
+
+  const char* data() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+
+ private:
+  char* data_;
+  size_t size_;
+  bool isMapped_; // false if data_ was allocated on the heap instead
+
+  // not copyable, pointers into data_ are handed out
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+};
+
+#endif /* MAPPEDFILE_H_ */
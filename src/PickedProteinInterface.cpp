@@ -19,13 +19,17 @@
 
 using namespace PercolatorCrux;
 
+static const size_t kNoProteinIdx = std::numeric_limits<size_t>::max();
+
 PickedProteinInterface::PickedProteinInterface(const std::string& fastaDatabase,
     double pvalueCutoff, bool reportFragmentProteins, bool reportDuplicateProteins,
     bool trivialGrouping, double absenceRatio, bool outputEmpirQval, 
-    std::string& decoyPattern, double specCountQvalThreshold) :
+    std::string& decoyPattern, double specCountQvalThreshold,
+    const std::string& digestCacheDir) :
       ProteinProbEstimator(trivialGrouping, absenceRatio, outputEmpirQval, 
                            decoyPattern, specCountQvalThreshold),
-      fastaProteinFN_(fastaDatabase), maxPeptidePval_(pvalueCutoff),
+      fastaProteinFN_(fastaDatabase), digestCacheDir_(digestCacheDir),
+      maxPeptidePval_(pvalueCutoff),
       reportFragmentProteins_(reportFragmentProteins),
       reportDuplicateProteins_(reportDuplicateProteins),
       protInferenceMethod_(BESTPEPT) {
@@ -207,6 +211,7 @@ void PickedProteinInterface::groupProteins(Scores& peptideScores,
   std::map<std::string, std::string> fragment_map, duplicate_map;
   if (fastaProteinFN_ != "auto") {
     pickedProteinCaller.setFastaDatabase(fastaProteinFN_, decoyPattern_);
+    pickedProteinCaller.setDigestCacheDirectory(digestCacheDir_);
     
     if (VERB > 1) {
       std::cerr << "Detecting protein fragments/duplicates in target database" << std::endl;
@@ -244,29 +249,28 @@ void PickedProteinInterface::groupProteins(Scores& peptideScores,
     }
   }
   
-  std::map<std::string, std::set<std::string> > groupProteinIds;
+  /* protein identifiers are interned once, the grouping below only compares
+     integer identifiers and looks up flat arrays indexed by them */
+  std::vector<unsigned int> representativeIds;
+  std::vector<bool> reportIds;
+  std::vector<std::vector<unsigned int> > groupMemberIds; // same indexing as proteins_
+  
+  std::vector<unsigned int> proteinsInGroup;
   unsigned int numGroups = 0;
   for (vector<ScoreHolder>::iterator peptideIt = peptideScores.begin(); 
           peptideIt != peptideScores.end(); ++peptideIt) {
-    std::string lastProteinId;
-    std::set<std::string> proteinsInGroup;
+    unsigned int lastProteinId = 0;
     bool isFirst = true, isShared = false;
     
     if (peptideIt->p > maxPeptidePval_) continue;
     
+    proteinsInGroup.clear();
     for (std::vector<std::string>::iterator protIt = peptideIt->pPSM->proteinIds.begin(); 
             protIt != peptideIt->pPSM->proteinIds.end(); protIt++) {
-      std::string proteinId = *protIt;
-      
-      if (fragment_map.find(proteinId) != fragment_map.end()) {
-        if (reportFragmentProteins_) proteinsInGroup.insert(*protIt);
-        proteinId = fragment_map[proteinId];
-      } else if (duplicate_map.find(proteinId) != duplicate_map.end()) {
-        if (reportDuplicateProteins_) proteinsInGroup.insert(*protIt);
-        proteinId = duplicate_map[proteinId];
-      } else {
-        proteinsInGroup.insert(*protIt);
-      }
+      unsigned int proteinId = internProteinId(*protIt, proteinIds_, 
+          representativeIds, reportIds, fragment_map, duplicate_map);
+      if (reportIds[proteinId]) proteinsInGroup.push_back(proteinId);
+      proteinId = representativeIds[proteinId];
       
       if (isFirst) {
         lastProteinId = proteinId;
@@ -277,55 +281,141 @@ void PickedProteinInterface::groupProteins(Scores& peptideScores,
       }
     }
     
+    if (isFirst) { // peptide without proteins
+      lastProteinId = proteinIds_.intern("");
+    }
+    
+    std::sort(proteinsInGroup.begin(), proteinsInGroup.end());
+    proteinsInGroup.erase(std::unique(proteinsInGroup.begin(), 
+        proteinsInGroup.end()), proteinsInGroup.end());
     if (proteinsInGroup.size() == 1) {
-      lastProteinId = *(proteinsInGroup.begin());
+      lastProteinId = proteinsInGroup.front();
     }
     
     if (!isShared) {
+      if (proteinIdToIdx_.size() < proteinIds_.size()) {
+        proteinIdToIdx_.resize(proteinIds_.size(), kNoProteinIdx);
+      }
       ProteinScoreHolder::Peptide peptide(peptideIt->pPSM->getPeptideSequence(), 
           peptideIt->isDecoy(), peptideIt->p, peptideIt->pep, peptideIt->q, peptideIt->score);
-      if (proteinToIdxMap_.find(lastProteinId) == proteinToIdxMap_.end()) {
-        if (proteinsInGroup.size() > 1) {
-          groupProteinIds[lastProteinId] = proteinsInGroup;
-        }
-        ProteinScoreHolder newProtein(lastProteinId, peptideIt->isDecoy(),
+      if (proteinIdToIdx_[lastProteinId] == kNoProteinIdx) {
+        const std::string& lastProteinName = proteinIds_.getName(lastProteinId);
+        ProteinScoreHolder newProtein(lastProteinName, peptideIt->isDecoy(),
             peptide, ++numGroups);
-        proteinToIdxMap_[lastProteinId] = proteins_.size();
+        proteinIdToIdx_[lastProteinId] = proteins_.size();
         proteins_.push_back(newProtein);
-        if (lastProteinId.find(decoyPattern_) == std::string::npos) {
+        groupMemberIds.push_back(std::vector<unsigned int>());
+        if (proteinsInGroup.size() > 1) {
+          groupMemberIds.back() = proteinsInGroup;
+        }
+        if (lastProteinName.find(decoyPattern_) == std::string::npos) {
           ++numberTargetProteins_;
         } else {
           ++numberDecoyProteins_;
         }
       } else {
-        proteins_.at(proteinToIdxMap_[lastProteinId]).addPeptide(peptide);
+        size_t proteinIdx = proteinIdToIdx_[lastProteinId];
+        proteins_.at(proteinIdx).addPeptide(peptide);
         if (proteinsInGroup.size() > 1) {
-          groupProteinIds[lastProteinId].insert(proteinsInGroup.begin(), 
-                                                 proteinsInGroup.end());
+          std::vector<unsigned int>& memberIds = groupMemberIds[proteinIdx];
+          std::vector<unsigned int> mergedIds;
+          std::set_union(memberIds.begin(), memberIds.end(), 
+              proteinsInGroup.begin(), proteinsInGroup.end(), 
+              std::back_inserter(mergedIds));
+          memberIds.swap(mergedIds);
         }
       }
     }
   }
   
+  proteinIdToIdx_.resize(proteinIds_.size(), kNoProteinIdx);
+  
   /* Update protein group identifier to include fragment and duplicate protein identifiers */
   if (reportFragmentProteins_ || reportDuplicateProteins_) {
-    std::map<std::string, std::set<std::string> >::iterator groupIt;
-    std::map<std::string, size_t>::iterator representIt;
-    for (groupIt = groupProteinIds.begin(); groupIt != groupProteinIds.end(); ++groupIt) {
-      representIt = proteinToIdxMap_.find(groupIt->first);
-      if (representIt != proteinToIdxMap_.end()) { /* these are the protein group representatives */
-        std::string newName = "";
-        for (std::set<std::string>::iterator proteinIt = groupIt->second.begin(); proteinIt != groupIt->second.end(); ++proteinIt) {
-          /* some protein identifiers contain commas, replace them by the much 
-             less used semicolon as the comma is used to separate protein 
-             identifiers */
-          std::string proteinId = *proteinIt;
-          std::replace(proteinId.begin(), proteinId.end(), ',', ';'); 
-          newName += proteinId + ",";
-        }
-        newName = newName.substr(0, newName.size() - 1); // remove last comma
-        proteins_.at(representIt->second).setName(newName);
+    std::vector<std::string> memberNames;
+    for (size_t proteinIdx = 0; proteinIdx < proteins_.size(); ++proteinIdx) {
+      const std::vector<unsigned int>& memberIds = groupMemberIds[proteinIdx];
+      if (memberIds.empty()) continue;
+      
+      memberNames.clear();
+      for (std::vector<unsigned int>::const_iterator idIt = memberIds.begin(); 
+             idIt != memberIds.end(); ++idIt) {
+        memberNames.push_back(proteinIds_.getName(*idIt));
       }
+      std::sort(memberNames.begin(), memberNames.end());
+      
+      std::string newName = "";
+      for (std::vector<std::string>::const_iterator proteinIt = memberNames.begin(); 
+             proteinIt != memberNames.end(); ++proteinIt) {
+        /* some protein identifiers contain commas, replace them by the much 
+           less used semicolon as the comma is used to separate protein 
+           identifiers */
+        std::string proteinId = *proteinIt;
+        std::replace(proteinId.begin(), proteinId.end(), ',', ';'); 
+        newName += proteinId + ",";
+      }
+      newName = newName.substr(0, newName.size() - 1); // remove last comma
+      proteins_.at(proteinIdx).setName(newName);
+    }
+  }
+}
+
+/* interns the protein identifier and, the first time it is seen, resolves
+   the fragment or duplicate protein it is represented by */
+unsigned int PickedProteinInterface::internProteinId(
+    const std::string& proteinName, ProteinIdTable& proteinIds, 
+    std::vector<unsigned int>& representativeIds, std::vector<bool>& reportIds,
+    const std::map<std::string, std::string>& fragment_map,
+    const std::map<std::string, std::string>& duplicate_map) {
+  unsigned int proteinId = proteinIds.intern(proteinName);
+  if (proteinId < representativeIds.size() 
+        && representativeIds[proteinId] != UINT_MAX) {
+    return proteinId;
+  }
+  
+  unsigned int representativeId = proteinId;
+  bool report = true;
+  std::map<std::string, std::string>::const_iterator mapIt;
+  if ((mapIt = fragment_map.find(proteinName)) != fragment_map.end()) {
+    report = reportFragmentProteins_;
+    representativeId = proteinIds.intern(mapIt->second);
+  } else if ((mapIt = duplicate_map.find(proteinName)) != duplicate_map.end()) {
+    report = reportDuplicateProteins_;
+    representativeId = proteinIds.intern(mapIt->second);
+  }
+  
+  representativeIds.resize(proteinIds.size(), UINT_MAX);
+  reportIds.resize(proteinIds.size(), true);
+  representativeIds[proteinId] = representativeId;
+  reportIds[proteinId] = report;
+  return proteinId;
+}
+
+/* spectral counts on the interned protein identifiers of the grouping step,
+   identical to ProteinProbEstimator::addSpectralCounts but without the map 
+   lookups by protein name */
+void PickedProteinInterface::addSpectralCounts(Scores& peptideScores) {
+  std::vector<size_t> seenProteinIdxs;
+  std::vector<ScoreHolder>::iterator psm = peptideScores.begin();
+  for (; psm!= peptideScores.end(); ++psm) {
+    seenProteinIdxs.clear();
+    std::vector<std::string>::const_iterator protIt = psm->pPSM->proteinIds.begin();
+    for (; protIt != psm->pPSM->proteinIds.end(); protIt++) {
+      unsigned int proteinId = proteinIds_.find(*protIt);
+      if (proteinId != ProteinIdTable::kNotFound 
+            && proteinIdToIdx_[proteinId] != kNoProteinIdx) {
+        seenProteinIdxs.push_back(proteinIdToIdx_[proteinId]);
+      }
+    }
+    std::sort(seenProteinIdxs.begin(), seenProteinIdxs.end());
+    seenProteinIdxs.erase(std::unique(seenProteinIdxs.begin(), 
+        seenProteinIdxs.end()), seenProteinIdxs.end());
+    
+    bool isUnique = (seenProteinIdxs.size() == 1);
+    unsigned int psmCount = peptideSpecCounts_[psm->pPSM->getPeptideSequence()];
+    std::vector<size_t>::const_iterator protIdxIt = seenProteinIdxs.begin();
+    for (; protIdxIt != seenProteinIdxs.end(); ++protIdxIt) {
+      proteins_[*protIdxIt].addSpecCounts(psmCount, isUnique);
     }
   }
 }
@@ -381,52 +471,53 @@ void PickedProteinInterface::computeProbabilities(const std::string& fname) {
   estimatePEPs();
 }
 
-bool PickedProteinInterface::pickedProteinCheckId(std::string& proteinId, bool isDecoy,
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts) {
-  bool found = false;
-  if (isDecoy) {
-    std::string targetId = proteinId;
-    if (decoyPattern_.size() >= proteinId.size()) {
-      ostringstream oss;
-      oss << "ERROR: Could not detect the decoy prefix \"" << decoyPattern_ 
-          << "\" for the decoy protein identifier \"" << proteinId << "\"." << std::endl;
-      if (NO_TERMINATE) {
-        std::cerr << oss.str() << "No-terminate flag set: ignoring error and skipping removal of decoyPrefix." << std::endl;
-      } else {
-        throw MyException(oss.str());
+/* For each protein group, finds the identifiers of its member proteins and
+   the identifiers of their target/decoy partners, i.e. the decoy with the 
+   decoy pattern prepended for a target protein and the target with the decoy
+   pattern removed for a decoy protein. The members of protein group i are 
+   stored in the range [memberOffsets[i], memberOffsets[i+1]). */
+void PickedProteinInterface::getPickedProteinPartners(ProteinIdTable& proteinIds,
+    std::vector<unsigned int>& memberIds, std::vector<unsigned int>& partnerIds,
+    std::vector<bool>& missingDecoyPattern, std::vector<size_t>& memberOffsets) {
+  bool splitGroups = reportFragmentProteins_ || reportDuplicateProteins_;
+  memberOffsets.reserve(proteins_.size() + 1);
+  memberOffsets.push_back(0);
+  std::vector<std::string> memberNames;
+  std::vector<ProteinScoreHolder>::const_iterator it = proteins_.begin();
+  for (; it != proteins_.end(); ++it) {
+    bool isDecoy = it->isDecoy();
+    std::string proteinName = it->getName();
+    
+    memberNames.clear();
+    if (splitGroups) {
+      std::istringstream ss(proteinName); 
+      std::string proteinId;
+      while (std::getline(ss, proteinId, ',')) { // split name by comma
+        memberNames.push_back(proteinId);
       }
     } else {
-      targetId = proteinId.substr(decoyPattern_.size());
-    }
-    if (targetProts.find(targetId) != targetProts.end()) {
-      found = true;
-    } else {
-      decoyProts.insert(proteinId);
+      memberNames.push_back(proteinName);
     }
-  } else {
-    if (decoyProts.find(decoyPattern_ + proteinId) != decoyProts.end()) {
-      found = true;
-    } else {
-      targetProts.insert(proteinId);
-    }
-  }
-  return found;
-}
-
-bool PickedProteinInterface::pickedProteinCheck(std::string& proteinName, bool isDecoy, 
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts) {
-  bool erase = false;
-  if (reportFragmentProteins_ || reportDuplicateProteins_) {
-    std::istringstream ss(proteinName); 
-    std::string proteinId;
-    while (std::getline(ss, proteinId, ',')) { // split name by comma
-      erase = erase || pickedProteinCheckId(proteinId, isDecoy, 
-                                          targetProts, decoyProts);
+    
+    std::vector<std::string>::const_iterator nameIt = memberNames.begin();
+    for (; nameIt != memberNames.end(); ++nameIt) {
+      const std::string& proteinId = *nameIt;
+      memberIds.push_back(proteinIds.intern(proteinId));
+      bool missingPattern = false;
+      if (isDecoy) {
+        if (decoyPattern_.size() >= proteinId.size()) {
+          missingPattern = true;
+          partnerIds.push_back(memberIds.back());
+        } else {
+          partnerIds.push_back(proteinIds.intern(proteinId.substr(decoyPattern_.size())));
+        }
+      } else {
+        partnerIds.push_back(proteinIds.intern(decoyPattern_ + proteinId));
+      }
+      missingDecoyPattern.push_back(missingPattern);
     }
-  } else {
-    erase = pickedProteinCheckId(proteinName, isDecoy, targetProts, decoyProts);
+    memberOffsets.push_back(memberIds.size());
   }
-  return erase;
 }
 
 /* Executes the picked protein-FDR strategy from Savitski et al. 2015
@@ -437,25 +528,63 @@ void PickedProteinInterface::pickedProteinStrategy() {
     std::cerr << "Performing picked protein strategy" << std::endl;
   }
   
-  std::vector<ProteinScoreHolder> pickedProtIdProtPairs;
-  std::set<std::string> targetProts, decoyProts;
-  std::vector<ProteinScoreHolder>::iterator it = proteins_.begin();
-  size_t numErased = 0;
+  ProteinIdTable proteinIds;
+  std::vector<unsigned int> memberIds, partnerIds;
+  std::vector<bool> missingDecoyPattern;
+  std::vector<size_t> memberOffsets;
+  getPickedProteinPartners(proteinIds, memberIds, partnerIds, 
+                           missingDecoyPattern, memberOffsets);
+  
+  std::vector<bool> targetSeen(proteinIds.size(), false);
+  std::vector<bool> decoySeen(proteinIds.size(), false);
+  size_t numTargetProts = 0u, numDecoyProts = 0u;
+  size_t numErased = 0, numKept = 0;
   // TODO: what about peptides with both target and decoy proteins?
-  for (; it != proteins_.end(); ++it) {
-    bool isDecoy = it->isDecoy();
-    std::string proteinName = it->getName(); 
+  for (size_t proteinIdx = 0; proteinIdx < proteins_.size(); ++proteinIdx) {
+    bool isDecoy = proteins_[proteinIdx].isDecoy();
+    
+    bool erase = false;
+    for (size_t m = memberOffsets[proteinIdx]; 
+           m < memberOffsets[proteinIdx + 1] && !erase; ++m) {
+      unsigned int proteinId = memberIds[m];
+      if (isDecoy) {
+        if (missingDecoyPattern[m]) {
+          ostringstream oss;
+          oss << "ERROR: Could not detect the decoy prefix \"" << decoyPattern_ 
+              << "\" for the decoy protein identifier \"" 
+              << proteinIds.getName(proteinId) << "\"." << std::endl;
+          if (NO_TERMINATE) {
+            std::cerr << oss.str() << "No-terminate flag set: ignoring error and skipping removal of decoyPrefix." << std::endl;
+          } else {
+            throw MyException(oss.str());
+          }
+        }
+        if (targetSeen[partnerIds[m]]) {
+          erase = true;
+        } else if (!decoySeen[proteinId]) {
+          decoySeen[proteinId] = true;
+          ++numDecoyProts;
+        }
+      } else {
+        if (decoySeen[partnerIds[m]]) {
+          erase = true;
+        } else if (!targetSeen[proteinId]) {
+          targetSeen[proteinId] = true;
+          ++numTargetProts;
+        }
+      }
+    }
     
-    bool erase = pickedProteinCheck(proteinName, isDecoy, targetProts, decoyProts);
     if (erase) {
       if (isDecoy) --numberDecoyProteins_;
       else --numberTargetProteins_;
       numErased += 1;
     } else {
-      pickedProtIdProtPairs.push_back(*it);
+      if (numKept != proteinIdx) proteins_[numKept] = proteins_[proteinIdx];
+      ++numKept;
     }
   }
-  pickedProtIdProtPairs.swap(proteins_);
+  proteins_.erase(proteins_.begin() + numKept, proteins_.end());
   
   if (numErased == 0) {
     std::cerr << "Warning: No target-decoy protein pairs found for the picked "
@@ -467,14 +596,16 @@ void PickedProteinInterface::pickedProteinStrategy() {
   
   if (VERB > 1) {
     std::cerr << "Eliminated lower-scoring target-decoy protein: "
-              << targetProts.size() << " target proteins and "
-              << decoyProts.size() << " decoy proteins remaining." << std::endl;
+              << numTargetProts << " target proteins and "
+              << numDecoyProts << " decoy proteins remaining." << std::endl;
   }
 }
 
 void PickedProteinInterface::estimatePEPs() {
   std::vector<std::pair<double, bool> > combined;
   std::vector<double> pvals;
+  combined.reserve(proteins_.size());
+  pvals.reserve(proteins_.size());
   switch (protInferenceMethod_) {
     case FISHER: { // if we have well calibrated p-values
       for (size_t i = 0; i < proteins_.size(); ++i) {
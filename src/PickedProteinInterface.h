@@ -21,6 +21,9 @@
 #include <cmath>
 #include <functional>
 #include <cfloat>
+#include <climits>
+#include <limits>
+#include <boost/unordered/unordered_map.hpp>
 //#include <boost/math/special_functions/gamma.hpp>
 
 #include "MyException.h"
@@ -41,6 +44,37 @@ enum ProteinInferenceMethod {
   FISHER, PEPPROD, BESTPEPT
 };
 
+/*
+* ProteinIdTable interns protein identifiers into dense integer identifiers,
+* such that the grouping and picking steps can work on flat arrays instead of
+* maps and sets of strings.
+*/
+class ProteinIdTable {
+ public:
+  static const unsigned int kNotFound = UINT_MAX;
+  
+  inline unsigned int intern(const std::string& proteinName) {
+    std::pair<boost::unordered_map<std::string, unsigned int>::iterator, bool> 
+        inserted = proteinIds_.insert(std::make_pair(proteinName, 
+            static_cast<unsigned int>(proteinNames_.size())));
+    if (inserted.second) proteinNames_.push_back(&inserted.first->first);
+    return inserted.first->second;
+  }
+  inline unsigned int find(const std::string& proteinName) const {
+    boost::unordered_map<std::string, unsigned int>::const_iterator it = 
+        proteinIds_.find(proteinName);
+    return (it != proteinIds_.end()) ? it->second : kNotFound;
+  }
+  inline const std::string& getName(unsigned int proteinId) const {
+    return *proteinNames_[proteinId];
+  }
+  inline size_t size() const { return proteinNames_.size(); }
+  
+ private:
+  boost::unordered_map<std::string, unsigned int> proteinIds_;
+  std::vector<const std::string*> proteinNames_; // points to the keys of proteinIds_
+};
+
 /*
 * PickedProteinInterface is a class that computes probabilities and statistics based
 * on provided proteins from the set of scored peptides from percolator. It
@@ -58,12 +92,13 @@ class PickedProteinInterface : public ProteinProbEstimator {
     bool reportFragmentProteins, bool reportDuplicateProteins, 
     bool trivialGrouping, double absenceRatio, 
     bool outputEmpirQval, std::string& decoyPattern,
-    double specCountQvalThreshold);
+    double specCountQvalThreshold, const std::string& digestCacheDir = "");
   virtual ~PickedProteinInterface();
   
   bool initialize(Scores& fullset, const Enzyme* enzyme);
   void run() {}
   void computeProbabilities(const std::string& fname = "");
+  void addSpectralCounts(Scores& peptideScores);
   
   std::ostream& printParametersXML(std::ostream &os);
   string printCopyright();
@@ -72,19 +107,30 @@ class PickedProteinInterface : public ProteinProbEstimator {
   void groupProteins(Scores& peptideScores, 
     PickedProteinCaller& pickedProteinCaller);
   
+  unsigned int internProteinId(const std::string& proteinName,
+    ProteinIdTable& proteinIds, std::vector<unsigned int>& representativeIds,
+    std::vector<bool>& reportIds,
+    const std::map<std::string, std::string>& fragment_map,
+    const std::map<std::string, std::string>& duplicate_map);
+  
   void pickedProteinStrategy();
-  bool pickedProteinCheckId(std::string& proteinId, bool isDecoy,
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts);
-  bool pickedProteinCheck(std::string& proteinName, bool isDecoy, 
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts);
+  void getPickedProteinPartners(ProteinIdTable& proteinIds,
+    std::vector<unsigned int>& memberIds, std::vector<unsigned int>& partnerIds,
+    std::vector<bool>& missingDecoyPattern, std::vector<size_t>& memberOffsets);
   void estimatePEPs();
   
   /** PICKED_PROTEIN PARAMETERS **/
   ProteinInferenceMethod protInferenceMethod_;
   std::string fastaProteinFN_;
+  std::string digestCacheDir_;
   bool reportFragmentProteins_, reportDuplicateProteins_;
   double maxPeptidePval_;
   
+  /** interned protein identifiers of the grouping step and, indexed by
+      these, the index of the protein group in proteins_ **/
+  ProteinIdTable proteinIds_;
+  std::vector<size_t> proteinIdToIdx_;
+  
 };
 
 #endif // PICKED_PROTEININTERFACE_H
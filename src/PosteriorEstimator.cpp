@@ -63,17 +63,53 @@ bool isMixed(const pair<double, bool>& aPair) {
   return aPair.second;
 }
 
-template<class T> void bootstrap(const vector<T>& in, vector<T>& out,
-                                 size_t max_size = 1000) {
-  out.clear();
-  double n = in.size();
-  size_t num_draw = min(in.size(), max_size);
-  for (size_t ix = 0; ix < num_draw; ++ix) {
-    size_t draw = (size_t)((double)PseudoRandom::lcg_rand() / ((double)PseudoRandom::kRandMax + (double)1) * n);
-    out.push_back(in[draw]);
-  }
-  // sort in desending order
-  sort(out.begin(), out.end());
+/*
+ * Bootstraps the pi0 estimates of Storey's method. The replicates are drawn
+ * in parallel, each from its own counter based random stream, and their
+ * squared errors are summed in replicate order, so that the result does not
+ * depend on the number of threads. As p is sorted in ascending order, a
+ * replicate does not need to copy and sort p-values, but only sorts the
+ * indices it drew and compares them against the index of each lambda in p.
+ */
+static void bootstrapPi0s(const vector<double>& p, const vector<double>& lambdas,
+                          double minPi0, unsigned int numBoot, vector<double>& mse,
+                          size_t max_size = 1000) {
+  size_t numLambdas = lambdas.size();
+  vector<size_t> lambdaIdx(numLambdas);
+  for (size_t ix = 0; ix < numLambdas; ++ix) {
+    lambdaIdx[ix] = distance(p.begin(), lower_bound(p.begin(), p.end(), lambdas[ix]));
+  }
+  
+  double n = p.size();
+  size_t num_draw = min(p.size(), max_size);
+  uint64_t key = PseudoRandom::lcg_rand();
+  vector<double> sqErrors(static_cast<size_t>(numBoot) * numLambdas);
+  #pragma omp parallel
+  {
+    vector<size_t> draws(num_draw);
+    #pragma omp for schedule(static)
+    for (int boot = 0; boot < static_cast<int>(numBoot); ++boot) {
+      uint64_t counter = static_cast<uint64_t>(boot) * num_draw;
+      for (size_t ix = 0; ix < num_draw; ++ix) {
+        draws[ix] = (size_t)(PseudoRandom::counter_uniform(key, counter + ix) * n);
+      }
+      sort(draws.begin(), draws.end());
+      double* sqError = &sqErrors[static_cast<size_t>(boot) * numLambdas];
+      for (size_t ix = 0; ix < numLambdas; ++ix) {
+        double Wl = (double)distance(lower_bound(draws.begin(), draws.end(), lambdaIdx[ix]), draws.end());
+        double pi0Boot = Wl / num_draw / (1 - lambdas[ix]);
+        // Estimated mean-squared error.
+        sqError[ix] = (pi0Boot - minPi0) * (pi0Boot - minPi0);
+      }
+    }
+  }
+  
+  mse.assign(numLambdas, 0.0);
+  for (unsigned int boot = 0; boot < numBoot; ++boot) {
+    for (size_t ix = 0; ix < numLambdas; ++ix) {
+      mse[ix] += sqErrors[static_cast<size_t>(boot) * numLambdas + ix];
+    }
+  }
 }
 
 double mymin(double a, double b) {
@@ -552,22 +588,9 @@ double PosteriorEstimator::estimatePi0(vector<double>& p,
   }
   double minPi0 = *min_element(pi0s.begin(), pi0s.end());
   
-  vector<double> pBoot, mse;
-  // Initialize the vector mse with zeroes.
-  fill_n(back_inserter(mse), pi0s.size(), 0.0);
+  vector<double> mse;
   // Examine which lambda level that is most stable under bootstrap
-  for (unsigned int boot = 0; boot < numBoot; ++boot) {
-    // Create an array of bootstrapped p-values, and sort in ascending order.
-    bootstrap<double> (p, pBoot);
-    n = pBoot.size();
-    for (unsigned int ix = 0; ix < lambdas.size(); ++ix) {
-      start = lower_bound(pBoot.begin(), pBoot.end(), lambdas[ix]);
-      double Wl = (double)distance(start, pBoot.end());
-      double pi0Boot = Wl / n / (1 - lambdas[ix]);
-      // Estimated mean-squared error.
-      mse[ix] += (pi0Boot - minPi0) * (pi0Boot - minPi0);
-    }
-  }
+  bootstrapPi0s(p, lambdas, minPi0, numBoot, mse);
   // Which index did the iterator get?
   unsigned int minIx = distance(mse.begin(), 
                                 min_element(mse.begin(), mse.end()));
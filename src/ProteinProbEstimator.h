@@ -128,7 +128,7 @@ class ProteinProbEstimator {
   virtual bool initialize(Scores& peptideScores, const Enzyme* enzyme);
   
   /** adds spectral counts if specCountQvalThreshold_ is set **/
-  void addSpectralCounts(Scores& peptideScores);
+  virtual void addSpectralCounts(Scores& peptideScores);
   
   /** start the protein probabilities tool**/
   virtual void run() = 0;
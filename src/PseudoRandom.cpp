@@ -25,3 +25,15 @@ unsigned long PseudoRandom::lcg_rand() {
   seed_ = (seed_ * 279470273u) % 4294967291u;
   return seed_;
 }
+
+static inline uint64_t splitmix64_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// SplitMix64, see Steele et al., "Fast splittable pseudorandom number
+// generators", OOPSLA 2014, with the mixed key as the start of the stream
+uint64_t PseudoRandom::counter_rand(uint64_t key, uint64_t counter) {
+  return splitmix64_mix(splitmix64_mix(key) + (counter + 1u) * 0x9e3779b97f4a7c15ull);
+}
@@ -32,6 +32,19 @@ class PseudoRandom {
   inline static void setSeed(unsigned long s) { seed_ = s; }
   static unsigned long lcg_rand();
   const static uint64_t kRandMax = 4294967291u;
+  
+  /*
+  * Counter based generator: a pure function of the stream key and the
+  * counter, which does not touch the LCG state. Independent streams, e.g.
+  * one per bootstrap replicate, can therefore be drawn in parallel and
+  * reproduce the same numbers regardless of the number of threads.
+  */
+  static uint64_t counter_rand(uint64_t key, uint64_t counter);
+  
+  // uniform draw from [0, 1) using the upper 53 bits of counter_rand
+  inline static double counter_uniform(uint64_t key, uint64_t counter) {
+    return (double)(counter_rand(key, counter) >> 11) * (1.0 / 9007199254740992.0);
+  }
  protected:
   static uint64_t seed_;
 };
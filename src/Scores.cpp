@@ -636,10 +636,13 @@ void Scores::recalculateDescriptionOfCorrect(const double fdr) {
 }
 
 void Scores::setDOCFeatures(Normalizer* pNorm) {
+  std::vector<PSMDescription*> psms;
+  psms.reserve(scores_.size());
   std::vector<ScoreHolder>::const_iterator scoreIt = scores_.begin();
   for ( ; scoreIt != scores_.end(); ++scoreIt) {
-    doc_.setFeaturesNormalized(scoreIt->pPSM, pNorm);
+    psms.push_back(scoreIt->pPSM);
   }
+  doc_.setFeaturesNormalized(psms, pNorm);
 }
 
 int Scores::getInitDirection(const double initialSelectionFdr, std::vector<double>& direction) {
@@ -0,0 +1,306 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <cstring>
+#include <sstream>
+
+#include "SharedSVMModel.h"
+#include "MyException.h"
+
+namespace {
+
+const char kMagic[8] = { 'P', 'E', 'R', 'C', 'S', 'V', 'M', '1' };
+// written as is, to reject blocks saved on a machine with another byte order
+const int kByteOrderMark = 0x01020304;
+
+enum {
+  HAS_RHO = 1, HAS_PROBA = 2, HAS_PROBB = 4, HAS_LABEL = 8, HAS_NSV = 16
+};
+
+/*
+ * The block starts with this header, followed by the dimension of every
+ * support vector, the labels and the number of support vectors per class
+ * (classification only), the coefficients sv_coef[k][i] at (k * l + i), rho,
+ * probA, probB and at last the values of all support vectors, one after the
+ * other. Every array starts at a multiple of 8 bytes.
+ */
+struct BlockHeader {
+  char magic[8];
+  int byteOrder;
+  int svmType;
+  int kernelType;
+  int degree;
+  int nrClass;
+  int l;
+  int flags;
+  int reserved;
+  double gamma;
+  double coef0;
+  long long size;
+  long long numValues;
+};
+
+struct BlockLayout {
+  size_t dims, label, nSV, svCoef, rho, probA, probB, values, size;
+};
+
+inline size_t align8(size_t offset) {
+  return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+void computeLayout(const BlockHeader& header, BlockLayout& layout) {
+  size_t l = header.l, nrClass = header.nrClass;
+  size_t numPairs = nrClass * (nrClass - 1) / 2;
+  size_t offset = align8(sizeof(BlockHeader));
+  layout.dims = offset;
+  offset = align8(offset + sizeof(int) * l);
+  layout.label = offset;
+  if (header.flags & HAS_LABEL) offset = align8(offset + sizeof(int) * nrClass);
+  layout.nSV = offset;
+  if (header.flags & HAS_NSV) offset = align8(offset + sizeof(int) * nrClass);
+  layout.svCoef = offset;
+  offset += sizeof(double) * (nrClass - 1) * l;
+  layout.rho = offset;
+  if (header.flags & HAS_RHO) offset += sizeof(double) * numPairs;
+  layout.probA = offset;
+  if (header.flags & HAS_PROBA) offset += sizeof(double) * numPairs;
+  layout.probB = offset;
+  if (header.flags & HAS_PROBB) offset += sizeof(double) * numPairs;
+  layout.values = offset;
+  layout.size = offset + sizeof(double) * static_cast<size_t>(header.numValues);
+}
+
+} // namespace
+
+struct SharedSVMModel::Data {
+  Data() : refCount(1), block(NULL) {}
+
+  int refCount;
+  // the block is either stored in buffer or mapped by file
+  std::vector<double> buffer;
+  MappedFile file;
+  const char* block;
+  // svm_model pointing into the block
+  svm_model model;
+  std::vector<svm_node> nodes;
+  std::vector<double*> svCoef;
+};
+
+SharedSVMModel::SharedSVMModel() : data_(NULL) {}
+
+SharedSVMModel::SharedSVMModel(const svm_model* model) : data_(NULL) {
+  if (model == NULL) return;
+
+  BlockHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.byteOrder = kByteOrderMark;
+  header.svmType = model->param.svm_type;
+  header.kernelType = model->param.kernel_type;
+  header.degree = model->param.degree;
+  header.gamma = model->param.gamma;
+  header.coef0 = model->param.coef0;
+  header.nrClass = model->nr_class;
+  header.l = model->l;
+  header.flags = (model->rho ? HAS_RHO : 0) | (model->probA ? HAS_PROBA : 0) |
+      (model->probB ? HAS_PROBB : 0) | (model->label ? HAS_LABEL : 0) |
+      (model->nSV ? HAS_NSV : 0);
+  long long numValues = 0;
+  for (int i = 0; i < model->l; ++i) {
+    numValues += model->SV[i].dim;
+  }
+  header.numValues = numValues;
+  BlockLayout layout;
+  computeLayout(header, layout);
+  header.size = layout.size;
+
+  Data* data = new Data();
+  data->buffer.resize(layout.size / sizeof(double));
+  char* block = reinterpret_cast<char*>(&data->buffer[0]);
+  memcpy(block, &header, sizeof(header));
+  int* dims = reinterpret_cast<int*>(block + layout.dims);
+  double* values = reinterpret_cast<double*>(block + layout.values);
+  for (int i = 0; i < model->l; ++i) {
+    dims[i] = model->SV[i].dim;
+    memcpy(values, model->SV[i].values, sizeof(double) * dims[i]);
+    values += dims[i];
+  }
+  int numPairs = model->nr_class * (model->nr_class - 1) / 2;
+  if (model->label) {
+    memcpy(block + layout.label, model->label, sizeof(int) * model->nr_class);
+  }
+  if (model->nSV) {
+    memcpy(block + layout.nSV, model->nSV, sizeof(int) * model->nr_class);
+  }
+  for (int k = 0; k < model->nr_class - 1; ++k) {
+    memcpy(block + layout.svCoef + sizeof(double) * k * model->l,
+           model->sv_coef[k], sizeof(double) * model->l);
+  }
+  if (model->rho) {
+    memcpy(block + layout.rho, model->rho, sizeof(double) * numPairs);
+  }
+  if (model->probA) {
+    memcpy(block + layout.probA, model->probA, sizeof(double) * numPairs);
+  }
+  if (model->probB) {
+    memcpy(block + layout.probB, model->probB, sizeof(double) * numPairs);
+  }
+  attach(data, block);
+  data_ = data;
+}
+
+SharedSVMModel::SharedSVMModel(const SharedSVMModel& other) : data_(other.data_) {
+  if (data_ != NULL) {
+#pragma omp critical (shared_svm_model)
+    ++data_->refCount;
+  }
+}
+
+SharedSVMModel& SharedSVMModel::operator=(const SharedSVMModel& other) {
+  if (data_ != other.data_) {
+    release();
+    data_ = other.data_;
+    if (data_ != NULL) {
+#pragma omp critical (shared_svm_model)
+      ++data_->refCount;
+    }
+  }
+  return *this;
+}
+
+SharedSVMModel::~SharedSVMModel() {
+  release();
+}
+
+const svm_model* SharedSVMModel::get() const {
+  return data_ != NULL ? &data_->model : NULL;
+}
+
+void SharedSVMModel::reset() {
+  release();
+}
+
+void SharedSVMModel::release() {
+  if (data_ == NULL) return;
+  bool last;
+#pragma omp critical (shared_svm_model)
+  last = (--data_->refCount == 0);
+  if (last) {
+    delete data_;
+  }
+  data_ = NULL;
+}
+
+void SharedSVMModel::attach(Data* data, const char* block) {
+  BlockHeader header;
+  memcpy(&header, block, sizeof(header));
+  BlockLayout layout;
+  computeLayout(header, layout);
+  data->block = block;
+
+  svm_model& model = data->model;
+  memset(&model, 0, sizeof(model));
+  model.param.svm_type = header.svmType;
+  model.param.kernel_type = header.kernelType;
+  model.param.degree = header.degree;
+  model.param.gamma = header.gamma;
+  model.param.coef0 = header.coef0;
+  model.nr_class = header.nrClass;
+  model.l = header.l;
+  // the block is shared and possibly read-only, libsvm only reads it
+  char* base = const_cast<char*>(block);
+  const int* dims = reinterpret_cast<const int*>(block + layout.dims);
+  double* values = reinterpret_cast<double*>(base + layout.values);
+  data->nodes.resize(header.l);
+  for (int i = 0; i < header.l; ++i) {
+    data->nodes[i].dim = dims[i];
+    data->nodes[i].values = values;
+    values += dims[i];
+  }
+  model.SV = header.l > 0 ? &data->nodes[0] : NULL;
+  data->svCoef.resize(header.nrClass - 1);
+  for (int k = 0; k < header.nrClass - 1; ++k) {
+    data->svCoef[k] = reinterpret_cast<double*>(base + layout.svCoef) + k * header.l;
+  }
+  model.sv_coef = header.nrClass > 1 ? &data->svCoef[0] : NULL;
+  if (header.flags & HAS_RHO) model.rho = reinterpret_cast<double*>(base + layout.rho);
+  if (header.flags & HAS_PROBA) model.probA = reinterpret_cast<double*>(base + layout.probA);
+  if (header.flags & HAS_PROBB) model.probB = reinterpret_cast<double*>(base + layout.probB);
+  if (header.flags & HAS_LABEL) model.label = reinterpret_cast<int*>(base + layout.label);
+  if (header.flags & HAS_NSV) model.nSV = reinterpret_cast<int*>(base + layout.nSV);
+  model.free_sv = 0; // the block is not owned by the svm_model
+}
+
+int SharedSVMModel::save(FILE* fp) const {
+  if (data_ == NULL) return -1;
+  BlockHeader header;
+  memcpy(&header, data_->block, sizeof(header));
+  size_t size = static_cast<size_t>(header.size);
+  if (fwrite(data_->block, 1, size, fp) != size) return -1;
+  return ferror(fp) != 0 ? -1 : 0;
+}
+
+size_t SharedSVMModel::load(const std::string& fileName) {
+  Data* data = new Data();
+  if (!data->file.open(fileName)) {
+    delete data;
+    std::ostringstream temp;
+    temp << "Error: Unable to open " << fileName << ". Execution aborted." << std::endl;
+    throw MyException(temp.str());
+  }
+  const char* block = data->file.data();
+  bool valid = data->file.size() >= sizeof(BlockHeader);
+  BlockHeader header;
+  if (valid) {
+    memcpy(&header, block, sizeof(header));
+    valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.byteOrder == kByteOrderMark && header.nrClass >= 2 &&
+        header.l >= 0 && header.numValues >= 0;
+  }
+  if (valid) {
+    BlockLayout layout;
+    computeLayout(header, layout);
+    valid = static_cast<long long>(layout.size) == header.size &&
+        layout.size <= data->file.size();
+    long long numValues = 0;
+    const int* dims = reinterpret_cast<const int*>(block + layout.dims);
+    for (int i = 0; valid && i < header.l; ++i) {
+      valid = dims[i] >= 0;
+      numValues += dims[i];
+    }
+    valid = valid && numValues == header.numValues;
+  }
+  if (!valid) {
+    delete data;
+    std::ostringstream temp;
+    temp << "Error: " << fileName << " does not start with a binary svm model "
+         << "written on this platform. Execution aborted." << std::endl;
+    throw MyException(temp.str());
+  }
+  attach(data, block);
+  release();
+  data_ = data;
+  return static_cast<size_t>(header.size);
+}
+
+bool SharedSVMModel::isBinary(FILE* fp) {
+  char magic[sizeof(kMagic)];
+  long pos = ftell(fp);
+  size_t read = fread(magic, 1, sizeof(magic), fp);
+  fseek(fp, pos, SEEK_SET);
+  return read == sizeof(magic) && memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class SharedSVMModel, an immutable svm_model whose
+ * support vectors, coefficients and constants are stored in one contiguous
+ * block. Copies of a SharedSVMModel share the block by reference counting.
+ * The block is also the binary model format, so a saved model is loaded by
+ * memory mapping the file instead of parsing it. Used by the retention time
+ * models of Percolator and Elude.
+ */
+
+#ifndef SHAREDSVMMODEL_H_
+#define SHAREDSVMMODEL_H_
+
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "svm.h"
+#include "MappedFile.h"
+
+class SharedSVMModel {
+ public:
+  SharedSVMModel();
+  /**
+   * Packs a copy of model; the original model can be destroyed afterwards.
+   */
+  explicit SharedSVMModel(const svm_model* model);
+  SharedSVMModel(const SharedSVMModel& other);
+  SharedSVMModel& operator=(const SharedSVMModel& other);
+  ~SharedSVMModel();
+
+  bool isNull() const { return data_ == NULL; }
+  const svm_model* get() const;
+  void reset();
+
+  /**
+   * Writes the block to fp in the binary model format.
+   * \returns 0 on success.
+   */
+  int save(FILE* fp) const;
+  /**
+   * Memory maps a binary model stored at the beginning of fileName.
+   * \returns the size of the block in bytes, that is the offset at which
+   * any data appended after the model starts.
+   */
+  size_t load(const std::string& fileName);
+  /**
+   * Checks whether the next bytes of fp start a binary model; the position
+   * of fp is not changed.
+   */
+  static bool isBinary(FILE* fp);
+
+ private:
+  struct Data;
+
+  // points the svm_model of data into the packed block without copying it;
+  // the block (the packed heap buffer or the mapped file) must outlive data
+  static void attach(Data* data, const char* block);
+  void release();
+
+  Data* data_;
+};
+
+#endif /* SHAREDSVMMODEL_H_ */
@@ -1,24 +1,214 @@
 #include "FragSpectrumScanDatabase.h"
 //#include <MSToolkitTypes.h>
  
+// size in bytes beyond which the xml psms are stored in the backend
+static const size_t kPsmStoreBudget = 64 << 20;
+
 
 FragSpectrumScanDatabase::FragSpectrumScanDatabase(string id_par) :
     scan2rt(NULL) {
   if(id_par.empty()) id = "no_id"; else id = id_par;
 }
 
-void FragSpectrumScanDatabase::savePsm( unsigned int scanNr,
-    std::auto_ptr< percolatorInNs::peptideSpectrumMatch > psm_p ) {
-  std::auto_ptr< ::percolatorInNs::fragSpectrumScan>  fss = getFSS(scanNr);
-  // if FragSpectrumScan does not yet exist, create it
-  if (!fss.get()) {
-    std::auto_ptr< ::percolatorInNs::fragSpectrumScan>
-    fs_p( new ::percolatorInNs::fragSpectrumScan(scanNr));
-    fss = fs_p;
+void FragSpectrumScanDatabase::savePsm(const PsmRecord& psm) {
+  psms_.append(psm);
+  if (psms_.bytes() > kPsmStoreBudget) {
+    storePsms();
+  }
+}
+
+/*
+ * Groups the psms of the store by scan and adds each group to its
+ * fragSpectrumScan, which is read from and written to the backend once.
+ */
+void FragSpectrumScanDatabase::storePsms() {
+  sortPsms(psms_);
+  PsmRecord psm;
+  size_t first = 0;
+  while (first < psms_.size()) {
+    unsigned int scanNr = psms_[first].scanNr;
+    std::auto_ptr< ::percolatorInNs::fragSpectrumScan>  fss = getFSS(scanNr);
+    // if FragSpectrumScan does not yet exist, create it
+    if (!fss.get()) {
+      std::auto_ptr< ::percolatorInNs::fragSpectrumScan>
+      fs_p( new ::percolatorInNs::fragSpectrumScan(scanNr));
+      fss = fs_p;
+    }
+    // add the psms to the FragSpectrumScan in the order they were saved
+    size_t last = first;
+    for (; last < psms_.size() && psms_[last].scanNr == scanNr; ++last) {
+      psms_.get(last, psm);
+      fss->peptideSpectrumMatch().push_back(createPeptideSpectrumMatch(psm));
+    }
+    if (scan2rt != NULL) {
+      storeRetentionTime(*fss);
+    }
+    putFSS(*fss);
+    first = last;
+  }
+  psms_.clear();
+}
+
+void FragSpectrumScanDatabase::flushPsms() {
+  if (!psms_.empty()) {
+    storePsms();
+  }
+  sortPsms(tabPsms_);
+}
+
+void FragSpectrumScanDatabase::sortPsms(PsmStore& psms) {
+  psms.sortByScan(PsmStore::lessScanNr);
+}
+
+void FragSpectrumScanDatabase::saveTabPsm(const PsmRecord& psm) {
+  tabPsms_.append(psm);
+}
+
+void FragSpectrumScanDatabase::printTabPsms(ostream &tabOutputStream) {
+  std::vector<PsmRecord> scanPsms;
+  size_t first = 0;
+  while (first < tabPsms_.size()) {
+    unsigned int scanNr = tabPsms_[first].scanNr;
+    size_t last = first;
+    for (; last < tabPsms_.size() && tabPsms_[last].scanNr == scanNr; ++last) {
+      if (scanPsms.size() <= last - first) {
+        scanPsms.resize(last - first + 1);
+      }
+      tabPsms_.get(last, scanPsms[last - first]);
+    }
+    scanPsms.resize(last - first);
+    if (scan2rt != NULL) {
+      storeRetentionTime(scanNr, scanPsms);
+    }
+    std::vector<PsmRecord>::const_iterator it;
+    for (it = scanPsms.begin(); it != scanPsms.end(); ++it) {
+      it->printTab(tabOutputStream);
+    }
+    first = last;
+  }
+}
+
+std::auto_ptr<peptideSpectrumMatch> FragSpectrumScanDatabase::createPeptideSpectrumMatch(const PsmRecord& psm) {
+  std::auto_ptr< percolatorInNs::features >  features_p( new percolatorInNs::features ());
+  percolatorInNs::features::feature_sequence & f_seq =  features_p->feature();
+  std::copy(psm.features.begin(), psm.features.end(), std::back_inserter(f_seq));
+  
+  std::auto_ptr< percolatorInNs::peptideType > peptide_p( new percolatorInNs::peptideType( psm.peptide ) );
+  std::vector<PsmModification>::const_iterator mod;
+  for (mod = psm.modifications.begin(); mod != psm.modifications.end(); ++mod) {
+    std::auto_ptr< percolatorInNs::modificationType > mod_p( new percolatorInNs::modificationType(mod->location));
+    if (mod->isUniMod) {
+      std::auto_ptr< percolatorInNs::uniMod > um_p(new percolatorInNs::uniMod(mod->accession));
+      mod_p->uniMod(um_p);
+    } else {
+      std::auto_ptr< percolatorInNs::freeMod > fm_p (new percolatorInNs::freeMod(mod->moniker));
+      mod_p->freeMod(fm_p);
+    }
+    peptide_p->modification().push_back(mod_p);
+  }
+  
+  std::auto_ptr< percolatorInNs::peptideSpectrumMatch >
+  psm_p(new percolatorInNs::peptideSpectrumMatch (features_p,  peptide_p, psm.id, psm.isDecoy,
+                                                  psm.experimentalMass, psm.calculatedMass, psm.chargeState));
+  if (psm.hasObservedTime) psm_p->observedTime().set(psm.observedTime);
+  
+  std::vector<std::string>::const_iterator proteinId;
+  for (proteinId = psm.proteinIds.begin(); proteinId != psm.proteinIds.end(); ++proteinId) {
+    std::auto_ptr< percolatorInNs::occurence > oc_p(new percolatorInNs::occurence (*proteinId, psm.flankN, psm.flankC));
+    psm_p->occurence().push_back(oc_p);
+  }
+  return psm_p;
+}
+
+/*
+ * Returns the retention time of the alternative EZ-line whose mass is
+ * closest to the experimental mass of the psm.
+ */
+double FragSpectrumScanDatabase::retentionTimeForMass(const vector<double>& rTimes, double experimentalMass) {
+  double storeMe = 0;
+  // Loop over alternatives EZ-lines, choose the one with the smallest mass difference
+  double altMassDiff = (std::numeric_limits<double>::max)();  // + infinity
+  vector<double>::const_iterator r = rTimes.begin();
+  for(; r<rTimes.end(); r=r+2) { // Loops over the EZ-line mh values (rounded to one or two decimals...)
+    double rrr = *r;  //mass+h
+    double exm = experimentalMass;  //actually masstocharge
+    //FIXME: as rrr is m+h and exm is m/z, this ugly fix loops through many charges
+    double rrr_mz;
+    for(int charge = 1; charge<7; charge++) {
+      rrr_mz = (rrr + (charge-1)*1.007276466) / charge;
+      if(abs(rrr_mz-exm) < altMassDiff) {
+        altMassDiff = abs(rrr_mz-exm);
+        storeMe = *(r+1);
+      }
+    }
+  }
+  return storeMe;
+}
+
+/*
+ * Joins the psms of one scan with the retention time index. If the spectrum
+ * has several EZ-lines, the retention time is taken from the line closest
+ * in mass to the target psm whose observed mass is closest to its
+ * theoretical mass.
+ */
+void FragSpectrumScanDatabase::storeRetentionTime(unsigned int scanNr, std::vector<PsmRecord>& psms) {
+  map<int, vector<double> >::const_iterator rt = scan2rt->find(scanNr);
+  if (rt == scan2rt->end()) return;
+  const vector<double>& rTimes = rt->second;
+  double storeMe = 0;
+  if (rTimes.size()==1) {
+    storeMe = rTimes[0];
+  } else {
+    double massDiff = (std::numeric_limits<double>::max)(); // + infinity
+    std::vector<PsmRecord>::const_iterator psm;
+    for (psm = psms.begin(); psm != psms.end(); ++psm) {
+      if (!psm->isDecoy && abs(psm->calculatedMass - psm->experimentalMass) < massDiff) {
+        massDiff = abs(psm->calculatedMass - psm->experimentalMass);
+        storeMe = retentionTimeForMass(rTimes, psm->experimentalMass);
+      }
+    }
+  }
+  std::vector<PsmRecord>::iterator psm;
+  for (psm = psms.begin(); psm != psms.end(); ++psm) {
+    psm->hasObservedTime = true;
+    psm->observedTime = storeMe;
+  }
+}
+
+void FragSpectrumScanDatabase::storeRetentionTime(fragSpectrumScan& fss) {
+  map<int, vector<double> >::const_iterator rt = scan2rt->find(fss.scanNumber());
+  if (rt == scan2rt->end()) return;
+  const vector<double>& rTimes = rt->second;
+  fragSpectrumScan::peptideSpectrumMatch_sequence& psmSeq = fss.peptideSpectrumMatch();
+  // retention time to be stored
+  double storeMe = 0;
+  // if rTimes only contains one element
+  if (rTimes.size()==1) {
+    // take that as retention time
+    storeMe = rTimes[0];
+  } else {
+    // else, take retention time of psm that has observed mass closest to
+    // theoretical mass (smallest massDiff)
+    double massDiff = (std::numeric_limits<double>::max)(); // + infinity
+    for (fragSpectrumScan::peptideSpectrumMatch_iterator psmIter_i = psmSeq.begin(); psmIter_i != psmSeq.end(); ++psmIter_i) {
+      // skip decoy
+      if (psmIter_i->isDecoy() != true) {
+        double cm = psmIter_i->calculatedMass();
+        double em = psmIter_i->experimentalMass();
+        // if a psm with observed mass closer to theoretical mass is found
+        if (abs(cm-em) < massDiff) {
+          // update massDiff
+          massDiff = abs(cm-em);
+          // get corresponding retention time
+          storeMe = retentionTimeForMass(rTimes, em);
+        }
+      }
+    }
+  }
+  // store retention time for all psms in fss
+  for (fragSpectrumScan::peptideSpectrumMatch_iterator psmIter = psmSeq.begin(); psmIter != psmSeq.end(); ++psmIter) {
+    psmIter->observedTime().set(storeMe);
   }
-  // add the psm to the FragSpectrumScan
-  fss->peptideSpectrumMatch().push_back(psm_p);
-  putFSS(*fss);
 }
 
 bool FragSpectrumScanDatabase::initRTime(map<int, vector<double> >* scan2rt_par) {
@@ -28,35 +218,34 @@ bool FragSpectrumScanDatabase::initRTime(map<int, vector<double> >* scan2rt_par)
 }
 
 void FragSpectrumScanDatabase::printTabFss(std::auto_ptr< ::percolatorInNs::fragSpectrumScan> fss, ostream &tabOutputStream) {
-  int label = 0;
   BOOST_FOREACH (const ::percolatorInNs::peptideSpectrumMatch &psm, fss->peptideSpectrumMatch()) {
-    if (psm.isDecoy()) {
-      label = -1;
-    } else {
-      label = 1;
-    }
-
-    tabOutputStream << psm.id() << '\t' << label << '\t' << fss->scanNumber();
-    tabOutputStream << '\t' << psm.experimentalMass() << '\t' << psm.calculatedMass();
+    PsmRecord record;
+    record.id = psm.id();
+    record.isDecoy = psm.isDecoy();
+    record.scanNr = fss->scanNumber();
+    record.experimentalMass = psm.experimentalMass();
+    record.calculatedMass = psm.calculatedMass();
+    record.chargeState = psm.chargeState();
     if (psm.observedTime().present()) {
-      tabOutputStream << '\t' << psm.observedTime() << '\t' << MassHandler::massDiff(psm.experimentalMass() ,psm.calculatedMass(),psm.chargeState());
+      record.hasObservedTime = true;
+      record.observedTime = psm.observedTime().get();
     }
     BOOST_FOREACH (const double feature, psm.features().feature()) {
-      tabOutputStream << '\t' << feature;
+      record.features.push_back(feature);
     }
     bool isFirst = true;
     BOOST_FOREACH (const ::percolatorInNs::occurence & oc, psm.occurence() ) {
-      // adding n-term and c-term residues to peptide
       //NOTE the residues for the peptide in the PSMs are always the same for every protein
       if (isFirst) {
-        tabOutputStream << '\t' << oc.flankN() << "." << decoratePeptide(psm.peptide()) << "." << oc.flankC();
+        record.flankN = oc.flankN();
+        record.flankC = oc.flankC();
         isFirst = false;
       }
-      std::string proteinId = oc.proteinId();
-      std::replace(proteinId.begin(), proteinId.end(), ' ', '-');
-      tabOutputStream << '\t' << proteinId;
+      record.addProtein(oc.proteinId());
     }
-    tabOutputStream << std::endl;
+    // the decoration is done here, as a psm may carry both a uniMod and a freeMod
+    record.peptide = decoratePeptide(psm.peptide());
+    record.printTab(tabOutputStream);
   }
 }
 
@@ -74,15 +263,7 @@ std::string FragSpectrumScanDatabase::decoratePeptide(const ::percolatorInNs::pe
       mods.push_back(std::pair<int,std::string>(mod_ref.location(),ss.str()));
     }
   }
-  mods.sort(greater<std::pair<int,std::string> >());
-  std::list<std::pair<int,std::string> >::const_iterator it;
-  for (it = mods.begin(); it != mods.end(); ++it) {
-    if (it->first <= peptideSeq.length()) {
-      peptideSeq.insert(it->first, it->second);
-    } else {
-      peptideSeq.insert(peptideSeq.length(), it->second);
-    }
-  }
+  PsmRecord::insertModifications(peptideSeq, mods);
   return peptideSeq;
 }
 
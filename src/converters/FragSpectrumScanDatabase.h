@@ -24,11 +24,15 @@
 #include <cstring>  // memcpy
 #include <map>
 #include <list>
+#include <vector>
 #include <string>
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include "Globals.h"
 #include "MassHandler.h"
+#include "PsmRecord.h"
+#include "PsmStore.h"
 #include "serializer.hxx"
 #include <xercesc/util/PlatformUtils.hpp>
 #include <xercesc/util/XMLUni.hpp>
@@ -69,9 +73,46 @@ class FragSpectrumScanDatabase {
     
     ~FragSpectrumScanDatabase(){};
     
+    /**
+     * Sets the scan -> retention time index, which is joined to the psms
+     * whenever they are grouped into their scans. Has to be set before the
+     * first psm is saved.
+     */
     bool initRTime(map<int, vector<double> >* scan2rt_par);
     
-    void savePsm(unsigned int scanNr, auto_ptr<peptideSpectrumMatch> psm_p );
+    static double retentionTimeForMass(const vector<double>& rTimes, double experimentalMass);
+    
+    /**
+     * Appends the psm to the psm store of this database, for xml output.
+     * Whenever the store grows beyond kPsmStoreBudget bytes, and once more
+     * by flushPsms(), its psms are grouped by scan and each scan is read,
+     * extended and written to the backend once, rather than once per psm.
+     * The memory use of the LevelDB and Tokyo Cabinet backends therefore
+     * stays bounded.
+     */
+    void savePsm(const PsmRecord& psm);
+    
+    /**
+     * Merges all psms saved since the last call into the fragSpectrumScans
+     * of the database and sorts the tab psms. Has to be called before the
+     * scans are accessed with getFSS, print or printTab, and before
+     * printTabPsms.
+     */
+    void flushPsms();
+    
+    /**
+     * Stores a psm for tab output. These psms never pass through the xsd
+     * object model, they stay in their own psm store and are grouped by
+     * scan by printTabPsms().
+     */
+    void saveTabPsm(const PsmRecord& psm);
+    
+    void printTabPsms(ostream &tabOutputStream);
+    
+    /**
+     * Converts the psm into the xsd object model of the xml output.
+     */
+    static auto_ptr<peptideSpectrumMatch> createPeptideSpectrumMatch(const PsmRecord& psm);
     
     virtual std::string toString() = 0;
     
@@ -93,10 +134,22 @@ class FragSpectrumScanDatabase {
     std::string id;
   
   protected:
+    /**
+     * Sorts the psms of the store into the order in which printTab walks
+     * the scans of this backend, by default by increasing scan number.
+     */
+    virtual void sortPsms(PsmStore& psms);
+    
     // pointer to retention times
     map<int, vector<double> >* scan2rt;
     
+  private:
+    PsmStore psms_; // xml output psms not yet stored in the backend
+    PsmStore tabPsms_;
     
+    void storePsms();
+    void storeRetentionTime(fragSpectrumScan& fss);
+    void storeRetentionTime(unsigned int scanNr, std::vector<PsmRecord>& psms);
 };
 
 #endif
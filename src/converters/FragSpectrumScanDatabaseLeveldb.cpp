@@ -125,6 +125,10 @@ void FragSpectrumScanDatabaseLeveldb::printTab(ostream &tabOutputStream) {
 }
 
 
+void FragSpectrumScanDatabaseLeveldb::sortPsms(PsmStore& psms) {
+  psms.sortByScan(PsmStore::lessScanNrText);
+}
+
 void FragSpectrumScanDatabaseLeveldb::putFSS( ::percolatorInNs::fragSpectrumScan & fss ) 
 {
   assert(bdb);
@@ -48,6 +48,12 @@ public:
   
   virtual void putFSS( ::percolatorInNs::fragSpectrumScan & fss );
   
+protected:
+  
+  // the scans are keyed by their decimal scan number, so printTab walks
+  // them in string order
+  virtual void sortPsms(PsmStore& psms);
+  
 private:
   
   XDR xdr;
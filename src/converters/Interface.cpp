@@ -100,6 +100,11 @@ bool Interface::parseOpt(int argc, char **argv,const std::string &usage)
       "Include experimental mass in PSMid for easier correlation with search engine results.",
       "",
       TRUE_IF_SET);
+  cmd.defineOption(Option::NO_SHORT_OPT,
+      "no-schema-validation",
+      "Do not validate xml input files (mzIdentML, X!Tandem) against their schema, which speeds up reading large files.",
+      "",
+      TRUE_IF_SET);
   cmd.defineOption("N",
       "PNGaseF",
       "Calculate feature based on N-linked glycosylation pattern resulting from a PNGaseF treatment. (N[*].[ST])",
@@ -178,6 +183,7 @@ bool Interface::parseOpt(int argc, char **argv,const std::string &usage)
     parseOptions.enzymeString = cmd.options["enzyme"];
   }
   if (cmd.optionSet("id-with-exp-mass")) parseOptions.expMassInPsmId = true;
+  if (cmd.optionSet("no-schema-validation")) parseOptions.validateSchema = false;
   if (cmd.optionSet("PNGaseF")) parseOptions.pngasef = true;
   if (cmd.optionSet("aa-freq")) parseOptions.calcAAFrequencies = true;
   if (cmd.optionSet("PTM")) parseOptions.calcPTMs = true;
@@ -9,7 +9,10 @@ MSReader::MSReader(){
   iMZPrecision=4;
   //filter=Unspecified;
   rampFileOpen=false;
+  rampBatchPeaks=NULL;
+  rampBatchPos=0;
   compressMe=false;
+  scanIndex=NULL;
   rawFileOpen=false;
   exportMGF=false;
   highResMGF=false;
@@ -42,6 +45,7 @@ MSReader::MSReader(){
 
 MSReader::~MSReader(){
   closeFile();
+  clearRAMPBatch();
   if(rampFileOpen) {
     rampCloseFile(rampFileIn);
     free(pScanIndex);
@@ -248,6 +252,13 @@ bool MSReader::readFile(const char *c, bool text, Spectrum& s, int scNum){
 
   } else {
 
+    //with a scan index, go straight to the requested scan instead of searching for it
+    if(scNum!=0 && scanIndex!=NULL && scanIndex->getFileSize()==(long long)lEnd){
+      const MSScanIndexEntry* e=scanIndex->find(scNum);
+      if(e==NULL) return false;
+      fseek(fileIn,(f_off)e->offset,0);
+    }
+
     //if reading text files, some parsing is required.
     while(true){
 
@@ -1377,11 +1388,12 @@ bool MSReader::readFile(const char* c, MSFileFormat f, Spectrum& s, int scNum){
 
 	ramp_fileoffset_t indexOffset;
 	ScanHeaderStruct scanHeader;
-	RAMPREAL *pPeaks;
+	RAMPREAL *pPeaks=NULL;
 	int i,j;
 
 	if(c!=NULL) {
 		//open the file if new file was requested
+		clearRAMPBatch();
 		if(rampFileOpen) {
 			rampCloseFile(rampFileIn);
 			rampFileOpen=false;
@@ -1412,6 +1424,7 @@ bool MSReader::readFile(const char* c, MSFileFormat f, Spectrum& s, int scNum){
 
 	//read scan header
 	if(scNum!=0) {
+    clearRAMPBatch();
     rampIndex=scNum;
     /* Henry Lam fixed ramp to take scan numbers as indexes,
        see ramp.cpp commments marked HENRY
@@ -1490,51 +1503,14 @@ bool MSReader::readFile(const char* c, MSFileFormat f, Spectrum& s, int scNum){
 
   } else /* if scnum == 0 */ {
 
-		//read next index
-	  while(true){
-	    rampIndex++;
+		//take the next scan from the batch, the scans that follow are read at once
+		//when the batch is used up
+		if(rampBatchPos==(int)rampBatchIndices.size() && !readRAMPBatch()) return false;
+		scanHeader=rampBatchHeaders[rampBatchPos];
+		rampIndex=rampBatchIndices[rampBatchPos];
+		RAMPREAL* pBatchPeaks=rampBatchPeaks+rampBatchOffsets[rampBatchPos];
+		rampBatchPos++;
 
-	    //reached end of file
-	    if(rampIndex>rampLastScan) {
-				//rampCloseFile(rampFileIn);
-				//rampFileIn = NULL;
-				return false;
-			};
-			readHeader(rampFileIn, pScanIndex[rampIndex], &scanHeader);
-			/*
-			switch(filter){
-			case MS1:
-				if(scanHeader.msLevel!=1)	continue;
-				break;
-			case MS2:
-				if(scanHeader.msLevel!=2)	continue;
-				break;
-			case MS3:
-				if(scanHeader.msLevel!=3)	continue;
-				break;
-			default:
-				//no filter
-				break;
-			};
-			*/
-			switch(scanHeader.msLevel){
-			case 1:
-			  mslevel = MS1;
-			  break;
-			case 2:
-			  mslevel = MS2;
-			  break;
-			case 3:
-			  mslevel = MS3;
-			  break;
-			default:
-			  break;
-			}
-			if(find(filter.begin(), filter.end(), mslevel) != filter.end())
-			  break;
-			//if we got here, we passed the filter.
-
-		};
 		s.setMsLevel(scanHeader.msLevel);
 		s.setScanNumber(scanHeader.acquisitionNum);
 		s.setScanNumber(scanHeader.acquisitionNum,true);
@@ -1549,10 +1525,10 @@ bool MSReader::readFile(const char* c, MSFileFormat f, Spectrum& s, int scNum){
 		};
 		if(scanHeader.msLevel>1) s.setMZ(scanHeader.precursorMZ);
 		if(scanHeader.precursorCharge>0) s.addZState(scanHeader.precursorCharge,scanHeader.precursorMZ*scanHeader.precursorCharge-(scanHeader.precursorCharge-1)*1.00727649);
-		pPeaks = readPeaks(rampFileIn, pScanIndex[rampIndex]);
+		//the peaks of a scan end with -1 in the batch
 		j=0;
-		for(i=0;i<scanHeader.peaksCount;i++){
-			s.add((double)pPeaks[j],(float)pPeaks[j+1]);
+		for(i=0;i<scanHeader.peaksCount && pBatchPeaks[j]!=-1;i++){
+			s.add((double)pBatchPeaks[j],(float)pBatchPeaks[j+1]);
 			j+=2;
 		};
 
@@ -1563,6 +1539,62 @@ bool MSReader::readFile(const char* c, MSFileFormat f, Spectrum& s, int scNum){
 
 };
 
+//Reads the headers of the next scans that pass the filter, and decodes their peaks
+//at once with readPeaksBatch. Returns false if there are no more scans.
+bool MSReader::readRAMPBatch(){
+  const int batchSize=64;
+  ScanHeaderStruct scanHeader;
+  MSSpectrumType mslevel=Unspecified;
+  int index=rampIndex;
+
+  clearRAMPBatch();
+  while((int)rampBatchIndices.size()<batchSize && index<rampLastScan){
+    index++;
+    readHeader(rampFileIn, pScanIndex[index], &scanHeader);
+    switch(scanHeader.msLevel){
+    case 1:
+      mslevel = MS1;
+      break;
+    case 2:
+      mslevel = MS2;
+      break;
+    case 3:
+      mslevel = MS3;
+      break;
+    default:
+      break;
+    }
+    if(find(filter.begin(), filter.end(), mslevel) != filter.end()){
+      rampBatchHeaders.push_back(scanHeader);
+      rampBatchIndices.push_back(index);
+    }
+  }
+  if(rampBatchIndices.empty()) {
+    rampIndex=index;
+    return false;
+  }
+
+  int numScans=(int)rampBatchIndices.size();
+  vector<ramp_fileoffset_t> offsets(numScans);
+  for(int i=0;i<numScans;i++) offsets[i]=pScanIndex[rampBatchIndices[i]];
+  rampBatchOffsets.resize(numScans);
+  rampBatchPeaks=readPeaksBatch(rampFileIn,&offsets[0],numScans,&rampBatchOffsets[0]);
+  if(rampBatchPeaks==NULL) {
+    clearRAMPBatch();
+    return false;
+  }
+  return true;
+}
+
+void MSReader::clearRAMPBatch(){
+  free(rampBatchPeaks);
+  rampBatchPeaks=NULL;
+  rampBatchHeaders.clear();
+  rampBatchIndices.clear();
+  rampBatchOffsets.clear();
+  rampBatchPos=0;
+}
+
 void MSReader::setFilter(MSSpectrumType m){
   filter.clear();
   filter.push_back(m);
@@ -1598,6 +1630,10 @@ void MSReader::setRawFilter(char *c){
   #endif
 }
 
+void MSReader::setScanIndex(const MSScanIndex* idx){
+  scanIndex=idx;
+}
+
 void MSReader::setHighResMGF(bool b){
   highResMGF=b;
 }
@@ -3,6 +3,7 @@
 
 #include "Spectrum.h"
 #include "MSObject.h"
+#include "MSScanIndex.h"
 #include <cstring>
 #include <zlib.h>
 #include "ramp.h"
@@ -104,6 +105,10 @@ class MSReader {
   //File compression
   void setCompression(bool b);
 
+  //Random access to scans of text MS1/MS2 files. The index is owned by the caller
+  //and is only used for files of the size it was built for.
+  void setScanIndex(const MSScanIndex* idx);
+
   //for Sqlite
   void createIndex(); 
 
@@ -127,12 +132,24 @@ class MSReader {
   //File compression
   bool compressMe;
 
+  //scan offsets of text files
+  const MSScanIndex* scanIndex;
+
   //mzXML support variables;
   ramp_fileoffset_t  *pScanIndex;
   RAMPFILE  *rampFileIn;
   bool rampFileOpen;
   int rampLastScan;
   int rampIndex;
+
+  //headers and peaks of the next scans of a sequential mzXML read, whose peaks
+  //are decoded at once by readPeaksBatch
+  vector<ScanHeaderStruct> rampBatchHeaders;
+  vector<int> rampBatchIndices;
+  vector<size_t> rampBatchOffsets;
+  RAMPREAL* rampBatchPeaks;
+  int rampBatchPos;
+
   vector<MSSpectrumType> filter;
 
   //for RAW file support (even if not on windows)
@@ -148,6 +165,8 @@ class MSReader {
   bool findSpectrum(int i);
   void readCompressSpec(FILE* fileIn, MSScanInfo& ms, Spectrum& s);
   void readSpecHeader(FILE* fileIn, MSScanInfo& ms);
+  bool readRAMPBatch();
+  void clearRAMPBatch();
 
   void writeBinarySpec(FILE* fileOut, Spectrum& s);
   void writeCompressSpec(FILE* fileOut, Spectrum& s);
@@ -0,0 +1,304 @@
+#include "MSScanIndex.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+//files smaller than this are searched for spectra by a single thread
+static const size_t minChunkSize = 1 << 20;
+
+static const char indexMagic[8] = {'M','S','T','K','S','C','N','2'};
+
+static bool compareScanNumber(const MSScanIndexEntry& a, const MSScanIndexEntry& b){
+  return a.scanNumber < b.scanNumber;
+}
+
+//copies the line at p into buf, truncated to len-1 characters, and returns the start of the next line
+static const char* nextLine(const char* p, const char* end, char* buf, int len){
+  const char* eol=(const char*)memchr(p,'\n',end-p);
+  if(eol==NULL) eol=end;
+  int n=(int)(eol-p);
+  if(n>len-1) n=len-1;
+  memcpy(buf,p,n);
+  buf[n]='\0';
+  return (eol<end) ? eol+1 : end;
+}
+
+MSScanIndex::MSScanIndex(){
+  fileSize=0;
+  fileTime=0;
+  isMGF=false;
+}
+
+MSScanIndex::~MSScanIndex(){
+}
+
+void MSScanIndex::clear(){
+  entries.clear();
+  ezLines.clear();
+  fileSize=0;
+  fileTime=0;
+  isMGF=false;
+}
+
+unsigned int MSScanIndex::size() const{
+  return (unsigned int)entries.size();
+}
+
+const MSScanIndexEntry& MSScanIndex::at(const unsigned int& i) const{
+  return entries[i];
+}
+
+const MSScanIndexEZ& MSScanIndex::getEZ(const MSScanIndexEntry& e, int i) const{
+  return ezLines[e.firstEZ+i];
+}
+
+long long MSScanIndex::getFileSize() const{
+  return fileSize;
+}
+
+string MSScanIndex::sidecarName(const char* fileName){
+  return string(fileName) + ".msidx";
+}
+
+//binary search, the entries are sorted by scan number. Returns NULL if the scan is not in the file.
+const MSScanIndexEntry* MSScanIndex::find(int scanNumber) const{
+  MSScanIndexEntry key;
+  key.scanNumber=scanNumber;
+  vector<MSScanIndexEntry>::const_iterator it=lower_bound(entries.begin(),entries.end(),key,compareScanNumber);
+  if(it==entries.end() || it->scanNumber!=scanNumber) return NULL;
+  return &(*it);
+}
+
+bool MSScanIndex::statFile(const char* fileName, long long& size, long long& mtime){
+  struct stat st;
+  if(stat(fileName,&st)!=0) return false;
+  size=(long long)st.st_size;
+  mtime=(long long)st.st_mtime;
+  return true;
+}
+
+//Spectra start with an S line, or with BEGIN IONS in MGF files. The file is cut into
+//equally sized chunks that are searched independently, a spectrum belongs to the chunk
+//holding the first character of its start line.
+void MSScanIndex::findRecords(const char* data, size_t size, vector<size_t>& starts) const{
+  int numChunks=1;
+  #ifdef _OPENMP
+  numChunks=omp_get_max_threads()*4;
+  #endif
+  numChunks=min(numChunks,(int)(size/minChunkSize)+1);
+
+  const char tag = isMGF ? 'B' : 'S';
+  vector<vector<size_t> > chunkStarts(numChunks);
+  #pragma omp parallel for schedule(dynamic,1)
+  for(int chunk=0;chunk<numChunks;chunk++){
+    const char* p=data+size/numChunks*chunk;
+    const char* end=(chunk==numChunks-1) ? data+size : data+size/numChunks*(chunk+1);
+    while(p<end && (p=(const char*)memchr(p,tag,end-p))!=NULL){
+      if(p==data || p[-1]=='\n'){
+        if(!isMGF || (data+size-p>=10 && strncmp(p,"BEGIN IONS",10)==0)) chunkStarts[chunk].push_back(p-data);
+      }
+      p++;
+    }
+  }
+
+  starts.clear();
+  for(int chunk=0;chunk<numChunks;chunk++){
+    starts.insert(starts.end(),chunkStarts[chunk].begin(),chunkStarts[chunk].end());
+  }
+}
+
+//Reads the S, I and Z lines of an MS1 or MS2 spectrum the way MSReader does, stopping at the peaks.
+//EZ lines only provide the charge if there are no Z lines.
+void MSScanIndex::parseRecord(const char* begin, const char* end, MSScanIndexEntry& e, vector<MSScanIndexEZ>& ez) const{
+  char line[256];
+  char key[32];
+  int scan2;
+  int ezCharge=0;
+  double d;
+  MSScanIndexEZ ezLine;
+  const char* p=nextLine(begin,end,line,sizeof(line));
+  sscanf(line+1,"%d %d %lf",&e.scanNumber,&scan2,&e.mz);
+  while(p<end){
+    if(*p>='0' && *p<='9') break;
+    char tag=*p;
+    p=nextLine(p,end,line,sizeof(line));
+    if(tag=='I'){
+      if(sscanf(line+1,"%31s",key)!=1) continue;
+      if(strcmp(key,"RTime")==0 && sscanf(line+1,"%*s %lf",&d)==1) e.rTime=(float)d;
+      else if(strcmp(key,"EZ")==0){
+        ezLine.z=0;
+        ezLine.mh=0;
+        d=0;
+        sscanf(line+1,"%*s %d %lf %lf",&ezLine.z,&ezLine.mh,&d);
+        ezLine.pRTime=(float)d;
+        ez.push_back(ezLine);
+        if(ezCharge==0) ezCharge=ezLine.z;
+      }
+    } else if(tag=='Z' && e.charge==0){
+      sscanf(line+1,"%d",&e.charge);
+    }
+  }
+  if(e.charge==0) e.charge=ezCharge;
+}
+
+void MSScanIndex::parseMGFRecord(const char* begin, const char* end, MSScanIndexEntry& e) const{
+  char line[256];
+  double d;
+  const char* p=nextLine(begin,end,line,sizeof(line));
+  while(p<end){
+    if((*p>='0' && *p<='9') || strncmp(p,"END IONS",min((ptrdiff_t)8,end-p))==0) break;
+    p=nextLine(p,end,line,sizeof(line));
+    if(strncmp(line,"PEPMASS=",8)==0) sscanf(line+8,"%lf",&e.mz);
+    else if(strncmp(line,"CHARGE=",7)==0) sscanf(line+7,"%d",&e.charge);
+    else if(strncmp(line,"SCANS=",6)==0) sscanf(line+6,"%d",&e.scanNumber);
+    else if(strncmp(line,"RTINSECONDS=",12)==0 && sscanf(line+12,"%lf",&d)==1) e.rTime=(float)(d/60.0);
+  }
+}
+
+bool MSScanIndex::build(const char* fileName){
+  clear();
+  if(!statFile(fileName,fileSize,fileTime)) return false;
+  size_t len=strlen(fileName);
+  isMGF = len>=4 && (strcmp(fileName+len-4,".mgf")==0 || strcmp(fileName+len-4,".MGF")==0);
+  if(fileSize==0) return true;
+
+  //map the file, or read it into memory where mapping is not available
+  size_t size=(size_t)fileSize;
+  const char* data=NULL;
+  vector<char> buffer;
+  #ifndef _MSC_VER
+  int fd=open(fileName,O_RDONLY);
+  if(fd<0) return false;
+  void* address=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(address!=MAP_FAILED) data=(const char*)address;
+  #endif
+  if(data==NULL){
+    FILE* f=fopen(fileName,"rb");
+    if(f==NULL) return false;
+    buffer.resize(size);
+    bool ok=(fread(&buffer[0],1,size,f)==size);
+    fclose(f);
+    if(!ok) return false;
+    data=&buffer[0];
+  }
+
+  vector<size_t> starts;
+  findRecords(data,size,starts);
+  entries.resize(starts.size());
+  starts.push_back(size);
+
+  int numEntries=(int)entries.size();
+  vector<vector<MSScanIndexEZ> > ez(numEntries);
+  #pragma omp parallel for schedule(dynamic,256)
+  for(int i=0;i<numEntries;i++){
+    MSScanIndexEntry& e=entries[i];
+    e.offset=(long long)starts[i];
+    e.mz=0;
+    e.scanNumber=i+1;
+    e.rTime=0;
+    e.charge=0;
+    e.numEZ=0;
+    e.firstEZ=0;
+    e.reserved=0;
+    if(isMGF) parseMGFRecord(data+starts[i],data+starts[i+1],e);
+    else parseRecord(data+starts[i],data+starts[i+1],e,ez[i]);
+  }
+
+  //the EZ lines of each spectrum are appended in file order
+  for(int i=0;i<numEntries;i++){
+    entries[i].numEZ=(int)ez[i].size();
+    entries[i].firstEZ=(unsigned int)ezLines.size();
+    ezLines.insert(ezLines.end(),ez[i].begin(),ez[i].end());
+  }
+
+  #ifndef _MSC_VER
+  if(buffer.empty()) munmap((void*)data,size);
+  #endif
+  stable_sort(entries.begin(),entries.end(),compareScanNumber);
+  return true;
+}
+
+//The index is stored as a header holding the size and modification time of the indexed
+//file, followed by the entries and the EZ lines in native byte order.
+bool MSScanIndex::save(const char* indexName){
+  FILE* f=fopen(indexName,"wb");
+  if(f==NULL) return false;
+  unsigned int n=(unsigned int)entries.size();
+  unsigned int entrySize=sizeof(MSScanIndexEntry);
+  unsigned int numEZ=(unsigned int)ezLines.size();
+  int mgf=isMGF ? 1 : 0;
+  bool ok = fwrite(indexMagic,1,8,f)==8 &&
+            fwrite(&fileSize,8,1,f)==1 &&
+            fwrite(&fileTime,8,1,f)==1 &&
+            fwrite(&mgf,4,1,f)==1 &&
+            fwrite(&entrySize,4,1,f)==1 &&
+            fwrite(&n,4,1,f)==1 &&
+            (n==0 || fwrite(&entries[0],entrySize,n,f)==n) &&
+            fwrite(&numEZ,4,1,f)==1 &&
+            (numEZ==0 || fwrite(&ezLines[0],sizeof(MSScanIndexEZ),numEZ,f)==numEZ);
+  if(fclose(f)!=0) ok=false;
+  if(!ok) remove(indexName);
+  return ok;
+}
+
+//Fails if the index does not exist, or if it was built for another version of the file.
+bool MSScanIndex::load(const char* indexName, const char* fileName){
+  clear();
+  long long size, mtime;
+  if(!statFile(fileName,size,mtime)) return false;
+  FILE* f=fopen(indexName,"rb");
+  if(f==NULL) return false;
+  char magic[8];
+  unsigned int n=0;
+  unsigned int entrySize=0;
+  unsigned int numEZ=0;
+  int mgf=0;
+  bool ok = fread(magic,1,8,f)==8 && memcmp(magic,indexMagic,8)==0 &&
+            fread(&fileSize,8,1,f)==1 && fileSize==size &&
+            fread(&fileTime,8,1,f)==1 && fileTime==mtime &&
+            fread(&mgf,4,1,f)==1 &&
+            fread(&entrySize,4,1,f)==1 && entrySize==sizeof(MSScanIndexEntry) &&
+            fread(&n,4,1,f)==1;
+  if(ok){
+    entries.resize(n);
+    ok = (n==0 || fread(&entries[0],entrySize,n,f)==n) && fread(&numEZ,4,1,f)==1;
+  }
+  if(ok){
+    ezLines.resize(numEZ);
+    ok = (numEZ==0 || fread(&ezLines[0],sizeof(MSScanIndexEZ),numEZ,f)==numEZ);
+  }
+  for(unsigned int i=0;ok && i<n;i++){
+    ok = entries[i].numEZ>=0 && (long long)entries[i].firstEZ+entries[i].numEZ<=(long long)numEZ;
+  }
+  fclose(f);
+  if(!ok){
+    clear();
+    return false;
+  }
+  isMGF=(mgf!=0);
+  return true;
+}
+
+//An index that cannot be saved, e.g. in a read-only directory, is simply built again next time.
+bool MSScanIndex::loadOrBuild(const char* fileName, bool saveIndex){
+  string indexName=sidecarName(fileName);
+  if(load(indexName.c_str(),fileName)) return true;
+  if(!build(fileName)) return false;
+  if(saveIndex) save(indexName.c_str());
+  return true;
+}
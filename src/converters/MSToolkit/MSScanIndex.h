@@ -0,0 +1,70 @@
+#ifndef _MSSCANINDEX_H
+#define _MSSCANINDEX_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//One spectrum of a text MS1, MS2 or MGF file
+typedef struct {
+  long long offset;   //byte offset of the S line, or of BEGIN IONS in MGF files
+  double mz;          //precursor m/z, 0 if not given
+  int scanNumber;     //SCANS= in MGF files, or the position of the spectrum if missing
+  float rTime;        //retention time in minutes, 0 if not given
+  int charge;         //first charge state, 0 if not given
+  int numEZ;          //number of EZ lines of the spectrum, see getEZ()
+  unsigned int firstEZ;
+  int reserved;
+} MSScanIndexEntry;
+
+//An EZ line of an MS2 spectrum, a charge state with its M+H and precursor retention time
+typedef struct {
+  double mh;
+  float pRTime;
+  int z;
+} MSScanIndexEZ;
+
+//Maps scan numbers of a text MS1, MS2 or MGF file to the byte offsets of their spectra,
+//together with the retention time, precursor m/z, charge and EZ lines of each spectrum. The index
+//is built by memory mapping the file and scanning chunks of it in parallel, and can be
+//stored next to the file such that it is only built once.
+class MSScanIndex {
+ public:
+  //Constructors & Destructors
+  MSScanIndex();
+  ~MSScanIndex();
+
+  //Functions
+  bool build(const char* fileName);
+  bool load(const char* indexName, const char* fileName);
+  bool save(const char* indexName);
+  bool loadOrBuild(const char* fileName, bool saveIndex=true);
+
+  const MSScanIndexEntry* find(int scanNumber) const;
+  const MSScanIndexEntry& at(const unsigned int& i) const;
+  const MSScanIndexEZ& getEZ(const MSScanIndexEntry& e, int i) const;
+  unsigned int size() const;
+  void clear();
+
+  long long getFileSize() const;
+
+  //the index of file.ms2 is stored in file.ms2.msidx
+  static string sidecarName(const char* fileName);
+
+ private:
+  //Data Members
+  vector<MSScanIndexEntry> entries;   //sorted by scan number
+  vector<MSScanIndexEZ> ezLines;      //EZ lines of all spectra, in file order
+  long long fileSize;
+  long long fileTime;
+  bool isMGF;
+
+  //Functions
+  static bool statFile(const char* fileName, long long& size, long long& mtime);
+  void findRecords(const char* data, size_t size, vector<size_t>& starts) const;
+  void parseRecord(const char* begin, const char* end, MSScanIndexEntry& e, vector<MSScanIndexEZ>& ez) const;
+  void parseMGFRecord(const char* begin, const char* end, MSScanIndexEntry& e) const;
+};
+
+#endif
@@ -135,6 +135,8 @@ static int isquot(const char c) { /* " and ' are both valid attribute delimiters
 static int setTagValue(const char* text, char* storage, int maxlen,
                        const char* lead);
 
+static void freeDecodeBuffers(RAMPFILE* pFI);
+
 const char* skipspace(const char* pStr) {
   while (isspace(*pStr)) {
     pStr++;
@@ -258,6 +260,7 @@ void rampCloseFile(RAMPFILE* pFI) {
 #else
     fclose(pFI->fileHandle);
 #endif
+    freeDecodeBuffers(pFI);
     free(pFI);
   }
 }
@@ -1365,6 +1368,295 @@ int readPeaksCount(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
   return result;
 }
 
+#include <zlib.h>
+#include <vector>
+
+/*
+ * One base64 encoded <peaks> array of an mzXML scan, as read from the file.
+ */
+struct RampPeakArray {
+    int precision;
+    int isLittleEndian;
+    int isCompressed;
+    int compressedLen;
+    e_contentType contType;
+    bool readingMZ;
+    bool readingIntensity;
+    std::vector<char> base64; // white space removed, NUL terminated
+};
+
+/*
+ * The buffers of readPeaks live as long as the RAMPFILE, such that reading
+ * a run does not allocate and free them for every scan.
+ */
+struct RampDecodeBuffers {
+    std::vector<RampPeakArray> arrays;
+    std::vector<char> encoded; // mzData base64
+    std::vector<char> decoded;
+    std::vector<Byte> uncompressed;
+};
+
+static RampDecodeBuffers* getDecodeBuffers(RAMPFILE* pFI) {
+  if (!pFI->decodeBuffers) {
+    pFI->decodeBuffers = new RampDecodeBuffers();
+  }
+  return pFI->decodeBuffers;
+}
+
+static void freeDecodeBuffers(RAMPFILE* pFI) {
+  delete pFI->decodeBuffers;
+  pFI->decodeBuffers = NULL;
+}
+
+/*
+ * Reads peaksLen - 1 base64 characters followed by the '<' of the closing
+ * tag into pData, starting with the ones already read into pBeginData.
+ * White space in the base64 stream is dropped.
+ */
+static void readBase64(RAMPFILE* pFI, const char* pBeginData, char* pData,
+                       int peaksLen) {
+  int partial;
+  // copy in any partial read of peak data, and complete the read
+  strncpy(pData, pBeginData, peaksLen);
+  pData[peaksLen] = 0;
+  partial = (int)strlen(pData);
+  if (partial < peaksLen) {
+    ramp_fread(pData + partial, peaksLen - partial, pFI);
+  }
+  // whitespace may be present in base64 char stream
+  while (pData[peaksLen - 1] != '<') {
+    // didn't read all the peak info - must be whitespace
+    char* dest = pData;
+    for (const char* cp = pData; cp < pData + peaksLen && *cp; ++cp) {
+      if (*cp != '\t' && *cp != '\n' && *cp != '\r' && *cp != ' ') {
+        *dest++ = *cp;
+      }
+    }
+    partial = (int)(pData + peaksLen - dest);
+    if (!ramp_fread(dest, partial, pFI)) {
+      break;
+    }
+  }
+  pData[peaksLen - 1] = 0; // pure base64 now
+}
+
+/*
+ * Reads the encoded <peaks> arrays of the mzXML scan at lScanIndex into
+ * arrays[*numArrays] and onwards, growing arrays as needed, and advances
+ * *numArrays. Returns the number of peaks, or 0 if the scan has no peaks
+ * or an unsupported encoding, in which case *numArrays is left unchanged.
+ */
+static int readMzXMLPeakArrays(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex,
+                               std::vector<RampPeakArray>& arrays,
+                               size_t* numArrays) {
+  int peaksCount = readPeaksCount(pFI, lScanIndex);
+  if (peaksCount <= 0) { // No peaks in this scan!!
+    return 0;
+  }
+  int precision = 0;
+  size_t next = *numArrays;
+  const char* pBeginData;
+  char buf[1000];
+  buf[sizeof(buf) - 1] = 0;
+  // handle possible mz/intensity in seperate arrays
+  bool gotMZ = false;
+  bool gotIntensity = false;
+  while ((!gotMZ) || (!gotIntensity)) {
+    int isCompressed = 0;
+    bool readingMZ = false;
+    bool readingIntensity = false;
+    int bytes, triplets, peaksLen;
+    int isLittleEndian = 0; // default is network byte order (Big endian)
+    int compressedLen = 0;
+    e_contentType contType = mzInt; // default to m/z-int
+    // now determine peaks precision
+    (void) ramp_fgets(buf, sizeof(buf) - 1, pFI);
+    while (!(pBeginData = (char*)strstr(buf, "<peaks"))) {
+      (void) ramp_fgets(buf, sizeof(buf) - 1, pFI);
+    }
+    getIsLittleEndian(buf, &isLittleEndian);
+    // TODO ALL OF THE FOLLOWING CHECKS ASSUME THAT THE NAME AND THE VALUE OF THE
+    // ATTRIBUTE ARE PRESENT AT THE SAME TIME IN THE BUFFER.
+    // ADD A CHECK FOR THAT!
+    while (1) { // Untill the end of the peaks element
+      if ((pBeginData = strstr(buf, "precision="))) { // read the precision attribute
+        precision = atoi(strchr(pBeginData, '\"') + 1);
+      }
+      if ((pBeginData = strstr(buf, "contentType="))) { // read the contentType attribute
+        // we are only supporting m/z-int for the moment > return if it is something else
+        // TODO add support for the other content types
+        if ((pBeginData = strstr(buf, "m/z-int"))) {
+          contType = mzInt;
+        } else if ((pBeginData = strstr(buf, "m/z ruler"))) {
+          contType = mzRuler;
+          readingMZ = readingIntensity = gotMZ = gotIntensity = true; // they're munged together
+        } else if ((pBeginData = strstr(buf, "m/z"))) {
+          contType = mzOnly;
+          readingMZ = gotMZ = true;
+        } else if ((pBeginData = strstr(buf, "intensity"))) {
+          contType = intensityOnly;
+          readingIntensity = gotIntensity = true;
+        } else {
+          const char* pEndAttrValue;
+          pEndAttrValue = strchr(pBeginData + strlen("contentType=\"")
+              + 1, '\"');
+          int len = pEndAttrValue - pBeginData;
+          fprintf(stderr, "%.*s Unsupported content type\n", len, pBeginData);
+          return 0;
+        }
+      }
+      if ((pBeginData = strstr(buf, "compressionType="))) { // read the compressionType attribute.
+        if ((pBeginData = strstr(buf, "zlib"))) {
+          isCompressed = 1;
+        } else if ((pBeginData = strstr(buf, "none"))) {
+          isCompressed = 0;
+        } else {
+          const char* pEndAttrValue;
+          pEndAttrValue = strchr(pBeginData
+              + strlen("compressionType=\"") + 1, '\"');
+          int len = pEndAttrValue - pBeginData;
+          fprintf(stderr,
+                  "%.*s Unsupported compression type\n",
+                  len, pBeginData);
+          return 0;
+        }
+      }
+      if ((pBeginData = strstr(buf, "compressedLen=\""))) {
+        compressedLen = atoi(pBeginData + strlen("compressedLen=\""));
+      }
+      if (!(pBeginData = strstr(buf, ">"))) { // There is more to read
+        (void) ramp_fgets(buf, sizeof(buf) - 1 , pFI);
+        getIsLittleEndian(buf, &isLittleEndian);
+      } else {
+        pBeginData++; // skip the >
+        break;
+      }
+    }
+    if (!precision) { // precision attribute was not defined assume 32 by default
+      precision = 32;
+    }
+    if (mzInt == contType) {
+      readingMZ = readingIntensity = gotMZ = gotIntensity = true; // they're munged together
+    }
+    int dataPerPeak = 1 + (readingMZ && readingIntensity);
+    if (isCompressed) {
+      bytes = compressedLen;
+    } else {
+      bytes = (dataPerPeak * peaksCount * (precision / 8));
+    }
+    // base64 has 4:3 bloat, precision/8 bytes per value, 2 values per peak
+    // for every 3 bytes base64 emits 4 characters - 1, 2 or 3 byte input emits 4 bytes
+    triplets = (bytes / 3) + ((bytes % 3) != 0);
+    peaksLen = (4 * triplets) + 1; // read the "<" from </data> too, to confirm lack of whitespace
+    if (arrays.size() <= next) {
+      arrays.resize(next + 1);
+    }
+    RampPeakArray& array = arrays[next++];
+    array.precision = precision;
+    array.isLittleEndian = isLittleEndian;
+    array.isCompressed = isCompressed;
+    array.compressedLen = compressedLen;
+    array.contType = contType;
+    array.readingMZ = readingMZ;
+    array.readingIntensity = readingIntensity;
+    array.base64.resize(peaksLen + 1);
+    readBase64(pFI, pBeginData, &array.base64[0], peaksLen);
+  }
+  *numArrays = next;
+  return peaksCount;
+}
+
+/*
+ * Decodes the arrays of an mzXML scan into pPeaks, which has room for
+ * (peaksCount + 1) * 2 values, and terminates the list with -1. Only the
+ * buffers that are passed in are written to, so that different scans can
+ * be decoded concurrently.
+ */
+static void decodeMzXMLPeakArrays(const RampPeakArray* arrays, size_t numArrays,
+                                  int peaksCount, std::vector<char>& decoded,
+                                  std::vector<Byte>& uncompressed,
+                                  RAMPREAL* pPeaks) {
+  int endtest = 1;
+  int weAreLittleEndian = *((char*)&endtest);
+  for (size_t a = 0; a < numArrays; ++a) {
+    const RampPeakArray& array = arrays[a];
+    int n;
+    int precision = array.precision;
+    int dataPerPeak = 1 + (array.readingMZ && array.readingIntensity);
+    // dataPerPeak values per peak, precision/8 bytes per value
+    int rawSize = dataPerPeak * peaksCount * (precision / 8);
+    int decodedSize = array.isCompressed ? array.compressedLen : rawSize;
+    if (decoded.size() < (size_t)decodedSize + 1) {
+      decoded.resize(decodedSize + 1);
+    }
+    // Base64 decoding
+    b64_decode(&decoded[0], &array.base64[0], decodedSize);
+    const char* pToBeCorrected = &decoded[0];
+    //Zlib decompression
+    if (array.isCompressed) {
+      uLong uncomprLen = rawSize + 1;
+      uncompressed.assign(uncomprLen, 0);
+      uncompress(&uncompressed[0],
+                 &uncomprLen,
+                 (const Bytef*)&decoded[0],
+                 decodedSize + 1);
+      pToBeCorrected = (const char*)&uncompressed[0];
+    }
+    // And byte order correction
+    int byteOrderOK = (array.isLittleEndian == weAreLittleEndian);
+    int beginAt = array.readingMZ ? 0 : 1;
+    int step = 1 + (array.readingMZ != array.readingIntensity);
+    int m = 0;
+    if (32 == precision) { // floats
+      if (byteOrderOK) {
+        for (n = beginAt; n < (2 * peaksCount); n += step) {
+          pPeaks[n] = (RAMPREAL)((const float*)pToBeCorrected)[m++];
+        }
+      } else {
+        U32 tmp;
+        for (n = beginAt; n < (2 * peaksCount); n += step) {
+          tmp.u32 = swapbytes(((const uint32_t*) pToBeCorrected)[m++]);
+          pPeaks[n] = (RAMPREAL)tmp.flt;
+        }
+      }
+    } else { // doubles
+      if (byteOrderOK) {
+        for (n = beginAt; n < (2 * peaksCount); n += step) {
+          pPeaks[n] = (RAMPREAL)((const double*)pToBeCorrected)[m++];
+        }
+      } else {
+        U64 tmp;
+        for (n = beginAt; n < (2 * peaksCount); n += step) {
+          tmp.u64
+              = swapbytes64((uint64_t)((const uint64_t*)pToBeCorrected)[m++]);
+          pPeaks[n] = (RAMPREAL)tmp.dbl;
+        }
+      }
+    }
+    pPeaks[n] = -1;
+    if (array.contType == mzRuler) { // Convert back from m/z ruler contentType into m/z - int pairs
+      std::vector<RAMPREAL> ruled(pPeaks, pPeaks + (peaksCount + 1) * 2);
+      RAMPREAL lastMass = 0;
+      RAMPREAL deltaMass = 0;
+      int multiplier = 0;
+      int j = 0;
+      for (n = 0; n < (2 * peaksCount);) {
+        if ((int)ruled[j] == -1) { // Change in delta m/z
+          ++j;
+          lastMass = (RAMPREAL)ruled[j++];
+          deltaMass = ruled[j++];
+          multiplier = 0;
+        }
+        pPeaks[n++] = lastMass + (RAMPREAL)multiplier * deltaMass;
+        ++multiplier;
+        pPeaks[n++] = ruled[j++];
+      }
+      pPeaks[n] = -1;
+      return;
+    }
+  }
+}
+
 /****************************************************************
  * READS the base64 encoded list of peaks.             *
  * Return a RAMPREAL* that becomes property of the caller!       *
@@ -1372,7 +1664,6 @@ int readPeaksCount(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
  * !! THE STREAM IS NOT RESET AT THE INITIAL POSITION BEFORE     *
  *    RETURNING !!                           *
  ***************************************************************/
-#include <zlib.h>
 RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
   RAMPREAL* pPeaks = NULL;
 #ifdef HAVE_PWIZ_MZML_LIB
@@ -1402,7 +1693,6 @@ RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
   int peaksCount = 0;
   int peaksLen; // The length of the base64 section
   int precision = 0;
-  RAMPREAL* pPeaksDeRuled = NULL;
   int endtest = 1;
   int weAreLittleEndian = *((char*)&endtest);
   char* pData = NULL;
@@ -1419,6 +1709,7 @@ RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
     // intensity and mz are written in two different arrays
     int bGotInten = 0;
     int bGotMZ = 0;
+    RampDecodeBuffers* buffers = getDecodeBuffers(pFI);
     ramp_fseek(pFI, lScanIndex, SEEK_SET);
     while ((!(bGotInten && bGotMZ)) && ramp_nextTag(buf,
                                                     sizeof(buf) - 1,
@@ -1433,7 +1724,7 @@ RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
         isArray = isInten = bGotInten = 1;
       }
       if (isArray) {
-        int partial, triplets, bytes;
+        int triplets, bytes;
         const char* datastart;
         // now determine peaks count, precision
         while (!(datastart = (char*)strstr(buf, "<data"))) {
@@ -1467,40 +1758,11 @@ RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
         // for every 3 bytes base64 emits 4 characters - 1, 2 or 3 byte input emits 4 bytes
         triplets = (bytes / 3) + ((bytes % 3) != 0);
         peaksLen = (4 * triplets) + 1; // read the "<" from </data> too, to confirm lack of whitespace
-        if ((pData = (char*)realloc(pData, 1 + peaksLen)) == NULL) {
-          printf("Cannot allocate memory\n");
-          return NULL;
-        }
-        // copy in any partial read of peak data, and complete the read
-        strncpy(pData, pBeginData, peaksLen);
-        pData[peaksLen] = 0;
-        partial = (int)strlen(pData);
-        if (partial < peaksLen) {
-          ramp_fread(pData + partial, (int)(peaksLen - partial), pFI);
-        }
-        // whitespace may be present in base64 char stream
-        while (pData[peaksLen - 1] != '<') {
-          char* cp;
-          partial = 0;
-          // didn't read all the peak info - must be whitespace
-          for (cp = pData; *cp;) {
-            if (strchr("\t\n\r ", *cp)) {
-              memmove(cp, cp + 1, peaksLen - (partial + cp - pData));
-              partial++;
-            } else {
-              cp++;
-            }
-          }
-          if (!ramp_fread(pData + peaksLen - partial, partial, pFI)) {
-            break;
-          }
-        }
-        pData[peaksLen - 1] = 0; // pure base64 now
-        if ((pDecoded = (char*)realloc(pDecoded, peaksCount * (precision
-            / 8) + 1)) == NULL) {
-          printf("Cannot allocate memory\n");
-          return NULL;
-        }
+        buffers->encoded.resize(peaksLen + 1);
+        pData = &buffers->encoded[0];
+        readBase64(pFI, pBeginData, pData, peaksLen);
+        buffers->decoded.resize(peaksCount * (precision / 8) + 1);
+        pDecoded = &buffers->decoded[0];
         // Base64 decoding
         b64_decode(pDecoded, pData, peaksCount * (precision / 8));
         if ((!pPeaks) && ((pPeaks = (RAMPREAL*)malloc((peaksCount + 1) * 2
@@ -1544,235 +1806,95 @@ RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex) {
         }
       } // end if isArray
     } // end while we haven't got both inten and mz
-    free(pData);
-    free(pDecoded);
     pPeaks[peaksCount * 2] = -1; // some callers want a terminator
   } else { // mzXML
-    peaksCount = readPeaksCount(pFI, lScanIndex);
+    RampDecodeBuffers* buffers = getDecodeBuffers(pFI);
+    size_t numArrays = 0;
+    peaksCount = readMzXMLPeakArrays(pFI, lScanIndex, buffers->arrays, &numArrays);
     if (peaksCount <= 0) { // No peaks in this scan!!
       return NULL;
     }
-    // handle possible mz/intensity in seperate arrays
-    bool gotMZ = false;
-    bool gotIntensity = false;
-    while ((!gotMZ) || (!gotIntensity)) {
-      Byte* pUncompr;
-      int isCompressed = 0;
-      bool readingMZ = false;
-      bool readingIntensity = false;
-      int partial, bytes, triplets;
-      int isLittleEndian = 0; // default is network byte order (Big endian)
-      int byteOrderOK;
-      int compressedLen = 0;
-      int decodedSize;
-      char* pToBeCorrected;
-      e_contentType contType = mzInt; // default to m/z-int
-      // now determine peaks precision
-      (void) ramp_fgets(buf, sizeof(buf) - 1, pFI);
-      while (!(pBeginData = (char*)strstr(buf, "<peaks"))) {
-        (void) ramp_fgets(buf, sizeof(buf) - 1, pFI);
-      }
-      getIsLittleEndian(buf, &isLittleEndian);
-      // TODO ALL OF THE FOLLOWING CHECKS ASSUME THAT THE NAME AND THE VALUE OF THE
-      // ATTRIBUTE ARE PRESENT AT THE SAME TIME IN THE BUFFER.
-      // ADD A CHECK FOR THAT!
-      while (1) { // Untill the end of the peaks element
-        if ((pBeginData = strstr(buf, "precision="))) { // read the precision attribute
-          precision = atoi(strchr(pBeginData, '\"') + 1);
-        }
-        if ((pBeginData = strstr(buf, "contentType="))) { // read the contentType attribute
-          // we are only supporting m/z-int for the moment > return if it is something else
-          // TODO add support for the other content types
-          if ((pBeginData = strstr(buf, "m/z-int"))) {
-            contType = mzInt;
-          } else if ((pBeginData = strstr(buf, "m/z ruler"))) {
-            contType = mzRuler;
-            readingMZ = readingIntensity = gotMZ = gotIntensity = true; // they're munged together
-          } else if ((pBeginData = strstr(buf, "m/z"))) {
-            contType = mzOnly;
-            readingMZ = gotMZ = true;
-          } else if ((pBeginData = strstr(buf, "intensity"))) {
-            contType = intensityOnly;
-            readingIntensity = gotIntensity = true;
-          } else {
-            const char* pEndAttrValue;
-            pEndAttrValue = strchr(pBeginData + strlen("contentType=\"")
-                + 1, '\"');
-            int len = pEndAttrValue - pBeginData;
-            fprintf(stderr, "%.*s Unsupported content type\n", len, pBeginData);
-            return NULL;
-          }
-        }
-        if ((pBeginData = strstr(buf, "compressionType="))) { // read the compressionType attribute.
-          if ((pBeginData = strstr(buf, "zlib"))) {
-            isCompressed = 1;
-          } else if ((pBeginData = strstr(buf, "none"))) {
-            isCompressed = 0;
-          } else {
-            const char* pEndAttrValue;
-            pEndAttrValue = strchr(pBeginData
-                + strlen("compressionType=\"") + 1, '\"');
-            int len = pEndAttrValue - pBeginData;
-            fprintf(stderr,
-                    "%.*s Unsupported compression type\n",
-                    len, pBeginData);
-            return NULL;
-          }
-        }
-        if ((pBeginData = strstr(buf, "compressedLen=\""))) {
-          compressedLen = atoi(pBeginData + strlen("compressedLen=\""));
-        }
-        if (!(pBeginData = strstr(buf, ">"))) { // There is more to read
-          (void) ramp_fgets(buf, sizeof(buf) - 1 , pFI);
-          getIsLittleEndian(buf, &isLittleEndian);
-        } else {
-          pBeginData++; // skip the >
-          break;
-        }
-      }
-      if (!precision) { // precision attribute was not defined assume 32 by default
-        precision = 32;
-      }
-      if (mzInt == contType) {
-        readingMZ = readingIntensity = gotMZ = gotIntensity = true; // they're munged together
-      }
-      int dataPerPeak = 1 + (readingMZ && readingIntensity);
-      if (isCompressed) {
-        bytes = compressedLen;
-      } else {
-        bytes = (dataPerPeak * peaksCount * (precision / 8));
-      }
-      // base64 has 4:3 bloat, precision/8 bytes per value, 2 values per peak
-      // for every 3 bytes base64 emits 4 characters - 1, 2 or 3 byte input emits 4 bytes
-      triplets = (bytes / 3) + ((bytes % 3) != 0);
-      peaksLen = (4 * triplets) + 1; // read the "<" from </data> too, to confirm lack of whitespace
-      if ((pData = (char*)malloc(1 + peaksLen)) == NULL) {
-        printf("Cannot allocate memory\n");
-        return NULL;
-      }
-      pData[peaksLen] = 0;
-      // copy in any partial read of peak data, and complete the read
-      strncpy(pData, pBeginData, peaksLen);
-      partial = (int)strlen(pData);
-      if (partial < peaksLen) {
-        ramp_fread(pData + partial, peaksLen - partial, pFI);
-      }
-      // whitespace may be present in base64 char stream
-      while (pData[peaksLen - 1] != '<') {
-        char* cp;
-        partial = 0;
-        // didn't read all the peak info - must be whitespace
-        for (cp = pData; *cp;) {
-          if (strchr("\t\n\r ", *cp)) {
-            memmove(cp, cp + 1, peaksLen + 1 - (partial + cp - pData));
-            partial++;
-          } else {
-            cp++;
-          }
-        }
-        if (!ramp_fread(pData + peaksLen - partial, partial, pFI)) {
-          break;
-        }
-      }
-      if (isCompressed) {
-        decodedSize = compressedLen + 1;
-      } else {
-        // dataPerPeak values per peak, precision/8 bytes per value
-        decodedSize = dataPerPeak * peaksCount * (precision / 8) + 1;
-      }
-      pData[peaksLen - 1] = 0; // pure base64 now
-      if ((pDecoded = (char*)malloc(decodedSize)) == NULL) {
-        printf("Cannot allocate memory\n");
-        return NULL;
-      }
-      // Base64 decoding
-      b64_decode(pDecoded, pData, decodedSize - 1);
-      free(pData);
-      if ((!pPeaks) && ((pPeaks = (RAMPREAL*)malloc((peaksCount + 1) * 2
-          * sizeof(RAMPREAL) + 1)) == NULL)) {
-        printf("Cannot allocate memory\n");
-        return NULL;
-      }
-      //Zlib decompression
-      if (isCompressed) {
-        int err;
-        //        printf("Decompressing data\n");
-        uLong uncomprLen =
-            (dataPerPeak * peaksCount * (precision / 8) + 1);
-        pUncompr = (Byte*)calloc((uInt)uncomprLen, 1);
-        err = uncompress(pUncompr,
-                         &uncomprLen,
-                         (const Bytef*)pDecoded,
-                         decodedSize);
-        free(pDecoded);
-        pToBeCorrected = (char*)pUncompr;
-      } else {
-        pToBeCorrected = pDecoded;
+    if ((pPeaks = (RAMPREAL*)malloc((peaksCount + 1) * 2
+        * sizeof(RAMPREAL) + 1)) == NULL) {
+      printf("Cannot allocate memory\n");
+      return NULL;
+    }
+    decodeMzXMLPeakArrays(&buffers->arrays[0], numArrays, peaksCount,
+                          buffers->decoded, buffers->uncompressed, pPeaks);
+  }
+  return (pPeaks); // caller must free this pointer
+}
+
+/*
+ * Reading the file stays serial, only the decoding of mzXML scans is spread
+ * over the threads. Each thread keeps its own decode buffers, while the
+ * encoded arrays of all scans are kept in the buffers of the RAMPFILE.
+ */
+RAMPREAL* readPeaksBatch(RAMPFILE* pFI, const ramp_fileoffset_t* lScanIndices,
+                         int numScans, size_t* peakOffsets) {
+  bool isMzXML = !pFI->bIsMzData;
+#ifdef HAVE_PWIZ_MZML_LIB
+  isMzXML = isMzXML && !pFI->mzML;
+#endif
+  RampDecodeBuffers* buffers = getDecodeBuffers(pFI);
+  std::vector<int> peaksCounts(numScans, 0);
+  std::vector<size_t> firstArray(numScans + 1, 0);
+  std::vector<RAMPREAL*> otherPeaks; // scans that readPeaks decoded already
+  if (!isMzXML) {
+    otherPeaks.resize(numScans, NULL);
+  }
+  size_t numArrays = 0, poolSize = 0;
+  for (int i = 0; i < numScans; ++i) {
+    firstArray[i] = numArrays;
+    if (isMzXML) {
+      peaksCounts[i] = readMzXMLPeakArrays(pFI, lScanIndices[i],
+                                           buffers->arrays, &numArrays);
+    } else if ((otherPeaks[i] = readPeaks(pFI, lScanIndices[i])) != NULL) {
+      while (otherPeaks[i][2 * peaksCounts[i]] != -1) {
+        ++peaksCounts[i];
       }
-      // And byte order correction
-      byteOrderOK = (isLittleEndian == weAreLittleEndian);
-      int beginAt = readingMZ ? 0 : 1;
-      int step = 1 + (readingMZ != readingIntensity);
-      int m = 0;
-      if (32 == precision) { // floats
-        if (byteOrderOK) {
-          for (n = beginAt; n < (2 * peaksCount); n += step) {
-            pPeaks[n] = (RAMPREAL)((float*)pToBeCorrected)[m++];
-          }
-        } else {
-          U32 tmp;
-          for (n = beginAt; n < (2 * peaksCount); n += step) {
-            tmp.u32 = swapbytes(((uint32_t*) pToBeCorrected)[m++]);
-            pPeaks[n] = (RAMPREAL)tmp.flt;
-          }
-        }
-      } else { // doubles
-        if (byteOrderOK) {
-          for (n = beginAt; n < (2 * peaksCount); n += step) {
-            pPeaks[n] = (RAMPREAL)((double*)pToBeCorrected)[m++];
-          }
-        } else {
-          U64 tmp;
-          for (n = beginAt; n < (2 * peaksCount); n += step) {
-            tmp.u64
-                = swapbytes64((uint64_t)((uint64_t*)pToBeCorrected)[m++]);
-            pPeaks[n] = (RAMPREAL)tmp.dbl;
-          }
+    }
+    peakOffsets[i] = poolSize;
+    poolSize += (peaksCounts[i] + 1) * 2;
+  }
+  firstArray[numScans] = numArrays;
+
+  RAMPREAL* pool = (RAMPREAL*)malloc((poolSize + 1) * sizeof(RAMPREAL));
+  if (!pool) {
+    printf("Cannot allocate memory\n");
+  }
+  if (!isMzXML) {
+    for (int i = 0; i < numScans; ++i) {
+      if (pool) {
+        RAMPREAL* pPeaks = pool + peakOffsets[i];
+        if (otherPeaks[i]) {
+          memcpy(pPeaks, otherPeaks[i], 2 * peaksCounts[i] * sizeof(RAMPREAL));
         }
+        pPeaks[2 * peaksCounts[i]] = pPeaks[2 * peaksCounts[i] + 1] = -1;
       }
-      if (contType == mzRuler) { // Convert back from m/z ruler contentType into m/z - int pairs
-        RAMPREAL lastMass = 0;
-        RAMPREAL deltaMass = 0;
-        int multiplier = 0;
-        int j = 0;
-        if ((pPeaksDeRuled = (RAMPREAL*)malloc((peaksCount + 1) * 2
-            * sizeof(RAMPREAL) + 1)) == NULL) {
-          printf("Cannot allocate memory\n");
-          return NULL;
-        }
-        for (n = 0; n < (2 * peaksCount);) {
-          // printf("%f\n" , pPeaks[j] );
-          if ((int)pPeaks[j] == -1) { // Change in delta m/z
-            ++j;
-            lastMass = (RAMPREAL)pPeaks[j++];
-            deltaMass = pPeaks[j++];
-            multiplier = 0;
-            //printf("%f %f\n" , lastMass , deltaMass );
-          }
-          pPeaksDeRuled[n++] = lastMass + (RAMPREAL)multiplier * deltaMass;
-          ++multiplier;
-          pPeaksDeRuled[n++] = pPeaks[j++];
-        }
-        free(pToBeCorrected);
-        pPeaksDeRuled[n] = -1;
-        free(pPeaks);
-        return (pPeaksDeRuled); // caller must free this pointer
+      free(otherPeaks[i]);
+    }
+    return pool;
+  }
+  if (!pool) {
+    return NULL;
+  }
+  #pragma omp parallel
+  {
+    std::vector<char> decoded;
+    std::vector<Byte> uncompressed;
+    #pragma omp for schedule(dynamic, 16)
+    for (int i = 0; i < numScans; ++i) {
+      RAMPREAL* pPeaks = pool + peakOffsets[i];
+      pPeaks[0] = pPeaks[1] = -1;
+      if (peaksCounts[i] > 0) {
+        decodeMzXMLPeakArrays(&buffers->arrays[firstArray[i]],
+                              firstArray[i + 1] - firstArray[i], peaksCounts[i],
+                              decoded, uncompressed, pPeaks);
       }
-      free(pToBeCorrected);
-      pPeaks[n] = -1;
     }
-  } // end while((!gotMZ)||(!gotIntensity))
-  return (pPeaks); // caller must free this pointer
+  }
+  return pool;
 }
 
 /*
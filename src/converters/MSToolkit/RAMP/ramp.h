@@ -86,6 +86,8 @@ namespace pwiz { // forward ref
 }
 #endif
 
+struct RampDecodeBuffers; // scratch space of readPeaks, see ramp.cpp
+
 //
 // we use this struct instead of FILE* so we can track what kind of files we're parsing
 //
@@ -95,6 +97,7 @@ typedef struct {
     pwiz::msdata::RAMPAdapter* mzML; // if nonNULL, then we're reading mzML
 #endif
     int bIsMzData; // if not mzML, then is it mzXML or mzData?
+    struct RampDecodeBuffers* decodeBuffers; // kept between readPeaks calls
 } RAMPFILE;
 
 #ifdef RAMP_NONNATIVE_LONGFILE // use MSFT API for 64 bit file pointers
@@ -217,6 +220,15 @@ double readStartMz(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex);
 double readEndMz(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex);
 int readPeaksCount(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex);
 RAMPREAL* readPeaks(RAMPFILE* pFI, ramp_fileoffset_t lScanIndex);
+// read the peaks of numScans scans at once: the encoded peaks are read from
+// the file one scan after the other, the base64 decoding, decompression and
+// byte order correction of mzXML scans then run in parallel. All peaks are
+// stored in a single buffer that becomes property of the caller. The peaks
+// of scan i start at peakOffsets[i] and are terminated by -1 like the list
+// returned by readPeaks, a scan without peaks holds only the terminator.
+// returns NULL if the buffer cannot be allocated
+RAMPREAL* readPeaksBatch(RAMPFILE* pFI, const ramp_fileoffset_t* lScanIndices,
+                         int numScans, size_t* peakOffsets);
 void readRunHeader(RAMPFILE* pFI, ramp_fileoffset_t* pScanIndex,
                    struct RunHeaderStruct* runHeader, int iLastScan);
 void readMSRun(RAMPFILE* pFI, struct RunHeaderStruct* runHeader);
@@ -31,6 +31,7 @@ int Msgfplus2pin::run() {
   parseOptions.call = call;
   parseOptions.spectrumFN = spectrumFile;
   parseOptions.xmlOutputFN = outputFN;
+  parseOptions.xmlOutput = xmlOutput;
   reader = new MsgfplusReader(parseOptions);
 
   reader->init();
@@ -200,8 +200,8 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
         bool isDecoy, unsigned useScanNumber, boost::shared_ptr<FragSpectrumScanDatabase> database,
         const std::string &fn) {
 
-  std::auto_ptr< percolatorInNs::features > features_p(new percolatorInNs::features());
-  percolatorInNs::features::feature_sequence & f_seq = features_p->feature();
+  PsmRecord psm;
+  std::vector<double> & f_seq = psm.features;
 
   if (!item.calculatedMassToCharge().present()) {
     ostringstream temp;
@@ -210,9 +210,9 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
     throw MyException(temp.str());
   }
 
-  std::string peptideSeq = peptideMap[item.peptide_ref().get()]->PeptideSequence();
-  std::string peptideId = item.peptide_ref().get();
-  std::vector< std::string > proteinIds;
+  size_t peptideIdx = lookupRef(peptideIndex, item.peptide_ref().get(), "Peptide");
+  std::string peptideSeq = peptides[peptideIdx].sequence;
+  std::vector< std::string > & proteinIds = psm.proteinIds;
   std::string __flankN = "";
   std::string __flankC = "";
 
@@ -221,32 +221,29 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
 
     BOOST_FOREACH (const ::mzIdentML_ns::PeptideEvidenceRefType &pepEv_ref, item.PeptideEvidenceRef()) {
       std::string ref_id = pepEv_ref.peptideEvidence_ref().c_str();
-      ::mzIdentML_ns::PeptideEvidenceType *pepEv = peptideEvidenceMap[ref_id];
+      const MzidPeptideEvidence &pepEv = peptideEvidences[lookupRef(peptideEvidenceIndex, ref_id, "PeptideEvidence")];
       //NOTE check that there are not chimeric peptides
-      if (peptideId != std::string(pepEv->peptide_ref())) {
+      if (peptideIdx != pepEv.peptide) {
 	      std::cerr << "Warning : The PSM " << boost::lexical_cast<string > (item.id())
 		        << " contains different chimeric peptide sequences. "
-		        << peptideMap[pepEv->peptide_ref()]->PeptideSequence() << " and " << peptideSeq
+		        << peptides[pepEv.peptide].sequence << " and " << peptideSeq
 		        << " only the proteins that contain the first peptide will be included in the PSM..\n" << std::endl;
       }
       //else
       //{
       if (__flankN != "-") {
-        __flankN = boost::lexical_cast<std::string> (pepEv->pre());
+        __flankN = pepEv.pre;
         if (__flankN == "?") {__flankN = "-";} //MSGF+ sometimes outputs questionmarks here
         // MT: MSGF+ clips methionine of protein N-terminals, set to "-" to avoid confusion with cleavage rules
-        if (__flankN == "M" && boost::lexical_cast<std::string>(pepEv->start()) == "2") { __flankN = "-"; } 
+        if (__flankN == "M" && pepEv.start == "2") { __flankN = "-"; } 
       }
       
       if (__flankC != "-") {
-        __flankC = boost::lexical_cast<std::string> (pepEv->post());
+        __flankC = pepEv.post;
         if (__flankC == "?") {__flankC = "-";}
       }
       
-      std::string proteinid = boost::lexical_cast<string > (pepEv->dBSequence_ref());
-      mzIdentML_ns::SequenceCollectionType::DBSequence_type *proteinObj = proteinMap[proteinid];
-      std::string proteinName = boost::lexical_cast<string > (proteinObj->accession());
-      proteinIds.push_back(proteinName);
+      proteinIds.push_back(proteinAccessions[pepEv.protein]);
       //}
     }
 
@@ -269,7 +266,8 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
     double observed_mass = boost::lexical_cast<double>(item.experimentalMassToCharge());
     
     std::string peptideSeqWithFlanks = __flankN + std::string(".") + peptideSeq + std::string(".") + __flankC;
-    unsigned peptide_length = peptideLength(peptideSeqWithFlanks);
+    const PeptideFeatures& features = featureCache_.lookup(peptideSeqWithFlanks);
+    unsigned peptide_length = features.length;
 
     // Make a PSM id, from filename, item_id, scan_number, charge and rank
     std::string fileId = fn;
@@ -283,7 +281,7 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
     {
       fileId.erase(spos);
     }
-    std::string psmId = createPsmId(fileId + "_" + boost::lexical_cast<string > (item.id()), 
+    psm.id = createPsmId(fileId + "_" + boost::lexical_cast<string > (item.id()), 
         observed_mass, useScanNumber, charge, rank);
 
     double RawScore = 0.0;
@@ -363,7 +361,7 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
     f_seq.push_back(log(CTermIonCurrentRatio+0.0001));
     f_seq.push_back(log(MS2IonCurrent));
     f_seq.push_back(observed_mass);
-    f_seq.push_back(peptideLength(peptideSeqWithFlanks));
+    f_seq.push_back(peptide_length);
     f_seq.push_back(dM);
     f_seq.push_back(abs(dM));
 
@@ -377,13 +375,13 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
       f_seq.push_back(charge == c ? 1.0 : 0.0); // Charge
     }
     if (enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
-      f_seq.push_back(enzyme_->isEnzymatic(peptideSeqWithFlanks.at(0), peptideSeqWithFlanks.at(2)) ? 1.0 : 0.0);
-      f_seq.push_back(enzyme_->isEnzymatic(peptideSeqWithFlanks.at(peptideSeqWithFlanks.size() - 3), peptideSeqWithFlanks.at(peptideSeqWithFlanks.size() - 1)) ? 1.0 : 0.0);
-      f_seq.push_back((double) enzyme_->countEnzymatic(peptideSeq));
+      f_seq.push_back(features.enzymaticN);
+      f_seq.push_back(features.enzymaticC);
+      f_seq.push_back(features.numEnzymatic);
     }
 
-    percolatorInNs::occurence::flankN_type flankN = peptideSeqWithFlanks.substr(0, 1);
-    percolatorInNs::occurence::flankC_type flankC = peptideSeqWithFlanks.substr(peptideSeqWithFlanks.size() - 1, 1);
+    psm.flankN = peptideSeqWithFlanks.substr(0, 1);
+    psm.flankC = peptideSeqWithFlanks.substr(peptideSeqWithFlanks.size() - 1, 1);
 
     // Strip peptide from termini and modifications
     std::string peptideS = peptideSeq;
@@ -393,31 +391,26 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
       }
     }
 
-    std::auto_ptr< percolatorInNs::peptideType > peptide_p(new percolatorInNs::peptideType(peptideSeq));
+    psm.peptide = peptideSeq;
     // Register the ptms
     unsigned int numPTMs = 0;
-    BOOST_FOREACH (const ::mzIdentML_ns::ModificationType &mod_ref, peptideMap[item.peptide_ref().get()]->Modification()){
-      BOOST_FOREACH (const ::mzIdentML_ns::CVParamType &cv_ref, mod_ref.cvParam()) {
-        if (!(std::string(cv_ref.cvRef())=="UNIMOD")) {
+    BOOST_FOREACH (const MzidModification &mod_ref, peptides[peptideIdx].modifications){
+      BOOST_FOREACH (const MzidCvParam &cv_ref, mod_ref.cvParams) {
+        const std::string &cvRef = cv_ref.first, &accession = cv_ref.second;
+        if (!(cvRef=="UNIMOD")) {
           ostringstream errs;
           errs << "Error: current implementation can only handle UNIMOD accessions "
-	             << boost::lexical_cast<string > (cv_ref.accession())  << std::endl;
+	             << accession  << std::endl;
           throw MyException(errs.str());
         }
-        // cerr <<  cv_ref.accession() << endl;
-        int mod_loc = boost::lexical_cast<int>(mod_ref.location());
-        std::auto_ptr< percolatorInNs::modificationType >  mod_p( new percolatorInNs::modificationType(mod_loc));
-        if (cv_ref.accession() == "MS:1001460") {
-          std::string mod_acc = "unknown";
-          std::auto_ptr< percolatorInNs::freeMod > fm_p (new percolatorInNs::freeMod(mod_acc));
-          mod_p->freeMod(fm_p);
+        int mod_loc = mod_ref.location;
+        if (accession == "MS:1001460") {
+          psm.addFreeMod(mod_loc, "unknown");
         } else {
-          int mod_acc = boost::lexical_cast<int>(cv_ref.accession().substr(7));  // Only convert text after "UNIMOD:"
-          std::auto_ptr< percolatorInNs::uniMod > um_p (new percolatorInNs::uniMod(mod_acc));
-          mod_p->uniMod(um_p);
+          int mod_acc = boost::lexical_cast<int>(accession.substr(7));  // Only convert text after "UNIMOD:"
+          psm.addUniMod(mod_loc, mod_acc);
         }
         ++numPTMs;
-        peptide_p->modification().push_back(mod_p);
       }
     }
     
@@ -425,22 +418,18 @@ void MsgfplusReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemT
       f_seq.push_back(numPTMs);
     }
     if (po.pngasef) {
-      f_seq.push_back(isPngasef(peptideSeqWithFlanks, isDecoy));
+      f_seq.push_back(features.pngasef(isDecoy));
     }
     if (po.calcAAFrequencies) {
-      computeAAFrequencies(peptideSeqWithFlanks, f_seq);
+      f_seq.insert(f_seq.end(), features.aaFrequencies.begin(), features.aaFrequencies.end());
     }
 
-    ::percolatorInNs::peptideSpectrumMatch* tmp_psm = new ::percolatorInNs::peptideSpectrumMatch
-            (features_p, peptide_p, psmId, isDecoy, observed_mass, theoretic_mass, charge);
-    std::auto_ptr< ::percolatorInNs::peptideSpectrumMatch > psm_p(tmp_psm);
-
-    for (std::vector< std::string >::const_iterator i = proteinIds.begin(); i != proteinIds.end(); ++i) {
-      std::auto_ptr< percolatorInNs::occurence > oc_p(new percolatorInNs::occurence(*i, flankN, flankC));
-      psm_p->occurence().push_back(oc_p);
-    }
+    psm.isDecoy = isDecoy;
+    psm.experimentalMass = observed_mass;
+    psm.calculatedMass = theoretic_mass;
+    psm.chargeState = charge;
     
-    database->savePsm(useScanNumber, psm_p);
+    savePsm(useScanNumber, psm, database);
   }
   // Try-Catch statement to find potential errors among the features.
   catch(std::exception const& e)
@@ -29,6 +29,9 @@ class MsgfplusReader : public MzidentmlReader
     virtual ~MsgfplusReader();
     bool checkValidity(const std::string &file);
     virtual void searchEngineSpecificParsing(const ::mzIdentML_ns::SpectrumIdentificationItemType & item, int itemCount);
+    bool searchEngineSpecificParsingDone() const {
+      return additionalMsgfFeatures && useFragmentSpectrumFeatures;
+    }
     void addFeatureDescriptions(bool doEnzyme);
     void createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemType & item,
 		  ::percolatorInNs::fragSpectrumScan::experimentalMass_type experimentalMass,
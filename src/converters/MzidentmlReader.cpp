@@ -5,6 +5,28 @@ static const XMLCh sequenceCollectionStr[] = {
     chLatin_c, chLatin_e, chLatin_C, chLatin_o, chLatin_l, chLatin_l, chLatin_e,
     chLatin_c, chLatin_t, chLatin_i, chLatin_o, chLatin_n, chNull};
 
+static const XMLCh peptideStr[] = {
+    chLatin_P, chLatin_e, chLatin_p, chLatin_t, chLatin_i, chLatin_d, chLatin_e, chNull};
+
+static const XMLCh dbSequenceStr[] = {
+    chLatin_D, chLatin_B, chLatin_S, chLatin_e, chLatin_q, chLatin_u, chLatin_e,
+    chLatin_n, chLatin_c, chLatin_e, chNull};
+
+static const XMLCh peptideEvidenceStr[] = {
+    chLatin_P, chLatin_e, chLatin_p, chLatin_t, chLatin_i, chLatin_d, chLatin_e,
+    chLatin_E, chLatin_v, chLatin_i, chLatin_d, chLatin_e, chLatin_n, chLatin_c,
+    chLatin_e, chNull};
+
+static const XMLCh spectrumIdentificationItemStr[] = {
+    chLatin_S, chLatin_p, chLatin_e, chLatin_c, chLatin_t, chLatin_r, chLatin_u, chLatin_m,
+    chLatin_I, chLatin_d, chLatin_e, chLatin_n, chLatin_t, chLatin_i, chLatin_f, chLatin_i,
+    chLatin_c, chLatin_a, chLatin_t, chLatin_i, chLatin_o, chLatin_n,
+    chLatin_I, chLatin_t, chLatin_e, chLatin_m, chNull};
+
+static const XMLCh chargeStateStr[] = {
+    chLatin_c, chLatin_h, chLatin_a, chLatin_r, chLatin_g, chLatin_e,
+    chLatin_S, chLatin_t, chLatin_a, chLatin_t, chLatin_e, chNull};
+
 
 static string schemaDefinition = Globals::getInstance()->getXMLDir(true) + 
            MZIDENTML_SCHEMA_LOCATION + string("mzIdentML1.1.0.xsd");
@@ -19,22 +41,75 @@ MzidentmlReader::MzidentmlReader(ParseOptions po) : Reader(po) {}
 MzidentmlReader::~MzidentmlReader() {}
 
 void MzidentmlReader::cleanHashMaps() {
-  peptideMapType::iterator iter;
-  for (iter = peptideMap.begin(); iter != peptideMap.end(); ++iter) {
-    if(iter->second) delete iter->second;
-    iter->second = 0;
-  }
+  peptides.clear();
+  proteinAccessions.clear();
+  peptideEvidences.clear();
+  peptideIndex.clear();
+  proteinIndex.clear();
+  peptideEvidenceIndex.clear();
+}
 
-  proteinMapType::iterator iter2;
-  for (iter2 = proteinMap.begin(); iter2 != proteinMap.end(); ++iter2) {
-    if(iter2->second) delete iter2->second;
-    iter2->second = 0;
+size_t MzidentmlReader::lookupRef(const idIndexMapType& index,
+    const std::string& ref, const char* element) const {
+  idIndexMapType::const_iterator it = index.find(ref);
+  if (it == index.end()) {
+    ostringstream temp;
+    temp << "Error : reference to unknown " << element << " " << ref << std::endl;
+    throw MyException(temp.str());
   }
+  return it->second;
+}
 
-  peptideEvidenceMapType::iterator iter3;
-  for (iter3 = peptideEvidenceMap.begin(); iter3 != peptideEvidenceMap.end(); ++iter3) {
-    if(iter3->second) delete iter3->second;
-    iter3->second = 0;
+/*
+ * Walks the children of the SequenceCollection one by one, converting each
+ * into its xsd object only long enough to copy the fields we need. The
+ * evidences are read in a second sweep, as they refer to the other two.
+ */
+void MzidentmlReader::readSequenceCollection(const xercesc::DOMElement& sequenceCollection) {
+  cleanHashMaps();
+  
+  for (const DOMNode* n = sequenceCollection.getFirstChild(); n != 0; n = n->getNextSibling()) {
+    if (n->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+    const DOMElement& element = static_cast<const DOMElement&>(*n);
+    if (XMLString::equals(peptideStr, element.getLocalName())) {
+      //PEPTIDE
+      mzIdentML_ns::SequenceCollectionType::Peptide_type peptide(element);
+      peptideIndex[peptide.id()] = peptides.size();
+      peptides.push_back(MzidPeptide());
+      MzidPeptide& pept = peptides.back();
+      pept.sequence = peptide.PeptideSequence();
+      BOOST_FOREACH (const ::mzIdentML_ns::ModificationType &mod_ref, peptide.Modification()) {
+        pept.modifications.push_back(MzidModification());
+        MzidModification& mod = pept.modifications.back();
+        mod.location = boost::lexical_cast<int>(mod_ref.location());
+        BOOST_FOREACH (const ::mzIdentML_ns::CVParamType &cv_ref, mod_ref.cvParam()) {
+          mod.cvParams.push_back(MzidCvParam(std::string(cv_ref.cvRef()), 
+                                             std::string(cv_ref.accession())));
+        }
+      }
+    } else if (XMLString::equals(dbSequenceStr, element.getLocalName())) {
+      //PROTEIN
+      mzIdentML_ns::SequenceCollectionType::DBSequence_type protein(element);
+      proteinIndex[protein.id()] = proteinAccessions.size();
+      proteinAccessions.push_back(boost::lexical_cast<string > (protein.accession()));
+    }
+  }
+  
+  for (const DOMNode* n = sequenceCollection.getFirstChild(); n != 0; n = n->getNextSibling()) {
+    if (n->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+    const DOMElement& element = static_cast<const DOMElement&>(*n);
+    if (XMLString::equals(peptideEvidenceStr, element.getLocalName())) {
+      //PEPTIDE EVIDENCE
+      ::mzIdentML_ns::PeptideEvidenceType peptideE(element);
+      peptideEvidenceIndex[peptideE.id()] = peptideEvidences.size();
+      peptideEvidences.push_back(MzidPeptideEvidence());
+      MzidPeptideEvidence& peptE = peptideEvidences.back();
+      peptE.peptide = lookupRef(peptideIndex, peptideE.peptide_ref(), "Peptide");
+      peptE.protein = lookupRef(proteinIndex, peptideE.dBSequence_ref(), "DBSequence");
+      peptE.pre = boost::lexical_cast<std::string> (peptideE.pre());
+      peptE.post = boost::lexical_cast<std::string> (peptideE.post());
+      peptE.start = boost::lexical_cast<std::string> (peptideE.start());
+    }
   }
 }
 
@@ -60,9 +135,8 @@ void MzidentmlReader::getMaxMinCharge(const std::string &fn, bool isDecoy) {
   try {
     ifs.open(fn.c_str());
     parser p;
-    bool validateSchema = true;
     xml_schema::dom::auto_ptr<xercesc::DOMDocument> doc
-        (p.start(ifs, fn.c_str(), validateSchema, schemaDefinition, schema_major, 
+        (p.start(ifs, fn.c_str(), po.validateSchema, schemaDefinition, schema_major, 
                  schema_minor, scheme_namespace));
 
     // MT: This seems to be a bit slow for doing nothing
@@ -74,13 +148,28 @@ void MzidentmlReader::getMaxMinCharge(const std::string &fn, bool isDecoy) {
     int itemCount = 1;
     for (; doc.get() != 0 && XMLString::equals(spectrumIdentificationResultStr,
             doc->getDocumentElement()->getTagName()); doc = p.next()) {
-      ::mzIdentML_ns::SpectrumIdentificationResultType specIdResult(*doc->getDocumentElement());
-      // For each SpectrumIdentificationItem
-      BOOST_FOREACH(const ::mzIdentML_ns::SpectrumIdentificationItemType & item, specIdResult.SpectrumIdentificationItem()) {
-        minCharge = (std::min)(item.chargeState(), minCharge);
-        maxCharge = (std::max)(item.chargeState(), maxCharge);
-        searchEngineSpecificParsing(item, itemCount);  // Virtual function that potentially checks the features
-        ++itemCount;
+      if (!searchEngineSpecificParsingDone()) {
+        ::mzIdentML_ns::SpectrumIdentificationResultType specIdResult(*doc->getDocumentElement());
+        // For each SpectrumIdentificationItem
+        BOOST_FOREACH(const ::mzIdentML_ns::SpectrumIdentificationItemType & item, specIdResult.SpectrumIdentificationItem()) {
+          minCharge = (std::min)(item.chargeState(), minCharge);
+          maxCharge = (std::max)(item.chargeState(), maxCharge);
+          searchEngineSpecificParsing(item, itemCount);  // Virtual function that potentially checks the features
+          ++itemCount;
+        }
+        continue;
+      }
+      // only the charge states are needed, read them from the DOM directly
+      // instead of building the object model of the whole result
+      for (const DOMNode* n = doc->getDocumentElement()->getFirstChild(); n != 0; n = n->getNextSibling()) {
+        if (n->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement* item = static_cast<const DOMElement*>(n);
+        if (XMLString::equals(spectrumIdentificationItemStr, item->getLocalName())) {
+          int charge = XMLString::parseInt(item->getAttribute(chargeStateStr));
+          minCharge = (std::min)(charge, minCharge);
+          maxCharge = (std::max)(charge, maxCharge);
+          ++itemCount;
+        }
       }
     }
   } catch (ifstream::failure e) {
@@ -119,7 +208,7 @@ void MzidentmlReader::read(const std::string &fn, bool isDecoy,
     ifs.open(fn.c_str());
     parser p;
     xml_schema::dom::auto_ptr<xercesc::DOMDocument> doc
-            (p.start(ifs, fn.c_str(), true, schemaDefinition, schema_major, schema_minor, scheme_namespace));
+            (p.start(ifs, fn.c_str(), po.validateSchema, schemaDefinition, schema_major, schema_minor, scheme_namespace));
 
     //NOTE wouldnt be  better to use the get tag by Name to jump SequenceCollenction directly?
     while (doc.get() != 0 && !XMLString::equals(sequenceCollectionStr,
@@ -128,33 +217,7 @@ void MzidentmlReader::read(const std::string &fn, bool isDecoy,
     }
 
     assert(doc.get());
-    mzIdentML_ns::SequenceCollectionType sequenceCollection(*doc->getDocumentElement());
-
-    peptideMap.clear();
-    proteinMap.clear();
-    peptideEvidenceMap.clear();
-
-    //NOTE probably I can get rid of these hash tables with a proper access to elements by tag and id
-
-    BOOST_FOREACH(const mzIdentML_ns::SequenceCollectionType::Peptide_type &peptide, sequenceCollection.Peptide()) {
-      //PEPTIDE
-      mzIdentML_ns::SequenceCollectionType::Peptide_type *pept =
-              new mzIdentML_ns::SequenceCollectionType::Peptide_type(peptide);
-      peptideMap.insert(std::make_pair(peptide.id(), pept));
-    }
-
-    BOOST_FOREACH(const mzIdentML_ns::SequenceCollectionType::DBSequence_type &protein, sequenceCollection.DBSequence()) {
-      //PROTEIN
-      mzIdentML_ns::SequenceCollectionType::DBSequence_type *prot =
-              new mzIdentML_ns::SequenceCollectionType::DBSequence_type(protein);
-      proteinMap.insert(std::make_pair(protein.id(), prot));
-    }
-
-    BOOST_FOREACH(const ::mzIdentML_ns::PeptideEvidenceType &peptideE, sequenceCollection.PeptideEvidence()) {
-      //PEPTIDE EVIDENCE
-      ::mzIdentML_ns::PeptideEvidenceType *peptE = new mzIdentML_ns::PeptideEvidenceType(peptideE);
-      peptideEvidenceMap.insert(std::make_pair(peptideE.id(), peptE));
-    }
+    readSequenceCollection(*doc->getDocumentElement());
 
     for (doc = p.next(); doc.get() != 0 && !XMLString::equals(spectrumIdentificationResultStr,
             doc->getDocumentElement()->getTagName()); doc = p.next()) {
@@ -25,11 +25,31 @@
 
 using namespace std;
 using namespace xercesc;
-typedef map<std::string, mzIdentML_ns::SequenceCollectionType::Peptide_type *> peptideMapType;
-typedef map<std::string, mzIdentML_ns::SequenceCollectionType::DBSequence_type *> proteinMapType;
-typedef multimap<std::string, mzIdentML_ns::PeptideEvidenceType *> peptideEvidenceMapType_peptideid;
-typedef map<std::string, mzIdentML_ns::PeptideEvidenceType *> peptideEvidenceMapType;
 typedef map<std::string, int> scanNumberMapType;
+typedef map<std::string, size_t> idIndexMapType;
+
+/*
+ * Compact copies of the entries of the SequenceCollection that the psms
+ * refer to. Only the fields used by the readers are kept, rather than
+ * copies of the complete xsd objects.
+ */
+typedef std::pair<std::string, std::string> MzidCvParam; // cvRef, accession
+
+struct MzidModification {
+  int location;
+  std::vector<MzidCvParam> cvParams;
+};
+
+struct MzidPeptide {
+  std::string sequence;
+  std::vector<MzidModification> modifications;
+};
+
+struct MzidPeptideEvidence {
+  size_t peptide; // index in peptides
+  size_t protein; // index in proteinAccessions
+  std::string pre, post, start;
+};
 
 struct RetrieveValue
 {
@@ -65,13 +85,24 @@ public:
 		   bool isDecoy, unsigned useScanNumber, boost::shared_ptr<FragSpectrumScanDatabase> database,
 		   const std::string & fn) = 0;
 
+  /**
+   * Returns true once searchEngineSpecificParsing has seen all it needs, such
+   * that getMaxMinCharge only has to read the charge states of the items.
+   */
+  virtual bool searchEngineSpecificParsingDone() const { return true; }
+
   void cleanHashMaps();
 
  protected :
 
-    peptideMapType peptideMap;
-    proteinMapType proteinMap;
-    peptideEvidenceMapType peptideEvidenceMap;
+    void readSequenceCollection(const xercesc::DOMElement& sequenceCollection);
+    size_t lookupRef(const idIndexMapType& index, const std::string& ref,
+                     const char* element) const;
+
+    std::vector<MzidPeptide> peptides;
+    std::vector<std::string> proteinAccessions;
+    std::vector<MzidPeptideEvidence> peptideEvidences;
+    idIndexMapType peptideIndex, proteinIndex, peptideEvidenceIndex;
 };
 
 #endif // MZIDENTMLREADER_H
@@ -0,0 +1,253 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <assert.h>
+#include <sstream>
+
+#include "PeptideFeatureCache.h"
+#include "MyException.h"
+
+PeptideFeatureCache::PeptideFeatureCache() : terminalMass_(0.0), protonMass_(0.0),
+    numAminoAcids_(0), enzyme_(NULL), calcPTMs_(false), pngasef_(false),
+    calcAAFrequencies_(false), numLookups_(0) {
+  for (int c = 0; c < 256; ++c) {
+    aaIndex_[c] = -1;
+    isPtm_[c] = false;
+    mass_[c] = 0.0;
+    hasMass_[c] = false;
+  }
+}
+
+void PeptideFeatureCache::init(const std::string& aminoAcids,
+    const std::string& modifiedAminoAcids, const std::map<char,int>& ptmScheme,
+    const std::map<char,double>& massMap, const std::map<unsigned,double>& ptmMass,
+    const Enzyme* enzyme, bool calcPTMs, bool pngasef, bool calcAAFrequencies) {
+  for (int c = 0; c < 256; ++c) {
+    aaIndex_[c] = -1;
+    isPtm_[c] = false;
+    mass_[c] = 0.0;
+    hasMass_[c] = false;
+  }
+  numAminoAcids_ = aminoAcids.size();
+  for (size_t ix = 0; ix < aminoAcids.size(); ++ix) {
+    unsigned char c = aminoAcids[ix];
+    if (aaIndex_[c] < 0) aaIndex_[c] = static_cast<int>(ix);
+    std::map<char,double>::const_iterator massIt = massMap.find(aminoAcids[ix]);
+    mass_[c] = (massIt != massMap.end()) ? massIt->second : 0.0;
+    hasMass_[c] = true;
+  }
+  std::map<char,int>::const_iterator ptmIt;
+  for (ptmIt = ptmScheme.begin(); ptmIt != ptmScheme.end(); ++ptmIt) {
+    unsigned char c = ptmIt->first;
+    isPtm_[c] = true;
+    std::map<unsigned,double>::const_iterator massIt = ptmMass.find(ptmIt->second);
+    if (modifiedAminoAcids.find(ptmIt->first) != std::string::npos &&
+        massIt != ptmMass.end() && !hasMass_[c]) {
+      mass_[c] = massIt->second;
+      hasMass_[c] = true;
+    }
+  }
+  std::map<char,double>::const_iterator it;
+  terminalMass_ = ((it = massMap.find('o')) != massMap.end()) ? it->second : 0.0;
+  protonMass_ = ((it = massMap.find('h')) != massMap.end()) ? it->second : 0.0;
+
+  enzyme_ = enzyme;
+  calcPTMs_ = calcPTMs;
+  pngasef_ = pngasef;
+  calcAAFrequencies_ = calcAAFrequencies;
+  clear();
+}
+
+void PeptideFeatureCache::clear() {
+  cache_.clear();
+  numLookups_ = 0;
+}
+
+/*
+ * The features are computed outside of the critical sections, such that
+ * threads only serialize on the hash table itself. If two threads compute
+ * the same new peptide, the first one to insert it wins.
+ */
+const PeptideFeatures& PeptideFeatureCache::lookup(const std::string& peptide) {
+  const PeptideFeatures* found = NULL;
+  #pragma omp critical (peptide_feature_cache)
+  {
+    ++numLookups_;
+    boost::unordered_map<std::string, PeptideFeatures>::const_iterator it = cache_.find(peptide);
+    if (it != cache_.end()) found = &it->second;
+  }
+  if (found != NULL) return *found;
+
+  PeptideFeatures features;
+  compute(peptide, features);
+  #pragma omp critical (peptide_feature_cache)
+  {
+    // references to the elements of an unordered_map survive rehashing
+    found = &(cache_.insert(std::make_pair(peptide, features)).first->second);
+  }
+  return *found;
+}
+
+void PeptideFeatureCache::compute(const std::string& peptide, PeptideFeatures& features) const {
+  features.peptideNoMods = removePTMs(peptide);
+  features.length = peptideLength(peptide);
+  features.numPtms = calcPTMs_ ? cntPTMs(peptide) : 0u;
+  features.pngasefTarget = pngasef_ ? isPngasef(peptide, false) : 0.0;
+  features.pngasefDecoy = pngasef_ ? isPngasef(peptide, true) : 0.0;
+  features.enzymaticN = features.enzymaticC = features.numEnzymatic = 0.0;
+  if (enzyme_ != NULL && enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
+    const std::string& noMods = features.peptideNoMods;
+    features.enzymaticN = enzyme_->isEnzymatic(noMods.at(0), noMods.at(2)) ? 1.0 : 0.0;
+    features.enzymaticC = enzyme_->isEnzymatic(noMods.at(noMods.size() - 3),
+                                               noMods.at(noMods.size() - 1)) ? 1.0 : 0.0;
+    std::string peptide2 = noMods.substr(2, noMods.size() - 4);
+    features.numEnzymatic = (double)enzyme_->countEnzymatic(peptide2);
+  }
+  if (calcAAFrequencies_) {
+    computeAAFrequencies(peptide, features.aaFrequencies);
+    if (features.peptideNoMods == peptide) {
+      features.aaFrequenciesNoMods = features.aaFrequencies;
+    } else {
+      computeAAFrequencies(features.peptideNoMods, features.aaFrequenciesNoMods);
+    }
+  }
+}
+
+/* returns the offset of the ']' closing the modification that starts at pos */
+size_t PeptideFeatureCache::modificationEnd(const std::string& pep, size_t pos) {
+  size_t posEnd = pep.find(']', pos);
+  if (posEnd == std::string::npos) {
+    std::ostringstream temp;
+    temp << "Error : Peptide sequence " << pep << " contains an invalid modification" << std::endl;
+    throw MyException(temp.str());
+  }
+  return posEnd - pos;
+}
+
+std::string PeptideFeatureCache::removePTMs(const std::string& peptide) const {
+  bool flanked = hasFlanks(peptide);
+  size_t begin = flanked ? 2 : 0;
+  size_t end = flanked ? peptide.size() - 2 : peptide.size();
+  std::string peptideSequence;
+  peptideSequence.reserve(peptide.size());
+  if (flanked) peptideSequence.append(peptide, 0, 2);
+  for (size_t ix = begin; ix < end; ++ix) {
+    char c = peptide[ix];
+    if (isAA(c)) {
+      peptideSequence += c;
+    } else if (c == '[') {
+      size_t posEnd = peptide.find(']', ix);
+      if (posEnd == std::string::npos || posEnd >= end) {
+        std::ostringstream temp;
+        temp << "Error : Peptide sequence " << peptide << " contains an invalid modification" << std::endl;
+        throw MyException(temp.str());
+      }
+      ix = posEnd;
+    } else if (!isPtm_[(unsigned char)c]) {
+      std::ostringstream temp;
+      temp << "Error : Peptide sequence " << peptide << " contains modification "
+           << c << " that is not specified by a \"-p\" argument" << std::endl;
+      throw MyException(temp.str());
+    }
+  }
+  if (flanked) peptideSequence.append(peptide, end, 2);
+  return peptideSequence;
+}
+
+unsigned int PeptideFeatureCache::peptideLength(const std::string& pep) const {
+  unsigned int len = 0;
+  assert(hasFlanks(pep));
+  for (std::string::size_type pos = 2; (pos + 2) < pep.size(); pos++) {
+    if (isAA(pep[pos])) {
+      len++;
+    } else if (pep[pos] == '[') {
+      pos += modificationEnd(pep, pos);
+    }
+  }
+  return len;
+}
+
+unsigned int PeptideFeatureCache::cntPTMs(const std::string& pep) const {
+  unsigned int len = 0;
+  assert(hasFlanks(pep));
+  for (std::string::size_type pos = 2; (pos + 2) < pep.size(); pos++) {
+    if (isPtm_[(unsigned char)pep[pos]]) {
+      ++len;
+    } else if (pep[pos] == '[') {
+      ++len;
+      pos += modificationEnd(pep, pos);
+    }
+  }
+  return len;
+}
+
+//NOTE this should return bool and the converts to double
+double PeptideFeatureCache::isPngasef(const std::string& peptide, bool isDecoy) {
+  size_t next_pos = 0, pos;
+  while ((pos = peptide.find("N*", next_pos)) != std::string::npos) {
+    next_pos = pos + 1;
+    if (! isDecoy) {
+      pos += 3;
+      if (peptide[pos] == '#') {
+        pos += 1;
+      }
+    } else {
+      pos -= 2;
+      if (peptide[pos] == '#') {
+        pos -= 1;
+      }
+    }
+    if (peptide[pos] == 'T' || peptide[pos] == 'S') {
+      return 1.0;
+    }
+  }
+  return 0.0;
+}
+
+void PeptideFeatureCache::computeAAFrequencies(const std::string& pep,
+                                               std::vector<double>& f_seq) const {
+  //the peptide has to include the flanks
+  assert(hasFlanks(pep));
+  // Overall amino acid composition features
+  size_t offset = f_seq.size();
+  f_seq.resize(offset + numAminoAcids_, 0.0);
+  int len = 0;
+  for (std::string::const_iterator it = pep.begin() + 2; it != pep.end() - 2; it++) {
+    int pos = aaIndex_[(unsigned char)*it];
+    if (pos >= 0) f_seq[offset + pos]++;
+    len++;
+  }
+  assert(len>0);
+  for (size_t m = offset; m < f_seq.size(); m++) {
+    f_seq[m] /= len;
+  }
+}
+
+double PeptideFeatureCache::peptideMass(const std::string& pepsequence, double charge) const {
+  double mass = 0.0;
+  for (size_t i = 0; i < pepsequence.length(); i++) {
+    unsigned char c = pepsequence[i];
+    if (!hasMass_[c]) {
+      std::ostringstream temp;
+      temp << "Error: estimating peptide mass, the amino acid "
+           << pepsequence[i] << " is not valid." << std::endl;
+      throw MyException(temp.str());
+    }
+    mass += mass_[c];
+  }
+  return (mass + terminalMass_ + (charge * protonMass_) + 1.00727649);
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class PeptideFeatureCache, which computes the
+ * features that only depend on the peptide sequence (length, ptm count,
+ * PNGase F motif, enzymatic termini and amino acid frequencies) once per
+ * distinct peptide. The same peptide is typically matched by many spectra,
+ * so most psms are served from the cache. Characters are classified with
+ * 256-entry lookup tables instead of string searches and map lookups.
+ */
+
+#ifndef PEPTIDEFEATURECACHE_H
+#define PEPTIDEFEATURECACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/unordered/unordered_map.hpp>
+
+#include "Enzyme.h"
+
+/**
+ * The sequence derived features of a peptide with flanks, e.g. K.PEP*TIDE.A
+ */
+struct PeptideFeatures {
+  std::string peptideNoMods; // with flanks
+  unsigned int length; // number of amino acids, excluding modifications
+  unsigned int numPtms;
+  double pngasefTarget, pngasefDecoy; // PNGase F motif for target and decoy psms
+  double enzymaticN, enzymaticC, numEnzymatic; // computed on peptideNoMods
+  // only set if amino acid frequencies are used, the sqt reader takes them over peptideNoMods
+  std::vector<double> aaFrequencies, aaFrequenciesNoMods;
+
+  double pngasef(bool isDecoy) const {
+    return isDecoy ? pngasefDecoy : pngasefTarget;
+  }
+};
+
+class PeptideFeatureCache {
+ public:
+  PeptideFeatureCache();
+
+  /**
+   * Sets up the lookup tables. The feature flags determine which of the
+   * optional features are computed for new peptides, the enzyme is owned
+   * by the caller and may be NULL if no enzymatic features are needed.
+   */
+  void init(const std::string& aminoAcids, const std::string& modifiedAminoAcids,
+            const std::map<char,int>& ptmScheme, const std::map<char,double>& massMap,
+            const std::map<unsigned,double>& ptmMass,
+            const Enzyme* enzyme, bool calcPTMs, bool pngasef, bool calcAAFrequencies);
+
+  /**
+   * Returns the features of the peptide, computing them on the first call.
+   * The returned reference stays valid until clear() is called. Safe to
+   * call from the threads that read the files of a meta file in parallel.
+   */
+  const PeptideFeatures& lookup(const std::string& peptide);
+
+  void clear();
+  size_t size() const { return cache_.size(); }
+  size_t numLookups() const { return numLookups_; }
+
+  /* the uncached computations, peptides are expected to have flanks unless stated otherwise */
+  std::string removePTMs(const std::string& peptide) const; // with or without flanks
+  unsigned int peptideLength(const std::string& pep) const;
+  unsigned int cntPTMs(const std::string& pep) const;
+  static double isPngasef(const std::string& peptide, bool isDecoy);
+  void computeAAFrequencies(const std::string& pep, std::vector<double>& f_seq) const;
+  double peptideMass(const std::string& pepsequence, double charge) const; // without flanks
+
+  static bool hasFlanks(const std::string& pep) {
+    return pep.size() >= 4 && pep[1] == '.' && pep[pep.size() - 2] == '.';
+  }
+
+ private:
+  int aaIndex_[256]; // position in the amino acid alphabet, -1 for other characters
+  bool isPtm_[256]; // characters that denote a modification in the ptm scheme
+  double mass_[256];
+  bool hasMass_[256];
+  double terminalMass_, protonMass_; // masses of an oxygen and of a hydrogen atom
+  size_t numAminoAcids_;
+
+  const Enzyme* enzyme_;
+  bool calcPTMs_, pngasef_, calcAAFrequencies_;
+
+  boost::unordered_map<std::string, PeptideFeatures> cache_;
+  size_t numLookups_;
+
+  void compute(const std::string& peptide, PeptideFeatures& features) const;
+
+  static size_t modificationEnd(const std::string& pep, size_t pos);
+
+  bool isAA(char c) const { return aaIndex_[(unsigned char)c] >= 0; }
+
+  // not copyable, references into cache_ are handed out
+  PeptideFeatureCache(const PeptideFeatureCache&);
+  PeptideFeatureCache& operator=(const PeptideFeatureCache&);
+};
+
+#endif /* PEPTIDEFEATURECACHE_H */
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+#include "PsmRecord.h"
+#include "MassHandler.h"
+
+void PsmRecord::insertModifications(std::string& peptideSeq,
+    std::list<std::pair<int, std::string> >& mods) {
+  mods.sort(std::greater<std::pair<int, std::string> >());
+  std::list<std::pair<int, std::string> >::const_iterator it;
+  for (it = mods.begin(); it != mods.end(); ++it) {
+    if (it->first <= static_cast<int>(peptideSeq.length())) {
+      peptideSeq.insert(it->first, it->second);
+    } else {
+      peptideSeq.insert(peptideSeq.length(), it->second);
+    }
+  }
+}
+
+std::string PsmRecord::decoratedPeptide() const {
+  std::string peptideSeq = peptide;
+  if (modifications.empty()) return peptideSeq;
+  std::list<std::pair<int, std::string> > mods;
+  std::vector<PsmModification>::const_iterator it;
+  for (it = modifications.begin(); it != modifications.end(); ++it) {
+    std::ostringstream ss;
+    if (it->isUniMod) {
+      ss << "[UNIMOD:" << it->accession << "]";
+    } else {
+      ss << "[" << it->moniker << "]";
+    }
+    mods.push_back(std::pair<int, std::string>(it->location, ss.str()));
+  }
+  insertModifications(peptideSeq, mods);
+  return peptideSeq;
+}
+
+void PsmRecord::printTab(std::ostream& tabOutputStream) const {
+  int label = isDecoy ? -1 : 1;
+  tabOutputStream << id << '\t' << label << '\t' << scanNr;
+  tabOutputStream << '\t' << experimentalMass << '\t' << calculatedMass;
+  if (hasObservedTime) {
+    tabOutputStream << '\t' << observedTime << '\t'
+        << MassHandler::massDiff(experimentalMass, calculatedMass, chargeState);
+  }
+  std::vector<double>::const_iterator feature;
+  for (feature = features.begin(); feature != features.end(); ++feature) {
+    tabOutputStream << '\t' << *feature;
+  }
+  // the flanks are the same for every protein, print the peptide only once
+  if (!proteinIds.empty()) {
+    tabOutputStream << '\t' << flankN << "." << decoratedPeptide() << "." << flankC;
+  }
+  std::vector<std::string>::const_iterator proteinIt;
+  for (proteinIt = proteinIds.begin(); proteinIt != proteinIds.end(); ++proteinIt) {
+    std::string proteinId = *proteinIt;
+    std::replace(proteinId.begin(), proteinId.end(), ' ', '-');
+    tabOutputStream << '\t' << proteinId;
+  }
+  tabOutputStream << std::endl;
+}
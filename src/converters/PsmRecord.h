@@ -0,0 +1,94 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class PsmRecord, a compact representation of a psm
+ * that the readers fill in for every search engine hit. The databases keep
+ * the records in a PsmStore; in tab output mode they are written out
+ * directly, only for xml output they are turned into
+ * percolatorInNs::peptideSpectrumMatch objects.
+ */
+
+#ifndef PSMRECORD_H
+#define PSMRECORD_H
+
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+#include <utility>
+
+struct PsmModification {
+  PsmModification(int location_, int accession_) :
+      location(location_), isUniMod(true), accession(accession_) {}
+  PsmModification(int location_, const std::string& moniker_) :
+      location(location_), isUniMod(false), accession(0), moniker(moniker_) {}
+  int location; // 0 is the n-terminus, length+1 the c-terminus
+  bool isUniMod;
+  int accession; // UNIMOD accession, only used if isUniMod
+  std::string moniker; // description of a free modification
+};
+
+class PsmRecord {
+ public:
+  PsmRecord() : isDecoy(false), scanNr(0), experimentalMass(0.0),
+      calculatedMass(0.0), chargeState(0), hasObservedTime(false),
+      observedTime(0.0) {}
+
+  void addUniMod(int location, int accession) {
+    modifications.push_back(PsmModification(location, accession));
+  }
+  void addFreeMod(int location, const std::string& moniker) {
+    modifications.push_back(PsmModification(location, moniker));
+  }
+  void addProtein(const std::string& proteinId) {
+    proteinIds.push_back(proteinId);
+  }
+
+  /**
+   * Returns the peptide with its modifications inserted as [UNIMOD:x] or
+   * [moniker], in the notation of the tab delimited percolator input.
+   */
+  std::string decoratedPeptide() const;
+
+  /**
+   * Writes the psm as a row of the tab delimited percolator input.
+   */
+  void printTab(std::ostream& tabOutputStream) const;
+
+  /**
+   * Inserts the modification strings into the peptide sequence, starting
+   * with the one at the largest location such that the earlier locations
+   * remain valid. Shared with the xml based tab output.
+   */
+  static void insertModifications(std::string& peptideSeq,
+      std::list<std::pair<int, std::string> >& mods);
+
+  std::string id;
+  bool isDecoy;
+  unsigned int scanNr;
+  double experimentalMass, calculatedMass;
+  int chargeState;
+  bool hasObservedTime;
+  double observedTime;
+  std::vector<double> features;
+  std::string peptide; // without flanks and modifications
+  std::string flankN, flankC;
+  std::vector<PsmModification> modifications;
+  std::vector<std::string> proteinIds;
+};
+
+#endif /* PSMRECORD_H */
@@ -0,0 +1,177 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "PsmStore.h"
+
+// minimum size of the chunks of the store
+static const size_t kChunkSize = 1 << 20;
+
+template <typename T>
+static void putValue(std::string& buffer, const T& value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void putString(std::string& buffer, const std::string& str) {
+  putValue(buffer, static_cast<unsigned int>(str.size()));
+  buffer.append(str);
+}
+
+template <typename T>
+static void takeValue(const char*& data, T& value) {
+  memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+}
+
+static void takeString(const char*& data, std::string& str) {
+  unsigned int size;
+  takeValue(data, size);
+  str.assign(data, size);
+  data += size;
+}
+
+void PsmStore::append(const PsmRecord& psm) {
+  buffer_.clear();
+  char flags = (psm.isDecoy ? 1 : 0) | (psm.hasObservedTime ? 2 : 0);
+  putValue(buffer_, flags);
+  putValue(buffer_, psm.experimentalMass);
+  putValue(buffer_, psm.calculatedMass);
+  putValue(buffer_, psm.observedTime);
+  putValue(buffer_, psm.chargeState);
+  putValue(buffer_, static_cast<unsigned int>(psm.features.size()));
+  if (!psm.features.empty()) {
+    buffer_.append(reinterpret_cast<const char*>(&psm.features[0]),
+                   psm.features.size() * sizeof(double));
+  }
+  putString(buffer_, psm.id);
+  putString(buffer_, psm.peptide);
+  putString(buffer_, psm.flankN);
+  putString(buffer_, psm.flankC);
+  putValue(buffer_, static_cast<unsigned int>(psm.modifications.size()));
+  std::vector<PsmModification>::const_iterator mod;
+  for (mod = psm.modifications.begin(); mod != psm.modifications.end(); ++mod) {
+    putValue(buffer_, mod->location);
+    putValue(buffer_, static_cast<char>(mod->isUniMod));
+    if (mod->isUniMod) {
+      putValue(buffer_, mod->accession);
+    } else {
+      putString(buffer_, mod->moniker);
+    }
+  }
+  putValue(buffer_, static_cast<unsigned int>(psm.proteinIds.size()));
+  std::vector<std::string>::const_iterator proteinId;
+  for (proteinId = psm.proteinIds.begin(); proteinId != psm.proteinIds.end(); ++proteinId) {
+    putString(buffer_, *proteinId);
+  }
+
+  if (chunks_.empty() ||
+      chunks_.back().size() + buffer_.size() > chunks_.back().capacity()) {
+    chunks_.push_back(std::vector<char>());
+    chunks_.back().reserve((std::max)(kChunkSize, buffer_.size()));
+    chunkBytes_ += chunks_.back().capacity();
+  }
+  std::vector<char>& chunk = chunks_.back();
+  Entry entry;
+  entry.scanNr = psm.scanNr;
+  entry.chunk = static_cast<unsigned int>(chunks_.size() - 1);
+  entry.offset = chunk.size();
+  chunk.insert(chunk.end(), buffer_.begin(), buffer_.end());
+  entries_.push_back(entry);
+}
+
+void PsmStore::get(size_t idx, PsmRecord& psm) const {
+  const Entry& entry = entries_[idx];
+  const char* data = &chunks_[entry.chunk][entry.offset];
+  psm.scanNr = entry.scanNr;
+  char flags;
+  takeValue(data, flags);
+  psm.isDecoy = (flags & 1) != 0;
+  psm.hasObservedTime = (flags & 2) != 0;
+  takeValue(data, psm.experimentalMass);
+  takeValue(data, psm.calculatedMass);
+  takeValue(data, psm.observedTime);
+  takeValue(data, psm.chargeState);
+  unsigned int numFeatures;
+  takeValue(data, numFeatures);
+  psm.features.resize(numFeatures);
+  if (numFeatures > 0) {
+    memcpy(&psm.features[0], data, numFeatures * sizeof(double));
+    data += numFeatures * sizeof(double);
+  }
+  takeString(data, psm.id);
+  takeString(data, psm.peptide);
+  takeString(data, psm.flankN);
+  takeString(data, psm.flankC);
+  unsigned int numModifications;
+  takeValue(data, numModifications);
+  psm.modifications.clear();
+  for (unsigned int i = 0; i < numModifications; ++i) {
+    int location;
+    char isUniMod;
+    takeValue(data, location);
+    takeValue(data, isUniMod);
+    if (isUniMod) {
+      int accession;
+      takeValue(data, accession);
+      psm.addUniMod(location, accession);
+    } else {
+      std::string moniker;
+      takeString(data, moniker);
+      psm.addFreeMod(location, moniker);
+    }
+  }
+  unsigned int numProteins;
+  takeValue(data, numProteins);
+  psm.proteinIds.resize(numProteins);
+  for (unsigned int i = 0; i < numProteins; ++i) {
+    takeString(data, psm.proteinIds[i]);
+  }
+}
+
+void PsmStore::sortByScan(bool (*less)(const Entry&, const Entry&)) {
+  std::stable_sort(entries_.begin(), entries_.end(), less);
+}
+
+void PsmStore::clear() {
+  chunks_.clear();
+  chunkBytes_ = 0;
+  std::vector<Entry>().swap(entries_);
+}
+
+// number of decimal digits of n
+static int numDigits(unsigned long long n) {
+  int digits = 1;
+  while (n >= 10) {
+    n /= 10;
+    ++digits;
+  }
+  return digits;
+}
+
+bool PsmStore::lessScanNrText(const Entry& a, const Entry& b) {
+  // pad the shorter number with zeros to the length of the longer one; if
+  // the padded numbers are equal, the shorter string is a prefix and comes
+  // first. Scan numbers have at most 10 digits, which fits after padding.
+  unsigned long long x = a.scanNr, y = b.scanNr;
+  int digitsA = numDigits(x), digitsB = numDigits(y);
+  for (int i = digitsA; i < digitsB; ++i) x *= 10;
+  for (int i = digitsB; i < digitsA; ++i) y *= 10;
+  if (x != y) return x < y;
+  return digitsA < digitsB;
+}
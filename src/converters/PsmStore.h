@@ -0,0 +1,90 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class PsmStore, an append-only store in which a
+ * FragSpectrumScanDatabase keeps its psms until they are grouped into
+ * their scans. The PsmRecords are encoded in a compact binary form into
+ * large chunks of memory, next to an index of their scan numbers.
+ */
+
+#ifndef PSMSTORE_H
+#define PSMSTORE_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "PsmRecord.h"
+
+class PsmStore {
+ public:
+  // scan number and location of an encoded record
+  struct Entry {
+    unsigned int scanNr;
+    unsigned int chunk;
+    size_t offset;
+  };
+
+  PsmStore() : chunkBytes_(0) {}
+
+  /**
+   * Encodes the psm and appends it to the last chunk, starting a new chunk
+   * if it does not fit.
+   */
+  void append(const PsmRecord& psm);
+
+  /**
+   * Decodes the record of the idx-th entry into psm, overwriting all of
+   * its fields.
+   */
+  void get(size_t idx, PsmRecord& psm) const;
+
+  /**
+   * Sorts the entries by scan number with the given order. The sort is
+   * stable, such that the psms of a scan stay in the order they were
+   * appended.
+   */
+  void sortByScan(bool (*less)(const Entry&, const Entry&));
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  const Entry& operator[](size_t idx) const { return entries_[idx]; }
+
+  // memory held by the chunks and the index
+  size_t bytes() const { return chunkBytes_ + entries_.capacity() * sizeof(Entry); }
+
+  void clear();
+
+  static bool lessScanNr(const Entry& a, const Entry& b) {
+    return a.scanNr < b.scanNr;
+  }
+
+  /**
+   * Orders the scan numbers as their decimal strings, e.g. 10 before 2,
+   * which is the key order of the LevelDB backend.
+   */
+  static bool lessScanNrText(const Entry& a, const Entry& b);
+
+ private:
+  std::deque<std::vector<char> > chunks_;
+  size_t chunkBytes_;
+  std::vector<Entry> entries_;
+  std::string buffer_; // the record being encoded
+};
+
+#endif /* PSMSTORE_H */
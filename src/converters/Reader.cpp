@@ -21,6 +21,8 @@ Reader::Reader(ParseOptions __po) : po(__po) {
   minCharge = 10000;
   initMassMap(po.monoisotopic);
   enzyme_ = Enzyme::createEnzyme(po.enzymeString);
+  featureCache_.init(freqAA, modifiedAA, po.ptmScheme, massMap_, ptmMass, enzyme_,
+                     po.calcPTMs, po.pngasef, po.calcAAFrequencies);
 }
 
 Reader::Reader() : po() {
@@ -30,6 +32,8 @@ Reader::Reader() : po() {
   minCharge = 10000;
   initMassMap(po.monoisotopic);
   enzyme_ = Enzyme::createEnzyme(po.enzymeString);
+  featureCache_.init(freqAA, modifiedAA, po.ptmScheme, massMap_, ptmMass, enzyme_,
+                     po.calcPTMs, po.pngasef, po.calcAAFrequencies);
 }
 
 
@@ -108,30 +112,16 @@ void Reader::init() {
     if (VERB > 1)
       std::cerr << "Found a meta file: " << po.targetFN <<std::endl;
     
-    std::string line;
-    std::ifstream meta(po.targetFN.data(), std::ios::in);
-    while (getline(meta, line)) {
-      if (line.size() > 0 && line[0] != '#') {
-        line.erase(std::remove(line.begin(),line.end(),' '),line.end());
-        checkValidity(line);
-        getMaxMinCharge(line,false);
-      }
-    }
-    meta.close();
+    std::vector<std::string> files;
+    readMetaFile(po.targetFN, files);
+    checkFiles(files, false);
     if (!po.iscombined) {
       // we hopefully found a meta file
       if (VERB > 1)
         std::cerr << "Found a meta file: " << po.decoyFN <<std::endl;
         
-      meta.open(po.decoyFN.data(), std::ios::in);
-      while (getline(meta, line)) {
-        if (line.size() > 0 && line[0] != '#') {
-          line.erase(std::remove(line.begin(),line.end(),' '),line.end());
-          checkValidity(line);
-          getMaxMinCharge(line,true);
-        }
-      }
-      meta.close();
+      readMetaFile(po.decoyFN, files);
+      checkFiles(files, true);
     }
   } else {
     checkValidity(po.targetFN);
@@ -143,6 +133,11 @@ void Reader::init() {
   }
   //once I have max/min charge I can put in the features
   addFeatureDescriptions(enzyme_->getEnzymeType() != Enzyme::NO_ENZYME);
+  
+  // index the retention times if the converter was invoked with -2 option
+  if (po.spectrumFN.size() > 0) {
+    readRetentionTime(po.spectrumFN);
+  }
 
   if (!po.iscombined) {
     translateFileToXML(po.targetFN, false /* is_decoy */,0,isMeta);
@@ -150,12 +145,15 @@ void Reader::init() {
   } else {
     translateFileToXML(po.targetFN, false /* is_decoy */,0,isMeta);
   }
-
-  // read retention time if the converter was invoked with -2 option
-  if (po.spectrumFN.size() > 0) {
-    readRetentionTime(po.spectrumFN);
-    databases[0]->initRTime(&scan2rt);
-    storeRetentionTime(databases[0]);
+  
+  // group the psms of each database into their fragSpectrumScans
+  for (unsigned int i = 0; i < databases.size(); i++) {
+    databases[i]->flushPsms();
+  }
+  if (VERB > 2) {
+    std::cerr << "Computed the sequence features of " << featureCache_.size()
+              << " distinct peptides for " << featureCache_.numLookups()
+              << " lookups" << std::endl;
   }
 
   xercesc::XMLPlatformUtils::Terminate();
@@ -227,13 +225,15 @@ void Reader::print(ostream &outputStream, bool xmlOutput) {
 
       serializer ser;
       std::vector<Protein*>::const_iterator it;
+      std::string sequence;
       ser.start (outputStream);
       
       // NOTE I should serialize in a Btree the object protein as the PSMs
       // FIXME the serialization is creating a gap \o between elements
       for (it = proteins.begin(); it != proteins.end(); it++) { 
+        FastaReader::foldSequence((*it)->record, sequence);
         std::auto_ptr< ::percolatorInNs::protein > p (new ::percolatorInNs::protein((*it)->name,(*it)->length,
-							  (*it)->totalMass,(*it)->sequence,(*it)->id,(*it)->isDecoy));
+							  (*it)->totalMass,sequence,(*it)->id,(*it)->isDecoy));
         ser.next(PERCOLATOR_IN_NAMESPACE, "protein", *p);
       }
       outputStream << "\n";
@@ -280,88 +280,143 @@ void Reader::print(ostream &outputStream, bool xmlOutput) {
 
     for (unsigned int i = 0; i < databases.size(); i++) {
       databases[i]->printTab(outputStream);
+      databases[i]->printTabPsms(outputStream);
       databases[i]->terminate();
     }
   }
 }
 
-void Reader::translateFileToXML(const std::string &fn, bool isDecoy, 
-                                unsigned int lineNumber_par, bool isMeta) {
-  if (!isMeta) {
-    // there must be as many databases as lines in the metafile containing the
-    // files. If this is not the case, add a new one
-    if (databases.size() == lineNumber_par) {
-	    // initialize database
-	    std::auto_ptr<serialize_scheme> database(new serialize_scheme(fn));
+void Reader::readMetaFile(const std::string &fn, std::vector<std::string> &files) {
+  files.clear();
+  std::string line;
+  std::ifstream meta(fn.data(), std::ios::in);
+  if (!meta) {
+    ostringstream temp;
+    temp << "Error : unable to open or read file " << fn << std::endl;
+    throw MyException(temp.str());
+  }
+  while (getline(meta, line)) {
+    if (line.size() > 0 && line[0] != '#') {
+      line.erase(std::remove(line.begin(),line.end(),' '),line.end());
+      files.push_back(line);
+    }
+  }
+  meta.close();
+}
 
-	    //NOTE this is actually not needed in case we compile with the boost-serialization scheme
-	    //indicate this with a flag and avoid the creating of temp files when using boost-serialization
-	    if (database->toString() != "FragSpectrumScanDatabaseBoostdb") {
-	      // create temporary directory to store the pointer to the database
-	      string tcf = "";
-	      char * tcd;
-	      string str;
+/*
+ * Exceptions cannot leave an OpenMP loop, so they are collected per file and
+ * the first one in the order of the meta file is rethrown afterwards.
+ */
+void Reader::checkFiles(const std::vector<std::string> &files, bool isDecoy) {
+  int numFiles = static_cast<int>(files.size());
+  std::vector<std::string> errors(numFiles);
+  #pragma omp parallel for schedule(dynamic, 1) if (supportsParallelRead())
+  for (int i = 0; i < numFiles; ++i) {
+    try {
+      checkValidity(files[i]);
+      getMaxMinCharge(files[i], isDecoy);
+    } catch (std::exception &e) {
+      errors[i] = e.what();
+    }
+  }
+  for (int i = 0; i < numFiles; ++i) {
+    if (!errors[i].empty()) throw MyException(errors[i]);
+  }
+}
+
+void Reader::initDatabase(const std::string &fn, unsigned int lineNumber_par) {
+  // initialize database
+  std::auto_ptr<serialize_scheme> database(new serialize_scheme(fn));
+
+  //NOTE this is actually not needed in case we compile with the boost-serialization scheme
+  //indicate this with a flag and avoid the creating of temp files when using boost-serialization
+  if (database->toString() != "FragSpectrumScanDatabaseBoostdb") {
+    // create temporary directory to store the pointer to the database
+    string tcf = "";
+    char * tcd;
+    string str;
 
 #ifndef __APPLE__
-        //TODO it would be nice to somehow avoid these declararions and therefore avoid the linking to
-	      //boost filesystem when we don't use them
-        try {
-          boost::filesystem::path ph = boost::filesystem::unique_path();
-          boost::filesystem::path dir = boost::filesystem::temp_directory_path() / ph;
-          boost::filesystem::path file("converters-tmp.tcb");
-          tcf = std::string((dir / file).string());
-          str =  dir.string();
-          tcd = new char[str.size() + 1];
-          std::copy(str.begin(), str.end(), tcd);
-          tcd[str.size()] = '\0';
-          if (boost::filesystem::is_directory(dir)) {
-            boost::filesystem::remove_all(dir);
-          }
+    //TODO it would be nice to somehow avoid these declararions and therefore avoid the linking to
+    //boost filesystem when we don't use them
+    try {
+      boost::filesystem::path ph = boost::filesystem::unique_path();
+      boost::filesystem::path dir = boost::filesystem::temp_directory_path() / ph;
+      boost::filesystem::path file("converters-tmp.tcb");
+      tcf = std::string((dir / file).string());
+      str =  dir.string();
+      tcd = new char[str.size() + 1];
+      std::copy(str.begin(), str.end(), tcd);
+      tcd[str.size()] = '\0';
+      if (boost::filesystem::is_directory(dir)) {
+        boost::filesystem::remove_all(dir);
+      }
 
-          boost::filesystem::create_directory(dir);
-        } catch (boost::filesystem::filesystem_error &e) {
-          std::cerr << e.what() << std::endl;
-        }
+      boost::filesystem::create_directory(dir);
+    } catch (boost::filesystem::filesystem_error &e) {
+      std::cerr << e.what() << std::endl;
+    }
 
-        tmpDirs.resize(lineNumber_par+1);
-        tmpDirs[lineNumber_par]=tcd;
-        std::string tmpName = tcf;
+    tmpDirs.resize(lineNumber_par+1);
+    tmpDirs[lineNumber_par]=tcd;
+    std::string tmpName = tcf;
 #else
-        std::string tmpName = std::tmpnam(NULL);
+    std::string tmpName = std::tmpnam(NULL);
 #endif
-	      tmpFNs.resize(lineNumber_par+1);
-	      tmpFNs[lineNumber_par]=tmpName;
-	      database->init(tmpFNs[lineNumber_par]);
-	    } else {
-	      database->init("");
-	    }
-	    databases.resize(lineNumber_par+1);
-	    databases[lineNumber_par]=database;
-	    assert(databases.size()==lineNumber_par+1);
+    tmpFNs.resize(lineNumber_par+1);
+    tmpFNs[lineNumber_par]=tmpName;
+    database->init(tmpFNs[lineNumber_par]);
+  } else {
+    database->init("");
+  }
+  // the retention times are joined to the psms whenever they are stored
+  if (lineNumber_par == 0 && po.spectrumFN.size() > 0) {
+    database->initRTime(&scan2rt);
+  }
+  databases.resize(lineNumber_par+1);
+  databases[lineNumber_par]=database;
+  assert(databases.size()==lineNumber_par+1);
+}
+
+void Reader::translateFileToXML(const std::string &fn, bool isDecoy, 
+                                unsigned int lineNumber_par, bool isMeta) {
+  if (!isMeta) {
+    // there must be as many databases as lines in the metafile containing the
+    // files. If this is not the case, add a new one
+    if (databases.size() == lineNumber_par) {
+      initDatabase(fn, lineNumber_par);
     }
     if (VERB>1) {
     	std::cerr << "Reading " << fn << std::endl;
     }
 
     read(fn,isDecoy,databases[lineNumber_par]);
-  } else {      
-    unsigned int lineNumber=0;
-    std::string line2;
-    std::ifstream meta(fn.data(), std::ios::in);
-    if (!meta) {
-      meta.close();
-      ostringstream temp;
-      temp << "Error : unable to open or read file " << fn << std::endl;
-      throw MyException(temp.str());
+  } else {
+    std::vector<std::string> files;
+    readMetaFile(fn, files);
+    
+    // the databases are created in the order of the meta file, such that
+    // print() outputs them in that order whichever file is read first
+    int numFiles = static_cast<int>(files.size());
+    for (int i = 0; i < numFiles; ++i) {
+      if (databases.size() == static_cast<size_t>(i)) {
+        initDatabase(files[i], i);
+      }
     }
-    while (getline(meta, line2)) {
-	    if (line2.size() > 0 && line2[0] != '#') {
-	      line2.erase(std::remove(line2.begin(),line2.end(),' '),line2.end());
-	      translateFileToXML(line2,isDecoy,lineNumber,false);
-	      lineNumber++;
-	    }
+    
+    std::vector<std::string> errors(numFiles);
+    #pragma omp parallel for schedule(dynamic, 1) if (supportsParallelRead())
+    for (int i = 0; i < numFiles; ++i) {
+      try {
+        translateFileToXML(files[i], isDecoy, i, false);
+      } catch (std::exception &e) {
+        errors[i] = e.what();
+      }
+    }
+    for (int i = 0; i < numFiles; ++i) {
+      if (!errors[i].empty()) throw MyException(errors[i]);
     }
-    meta.close();
   }
 }
 
@@ -395,198 +450,73 @@ string Reader::getRidOfUnprintables(const string &inpString) {
   return outputs;
 }
 
-void Reader::computeAAFrequencies(const string& pep,  percolatorInNs::features::feature_sequence & f_seq ) {
-  //the peptide has to include the flanks
-  assert(checkPeptideFlanks(pep));
-  // Overall amino acid composition features
-  string::size_type aaSize = freqAA.size();
-
-  std::vector< double > doubleV;
-  for (unsigned int m = 0  ; m < aaSize ; m++ )  {
-    doubleV.push_back(0.0);
-  }
-  int len = 0;
-  for (string::const_iterator it = pep.begin() + 2; it != pep.end() - 2; it++) {
-    string::size_type pos = freqAA.find(*it);
-    if (pos != string::npos) doubleV[pos]++;
-    len++;
-  }
-  assert(len>0);
-  for (unsigned int m = 0  ; m < aaSize ; m++ )  {
-    doubleV[m] /= len;
+void Reader::savePsm(unsigned int scanNr, PsmRecord& psm,
+                     boost::shared_ptr<FragSpectrumScanDatabase> database) {
+  psm.scanNr = scanNr;
+  if (po.xmlOutput) {
+    database->savePsm(psm);
+  } else {
+    database->saveTabPsm(psm);
   }
-  std::copy(doubleV.begin(), doubleV.end(), std::back_inserter(f_seq));
 }
 
 double Reader::calculatePepMAss(const std::string &pepsequence,double charge) {
-  double mass  =  0.0;
   assert(!checkPeptideFlanks(pepsequence));
-
-  for(unsigned i=0; i<pepsequence.length();i++) {
-    if (freqAA.find(pepsequence[i]) != string::npos) {
-      mass += massMap_[pepsequence[i]];
-    } else if(modifiedAA.find(pepsequence[i]) != std::string::npos) {
-      unsigned annotation = po.ptmScheme[pepsequence[i]];
-      mass += ptmMass.at(annotation);
-    } else {
-      ostringstream temp;
-      temp << "Error: estimating peptide mass, the amino acid "
-           << pepsequence[i] << " is not valid." << std::endl;
-      throw MyException(temp.str());
-    }
-  }
-
-  mass = (mass + massMap_['o'] + (charge * massMap_['h']) + 1.00727649);
-  return mass;
+  return featureCache_.peptideMass(pepsequence, charge);
 }
 
-std::string Reader::removePTMs(const string& peptide, std::map<char,int>& ptmMap) {
-  std::string peptideSequence = peptide;
-  if (checkPeptideFlanks(peptide)) {
-    peptideSequence = peptide.substr(2, peptide.size()- 4);
-  }
-  for (unsigned int ix = 0; ix < peptideSequence.size(); ++ix) {
-    if (freqAA.find(peptideSequence[ix]) == string::npos) {
-      if (peptideSequence[ix] == '[') {
-        size_t posEnd = peptideSequence.substr(ix).find_first_of(']');
-        if (posEnd == string::npos) {
-          ostringstream temp;
-	        temp << "Error : Peptide sequence " << peptide << " contains an invalid modification" << endl;
-          throw MyException(temp.str());
-        } else {
-          peptideSequence.erase(ix--, posEnd + 1);
-        }
-      } else if (ptmMap.count(peptideSequence[ix]) > 0) {
-	      peptideSequence.erase(ix--,1);
-      } else {
-        ostringstream temp;
-	      temp << "Error : Peptide sequence " << peptide << " contains modification " 
-	      << peptideSequence[ix] << " that is not specified by a \"-p\" argument" << endl;
-        throw MyException(temp.str());
-      }
-    }  
-  }
-  if (checkPeptideFlanks(peptide)) {
-    return peptide.substr(0,1) + std::string(".") + peptideSequence + std::string(".") + peptide.substr(peptide.size() - 1,1);
-  } else {
-    return peptideSequence;
-  }
-}
 
-unsigned int Reader::peptideLength(const string& pep) {
-  unsigned int len = 0;
-  assert(checkPeptideFlanks(pep));
-  for (string::size_type pos = 2; (pos + 2) < pep.size(); pos++) {
-    if (freqAA.find(pep.at(pos)) != string::npos) {
-      len++;
-    } else if (pep.at(pos) == '[') {
-      size_t posEnd = pep.substr(pos).find_first_of(']');
-      if (posEnd == string::npos) {
-        ostringstream temp;
-        temp << "Error : Peptide sequence " << pep << " contains an invalid modification" << endl;
-        throw MyException(temp.str());
-      } else {
-        pos += posEnd;
-      }
-    }
+void Reader::parseDataBase(const char* seqfile, bool isDecoy, bool isCombined, unsigned &proteins_counter) {
+  if (VERB>1)
+    std::cerr << "Reading fasta file : " << seqfile << std::endl;
+  
+  boost::shared_ptr<FastaReader> fasta(new FastaReader());
+  if (!fasta->open(seqfile)) {
+    ostringstream temp;
+    temp <<  "Error : reading combined database : " << seqfile <<  std::endl;
+    throw MyException(temp.str());
   }
-  return len;
-}
-
-unsigned int Reader::cntPTMs(const string& pep, std::map<char,int>& ptmMap) {
-  unsigned int len = 0;
-  assert(checkPeptideFlanks(pep));
-  for (string::size_type pos = 2; (pos + 2) < pep.size(); pos++) {
-    if (ptmMap.find(pep.at(pos)) != ptmMap.end()) {
-      ++len;
-    } else if (pep.at(pos) == '[') {
-      size_t posEnd = pep.substr(pos).find_first_of(']');
-      if (posEnd == string::npos) {
+  if (fasta->getPreamble() != NULL) {
+    ostringstream temp;
+    temp << "Error : parsing fasta file " << "Incorrect format next character is "
+         << *fasta->getPreamble() << std::endl;
+    throw MyException(temp.str());
+  }
+  fastaFiles_.push_back(fasta);
+  
+  // the wrapped lines of each record are folded into this buffer for the
+  // digestion; the proteins keep their record in the mapping instead
+  std::string protein_seq;
+  for (size_t i = 0; i < fasta->size(); ++i) {
+    const FastaRecord& record = (*fasta)[i];
+    FastaReader::foldSequence(record, protein_seq);
+    for (std::string::const_iterator aa = protein_seq.begin(); aa != protein_seq.end(); ++aa) {
+      if ( !((*aa >= 'A') && (*aa <= 'Z')) && (modifiedAA.find(*aa) == std::string::npos) ) {
         ostringstream temp;
-        temp << "Error : Peptide sequence " << pep << " contains an invalid modification" << endl;
+        temp << "Error : parsing fasta file " << "Incorrect fasta sequence character " << *aa << std::endl;
         throw MyException(temp.str());
-      } else {
-        ++len;
-        pos += posEnd;
       }
     }
-  }
-  return len;
-}
-
-//NOTE this should return bool and the converts to double
-double Reader::isPngasef(const string& peptide, bool isDecoy ) {
-  size_t next_pos = 0, pos;
-  while ((pos = peptide.find("N*", next_pos)) != string::npos) {
-    next_pos = pos + 1;
-    if (! isDecoy) {
-      pos += 3;
-      if (peptide[pos] == '#') {
-        pos += 1;
-      }
-    } else {
-      pos -= 2;
-      if (peptide[pos] == '#') {
-        pos -= 1;
-      }
-    }
-    if (peptide[pos] == 'T' || peptide[pos] == 'S') {
-      return 1.0;
-    }
-  }
-  return 0.0;
-}
-
-
-void Reader::parseDataBase(const char* seqfile, bool isDecoy, bool isCombined, unsigned &proteins_counter) {
-  try {
-    filebuf fb;
-    fb.open (seqfile,ios::in);
-    istream buffer(&fb);
-    if (VERB>1)
-      std::cerr << "Reading fasta file : " << seqfile << std::endl;
-    
-    if (!buffer.eof()) {
-	    wchar_t c;
-	    while (!buffer.eof()) {
-	      c = buffer.peek();
-	      if (c == '>') {
-	        std::string protein_name;
-	        std::string protein_seq;
-	        read_from_fasta(buffer,protein_name,protein_seq);
-	        //std::cerr << " Reading " << protein_name << " " << protein_seq << std::endl;
-	        if(isCombined) isDecoy = protein_name.find(po.reversedFeaturePattern,0) != std::string::npos;
-	        std::set<std::string> peptides;
-	        double totalMass = 0.0;
-	        //NOTE here I should check the enzyme and do the according digestion a switch
-	        //unsigned num_tryptic = calculateProtLengthElastase(protein_seq,peptides,totalMass);
-	        unsigned num_tryptic = calculateProtLengthTrypsin(protein_seq,peptides,totalMass);
-	        //unsigned num_tryptic = calculateProtLengthChymotrypsin(protein_seq,peptides,totalMass);
-	        //unsigned num_tryptic = calculateProtLengthThermolysin(protein_seq,peptides,totalMass);
-	        //unsigned num_tryptic = calculateProtLengthProteinasek(protein_seq,peptides,totalMass);
-	        Protein *tmp = new Protein();
-	        tmp->id = ++proteins_counter;
-	        tmp->name = protein_name;
-	        tmp->isDecoy = isDecoy;
-	        tmp->sequence = protein_seq;
-	        tmp->peptides = peptides;
-	        tmp->length = num_tryptic;
-	        tmp->totalMass = totalMass;
-	        proteins.push_back(tmp);
-        }
-      }
-    } else {
-      fb.close();
-      ostringstream temp;
-      temp <<  "Error : reading combined database : " << seqfile <<  std::endl;
-      throw MyException(temp.str());
-    }
-
-    buffer.clear();
-    fb.close();
-
-  } catch(const std::exception &e) {
-    throw MyException(std::string(e.what()));
+    std::string protein_name = record.getId();
+    //std::cerr << " Reading " << protein_name << " " << protein_seq << std::endl;
+    if(isCombined) isDecoy = protein_name.find(po.reversedFeaturePattern,0) != std::string::npos;
+    std::set<std::string> peptides;
+    double totalMass = 0.0;
+    //NOTE here I should check the enzyme and do the according digestion a switch
+    //unsigned num_tryptic = calculateProtLengthElastase(protein_seq,peptides,totalMass);
+    unsigned num_tryptic = calculateProtLengthTrypsin(protein_seq,peptides,totalMass);
+    //unsigned num_tryptic = calculateProtLengthChymotrypsin(protein_seq,peptides,totalMass);
+    //unsigned num_tryptic = calculateProtLengthThermolysin(protein_seq,peptides,totalMass);
+    //unsigned num_tryptic = calculateProtLengthProteinasek(protein_seq,peptides,totalMass);
+    Protein *tmp = new Protein();
+    tmp->id = ++proteins_counter;
+    tmp->name = protein_name;
+    tmp->isDecoy = isDecoy;
+    tmp->record = record;
+    tmp->peptides = peptides;
+    tmp->length = num_tryptic;
+    tmp->totalMass = totalMass;
+    proteins.push_back(tmp);
   }
 
   std::string type = isDecoy ?  "decoy" : "target";
@@ -659,75 +589,6 @@ void Reader::readProteins(const string &filenameTarget,const string &fileNamedec
   }
 }
 
-void Reader::read_from_fasta(istream &buffer, std::string &name , std::string &seq) {
-  std::string comment;
-  char b[BUFFER_LEN+1];
-  b[BUFFER_LEN] = '\0';
-  stringstream buf;
-  char c = buffer.peek();
-
-  while (!buffer.eof() && (c == ' ' || c == '\n')) {
-    buffer.ignore(1);
-    if (!buffer.eof()) c = buffer.peek();
-  }
-
-  if (!buffer.eof() && c != '>') {
-    stringstream ss;
-    ss << "next character is " << c;
-    ss << "Error : parsing fasta file " << "Incorrect format " << ss.str() << std::endl;
-    throw MyException(ss.str());
-  }
-
-  buffer.getline(b, BUFFER_LEN);
-  name = string(b+1);
-  name.erase(std::remove(name.begin(), name.end(), '\r'), name.end());
-
-  long int pos;
-  {
-    long int pos1 = static_cast<long int>(name.find(' '));
-    long int pos2 = static_cast<long int>(name.find('\t'));
-    if (pos1 != -1 && pos2 != -1)
-      pos = pos1 < pos2 ? pos1 : pos2;
-    else if (pos1 != -1)
-      pos = pos1;
-    else if (pos2 != -1)
-      pos = pos2;
-    else
-      pos = -1;
-  }
-
-  if (pos > 0) {
-    comment = name.substr(pos+1,name.length());
-    name = name.substr(0,pos);
-  }
-
-  string temp;
-
-  while (!buffer.eof() && (buffer.peek() != '>')) {
-    buffer >> temp;
-    for (string::iterator iter = temp.begin(); iter != temp.end(); iter++) {
-      if ( ((*iter >= 'A') && (*iter <= 'Z')) || (modifiedAA.find(*iter) != std::string::npos) ) {
-	      buf << *iter;
-      } else {
-      	ostringstream temp;
-	      temp << "Error : parsing fasta file " << "Incorrect fasta sequence character " << *iter << std::endl;
-	      throw MyException(temp.str());
-      }
-    }
-
-    c = buffer.peek();
-
-    while (!buffer.eof() && (c == ' ' || c == '\n' || c == '\r')) {
-      buffer.ignore(1);
-      if (!buffer.eof()) c = buffer.peek();
-    }
-  }
-  seq = string(buf.str());
-
-  return;
-
-}
-
 double Reader::massDiff(double observedMass, double calculatedMass, unsigned int charge) {
   return MassHandler::massDiff(observedMass, calculatedMass, charge);
 }
@@ -803,7 +664,14 @@ void Reader::initMassMap(bool useAvgMass) {
   }
 }
 
+/*
+ * Builds the scan -> retention time index. Text ms2 files are scanned for
+ * their S and I lines only, without parsing the peak lines. All other
+ * formats are read through the MSToolkit.
+ */
 void Reader::readRetentionTime(const std::string &filename) {
+  if (readMs2RetentionTime(filename) || readRampRetentionTime(filename)) return;
+  
   MSReader r;
   Spectrum s;
   r.setFilter(MS2);
@@ -824,10 +692,7 @@ void Reader::readRetentionTime(const std::string &filename) {
       scan2rt[s.getScanNumber()].push_back(s.getRTime());
     } else { // if neither EZ nor I lines are available
       delete[] cstr;
-      ostringstream temp;
-      temp << "Error : The ms2 in input file does not appear to contain retention time "
-          << "information. Please run without -2 option." << std::endl;
-      throw MyException(temp.str());
+      throwMissingRetentionTime();
     }
     // read next scan
     r.readFile(NULL, s);
@@ -835,65 +700,101 @@ void Reader::readRetentionTime(const std::string &filename) {
   delete[] cstr;
 }
 
-void Reader::storeRetentionTime(boost::shared_ptr<FragSpectrumScanDatabase> database) {
-  // for each spectra from the ms2 file
-  typedef std::map<int, vector<double> > map_t;
-  BOOST_FOREACH (map_t::value_type& i, scan2rt) {
-    // scan number
-    int scanNr = i.first;
-    // related retention times
-    vector<double>* rTimes = &(i.second);
-    if (database->getFSS(scanNr).get()!=0) {
-      fragSpectrumScan fss = *(database->getFSS(scanNr));
-      fragSpectrumScan::peptideSpectrumMatch_sequence& psmSeq = fss.peptideSpectrumMatch();
-      // retention time to be stored
-      double storeMe = 0;
-      // if rTimes only contains one element
-      if (rTimes->size()==1) {
-        // take that as retention time
-        storeMe = rTimes->at(0);
-      } else {
-        // else, take retention time of psm that has observed mass closest to
-        // theoretical mass (smallest massDiff)
-        double massDiff = (std::numeric_limits<double>::max)(); // + infinity
-        for (fragSpectrumScan::peptideSpectrumMatch_iterator psmIter_i = psmSeq.begin(); psmIter_i != psmSeq.end(); ++psmIter_i) {
-          // skip decoy
-          if (psmIter_i->isDecoy() != true) {
-            double cm = psmIter_i->calculatedMass();
-            double em = psmIter_i->experimentalMass();
-            // if a psm with observed mass closer to theoretical mass is found
-            if (abs(cm-em) < massDiff) {
-              // update massDiff
-              massDiff = abs(cm-em);
-              // get corresponding retention time
-              vector<double>::const_iterator r = rTimes->begin();
-
-              // Loop over alternatives EZ-lines, choose the one with the smallest mass difference
-              double altMassDiff = (std::numeric_limits<double>::max)();  // + infinity
-              for(; r<rTimes->end(); r=r+2) { // Loops over the EZ-line mh values (rounded to one or two decimals...)
-                double rrr = *r;  //mass+h
-                double exm = psmIter_i->experimentalMass();  //actually masstocharge
-                //FIXME: as rrr is m+h and exm is m/z, this ugly fix loops through many charges
-                double rrr_mz;
-                for(int charge = 1; charge<7; charge++) {
-                  rrr_mz = (rrr + (charge-1)*1.007276466) / charge;
-                  if(abs(rrr_mz-exm) < altMassDiff) {
-                    altMassDiff = abs(rrr_mz-exm);
-                    storeMe = *(r+1);
-                  }
-                }
-              }
-              r = rTimes->end();
-            }
-          }
-        }
-      }
-      // store retention time for all psms in fss
-      for (fragSpectrumScan::peptideSpectrumMatch_iterator psmIter = psmSeq.begin(); psmIter != psmSeq.end(); ++psmIter)
-      {
-        psmIter->observedTime().set(storeMe);
-      }
-      database->putFSS(fss);
+void Reader::throwMissingRetentionTime() {
+  ostringstream temp;
+  temp << "Error : The ms2 in input file does not appear to contain retention time "
+      << "information. Please run without -2 option." << std::endl;
+  throw MyException(temp.str());
+}
+
+/*
+ * Adds the retention times of one spectrum of an ms2 file, with the same
+ * precedence of EZ over RTime lines as the MSToolkit based reader.
+ */
+void Reader::addMs2RetentionTime(int scanNr, const std::vector<double>& ezLines, double rTime) {
+  if (!ezLines.empty()) {
+    std::vector<double>& rTimes = scan2rt[scanNr];
+    rTimes.insert(rTimes.end(), ezLines.begin(), ezLines.end());
+  } else if (rTime != 0) {
+    scan2rt[scanNr].push_back(rTime);
+  } else {
+    throwMissingRetentionTime();
+  }
+}
+
+/*
+ * Reads the retention times of an ms2 file from its scan index, which holds
+ * the RTime and EZ lines of each spectrum, rather than reading the spectra.
+ */
+bool Reader::readMs2RetentionTime(const std::string &filename) {
+  std::string extension = boost::filesystem::extension(filename);
+  if (!boost::iequals(extension, ".ms2")) return false;
+  
+  // reuses the index stored next to the file by an earlier run, if it is still up to date
+  MSScanIndex index;
+  if (!index.loadOrBuild(filename.c_str())) {
+    ostringstream temp;
+    temp << "Error : can not open file " << filename << std::endl;
+    throw MyException(temp.str());
+  }
+  
+  // a scan number of 0 ends the file for the MSToolkit reader as well
+  long long endOffset = (std::numeric_limits<long long>::max)();
+  const MSScanIndexEntry* endScan = index.find(0);
+  if (endScan != NULL) endOffset = endScan->offset;
+  
+  // the entries are sorted by scan number, spectra with the same number stay in file order
+  std::vector<double> ezLines;
+  for (unsigned int i = 0; i < index.size(); ++i) {
+    const MSScanIndexEntry& entry = index.at(i);
+    if (entry.offset >= endOffset) continue;
+    ezLines.clear();
+    for (int ez = 0; ez < entry.numEZ; ++ez) {
+      ezLines.push_back(index.getEZ(entry, ez).mh);
+      ezLines.push_back(index.getEZ(entry, ez).pRTime);
     }
+    addMs2RetentionTime(entry.scanNumber, ezLines, entry.rTime);
   }
+  return true;
+}
+
+/*
+ * Reads the retention times of the MS2 scans of an mzXML or mzData file
+ * from their scan headers, without reading or decoding their peaks.
+ */
+bool Reader::readRampRetentionTime(const std::string &filename) {
+  std::string extension = boost::filesystem::extension(filename);
+  if (!boost::iequals(extension, ".mzXML") && !boost::iequals(extension, ".mzData")) return false;
+  
+  RAMPFILE* rampFile = rampOpenFile(filename.c_str());
+  int lastScan = 0;
+  ramp_fileoffset_t* scanIndex = NULL;
+  if (rampFile != NULL) {
+    scanIndex = readIndex(rampFile, getIndexOffset(rampFile), &lastScan);
+  }
+  if (scanIndex == NULL) {
+    if (rampFile != NULL) rampCloseFile(rampFile);
+    ostringstream temp;
+    temp << "Error : can not read the scans of file " << filename << std::endl;
+    throw MyException(temp.str());
+  }
+  
+  ScanHeaderStruct header;
+  std::vector<double> noEzLines;
+  try {
+    for (int i = 1; i <= lastScan; ++i) {
+      readHeader(rampFile, scanIndex[i], &header);
+      if (header.msLevel != 2) continue;
+      // a scan number of 0 ends the file for the MSToolkit reader as well
+      if (header.acquisitionNum == 0) break;
+      addMs2RetentionTime(header.acquisitionNum, noEzLines, (float)header.retentionTime);
+    }
+  } catch (...) {
+    free(scanIndex);
+    rampCloseFile(rampFile);
+    throw;
+  }
+  free(scanIndex);
+  rampCloseFile(rampFile);
+  return true;
 }
@@ -50,6 +50,9 @@
 #include "MassHandler.h"
 #include "Spectrum.h"
 #include "Enzyme.h"
+#include "FastaReader.h"
+#include "PsmRecord.h"
+#include "PeptideFeatureCache.h"
 
 #if defined (__WIN32__) || defined (__MINGW__) 
   #include <direct.h>
@@ -86,7 +89,7 @@ class Protein {
   }
     
   std::string name;
-  std::string sequence;
+  FastaRecord record; // the record in the fasta file, which the Reader keeps mapped
   double totalMass;
   unsigned id;
   bool isDecoy;
@@ -105,6 +108,14 @@ class Reader {
   
   void translateFileToXML(const std::string &fn,bool isDecoy,
 			  unsigned int lineNumber_par,bool isMeta = false);
+  
+  /**
+   * Readers that only keep per-file state in read() and getMaxMinCharge()
+   * (apart from updating minCharge and maxCharge within a critical section)
+   * can override this to have the files of a meta file processed in
+   * parallel, each into its own database.
+   */
+  virtual bool supportsParallelRead() const { return false; }
 
   std::string getRidOfUnprintables(const std::string &inpString);
   
@@ -120,15 +131,17 @@ class Reader {
   virtual void addFeatureDescriptions(bool doEnzyme) = 0;
   
   void readRetentionTime(const std::string &filename);
-	
-  void storeRetentionTime(boost::shared_ptr<FragSpectrumScanDatabase> database);
   
   void push_backFeatureDescription(const char *str, const char *description = "", double initvalue = 0.0);
   
   std::string createPsmId(const std::string& fileId, double expMass, unsigned int scan, int charge, unsigned int rank);
   
-  void computeAAFrequencies(const string& pep,
-			    percolatorInNs::features::feature_sequence & f_seq);
+  /**
+   * Hands a psm filled in by one of the readers to the database, which
+   * keeps it as a compact record until it is stored or printed.
+   */
+  void savePsm(unsigned int scanNr, PsmRecord& psm,
+               boost::shared_ptr<FragSpectrumScanDatabase> database);
   
   double calculatePepMAss(const std::string &pepsequence,double charge = 2);
 
@@ -138,14 +151,6 @@ class Reader {
   
   virtual void print(ostream &outputStream, bool xmlOutput);
   
-  std::string removePTMs(const string& peptide, std::map<char,int>& ptmMap);
-  
-  unsigned int peptideLength(const string& pep);
-  
-  unsigned int cntPTMs(const string& pep, std::map<char,int>& ptmMap);
-  
-  double isPngasef(const string& peptide, bool isDecoy );
-  
   void readProteins(const std::string &filenameTarget, const std::string &fileNamedecoy);
   
   void parseDataBase(const char* seqfile, bool isDecoy,bool isCombined, 
@@ -154,8 +159,6 @@ class Reader {
   unsigned calculateProtLengthTrypsin(const std::string &protsequence,
 				      std::set<std::string> &peptides,double &totalMass);
   
-  void read_from_fasta(istream &buffer, std::string &name , std::string &seq); 
-  
   double massDiff(double observedMass, double calculatedMass,unsigned int charge);
   
   bool checkPeptideFlanks(const std::string &pep);
@@ -164,6 +167,14 @@ class Reader {
   
    std::vector<char*> tmpDirs;
    std::vector<std::string> tmpFNs;
+   
+   void readMetaFile(const std::string &fn, std::vector<std::string> &files);
+   void checkFiles(const std::vector<std::string> &files, bool isDecoy);
+   void initDatabase(const std::string &fn, unsigned int lineNumber_par);
+   bool readMs2RetentionTime(const std::string &filename);
+   bool readRampRetentionTime(const std::string &filename);
+   void addMs2RetentionTime(int scanNr, const std::vector<double>& ezLines, double rTime);
+   static void throwMissingRetentionTime();
 
  protected:
   
@@ -182,8 +193,10 @@ class Reader {
    int minCharge;
    ParseOptions po;
    std::map<char, double> massMap_;
+   PeptideFeatureCache featureCache_; // sequence features of the peptides seen so far
    std::map<int, vector<double> > scan2rt;
    std::vector<Protein*> proteins;
+   std::vector< boost::shared_ptr<FastaReader> > fastaFiles_; // mapped databases the proteins point into
    Enzyme* enzyme_;
 };
 
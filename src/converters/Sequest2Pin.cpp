@@ -27,6 +27,7 @@ int Sequest2Pin::run() {
   parseOptions.call = call;
   parseOptions.spectrumFN = spectrumFile;
   parseOptions.xmlOutputFN = outputFN;
+  parseOptions.xmlOutput = xmlOutput;
   reader = new SequestReader(parseOptions);
   
   reader->init();
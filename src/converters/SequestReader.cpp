@@ -113,8 +113,8 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
         bool isDecoy, unsigned useScanNumber, boost::shared_ptr<FragSpectrumScanDatabase> database,
         const std::string & fn) {
 
-  std::auto_ptr< percolatorInNs::features > features_p(new percolatorInNs::features());
-  percolatorInNs::features::feature_sequence & f_seq = features_p->feature();
+  PsmRecord psm;
+  std::vector<double> & f_seq = psm.features;
 
   if (!item.calculatedMassToCharge().present()) {
     ostringstream temp;
@@ -123,9 +123,9 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
     throw MyException(temp.str());
   }
 
-  std::string peptideSeq = peptideMap[item.peptide_ref().get()]->PeptideSequence();
-  std::string peptideId = item.peptide_ref().get();
-  std::vector< std::string > proteinIds;
+  size_t peptideIdx = lookupRef(peptideIndex, item.peptide_ref().get(), "Peptide");
+  std::string peptideSeq = peptides[peptideIdx].sequence;
+  std::vector< std::string > & proteinIds = psm.proteinIds;
   std::string __flankN = "";
   std::string __flankC = "";
 
@@ -135,22 +135,19 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
     BOOST_FOREACH (const ::mzIdentML_ns::PeptideEvidenceRefType &pepEv_ref, item.PeptideEvidenceRef())
     {
       std::string ref_id = pepEv_ref.peptideEvidence_ref().c_str();
-      ::mzIdentML_ns::PeptideEvidenceType *pepEv = peptideEvidenceMap[ref_id];
+      const MzidPeptideEvidence &pepEv = peptideEvidences[lookupRef(peptideEvidenceIndex, ref_id, "PeptideEvidence")];
       //NOTE check that there are not quimera peptides
-      if (peptideId != std::string(pepEv->peptide_ref())) {
+      if (peptideIdx != pepEv.peptide) {
 	      std::cerr << "Warning : The PSM " << boost::lexical_cast<string > (item.id())
 		        << " contains different chimeric peptide sequences. "
-		        << peptideMap[pepEv->peptide_ref()]->PeptideSequence() << " and " << peptideSeq
+		        << peptides[pepEv.peptide].sequence << " and " << peptideSeq
 		        << " only the proteins that contain the first peptide will be included in the PSM..\n" << std::endl;
       } else {
-	      __flankN = boost::lexical_cast<string > (pepEv->pre());
-	      __flankC = boost::lexical_cast<string > (pepEv->post());
+	      __flankN = pepEv.pre;
+	      __flankC = pepEv.post;
 	      if (__flankN == "?") {__flankN = "-";} //MSGF+ sometimes outputs questionmarks here
 	      if (__flankC == "?") {__flankC = "-";}
-	      std::string proteinid = boost::lexical_cast<string > (pepEv->dBSequence_ref());
-	      mzIdentML_ns::SequenceCollectionType::DBSequence_type *proteinObj = proteinMap[proteinid];
-	      std::string proteinName = boost::lexical_cast<string > (proteinObj->accession());
-	      proteinIds.push_back(proteinName);
+	      proteinIds.push_back(proteinAccessions[pepEv.protein]);
       }
     }
 
@@ -171,10 +168,10 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
     double theoretic_mass = boost::lexical_cast<double>(item.calculatedMassToCharge());
     double observed_mass = boost::lexical_cast<double>(item.experimentalMassToCharge());
     std::string peptideSeqWithFlanks = __flankN + std::string(".") + peptideSeq + std::string(".") + __flankC;
-    unsigned peptide_length = peptideLength(peptideSeqWithFlanks);
+    const PeptideFeatures& features = featureCache_.lookup(peptideSeqWithFlanks);
+    unsigned peptide_length = features.length;
     std::map<char, int> ptmMap = po.ptmScheme;
-    std::string peptideNoMods = removePTMs(peptideSeqWithFlanks, ptmMap);
-    std::string psmId = createPsmId(item.id(), observed_mass, useScanNumber, charge, rank);
+    psm.id = createPsmId(item.id(), observed_mass, useScanNumber, charge, rank);
 
     double lnrSP = 0.0;
     double deltaCN = 0.0;
@@ -209,7 +206,7 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
     f_seq.push_back(Sp);
     f_seq.push_back(ionMatched / ionTotal);
     f_seq.push_back(observed_mass);
-    f_seq.push_back(peptideLength(peptideSeqWithFlanks));
+    f_seq.push_back(peptide_length);
     f_seq.push_back(dM);
     f_seq.push_back(abs(dM));
 
@@ -217,24 +214,23 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
       f_seq.push_back(charge == c ? 1.0 : 0.0); // Charge
     }
     if (enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
-      f_seq.push_back(enzyme_->isEnzymatic(peptideNoMods.at(0), peptideNoMods.at(2)) ? 1.0 : 0.0);
-      f_seq.push_back(enzyme_->isEnzymatic(peptideNoMods.at(peptideNoMods.size() - 3), peptideNoMods.at(peptideNoMods.size() - 1)) ? 1.0 : 0.0);
-      std::string peptide2 = peptideNoMods.substr(2, peptideNoMods.size() - 4);
-      f_seq.push_back((double) enzyme_->countEnzymatic(peptide2));
+      f_seq.push_back(features.enzymaticN);
+      f_seq.push_back(features.enzymaticC);
+      f_seq.push_back(features.numEnzymatic);
     }
 
     if (po.calcPTMs) {
-      f_seq.push_back(cntPTMs(peptideSeqWithFlanks, ptmMap));
+      f_seq.push_back(features.numPtms);
     }
     if (po.pngasef) {
-      f_seq.push_back(isPngasef(peptideSeqWithFlanks, isDecoy));
+      f_seq.push_back(features.pngasef(isDecoy));
     }
     if (po.calcAAFrequencies) {
-      computeAAFrequencies(peptideSeqWithFlanks, f_seq);
+      f_seq.insert(f_seq.end(), features.aaFrequencies.begin(), features.aaFrequencies.end());
     }
 
-    percolatorInNs::occurence::flankN_type flankN = peptideSeqWithFlanks.substr(0, 1);
-    percolatorInNs::occurence::flankC_type flankC = peptideSeqWithFlanks.substr(peptideSeqWithFlanks.size() - 1, 1);
+    psm.flankN = peptideSeqWithFlanks.substr(0, 1);
+    psm.flankC = peptideSeqWithFlanks.substr(peptideSeqWithFlanks.size() - 1, 1);
 
     // Strip peptide from termini and modifications
     std::string peptideS = peptideSeq;
@@ -250,29 +246,22 @@ void SequestReader::createPSM(const ::mzIdentML_ns::SpectrumIdentificationItemTy
       }
     }
 
-    std::auto_ptr< percolatorInNs::peptideType > peptide_p(new percolatorInNs::peptideType(peptideSeq));
+    psm.peptide = peptideSeq;
     // Register the ptms
     for (unsigned int ix = 0; ix < peptideS.size(); ++ix) {
       if (freqAA.find(peptideS[ix]) == string::npos) {
         int accession = ptmMap[peptideS[ix]];
-        std::auto_ptr< percolatorInNs::uniMod > um_p (new percolatorInNs::uniMod(accession));
-        std::auto_ptr< percolatorInNs::modificationType >  mod_p( new percolatorInNs::modificationType(ix));
-        mod_p->uniMod(um_p);
-        peptide_p->modification().push_back(mod_p);      
+        psm.addUniMod(ix, accession);
         peptideS.erase(ix--,1);      
       }
     }
 
-    ::percolatorInNs::peptideSpectrumMatch* tmp_psm = new ::percolatorInNs::peptideSpectrumMatch
-            (features_p, peptide_p, psmId, isDecoy, observed_mass, theoretic_mass, charge);
-    std::auto_ptr< ::percolatorInNs::peptideSpectrumMatch > psm_p(tmp_psm);
+    psm.isDecoy = isDecoy;
+    psm.experimentalMass = observed_mass;
+    psm.calculatedMass = theoretic_mass;
+    psm.chargeState = charge;
 
-    for (std::vector< std::string >::const_iterator i = proteinIds.begin(); i != proteinIds.end(); ++i) {
-      std::auto_ptr< percolatorInNs::occurence > oc_p(new percolatorInNs::occurence(*i, flankN, flankC));
-      psm_p->occurence().push_back(oc_p);
-    }
-
-    database->savePsm(useScanNumber, psm_p);
+    savePsm(useScanNumber, psm, database);
   }
   // Try-Catch statement to find potential errors among the features.
   catch(std::exception const& e)
@@ -29,6 +29,7 @@ int Sqt2Pin::run() {
   parseOptions.call = call;
   parseOptions.spectrumFN = spectrumFile;
   parseOptions.xmlOutputFN = outputFN;
+  parseOptions.xmlOutput = xmlOutput;
   reader = new SqtReader(parseOptions);
   
   reader->init();
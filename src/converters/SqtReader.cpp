@@ -23,153 +23,183 @@ SqtReader::~SqtReader()
 
 }
 
-void SqtReader::readPSM(bool isDecoy, const std::string &in, int match,  
-			std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database) {
-  std::auto_ptr< percolatorInNs::features >  features_p( new percolatorInNs::features ());
-  unsigned int scan;
-  int charge;
-  double observedMassCharge;
-  double calculatedMassToCharge;
+/*
+ * Splits a line of the mapped file into white space separated fields
+ * without copying it, as a replacement for istringstream extraction.
+ */
+class SqtTokenizer {
+ public:
+  SqtTokenizer(const SqtLine& line) : pos_(line.begin), end_(line.end) {}
+  
+  bool next(const char*& begin, const char*& end) {
+    while (pos_ < end_ && isSpace(*pos_)) ++pos_;
+    if (pos_ == end_) return false;
+    begin = pos_;
+    while (pos_ < end_ && !isSpace(*pos_)) ++pos_;
+    end = pos_;
+    return true;
+  }
+  
+  bool skip(int numFields = 1) {
+    const char *begin, *end;
+    for (int i = 0; i < numFields; ++i) {
+      if (!next(begin, end)) return false;
+    }
+    return true;
+  }
+  
+  bool nextString(std::string& value) {
+    const char *begin, *end;
+    if (!next(begin, end)) return false;
+    value.assign(begin, end);
+    return true;
+  }
+  
+  bool nextDouble(double& value) {
+    char buffer[64];
+    if (!nextField(buffer, sizeof(buffer))) return false;
+    char* parsedEnd;
+    value = strtod(buffer, &parsedEnd);
+    return parsedEnd != buffer;
+  }
+  
+  bool nextInt(int& value) {
+    char buffer[64];
+    if (!nextField(buffer, sizeof(buffer))) return false;
+    char* parsedEnd;
+    value = static_cast<int>(strtol(buffer, &parsedEnd, 10));
+    return parsedEnd != buffer;
+  }
+  
+  bool nextUnsigned(unsigned int& value) {
+    char buffer[64];
+    if (!nextField(buffer, sizeof(buffer))) return false;
+    char* parsedEnd;
+    value = static_cast<unsigned int>(strtoul(buffer, &parsedEnd, 10));
+    return parsedEnd != buffer;
+  }
+  
+  // skips up to and including the next tab, like istream::ignore(256, '\t')
+  void ignoreField() {
+    const char* stop = pos_ + (std::min)(static_cast<ptrdiff_t>(256), end_ - pos_);
+    while (pos_ < stop && *pos_++ != '\t') {}
+  }
+  
+ private:
+  const char* pos_;
+  const char* end_;
+  
+  static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f' || c == '\n';
+  }
+  
+  // copies the next field into buffer, NUL terminated, for the strto* functions
+  bool nextField(char* buffer, size_t bufferSize) {
+    const char *begin, *end;
+    if (!next(begin, end)) return false;
+    size_t len = (std::min)(static_cast<size_t>(end - begin), bufferSize - 1);
+    memcpy(buffer, begin, len);
+    buffer[len] = '\0';
+    return true;
+  }
+};
 
-  std::istringstream instr(in), linestr;
-  std::ostringstream idbuild;
-  std::string line, tmp;
+void SqtReader::readPSM(bool isDecoy, const SqtSpectrum &spectrum, int match,  
+			const std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database) {
+  PsmRecord psm;
+  unsigned int scan = spectrum.scan;
+  int charge = spectrum.charge;
+  double observedMassCharge = spectrum.observedMassCharge;
+  double nSM = spectrum.nSM;
+  double otherXcorr = spectrum.otherXcorr, lastXcorr = spectrum.lastXcorr;
+  double calculatedMassToCharge, xcorr;
 
-  double deltCn, tmpdbl, otherXcorr = 0.0, xcorr = 0.0, lastXcorr = 0.0, nSM = 0.0, tstSM = 0.0;
-  bool gotL = true;
-  int ms = 0;
-  std::string peptide, peptideNoMods;
-  percolatorInNs::features::feature_sequence & f_seq =  features_p->feature();
-  std::string protein;
-  std::vector< std::string > proteinIds;
+  std::string peptide;
+  std::vector<double> & f_seq = psm.features;
+  std::vector< std::string > & proteinIds = psm.proteinIds;
   std::map<char,int> ptmMap = po.ptmScheme; 
 
-  while (getline(instr, line)) {
-    if (line[0] == 'S') {
-      linestr.clear();
-      linestr.str(line);
-      if (!(linestr >> tmp >> tmpdbl >> scan >> charge >> tmpdbl)) {
-	      ostringstream temp;
-        temp << "Error : can not parse the S line: " << line << endl;
-	      throw MyException(temp.str());
-      }
-      // Computer name might not be set, just skip this part of the line
-      linestr.ignore(256, '\t');
-      linestr.ignore(256, '\t');
-      // First assume a MacDonald et al definition of S (9 fields)
-      if (!(linestr >> observedMassCharge >> tmpdbl >> tmpdbl >> nSM)) {
-      	ostringstream temp;
-        temp << "Error : can not parse the S line: " << line << endl;
-	      throw MyException(temp.str());
-      }
-      // Check if the Yate's lab definition (10 fields) is valid
-      // http://fields.scripps.edu/sequest/SQTFormat.html
-      //
-      if (linestr >> tstSM) {
-        nSM = tstSM;
-      }
-    }
-    if (line[0] == 'M') {
-      linestr.clear();
-      linestr.str(line);
-
-      if (ms == 1) {
-        linestr >> tmp >> tmp >> tmp >> tmp >> deltCn >> otherXcorr;
-        lastXcorr = otherXcorr;
-      } else {
-        linestr >> tmp >> tmp >> tmp >> tmp >> tmp >> lastXcorr;
-      }
-      if (match == ms) {
-        double rSp, sp, matched, expected;
-        linestr.seekg(0, ios::beg);
-        if (!(linestr >> tmp >> tmp >> rSp >> calculatedMassToCharge >> tmp >> 
-                         xcorr >> sp >> matched >> expected >> peptide)) {
-	        ostringstream temp;
-	        temp << "Error : can not parse the M line: " << line << endl;
-	        throw MyException(temp.str());
-        }
-        
-        peptideNoMods = removePTMs(peptide, ptmMap);
-        // difference between observed and calculated mass
-        double dM = massDiff(observedMassCharge, calculatedMassToCharge,charge);
-	
-        f_seq.push_back( log(max(1.0, rSp))); // rank by Sp
-        f_seq.push_back( 0.0 ); // delt5Cn (leave until last M line)
-        f_seq.push_back( 0.0 ); // deltCn (leave until next M line)
-        f_seq.push_back( xcorr ); // Xcorr
-        f_seq.push_back( sp ); // Sp
-        f_seq.push_back( matched / expected ); // Fraction matched/expected ions
-        f_seq.push_back( observedMassCharge ); // Observed mass
-        f_seq.push_back(peptideLength(peptide)); // Peptide length
-        for (int c = minCharge; c <= maxCharge; c++)
-          f_seq.push_back( charge == c ? 1.0 : 0.0); // Charge
+  const SqtLine& mLine = spectrum.mLines[match];
+  SqtTokenizer linestr(mLine);
+  double rSp, sp, matched, expected;
+  if (!(linestr.skip(2) && linestr.nextDouble(rSp) && linestr.nextDouble(calculatedMassToCharge) &&
+        linestr.skip() && linestr.nextDouble(xcorr) && linestr.nextDouble(sp) &&
+        linestr.nextDouble(matched) && linestr.nextDouble(expected) && linestr.nextString(peptide))) {
+    ostringstream temp;
+    temp << "Error : can not parse the M line: " << std::string(mLine.begin, mLine.end) << endl;
+    throw MyException(temp.str());
+  }
+  
+  const PeptideFeatures& features = featureCache_.lookup(peptide);
+  const std::string& peptideNoMods = features.peptideNoMods;
+  // difference between observed and calculated mass
+  double dM = massDiff(observedMassCharge, calculatedMassToCharge,charge);
 
-        if (enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
-          f_seq.push_back( enzyme_->isEnzymatic(peptideNoMods.at(0),peptideNoMods.at(2)) ? 1.0 : 0.0);
-          f_seq.push_back( enzyme_->isEnzymatic(peptideNoMods.at(peptideNoMods.size() - 3),peptideNoMods.at(peptideNoMods.size() - 1)) ? 1.0 : 0.0);
-          std::string peptide2 = peptideNoMods.substr(2, peptideNoMods.length() - 4);
-          f_seq.push_back( (double)enzyme_->countEnzymatic(peptide2) );
-        }
-        
-        f_seq.push_back( log(max(1.0, nSM)));
-        f_seq.push_back( dM ); // obs - calc mass
-        f_seq.push_back( abs(dM) ); // abs only defined for integers on some systems
-        
-        if (po.calcPTMs) {
-	        f_seq.push_back(cntPTMs(peptide, ptmMap));
-	      }
-	      if (po.pngasef) {
-	        f_seq.push_back(isPngasef(peptide, isDecoy));
-	      }
-        if (po.calcAAFrequencies) {
-          computeAAFrequencies(peptideNoMods, f_seq);
-        }
-        gotL = false;
-      }
-      ms++;
-    }
-    assert(line.size() != 0 );
+  f_seq.push_back( log(max(1.0, rSp))); // rank by Sp
+  f_seq.push_back( 0.0 ); // delt5Cn (set below from the last M line)
+  f_seq.push_back( 0.0 ); // deltCn (set below from the second M line)
+  f_seq.push_back( xcorr ); // Xcorr
+  f_seq.push_back( sp ); // Sp
+  f_seq.push_back( matched / expected ); // Fraction matched/expected ions
+  f_seq.push_back( observedMassCharge ); // Observed mass
+  f_seq.push_back(features.length); // Peptide length
+  for (int c = minCharge; c <= maxCharge; c++)
+    f_seq.push_back( charge == c ? 1.0 : 0.0); // Charge
 
-    if (line.at(0) == 'L' && !gotL) 
-    {
-      if (instr.peek() != 'L') gotL = true;
-      
-      line = line.substr(0, 2) + getRidOfUnprintables(line.substr(2));
-      linestr.clear();
-      linestr.str(line);
-      linestr >> tmp >> protein;
-      
+  if (enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
+    f_seq.push_back( features.enzymaticN );
+    f_seq.push_back( features.enzymaticC );
+    f_seq.push_back( features.numEnzymatic );
+  }
+  
+  f_seq.push_back( log(max(1.0, nSM)));
+  f_seq.push_back( dM ); // obs - calc mass
+  f_seq.push_back( abs(dM) ); // abs only defined for integers on some systems
+  
+  if (po.calcPTMs) {
+    f_seq.push_back(features.numPtms);
+  }
+  if (po.pngasef) {
+    f_seq.push_back(features.pngasef(isDecoy));
+  }
+  if (po.calcAAFrequencies) {
+    // the frequencies are taken over the unmodified sequence for sqt files
+    f_seq.insert(f_seq.end(), features.aaFrequenciesNoMods.begin(), features.aaFrequenciesNoMods.end());
+  }
+  
+  // the L lines following the M line hold the proteins
+  for (size_t l = spectrum.lStart[match]; l < spectrum.lStart[match + 1]; ++l) {
+    const SqtLine& lLine = spectrum.lLines[l];
+    const char* begin = lLine.begin + (std::min)(static_cast<ptrdiff_t>(2), lLine.end - lLine.begin);
+    std::string rest = getRidOfUnprintables(std::string(begin, lLine.end));
+    SqtLine restLine = { rest.data(), rest.data() + rest.size() };
+    std::string protein;
+    if (SqtTokenizer(restLine).nextString(protein)) {
       proteinIds.push_back(protein);
-      
     }
   }
   f_seq[1] = (xcorr - lastXcorr) / (std::max)(1.0,xcorr); // delt5Cn
   f_seq[2] = (xcorr - otherXcorr) / (std::max)(1.0,xcorr); // deltCn
   
-  percolatorInNs::occurence::flankN_type flankN = peptide.substr(0,1);
-  percolatorInNs::occurence::flankC_type flankC = peptide.substr(peptide.size() - 1,1);
+  psm.flankN = peptide.substr(0,1);
+  psm.flankC = peptide.substr(peptide.size() - 1,1);
   
   // Strip peptide from termini and modifications 
   std::string peptideSequence = peptide.substr(2, peptide.size()- 4);
-  std::string peptideSeqNoMods = peptideNoMods.substr(2, peptideNoMods.size()- 4);
-  std::auto_ptr< percolatorInNs::peptideType > peptide_p( new percolatorInNs::peptideType(peptideSeqNoMods) );
+  psm.peptide = peptideNoMods.substr(2, peptideNoMods.size()- 4);
   // Register the ptms
   for (unsigned int ix = 0;ix < peptideSequence.size();++ix) {
     if (freqAA.find(peptideSequence[ix]) == string::npos) {
-      std::auto_ptr< percolatorInNs::modificationType >  mod_p( new percolatorInNs::modificationType(ix));
       if (peptideSequence[ix] == '[') {
         unsigned int posEnd = peptideSequence.substr(ix).find_first_of(']');
         std::string modAcc = peptideSequence.substr(ix + 1, posEnd - 1);
-        std::auto_ptr< percolatorInNs::freeMod > fm_p (new percolatorInNs::freeMod(modAcc));
-        mod_p->freeMod(fm_p);
+        psm.addFreeMod(ix, modAcc);
         peptideSequence.erase(ix--, posEnd + 1);
       } else {
         int accession = ptmMap[peptideSequence[ix]];
-        std::auto_ptr< percolatorInNs::uniMod > um_p (new percolatorInNs::uniMod(accession));
-        mod_p->uniMod(um_p);  
+        psm.addUniMod(ix, accession);
         peptideSequence.erase(ix--,1);
       }
-      peptide_p->modification().push_back(mod_p);    
     }  
   }
   
@@ -185,68 +215,76 @@ void SqtReader::readPSM(bool isDecoy, const std::string &in, int match,
   }
   
   unsigned int rank = match + 1;
-  std::string psmId = createPsmId(fileId, observedMassCharge, scan, charge, rank);
+  psm.id = createPsmId(fileId, observedMassCharge, scan, charge, rank);
+  psm.isDecoy = isDecoy;
+  psm.experimentalMass = observedMassCharge;
+  psm.calculatedMass = calculatedMassToCharge;
+  psm.chargeState = charge;
   
-  std::auto_ptr< percolatorInNs::peptideSpectrumMatch > psm_p(
-      new percolatorInNs::peptideSpectrumMatch(features_p, peptide_p, psmId, 
-          isDecoy, observedMassCharge, calculatedMassToCharge, charge));
+  savePsm(scan, psm, database);
+}
 
-  for ( std::vector< std::string >::const_iterator i = proteinIds.begin(); i != proteinIds.end(); ++i ) {
-    std::auto_ptr< percolatorInNs::occurence >  oc_p( new percolatorInNs::occurence (*i,flankN, flankC)  );
-    psm_p->occurence().push_back(oc_p);
-  }
-  
-  database->savePsm(scan, psm_p);
+/* returns the end of the line starting at pos, excluding the line break */
+static const char* sqtLineEnd(const char* pos, const char* end) {
+  const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+  return lineEnd == NULL ? end : lineEnd;
 }
 
 void SqtReader::getMaxMinCharge(const std::string &fn, bool isDecoy)
 {
   int charge = 0;
-  std::string line;
-  std::istringstream lineParse;
-  std::ifstream sqtIn;
+  int fileMinCharge = 10000, fileMaxCharge = -1;
   unsigned int scanExtra;
-  std::string tmp;
+  double tmpdbl;
   
-  sqtIn.open(fn.c_str(), std::ios::in);
-  if (!sqtIn) 
+  MappedFile sqtIn;
+  if (!sqtIn.open(fn)) 
   {
     ostringstream temp;
     temp << "Error : can not open file " << fn << std::endl;
     throw MyException(temp.str());
   }
 
-  while (getline(sqtIn, line)) 
+  const char* end = sqtIn.end();
+  for (const char* pos = sqtIn.data(); pos < end; ) 
   {
-    if (line[0] == 'S' && sqtIn.peek() != 'S') 
+    const char* lineEnd = sqtLineEnd(pos, end);
+    const char* next = (lineEnd < end) ? lineEnd + 1 : end;
+    if (*pos == 'S' && (next == end || *next != 'S')) 
     {
-      lineParse.clear();
-      lineParse.str(line);
-      lineParse >> tmp >> tmp >> scanExtra >> charge;
-      minCharge = (std::min)(minCharge,charge);
-      maxCharge = (std::max)(maxCharge,charge);
+      SqtLine line = { pos, lineEnd };
+      SqtTokenizer lineParse(line);
+      if (lineParse.skip() && lineParse.nextDouble(tmpdbl) && 
+          lineParse.nextUnsigned(scanExtra) && lineParse.nextInt(charge)) {
+        fileMinCharge = (std::min)(fileMinCharge,charge);
+        fileMaxCharge = (std::max)(fileMaxCharge,charge);
+      }
     }
-     
+    pos = next;
   }
   sqtIn.close();
+  // the files of a meta file are scanned in parallel
+  #pragma omp critical (sqt_charge)
+  {
+    minCharge = (std::min)(minCharge,fileMinCharge);
+    maxCharge = (std::max)(maxCharge,fileMaxCharge);
+  }
 }
 
-
+/*
+ * The file is memory mapped and split into S blocks without copying any
+ * line; only the M lines of the selected matches are tokenized later on.
+ */
 void SqtReader::read(const std::string &fn, bool isDecoy, 
     boost::shared_ptr<FragSpectrumScanDatabase> database) {
-  std::string ptmAlphabet;
   std::string fileId;
-  int ms = 0;
-  std::string line, tmp, prot;
-  std::ifstream sqtIn;
-  sqtIn.open(fn.c_str(), std::ios::in);
-  if (!sqtIn) {
+  MappedFile sqtIn;
+  if (!sqtIn.open(fn)) {
     ostringstream temp;
     temp << "Error : can not open file " << fn << std::endl;
     throw MyException(temp.str());
   }
 
-  std::string seq;
   fileId = fn;
   size_t spos = fileId.rfind('/');
   if (spos != std::string::npos) {
@@ -256,48 +294,95 @@ void SqtReader::read(const std::string &fn, bool isDecoy,
   if (spos != std::string::npos) {
     fileId.erase(spos);
   }
-  std::ostringstream buff;
-  int lines = 0;
+  
+  const std::string& pattern = po.reversedFeaturePattern;
+  bool checkPattern = po.iscombined && isDecoy && pattern != "";
+  SqtSpectrum spectrum;
+  bool inSpectrum = false;
   std::set<int> theMs;
 
-  while (getline(sqtIn, line)) {
-    if (line[0] == 'S') {
-      if (lines > 1) {
-        readSectionS( buff.str(), theMs, isDecoy, fileId, database);
+  const char* end = sqtIn.end();
+  for (const char* pos = sqtIn.data(); pos < end; ) {
+    const char* lineEnd = sqtLineEnd(pos, end);
+    SqtLine line = { pos, lineEnd };
+    if (*pos == 'S') {
+      if (inSpectrum) {
+        readSectionS(spectrum, theMs, isDecoy, fileId, database);
       }
-      buff.str("");
-      buff.clear();
-      lines = 1;
-      buff << line << std::endl;
-      ms = 0;
+      spectrum.clear();
+      spectrum.sLine = line;
+      inSpectrum = true;
       theMs.clear();
-    }
-    if (line[0] == 'M') {
-      ++ms;
-      ++lines;
-      buff << line << std::endl;
-    }
-    if (line[0] == 'L') {
-      ++lines;
-      buff << line << std::endl;
+    } else if (*pos == 'M' && inSpectrum) {
+      spectrum.mLines.push_back(line);
+      spectrum.lStart.push_back(spectrum.lLines.size());
+    } else if (*pos == 'L' && !spectrum.mLines.empty()) {
+      spectrum.lLines.push_back(line);
       if ((int)theMs.size() < po.hitsPerSpectrum && 
-           ( !po.iscombined || !isDecoy || ( po.reversedFeaturePattern == "" || 
-           ((line.find(po.reversedFeaturePattern, 0) != std::string::npos))))) {
-	      theMs.insert(ms - 1);
+           (!checkPattern || std::search(line.begin, line.end, pattern.begin(), 
+                                         pattern.end()) != line.end)) {
+	      theMs.insert(static_cast<int>(spectrum.mLines.size()) - 1);
       }
     }
+    pos = (lineEnd < end) ? lineEnd + 1 : end;
   }
-  if (lines > 1) {
-    readSectionS(buff.str(), theMs, isDecoy, fileId, database);
+  if (inSpectrum) {
+    readSectionS(spectrum, theMs, isDecoy, fileId, database);
   }
   sqtIn.close();
 }
 
-void SqtReader::readSectionS(const std::string &record, std::set<int>& theMs, bool isDecoy,
-			       std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database) {
+/*
+ * Parses the S line and the xcorr values shared by all matches of the
+ * spectrum once, after which the selected matches are turned into psms.
+ */
+void SqtReader::readSectionS(SqtSpectrum &spectrum, const std::set<int>& theMs, bool isDecoy,
+			       const std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database) {
+  if (theMs.empty()) return;
+  
+  double tmpdbl, tstSM;
+  SqtTokenizer linestr(spectrum.sLine);
+  if (!(linestr.skip() && linestr.nextDouble(tmpdbl) && linestr.nextUnsigned(spectrum.scan) &&
+        linestr.nextInt(spectrum.charge) && linestr.nextDouble(tmpdbl))) {
+    ostringstream temp;
+    temp << "Error : can not parse the S line: " 
+         << std::string(spectrum.sLine.begin, spectrum.sLine.end) << endl;
+    throw MyException(temp.str());
+  }
+  // Computer name might not be set, just skip this part of the line
+  linestr.ignoreField();
+  linestr.ignoreField();
+  // First assume a MacDonald et al definition of S (9 fields)
+  if (!(linestr.nextDouble(spectrum.observedMassCharge) && linestr.nextDouble(tmpdbl) && 
+        linestr.nextDouble(tmpdbl) && linestr.nextDouble(spectrum.nSM))) {
+    ostringstream temp;
+    temp << "Error : can not parse the S line: " 
+         << std::string(spectrum.sLine.begin, spectrum.sLine.end) << endl;
+    throw MyException(temp.str());
+  }
+  // Check if the Yate's lab definition (10 fields) is valid
+  // http://fields.scripps.edu/sequest/SQTFormat.html
+  //
+  if (linestr.nextDouble(tstSM)) {
+    spectrum.nSM = tstSM;
+  }
+  
+  // xcorr of the second and of the last M line, for deltCn and delt5Cn
+  spectrum.otherXcorr = 0.0;
+  spectrum.lastXcorr = 0.0;
+  for (size_t ms = 0; ms < spectrum.mLines.size(); ++ms) {
+    SqtTokenizer mLine(spectrum.mLines[ms]);
+    double xcorr;
+    if (mLine.skip(5) && mLine.nextDouble(xcorr)) {
+      spectrum.lastXcorr = xcorr;
+      if (ms == 1) spectrum.otherXcorr = xcorr;
+    }
+  }
+  spectrum.lStart.push_back(spectrum.lLines.size());
+  
   std::set<int>::const_iterator it;
   for (it = theMs.begin(); it != theMs.end(); it++) {
-    readPSM(isDecoy, record, *it, fileId, database);
+    readPSM(isDecoy, spectrum, *it, fileId, database);
   }
   return;
 }
@@ -19,7 +19,38 @@
 #define SQTREADER_H
 
 #include "Reader.h"
+#include "MappedFile.h"
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+/* a line of a memory mapped sqt file, without its line break */
+struct SqtLine {
+  const char* begin;
+  const char* end;
+};
+
+/*
+ * The lines of one S block: the S line, its M lines and the L lines that
+ * follow each M line, together with the values shared by all its psms.
+ */
+struct SqtSpectrum {
+  SqtLine sLine;
+  std::vector<SqtLine> mLines;
+  std::vector<SqtLine> lLines;
+  std::vector<size_t> lStart; // index of the first L line of each M line
+  
+  unsigned int scan;
+  int charge;
+  double observedMassCharge, nSM;
+  double otherXcorr, lastXcorr; // xcorr of the second and of the last match
+  
+  void clear() {
+    mLines.clear();
+    lLines.clear();
+    lStart.clear();
+  }
+};
 
 class SqtReader: public Reader {
 
@@ -32,11 +63,11 @@ class SqtReader: public Reader {
   void read(const std::string &fn, bool isDecoy,
 		    boost::shared_ptr<FragSpectrumScanDatabase> database);
 
-  void readSectionS(const std::string &record,std::set<int> &theMs, bool isDecoy,
-	            std::string& fileId,boost::shared_ptr<FragSpectrumScanDatabase> database);
+  void readSectionS(SqtSpectrum &spectrum, const std::set<int> &theMs, bool isDecoy,
+	            const std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database);
 
-  void readPSM(bool isDecoy, const std::string &in, int match, 
-	       std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database);
+  void readPSM(bool isDecoy, const SqtSpectrum &spectrum, int match, 
+	       const std::string& fileId, boost::shared_ptr<FragSpectrumScanDatabase> database);
   
   bool checkValidity(const std::string &file);
   
@@ -46,6 +77,8 @@ class SqtReader: public Reader {
   
   void addFeatureDescriptions(bool doEnzyme);
   
+  bool supportsParallelRead() const { return true; }
+  
  protected:
   static const std::map<string,double> sqtFeaturesDefaultValue;
 };
@@ -26,6 +26,7 @@ int Tandem2Pin::run() {
   parseOptions.call = call;
   parseOptions.spectrumFN = spectrumFile;
   parseOptions.xmlOutputFN = outputFN;
+  parseOptions.xmlOutput = xmlOutput;
   reader = new TandemReader(parseOptions);
   
   reader->init();
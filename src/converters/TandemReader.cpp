@@ -22,6 +22,7 @@ const std::map<string,double> TandemReader::tandemFeaturesDefaultValue =
 static const XMLCh groupStr[] = { chLatin_g, chLatin_r, chLatin_o, chLatin_u, chLatin_p, chNull};
 static const XMLCh groupTypeStr[] = { chLatin_t, chLatin_y, chLatin_p, chLatin_e, chNull};
 static const XMLCh groupModelStr[] = { chLatin_m, chLatin_o, chLatin_d, chLatin_e, chLatin_l, chNull};
+static const XMLCh chargeStr[] = { chLatin_z, chNull};
 static const std::string schemaDefinition = Globals::getInstance()->getXMLDir(true)+TANDEM_SCHEMA_LOCATION + string("tandem2011.12.01.1.xsd");
 static const std::string scheme_namespace = TANDEM_NAMESPACE;
 static const std::string schema_major = boost::lexical_cast<string>(TANDEM_VERSION);
@@ -210,22 +211,23 @@ void TandemReader::getMaxMinCharge(const std::string &fn, bool isDecoy){
   parser p;
   
   try {
-    bool validateSchema = true;
     xml_schema::dom::auto_ptr< xercesc::DOMDocument> 
-    doc (p.start (ifs, fn.c_str(), validateSchema, schemaDefinition, schema_major, schema_minor, scheme_namespace,true));
+    doc (p.start (ifs, fn.c_str(), po.validateSchema, schemaDefinition, schema_major, schema_minor, scheme_namespace,true));
     assert(doc.get());
     
     for (doc = p.next(); doc.get() != 0; doc = p.next ()) {  
       //Check that the tag name is group and that its not the inputput parameters
       if (XMLString::equals(groupStr,doc->getDocumentElement()->getTagName()) 
         	&& XMLString::equals(groupModelStr,doc->getDocumentElement()->getAttribute(groupTypeStr))) {
-	      tandem_ns::group groupObj(*doc->getDocumentElement()); //Parse to the codesynthesis object model
-	      
 	      //We are sure we are not in parameters group so z(the charge) has to be present.
-	      if (groupObj.z().present()) {
+	      //It is read from the DOM, the object model is only needed for the first psm.
+	      const XMLCh* z = doc->getDocumentElement()->getAttribute(chargeStr);
+	      if (XMLString::stringLen(z) > 0) {
+	        char* zStr = XMLString::transcode(z);
 	        stringstream chargeStream (stringstream::in | stringstream::out);
-	        chargeStream << groupObj.z();
+	        chargeStream << zStr;
 	        chargeStream >> charge;
+	        XMLString::release(&zStr);
 	        if (minCharge > charge) minCharge = charge;
 	        if (maxCharge < charge) maxCharge = charge;
 	        nTot++;
@@ -235,6 +237,7 @@ void TandemReader::getMaxMinCharge(const std::string &fn, bool isDecoy){
 	        throw MyException(temp.str());
 	      }
 	      if (firstPSM) {
+	        tandem_ns::group groupObj(*doc->getDocumentElement()); //Parse to the codesynthesis object model
 	        //Check what type of scores/ions are present
 	        BOOST_FOREACH (const tandem_ns::protein &protObj, groupObj.protein()) { //Protein
 	          tandem_ns::protein::peptide_type peptideObj=protObj.peptide(); //Peptide
@@ -364,8 +367,8 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
     const peptideProteinMapType &peptideProteinMap,const string &psmId, 
     int spectraId) {
   std::map<char,int> ptmMap = po.ptmScheme;
-  std::auto_ptr< percolatorInNs::features >  features_p( new percolatorInNs::features ());
-  percolatorInNs::features::feature_sequence & f_seq =  features_p->feature();
+  PsmRecord psm;
+  std::vector<double> & f_seq = psm.features;
   //double expect_value = boost::lexical_cast<double>(domain.expect());
   double calculated_mass = boost::lexical_cast<double>(domain.mh());
   double mass_diff = boost::lexical_cast<double>(domain.delta());
@@ -376,7 +379,7 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
   
   std::set<std::string> proteinOccuranceSet = peptideProteinMap.at(peptide);
   assert(proteinOccuranceSet.size() > 0);
-  std::vector<std::string> proteinOccurences;
+  std::vector<std::string> & proteinOccurences = psm.proteinIds;
   set<std::string>::iterator posIt;
   if (po.iscombined) isDecoy = true; // Adjust isDecoy if combined file
   for (posIt = proteinOccuranceSet.begin(); posIt != proteinOccuranceSet.end(); ++posIt) {
@@ -437,16 +440,13 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
     }  
   }
 
-  std::auto_ptr< percolatorInNs::peptideType > peptide_p( new percolatorInNs::peptideType(peptide) );
+  psm.peptide = peptide;
   
   // Register the ptms (modifications)
   for(unsigned int ix=0;ix<peptideS.size();++ix) {
     if (freqAA.find(peptideS[ix]) == string::npos) {
       int accession = ptmMap[peptideS[ix]];
-      std::auto_ptr< percolatorInNs::uniMod > um_p(new percolatorInNs::uniMod(accession));
-      std::auto_ptr< percolatorInNs::modificationType > mod_p( new percolatorInNs::modificationType(ix));
-      mod_p->uniMod(um_p);
-      peptide_p->modification().push_back(mod_p);      
+      psm.addUniMod(ix, accession);
       peptideS.erase(ix--,1);
     }  
   }
@@ -467,11 +467,8 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
       }
       int relativeModPos = modPos - peptideInProtStartPos + 1;
       // aaObj.type(); // gives the amino acid that was modified. Redundant information as we have the position already, could be used for assertion
-      std::auto_ptr< percolatorInNs::modificationType >  mod_p( new percolatorInNs::modificationType(relativeModPos));
       std::string mod_acc = aaObj.modified(); // modification mass
-      std::auto_ptr< percolatorInNs::freeMod > fm_p (new percolatorInNs::freeMod(mod_acc));
-      mod_p->freeMod(fm_p);
-      peptide_p->modification().push_back(mod_p);
+      psm.addFreeMod(relativeModPos, mod_acc);
     }
   }
 
@@ -490,7 +487,8 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
   f_seq.push_back(mass_diff);
   f_seq.push_back(abs(mass_diff));
   //peptide length
-  f_seq.push_back(peptideLength(fullpeptide));
+  const PeptideFeatures& features = featureCache_.lookup(fullpeptide);
+  f_seq.push_back(features.length);
 
   //Charge
   for (int c = minCharge; c <= maxCharge; c++) {
@@ -499,7 +497,8 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
 
   //Enzyme
   if (enzyme_->getEnzymeType() != Enzyme::NO_ENZYME) {
-    std::string peptideNoMods = removePTMs(peptide, ptmMap);
+    // the modifications were already removed from peptide above
+    const std::string& peptideNoMods = peptide;
     f_seq.push_back(enzyme_->isEnzymatic(peptideNoMods.at(0),peptideNoMods.at(2)) ? 1.0 : 0.0);
     f_seq.push_back(enzyme_->isEnzymatic(peptideNoMods.at(peptideNoMods.size() - 3),peptideNoMods.at(peptideNoMods.size() - 1)) ? 1.0 : 0.0);
     std::string peptide2 = peptideNoMods.substr(2, peptideNoMods.length() - 4);
@@ -508,29 +507,27 @@ void TandemReader::createPSM(const tandem_ns::peptide::domain_type &domain,
 
   //PTM
   if (po.calcPTMs) {
-    f_seq.push_back(cntPTMs(fullpeptide, ptmMap));
+    f_seq.push_back(features.numPtms);
   }
   //PNGA
   if (po.pngasef) {
-    f_seq.push_back(isPngasef(fullpeptide,isDecoy));
+    f_seq.push_back(features.pngasef(isDecoy));
   }
   //AA FREQ
   if (po.calcAAFrequencies) {
-    computeAAFrequencies(fullpeptide, f_seq);
+    f_seq.insert(f_seq.end(), features.aaFrequencies.begin(), features.aaFrequencies.end());
   }  
     
   //Save the psm
-  std::auto_ptr< percolatorInNs::peptideSpectrumMatch > psm_p(
-      new percolatorInNs::peptideSpectrumMatch(features_p, peptide_p, psmId, 
-      isDecoy, parentIonMass, calculated_mass, charge));
+  psm.id = psmId;
+  psm.isDecoy = isDecoy;
+  psm.experimentalMass = parentIonMass;
+  psm.calculatedMass = calculated_mass;
+  psm.chargeState = charge;
+  psm.flankN = flankN;
+  psm.flankC = flankC;
   
-  std::vector<std::string>::const_iterator poIt;
-  for (poIt = proteinOccurences.begin(); poIt != proteinOccurences.end(); ++poIt) {
-    std::auto_ptr< percolatorInNs::occurence > oc_p(new percolatorInNs::occurence(*poIt, flankN, flankC));
-    psm_p->occurence().push_back(oc_p);
-  }
-  
-  database->savePsm(spectraId, psm_p);
+  savePsm(spectraId, psm, database);
 }
 
 void TandemReader::read(const std::string &fn, bool isDecoy,
@@ -549,7 +546,7 @@ void TandemReader::read(const std::string &fn, bool isDecoy,
   //Sending defaultNameSpace as the bool for validation since if its not fixed 
   //the namespace has to be added later and then we cant validate the schema and xml file.
   xml_schema::dom::auto_ptr< xercesc::DOMDocument> doc(p.start(ifs, 
-      fn.c_str(), true, schemaDefinition, schema_major, schema_minor, 
+      fn.c_str(), po.validateSchema, schemaDefinition, schema_major, schema_minor, 
       scheme_namespace, true));
   assert(doc.get());   
   
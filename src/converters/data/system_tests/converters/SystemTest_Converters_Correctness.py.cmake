@@ -9,6 +9,7 @@ import csv
 pathToBinaries = "@pathToBinaries@"
 pathToData = "@pathToData@"
 pathToOutputData = "@pathToOutputData@"
+pathToReferenceBinaries = "@pathToReferenceBinaries@"
 
 class Tester:
   failures = 0
@@ -70,7 +71,27 @@ def hasColumnHeader(pinTabFile, colName, expectedResult = True):
 def doubleQuote(path):
   return ''.join(['"',path,'"'])
 
-def runTest(binary, testName, extraOptions = "", expectedResult = True):
+# compares the tab output with the one of the reference converters, line by line
+def compareWithReference(binary, testName, referenceTestName):
+  pinTabFile = os.path.join(pathToOutputData, "%s_%s.txt" % (binary, testName))
+  referenceFile = os.path.join(pathToOutputData, "%s_%s.txt" % (binary, referenceTestName))
+  print("(*): comparing %s with %s..." % (pinTabFile, referenceFile))
+  with open(pinTabFile, 'rb') as f:
+    lines = f.read().splitlines()
+  with open(referenceFile, 'rb') as f:
+    referenceLines = f.read().splitlines()
+  for i, (line, referenceLine) in enumerate(zip(lines, referenceLines)):
+    if line != referenceLine:
+      print("...TEST FAILED: line %d differs from the reference:" % (i + 1))
+      print(line)
+      print(referenceLine)
+      return False
+  if len(lines) != len(referenceLines):
+    print("...TEST FAILED: number of lines not as expected: %d vs. %d" % (len(lines), len(referenceLines)))
+    return False
+  return True
+
+def runTest(binary, testName, extraOptions = "", expectedResult = True, binaryDir = pathToBinaries):
   if binary == "sqt2pin":
     ext = "sqt"
   elif binary == "msgf2pin":
@@ -86,21 +107,21 @@ def runTest(binary, testName, extraOptions = "", expectedResult = True):
   
   print("(*): running %s with %s..." % (binary, testName))
   
-  if testName == "metafile":
+  if testName.startswith("metafile"):
     with open(os.path.join(pathToOutputData, "target_metafile.%s.txt" % (binary)), 'w') as f:
       f.write(os.path.join(pathToData, "converters/%s/target.%s" % (binary, ext)))
     
     with open(os.path.join(pathToOutputData, "decoy_metafile.%s.txt" % (binary)), 'w') as f:
       f.write(os.path.join(pathToData, "converters/%s/decoy.%s" % (binary, ext)))
       
-    cmd = ' '.join([doubleQuote(os.path.join(pathToBinaries, binary)),
+    cmd = ' '.join([doubleQuote(os.path.join(binaryDir, binary)),
       doubleQuote(os.path.join(pathToOutputData, "target_metafile.%s.txt" % (binary))),
       doubleQuote(os.path.join(pathToOutputData, "decoy_metafile.%s.txt" % (binary))),
       extraOptions,
       "2>&1 >", 
       doubleQuote(os.path.join(pathToOutputData, "%s_%s.txt" % (binary,testName)))])
   else:
-    cmd = ' '.join([doubleQuote(os.path.join(pathToBinaries, binary)),
+    cmd = ' '.join([doubleQuote(os.path.join(binaryDir, binary)),
       doubleQuote(os.path.join(pathToData, "converters/%s/target.%s" % (binary, ext))),
       doubleQuote(os.path.join(pathToData, "converters/%s/decoy.%s" % (binary, ext))),
       extraOptions,
@@ -121,13 +142,13 @@ def runTest(binary, testName, extraOptions = "", expectedResult = True):
     with open(os.path.join(pathToOutputData, "combined_metafile.%s.txt" % (binary)), 'w') as f:
       f.write(os.path.join(pathToData, "converters/%s/combined.%s" % (binary, ext)))
     
-    cmd = ' '.join([doubleQuote(os.path.join(pathToBinaries, binary)),
+    cmd = ' '.join([doubleQuote(os.path.join(binaryDir, binary)),
       doubleQuote(os.path.join(pathToOutputData, "combined_metafile.%s.txt" % (binary))),
       extraOptions,
       "2>&1 >", 
       doubleQuote(os.path.join(pathToOutputData, "%s_%s.txt" % (binary,testName)))])
   else:
-    cmd = ' '.join([doubleQuote(os.path.join(pathToBinaries, binary)),
+    cmd = ' '.join([doubleQuote(os.path.join(binaryDir, binary)),
       doubleQuote(os.path.join(pathToData, "converters/%s/combined.%s" % (binary, ext))),
       extraOptions,
       "2>&1 >", 
@@ -190,6 +211,13 @@ for binary, nt1, nd1, nt2, nd2 in zip(binaries, numTargetsSeparate, numDecoysSep
   pinTabFile = os.path.join(pathToOutputData, "%s_%s.txt" % (binary, "RT_combined"))
   T.doTest(checkNumTargetsAndDecoys(pinTabFile, nt2, nd2))
   
+  # compare with the output of reference converters, e.g. of a build from before a change
+  if len(pathToReferenceBinaries) > 0:
+    for testName, extraOptions in [("no_options", ""), ("metafile", ""), ("RT", ms2FileOption)]:
+      T.doTest(runTest(binary, testName + "_reference", extraOptions, binaryDir = pathToReferenceBinaries))
+      T.doTest(compareWithReference(binary, testName, testName + "_reference"))
+      T.doTest(compareWithReference(binary, testName + "_combined", testName + "_reference_combined"))
+  
   # run with option to output percolator input xml
   T.doTest(runTest(binary, "XML", xmlOutputOption % binary))
   T.doTest(validate(xmlOutputOption[3:] % binary))
@@ -0,0 +1,309 @@
+# Percolator Project
+# Script that measures the throughput of the converters on large synthetic
+# search results. Target and decoy files in sqt, mzIdentML and X!Tandem format
+# are generated from a random protein database, each converter is run on them
+# and the PSMs/s, peak resident memory and peak temporary disk usage are
+# reported. The serialization backend of the database is chosen when the
+# converters are compiled, so the backends are compared by passing the bin
+# folders of several builds.
+# Parameters: [--spectra N] [--hits N] [--proteins N] [--converters a,b]
+#             [--binaries label=path,label=path] [--keep]
+
+import os
+import sys
+import math
+import time
+import random
+import shutil
+import argparse
+import subprocess
+
+pathToBinaries = "@pathToBinaries@"
+pathToData = "@pathToData@"
+pathToOutputData = "@pathToOutputData@"
+serializeScheme = "@serializeScheme@"
+
+monoMass = {'G': 57.02146, 'A': 71.03711, 'S': 87.03203, 'P': 97.05276,
+  'V': 99.06841, 'T': 101.04768, 'L': 113.08406, 'I': 113.08406,
+  'N': 114.04293, 'D': 115.02694, 'Q': 128.05858, 'K': 128.09496,
+  'E': 129.04259, 'H': 137.05891, 'F': 147.06841, 'R': 156.10111,
+  'Y': 163.06333, 'W': 186.07931}
+waterMass = 18.01056
+protonMass = 1.00728
+# cysteine and methionine are left out, such that no modifications are needed
+nonCleaving = "GASPVTLINDQEHFYW"
+
+converterExtensions = {"sqt2pin": "sqt", "msgf2pin": "mzid", "tandem2pin": "t.xml"}
+
+# puts double quotes around the input string, needed for windows shell
+def doubleQuote(path):
+  return ''.join(['"',path,'"'])
+
+def peptideMass(peptide):
+  return sum(monoMass[aa] for aa in peptide) + waterMass
+
+# a protein is a chain of tryptic peptides, returns the sequence and the
+# peptides as (sequence, start, end) with 1-based inclusive positions
+def randomProtein(rng):
+  sequence, peptides = "", []
+  while len(sequence) < 300:
+    peptide = ''.join(rng.choice(nonCleaving) for i in range(rng.randint(6, 20))) + rng.choice("KR")
+    peptides.append((peptide, len(sequence) + 1, len(sequence) + len(peptide)))
+    sequence += peptide
+  return sequence, peptides
+
+class Database:
+  def __init__(self, numProteins, prefix, seed):
+    rng = random.Random(seed)
+    self.proteins = []
+    for i in range(numProteins):
+      sequence, peptides = randomProtein(rng)
+      self.proteins.append(("%sSYN%06d" % (prefix, i), sequence, peptides))
+
+  # returns the protein, the peptide with its position and its flanks
+  def randomHit(self, rng):
+    name, sequence, peptides = rng.choice(self.proteins)
+    peptide, start, end = rng.choice(peptides)
+    pre = sequence[start - 2] if start > 1 else '-'
+    post = sequence[end] if end < len(sequence) else '-'
+    return name, sequence, peptide, start, end, pre, post
+
+# one spectrum with its hits, the scores decrease with the rank
+def randomSpectra(database, numSpectra, numHits, seed):
+  rng = random.Random(seed)
+  for scan in range(1, numSpectra + 1):
+    charge = rng.choice([2, 2, 3])
+    hits = [database.randomHit(rng) for rank in range(numHits)]
+    score = rng.uniform(1.0, 5.0)
+    scores = sorted([score * rng.uniform(0.5, 1.0) for rank in range(numHits)], reverse = True)
+    yield scan, charge, rng.uniform(600.0, 6000.0), hits, scores
+
+def writeSqt(fileName, database, numSpectra, numHits, seed):
+  with open(fileName, 'w') as f:
+    f.write("H\tSQTGenerator synthetic\nH\tSQTGeneratorVersion 1.0\n")
+    f.write("H\tLine fields: S, scan number, scan number, charge, 0, server, experimental mass, total ion intensity, lowest Sp, number of matches\n")
+    f.write("H\tLine fields: M, rank by xcorr score, rank by sp score, peptide mass, deltaCn, xcorr score, sp score, number ions matched, total ions compared, sequence, validation status\n")
+    for scan, charge, rt, hits, scores in randomSpectra(database, numSpectra, numHits, seed):
+      mass = peptideMass(hits[0][2]) + protonMass
+      f.write("S\t%d\t%d\t%d\t0.0\tserver\t%.4f\t%.2f\t%.4f\t%d\n" % (scan, scan, charge, mass, 1000.0 * scores[0], 10.0, 100))
+      for rank, (hit, score) in enumerate(zip(hits, scores)):
+        name, sequence, peptide, start, end, pre, post = hit
+        deltaCn = (scores[0] - score) / scores[0]
+        f.write("M\t%d\t%d\t%.4f\t%.2f\t%.7f\t%.6f\t%d\t%d\t%s.%s.%s\tU\n" % (rank + 1, rank + 1,
+          peptideMass(peptide) + protonMass, deltaCn, score, 100.0 * score, len(peptide), 2 * (len(peptide) - 1), pre, peptide, post))
+        f.write("L\t%s\n" % name)
+
+# the generated elements are put into the boilerplate of one of the test files
+def writeMzid(fileName, database, numSpectra, numHits, seed, isDecoy):
+  text = open(os.path.join(pathToData, "converters/msgf2pin/target.mzid"), 'r').read()
+  head = text[:text.index("<SequenceCollection")]
+  middle = text[text.index("</SequenceCollection>"):text.index("<SpectrumIdentificationResult")]
+  tail = text[text.index("</SpectrumIdentificationList>"):]
+  results, peptideIds, evidenceIds, proteinIds = [], {}, {}, {}
+  for scan, charge, rt, hits, scores in randomSpectra(database, numSpectra, numHits, seed):
+    items = []
+    for rank, (hit, score) in enumerate(zip(hits, scores)):
+      name, sequence, peptide, start, end, pre, post = hit
+      proteinIds.setdefault(name, (len(proteinIds) + 1, len(sequence)))
+      peptideIds.setdefault(peptide, len(peptideIds) + 1)
+      evidenceIds.setdefault((peptide, name), (len(evidenceIds) + 1, start, end, pre, post))
+      mz = (peptideMass(peptide) + charge * protonMass) / charge
+      items.append(('<SpectrumIdentificationItem passThreshold="true" rank="%d" peptide_ref="Pep%d" calculatedMassToCharge="%.6f" experimentalMassToCharge="%.6f" chargeState="%d" id="SII_%d_%d">\n'
+        '<PeptideEvidenceRef peptideEvidence_ref="PepEv_%d"/>\n'
+        '<cvParam accession="MS:1002049" cvRef="PSI-MS" value="%d" name="MS-GF:RawScore"/>\n'
+        '<cvParam accession="MS:1002050" cvRef="PSI-MS" value="%d" name="MS-GF:DeNovoScore"/>\n'
+        '<cvParam accession="MS:1002052" cvRef="PSI-MS" value="%.6E" name="MS-GF:SpecEValue"/>\n'
+        '<cvParam accession="MS:1002053" cvRef="PSI-MS" value="%.6E" name="MS-GF:EValue"/>\n'
+        '<userParam value="0" name="IsotopeError"/>\n'
+        '<userParam value="HCD" name="AssumedDissociationMethod"/>\n'
+        '<userParam value="%.6f" name="ExplainedIonCurrentRatio"/>\n'
+        '<userParam value="%.6f" name="NTermIonCurrentRatio"/>\n'
+        '<userParam value="%.6f" name="CTermIonCurrentRatio"/>\n'
+        '<userParam value="%.2f" name="MS2IonCurrent"/>\n'
+        '<userParam value="%d" name="NumMatchedMainIons"/>\n'
+        '<userParam value="%.6f" name="MeanErrorTop7"/>\n'
+        '<userParam value="%.6f" name="StdevErrorTop7"/>\n'
+        '<userParam value="%.6f" name="MeanRelErrorTop7"/>\n'
+        '<userParam value="%.6f" name="StdevRelErrorTop7"/>\n'
+        '</SpectrumIdentificationItem>\n') % (rank + 1, peptideIds[peptide], mz, mz + 0.001, charge, scan, rank + 1,
+        evidenceIds[(peptide, name)][0], int(40 * score), int(45 * score), math.pow(10, -3 * score), math.pow(10, 3 - 3 * score),
+        0.1 * score, 0.04 * score, 0.06 * score, 1e5 * score, len(peptide) // 2, 5.0 / score, 3.0 / score, 4.0 / score, 2.0 / score))
+    results.append('<SpectrumIdentificationResult spectraData_ref="SID_1" spectrumID="scan=%d" id="SIR_%d">\n%s'
+      '<cvParam accession="MS:1001115" cvRef="PSI-MS" value="%d" name="scan number(s)"/>\n'
+      '</SpectrumIdentificationResult>\n' % (scan, scan, ''.join(items), scan))
+  with open(fileName, 'w') as f:
+    f.write(head)
+    f.write('<SequenceCollection xmlns="http://psidev.info/psi/pi/mzIdentML/1.1">\n')
+    for name, (proteinId, length) in proteinIds.items():
+      f.write('<DBSequence accession="%s" searchDatabase_ref="SearchDB_1" length="%d" id="DBSeq%d">\n'
+        '<cvParam accession="MS:1001088" cvRef="PSI-MS" value="%s" name="protein description"/>\n'
+        '</DBSequence>\n' % (name, length, proteinId, name))
+    for peptide, peptideId in peptideIds.items():
+      f.write('<Peptide id="Pep%d">\n<PeptideSequence>%s</PeptideSequence>\n</Peptide>\n' % (peptideId, peptide))
+    for (peptide, name), (evidenceId, start, end, pre, post) in evidenceIds.items():
+      f.write('<PeptideEvidence isDecoy="%s" post="%s" pre="%s" end="%d" start="%d" peptide_ref="Pep%d" dBSequence_ref="DBSeq%d" id="PepEv_%d"/>\n' %
+        ("true" if isDecoy else "false", post, pre, end, start, peptideIds[peptide], proteinIds[name][0], evidenceId))
+    f.write(middle)
+    f.writelines(results)
+    f.write(tail)
+
+def writeTandem(fileName, database, numSpectra, numHits, seed):
+  template = os.path.join(pathToData, "converters/tandem2pin/target.t.xml")
+  text = open(template, 'r').read()
+  head = text[:text.index(">", text.index("<bioml")) + 1] + "\n"
+  tail = text[text.index('<group label="input parameters"'):]
+  with open(fileName, 'w') as f:
+    f.write(head)
+    for scan, charge, rt, hits, scores in randomSpectra(database, numSpectra, numHits, seed):
+      mh = peptideMass(hits[0][2]) + protonMass
+      expect = math.pow(10, 3 - 3 * scores[0])
+      f.write('<group id="%d" mh="%.6f" z="%d" rt="%.3f" expect="%.1e" label="%s" type="model" sumI="5.67" maxI="95024.1" fI="950.241" act="0" >\n' %
+        (scan, mh, charge, rt, expect, hits[0][0]))
+      for rank, (hit, score) in enumerate(zip(hits, scores)):
+        name, sequence, peptide, start, end, pre, post = hit
+        domainExpect = math.pow(10, 3 - 3 * score)
+        f.write('<protein expect="%.1f" id="%d.%d" uid="%d" label="%s" sumI="6.37" >\n'
+          '<note label="description">%s</note>\n'
+          '<file type="peptide" URL="synthetic.fasta"/>\n'
+          '<peptide start="1" end="%d">\n\t%s\n'
+          '<domain id="%d.%d.1" start="%d" end="%d" expect="%.1e" mh="%.4f" delta="0.0010" hyperscore="%.1f" nextscore="%.1f" y_score="10.0" y_ions="%d" b_score="8.0" b_ions="%d" pre="%s" post="%s" seq="%s" missed_cleavages="0">\n'
+          '</domain>\n</peptide>\n</protein>\n' % (math.log10(domainExpect), scan, rank + 1, scan * numHits + rank, name, name,
+          len(sequence), sequence, scan, rank + 1, start, end, domainExpect, peptideMass(peptide) + protonMass,
+          20.0 * score, 10.0 * score, len(peptide) // 2, len(peptide) // 3,
+          sequence[max(0, start - 5):start - 1] or '[', sequence[end:end + 4] or ']', peptide))
+      f.write('<group type="support" label="fragment ion mass spectrum">\n'
+        '<note label="Description">scan=%d RTINSECONDS=%.3f </note>\n'
+        '<GAML:trace id="%d" label="%d.spectrum" type="tandem mass spectrum">\n'
+        '<GAML:attribute type="M+H">%.1f</GAML:attribute>\n'
+        '<GAML:attribute type="charge">%d</GAML:attribute>\n'
+        '<GAML:Xdata label="%d.spectrum" units="MASSTOCHARGERATIO">\n'
+        '<GAML:values byteorder="INTEL" format="ASCII" numvalues="3">\n235.247 263.287 293.453 \n</GAML:values>\n'
+        '</GAML:Xdata>\n'
+        '<GAML:Ydata label="%d.spectrum" units="UNKNOWN">\n'
+        '<GAML:values byteorder="INTEL" format="ASCII" numvalues="3">\n18 15 2 \n</GAML:values>\n'
+        '</GAML:Ydata>\n'
+        '</GAML:trace>\n'
+        '</group></group>\n' % (scan, rt, scan, scan, mh, charge, scan, scan))
+    f.write(tail)
+
+def generate(converter, fileName, database, numSpectra, numHits, seed, isDecoy):
+  if converter == "sqt2pin":
+    writeSqt(fileName, database, numSpectra, numHits, seed)
+  elif converter == "msgf2pin":
+    writeMzid(fileName, database, numSpectra, numHits, seed, isDecoy)
+  else:
+    writeTandem(fileName, database, numSpectra, numHits, seed)
+
+def directorySize(path):
+  total = 0
+  for root, dirs, files in os.walk(path):
+    for name in files:
+      try:
+        total += os.path.getsize(os.path.join(root, name))
+      except OSError:
+        pass # removed by the converter in the meantime
+  return total
+
+# runs the converter with its temporary files in tmpDir, returns the exit
+# status, the wall time, the peak resident memory in MB (None where this
+# cannot be measured) and the peak size of tmpDir in MB
+def runMeasured(cmd, tmpDir):
+  env = dict(os.environ)
+  for var in ["TMPDIR", "TMP", "TEMP"]:
+    env[var] = tmpDir
+  start = time.time()
+  process = subprocess.Popen(cmd, env = env)
+  peakTmp, peakRss, status = 0, None, None
+  while status is None:
+    peakTmp = max(peakTmp, directorySize(tmpDir))
+    if hasattr(os, "wait4"):
+      pid, waitStatus, usage = os.wait4(process.pid, os.WNOHANG)
+      if pid != 0:
+        status = waitStatus
+        # kilobytes on linux, bytes on mac os
+        peakRss = usage.ru_maxrss / (1024.0 * 1024.0 if sys.platform == "darwin" else 1024.0)
+    else:
+      status = process.poll()
+    if status is None:
+      time.sleep(0.05)
+  return status, time.time() - start, peakRss, peakTmp / 1e6
+
+def countPsms(pinTabFile):
+  numTargets, numDecoys = 0, 0
+  for line in open(pinTabFile, 'r'):
+    fields = line.rstrip('\r\n').split('\t')
+    if len(fields) > 1 and fields[0] != "SpecId" and fields[0] != "DefaultDirection":
+      if fields[1] == "1":
+        numTargets += 1
+      elif fields[1] == "-1":
+        numDecoys += 1
+  return numTargets, numDecoys
+
+parser = argparse.ArgumentParser(description = "Converter throughput benchmark")
+parser.add_argument("--spectra", type = int, default = 20000, help = "spectra per target and decoy file")
+parser.add_argument("--hits", type = int, default = 3, help = "hits per spectrum")
+parser.add_argument("--proteins", type = int, default = 2000, help = "proteins per database")
+parser.add_argument("--converters", default = "sqt2pin,msgf2pin,tandem2pin")
+parser.add_argument("--binaries", default = "%s=%s" % (serializeScheme, pathToBinaries),
+  help = "comma separated label=path pairs, one per build of the converters")
+parser.add_argument("--keep", action = "store_true", help = "keep the generated files")
+args = parser.parse_args()
+
+print("CONVERTERS PERFORMANCE")
+
+success = True
+benchDir = os.path.join(pathToOutputData, "converters_benchmark")
+if os.path.isdir(benchDir):
+  shutil.rmtree(benchDir)
+os.makedirs(benchDir)
+targetDb = Database(args.proteins, "", 1)
+decoyDb = Database(args.proteins, "decoy_", 2)
+
+results = []
+for converter in args.converters.split(','):
+  ext = converterExtensions[converter]
+  inputFiles = []
+  print("(*): generating %d target and %d decoy spectra with %d hits each for %s..." % (args.spectra, args.spectra, args.hits, converter))
+  for label, database, seed in [("target", targetDb, 3), ("decoy", decoyDb, 4)]:
+    fileName = os.path.join(benchDir, "%s.%s" % (label, ext))
+    generate(converter, fileName, database, args.spectra, args.hits, seed, label == "decoy")
+    inputFiles.append(fileName)
+  numBytes = sum(os.path.getsize(f) for f in inputFiles)
+
+  for binary in args.binaries.split(','):
+    backend, binDir = binary.split('=', 1)
+    pinTabFile = os.path.join(benchDir, "%s_%s.tab" % (converter, backend))
+    tmpDir = os.path.join(benchDir, "tmp_%s_%s" % (converter, backend))
+    os.makedirs(tmpDir)
+    cmd = [os.path.join(binDir, converter), inputFiles[0], inputFiles[1], "-o", pinTabFile, "-v", "0"]
+    if converter != "sqt2pin":
+      cmd.append("--no-schema-validation")
+    print("(*): running %s (%s) on %.1f MB..." % (converter, backend, numBytes / 1e6))
+    status, elapsed, peakRss, peakTmp = runMeasured(cmd, tmpDir)
+    if status != 0:
+      print(' '.join(doubleQuote(c) for c in cmd))
+      print("...TEST FAILED: %s terminated with %s exit status" % (converter, str(status)))
+      success = False
+      continue
+    numTargets, numDecoys = countPsms(pinTabFile)
+    if numTargets == 0 or numDecoys == 0:
+      print("...TEST FAILED: %s wrote %d target and %d decoy psms" % (converter, numTargets, numDecoys))
+      success = False
+    results.append((converter, backend, numTargets + numDecoys, elapsed, numBytes, peakRss, peakTmp))
+
+print("")
+print("%-11s %-14s %9s %8s %10s %8s %13s %11s" % ("converter", "backend", "psms", "time(s)", "psms/s", "MB/s", "peak RSS(MB)", "peak tmp(MB)"))
+for converter, backend, numPsms, elapsed, numBytes, peakRss, peakTmp in results:
+  elapsed = max(elapsed, 1e-6)
+  print("%-11s %-14s %9d %8.2f %10.0f %8.1f %13s %11.1f" % (converter, backend, numPsms, elapsed,
+    numPsms / elapsed, numBytes / 1e6 / elapsed, "%.1f" % peakRss if peakRss is not None else "n/a", peakTmp))
+
+if not args.keep:
+  shutil.rmtree(benchDir)
+
+if success:
+  print("...ALL TESTS SUCCEEDED")
+  exit(0)
+else:
+  print("...TEST FAILED")
+  exit(1)
@@ -0,0 +1,138 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the MSScanIndex class */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MSReader.h"
+#include "MSScanIndex.h"
+#include "Spectrum.h"
+
+#ifndef PATH_TO_DATA
+#define PATH_TO_DATA ""
+#endif
+
+class MSScanIndexTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ms2File = std::string(PATH_TO_DATA) + "small.ms2";
+    indexFile = "ms_scan_index_test.msidx";
+    readSequential();
+  }
+  virtual void TearDown() {
+    remove(indexFile.c_str());
+  }
+
+  // reads all MS2 spectra of the file from start to end, as the converters do without an index
+  void readSequential() {
+    MSReader r;
+    Spectrum s;
+    r.setFilter(MS2);
+    std::vector<char> fn(ms2File.begin(), ms2File.end());
+    fn.push_back('\0');
+    r.readFile(&fn[0], s);
+    while (s.getScanNumber() != 0) {
+      spectra.push_back(s);
+      r.readFile(NULL, s);
+    }
+  }
+
+  static void expectSameSpectrum(Spectrum& expected, Spectrum& actual) {
+    EXPECT_EQ(expected.getScanNumber(), actual.getScanNumber());
+    EXPECT_DOUBLE_EQ(expected.getMZ(), actual.getMZ());
+    EXPECT_FLOAT_EQ(expected.getRTime(), actual.getRTime());
+    ASSERT_EQ(expected.sizeZ(), actual.sizeZ());
+    for (int i = 0; i < expected.sizeZ(); ++i) {
+      EXPECT_EQ(expected.atZ(i).z, actual.atZ(i).z);
+      EXPECT_DOUBLE_EQ(expected.atZ(i).mz, actual.atZ(i).mz);
+    }
+    ASSERT_EQ(expected.sizeEZ(), actual.sizeEZ());
+    for (int i = 0; i < expected.sizeEZ(); ++i) {
+      EXPECT_EQ(expected.atEZ(i).z, actual.atEZ(i).z);
+      EXPECT_DOUBLE_EQ(expected.atEZ(i).mh, actual.atEZ(i).mh);
+      EXPECT_FLOAT_EQ(expected.atEZ(i).pRTime, actual.atEZ(i).pRTime);
+    }
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      EXPECT_DOUBLE_EQ(expected.at(i).mz, actual.at(i).mz);
+      EXPECT_FLOAT_EQ(expected.at(i).intensity, actual.at(i).intensity);
+    }
+  }
+
+  // compares the per spectrum fields of the index with a sequential read of the file
+  void expectSameEntries(const MSScanIndex& index) {
+    ASSERT_EQ(spectra.size(), index.size());
+    for (size_t i = 0; i < spectra.size(); ++i) {
+      Spectrum& s = spectra[i];
+      const MSScanIndexEntry* e = index.find(s.getScanNumber());
+      ASSERT_TRUE(e != NULL) << "scan " << s.getScanNumber();
+      EXPECT_EQ(s.getScanNumber(), e->scanNumber);
+      EXPECT_DOUBLE_EQ(s.getMZ(), e->mz);
+      EXPECT_FLOAT_EQ(s.getRTime(), e->rTime);
+      EXPECT_EQ(s.sizeZ() > 0 ? s.atZ(0).z : 0, e->charge);
+      ASSERT_EQ(s.sizeEZ(), e->numEZ);
+      for (int ez = 0; ez < e->numEZ; ++ez) {
+        EXPECT_EQ(s.atEZ(ez).z, index.getEZ(*e, ez).z);
+        EXPECT_DOUBLE_EQ(s.atEZ(ez).mh, index.getEZ(*e, ez).mh);
+        EXPECT_FLOAT_EQ(s.atEZ(ez).pRTime, index.getEZ(*e, ez).pRTime);
+      }
+    }
+  }
+
+  std::string ms2File, indexFile;
+  std::vector<Spectrum> spectra;
+};
+
+TEST_F(MSScanIndexTest, EntriesMatchSequentialRead) {
+  ASSERT_FALSE(spectra.empty());
+  MSScanIndex index;
+  ASSERT_TRUE(index.build(ms2File.c_str()));
+  expectSameEntries(index);
+  EXPECT_TRUE(index.find(-1) == NULL);
+}
+
+TEST_F(MSScanIndexTest, IndexedReadsMatchSequentialReads) {
+  MSScanIndex index;
+  ASSERT_TRUE(index.build(ms2File.c_str()));
+  MSReader r;
+  r.setFilter(MS2);
+  r.setScanIndex(&index);
+  std::vector<char> fn(ms2File.begin(), ms2File.end());
+  fn.push_back('\0');
+  // visit the spectra in reverse order, such that each read has to seek
+  for (size_t i = spectra.size(); i-- > 0;) {
+    Spectrum s;
+    ASSERT_TRUE(r.readFile(&fn[0], s, spectra[i].getScanNumber()));
+    expectSameSpectrum(spectra[i], s);
+  }
+}
+
+TEST_F(MSScanIndexTest, SaveAndLoad) {
+  MSScanIndex built;
+  ASSERT_TRUE(built.build(ms2File.c_str()));
+  ASSERT_TRUE(built.save(indexFile.c_str()));
+  MSScanIndex loaded;
+  ASSERT_TRUE(loaded.load(indexFile.c_str(), ms2File.c_str()));
+  EXPECT_EQ(built.getFileSize(), loaded.getFileSize());
+  ASSERT_EQ(built.size(), loaded.size());
+  for (unsigned int i = 0; i < built.size(); ++i) {
+    EXPECT_EQ(built.at(i).offset, loaded.at(i).offset);
+  }
+  expectSameEntries(loaded);
+}
@@ -36,6 +36,8 @@ class ParseOptions
     monoisotopic(false),
     expMassInPsmId(false),
     boost_serialization(true),
+    xmlOutput(false),
+    validateSchema(true),
     reversedFeaturePattern("random"),
     targetFN(""),
     decoyFN(""),
@@ -63,6 +65,8 @@ class ParseOptions
     bool monoisotopic;
     bool expMassInPsmId;
     bool boost_serialization;
+    bool xmlOutput;
+    bool validateSchema;
     std::string reversedFeaturePattern;
     std::string targetFN;
     std::string decoyFN;
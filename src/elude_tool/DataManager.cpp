@@ -76,16 +76,168 @@ public:
  }
 };
 
-struct EqualPSMDescription {
-   EqualPSMDescription(PSMDescription* _psm) : psm(_psm) {}
+/* predicate true for the psms whose peptide is in a given set */
+struct InPeptideSet {
+   InPeptideSet(const set<string>* _peptides) : peptides(_peptides) {}
 
-   bool operator()(const PSMDescription* otherPsm) const {
-      return *otherPsm == *psm;
+   bool operator()(const PSMDescription* psm) const {
+      return peptides->find(psm->peptide) != peptides->end();
    }
 private:
-   PSMDescription* psm;
+   const set<string>* peptides;
 };
 
+/* the information about a psm used to check whether it is an in-source fragment,
+ * computed once per psm instead of once per pair of psms */
+struct FragmentInfo {
+  string ms_peptide;
+  bool has_ptms;
+  bool has_context;
+  /* only computed when has_context is true */
+  bool is_enzymatic;
+  /* index sum of ms_peptide; index_error is set instead if it cannot be computed */
+  double index_sum;
+  string index_error;
+};
+
+/* Index of the psms without ptms by the substrings of kGramLength amino acids of their
+ * peptides. A parent includes the peptide of its fragment, so its psm is found in the
+ * postings of any of these substrings of the fragment. The postings are the positions
+ * of the psms in the list sorted by retention time, in increasing order */
+class FragmentIndex {
+ public:
+  static const size_t kGramLength = 3;
+
+  explicit FragmentIndex(const vector<FragmentInfo> &infos) {
+    vector< pair<unsigned int, int> > postings;
+    vector<unsigned int> grams;
+    for (int i = 0; i < (int) infos.size(); ++i) {
+      const string &peptide = infos[i].ms_peptide;
+      if (infos[i].has_ptms || peptide.length() < kGramLength) {
+        continue;
+      }
+      grams.clear();
+      for (size_t pos = 0; pos + kGramLength <= peptide.length(); ++pos) {
+        grams.push_back(Gram(peptide, pos));
+      }
+      sort(grams.begin(), grams.end());
+      grams.erase(unique(grams.begin(), grams.end()), grams.end());
+      for (size_t k = 0; k < grams.size(); ++k) {
+        postings.push_back(make_pair(grams[k], i));
+      }
+    }
+    sort(postings.begin(), postings.end());
+    ranks_.reserve(postings.size());
+    for (size_t k = 0; k < postings.size(); ++k) {
+      if (k == 0 || postings[k].first != postings[k - 1].first) {
+        keys_.push_back(postings[k].first);
+        starts_.push_back(k);
+      }
+      ranks_.push_back(postings[k].second);
+    }
+    starts_.push_back(postings.size());
+  }
+
+  /* the shortest postings of the substrings of peptide (at least kGramLength long);
+   * empty if some substring is not indexed */
+  pair<const int*, const int*> Candidates(const string &peptide) const {
+    pair<const int*, const int*> best((const int*) NULL, (const int*) NULL);
+    for (size_t pos = 0; pos + kGramLength <= peptide.length(); ++pos) {
+      unsigned int gram = Gram(peptide, pos);
+      vector<unsigned int>::const_iterator it = lower_bound(keys_.begin(), keys_.end(), gram);
+      if (it == keys_.end() || *it != gram) {
+        return pair<const int*, const int*>((const int*) NULL, (const int*) NULL);
+      }
+      size_t k = it - keys_.begin();
+      if (best.first == NULL || starts_[k + 1] - starts_[k] < best.second - best.first) {
+        best.first = &ranks_[0] + starts_[k];
+        best.second = &ranks_[0] + starts_[k + 1];
+      }
+    }
+    return best;
+  }
+
+ private:
+  static unsigned int Gram(const string &peptide, const size_t &pos) {
+    return ((unsigned int) (unsigned char) peptide[pos] << 16) |
+        ((unsigned int) (unsigned char) peptide[pos + 1] << 8) |
+        (unsigned int) (unsigned char) peptide[pos + 2];
+  }
+
+  vector<unsigned int> keys_;
+  /* the postings of keys_[k] are ranks_[starts_[k]], ..., ranks_[starts_[k + 1] - 1] */
+  vector<int> starts_;
+  vector<int> ranks_;
+};
+
+/* compute the information about the psm with the given peptide (given as A.XXX.B) */
+static FragmentInfo GetFragmentInfo(const string &peptide, const Enzyme* enzyme,
+                                    const map<string, double> &index) {
+  FragmentInfo info;
+  info.ms_peptide = DataManager::GetMSPeptide(peptide);
+  info.has_ptms = info.ms_peptide.find("[") != string::npos;
+  info.has_context = peptide != info.ms_peptide;
+  info.is_enzymatic = info.has_context && enzyme->isEnzymatic(peptide);
+  info.index_sum = 0.0;
+  if (!info.has_ptms) {
+    try {
+      info.index_sum = RetentionFeatures::IndexSum(info.ms_peptide, index);
+    } catch (const MyException &e) {
+      info.index_error = e.what();
+    }
+  }
+  return info;
+}
+
+/* check if child is an in-source fragment of parent; returns 1 if it is, 0 if not and -1
+ * if an index sum that is needed cannot be computed, in which case error is set */
+static int IsInSourceFragment(const FragmentInfo &child, const FragmentInfo &parent,
+                              const double &diff, string &error) {
+  if (child.has_ptms || parent.has_ptms) {
+    return 0;
+  }
+  if ((child.ms_peptide.length() >= parent.ms_peptide.length()) ||
+      (parent.ms_peptide.find(child.ms_peptide) == string::npos)) {
+    return 0;
+  }
+  if (parent.has_context && child.has_context && parent.is_enzymatic && !child.is_enzymatic) {
+    return 1;
+  }
+  if (!parent.index_error.empty() || !child.index_error.empty()) {
+    error = parent.index_error.empty() ? child.index_error : parent.index_error;
+    return -1;
+  }
+  double retention_difference = child.index_sum - parent.index_sum;
+  double my_diff = MYABS(retention_difference);
+  return my_diff > diff ? 1 : 0;
+}
+
+/* check the parents of the psm at position i in the same order as a scan of the psms at
+ * positions i - 1, ..., lo and then i + 1, ..., hi, restricted to the candidates (sorted
+ * positions); returns 1 if it is an in-source fragment, 0 if not and -1 on error */
+static int FindParent(const vector<FragmentInfo> &infos, const int &i, const int &lo,
+                      const int &hi, const int *first, const int *last,
+                      const double &diff, string &error) {
+  const int *pos = lower_bound(first, last, i);
+  for (const int *it = pos; it != first && *(it - 1) >= lo; ) {
+    --it;
+    int ret = IsInSourceFragment(infos[i], infos[*it], diff, error);
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  for (const int *it = pos; it != last && *it <= hi; ++it) {
+    if (*it == i) {
+      continue;
+    }
+    int ret = IsInSourceFragment(infos[i], infos[*it], diff, error);
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
 /* set to null all retention feature pointers and delete memory */
 void DataManager::CleanUpTable(vector<PSMDescription*> &psms, double *feat_table) {
   vector<PSMDescription*>::iterator it;
@@ -108,31 +260,7 @@ int DataManager::LoadPeptides(const string &file_name, const bool includes_rt, c
     temp << "Error: Unable to open " << file_name << ". Execution aborted. " << endl;
     throw MyException(temp.str());
   }
-  string peptide_sequence;
-  vector<string> amino_acids;
-  int len;
-  if (includes_rt) {
-    double retention_time;
-    while (in >> peptide_sequence >> retention_time) {
-      psms.push_back(new PSMDescriptionDOC(peptide_sequence, retention_time));
-      if (includes_context) {
-        len = peptide_sequence.length();
-        peptide_sequence = peptide_sequence[0] + peptide_sequence.substr(2, len - 4) + peptide_sequence[len - 1];
-      }
-      amino_acids = RetentionFeatures::GetAminoAcids(peptide_sequence);
-      aa_alphabet.insert(amino_acids.begin(), amino_acids.end());
-    }
-  } else {
-    while (in >> peptide_sequence) {
-      psms.push_back(new PSMDescriptionDOC(peptide_sequence, -1.0));
-      if (includes_context) {
-        len = peptide_sequence.length();
-        peptide_sequence = peptide_sequence[0] + peptide_sequence.substr(2, len - 4) + peptide_sequence[len - 1];
-      }
-      amino_acids = RetentionFeatures::GetAminoAcids(peptide_sequence);
-      aa_alphabet.insert(amino_acids.begin(), amino_acids.end());
-   }
-  }
+  LoadPeptides(in, includes_rt, includes_context, 0, psms, aa_alphabet);
   in.close();
   if (VERB >= 4) {
     cerr << psms.size() << " peptides loaded." << endl << endl;
@@ -140,6 +268,30 @@ int DataManager::LoadPeptides(const string &file_name, const bool includes_rt, c
   return 0;
 }
 
+/* load the next peptides from a stream, at most max_psms of them (all if max_psms is 0); the peptides
+ * are appended to psms and the alphabet is extended; return the number of peptides loaded */
+int DataManager::LoadPeptides(istream &in, const bool includes_rt, const bool includes_context,
+                              const int &max_psms, vector<PSMDescription*> &psms, set<string> &aa_alphabet) {
+  string peptide_sequence;
+  vector<string> amino_acids;
+  int len, number_loaded = 0;
+  double retention_time = -1.0;
+  while ((max_psms <= 0 || number_loaded < max_psms) && in >> peptide_sequence) {
+    if (includes_rt && !(in >> retention_time)) {
+      break;
+    }
+    psms.push_back(new PSMDescriptionDOC(peptide_sequence, retention_time));
+    ++number_loaded;
+    if (includes_context) {
+      len = peptide_sequence.length();
+      peptide_sequence = peptide_sequence[0] + peptide_sequence.substr(2, len - 4) + peptide_sequence[len - 1];
+    }
+    amino_acids = RetentionFeatures::GetAminoAcids(peptide_sequence);
+    aa_alphabet.insert(amino_acids.begin(), amino_acids.end());
+  }
+  return number_loaded;
+}
+
 /* memory allocation for the feature table; return a pointer to the feature table*/
 double* DataManager::InitFeatureTable(const int &no_features, vector<PSMDescription*> &psms) {
   int no_records = psms.size();
@@ -187,11 +339,13 @@ int DataManager::RemoveCommonPeptides(const vector<PSMDescription*> &test_psms,
     }
     return 0;
   }
+  set<string> test_peptides;
   vector<PSMDescription*>::const_iterator it = test_psms.begin();
   for ( ; it != test_psms.end(); ++it) {
-    train_psms.erase(remove_if(train_psms.begin(), train_psms.end(), EqualPSMDescription(*it)),
-                     train_psms.end());
+    test_peptides.insert((*it)->peptide);
   }
+  train_psms.erase(remove_if(train_psms.begin(), train_psms.end(), InPeptideSet(&test_peptides)),
+                   train_psms.end());
   if (VERB >= 4) {
     cerr << (train_psms.size() - initial_number) << " peptides were removed."
          << endl << endl;
@@ -210,37 +364,13 @@ string DataManager::GetMSPeptide(const string& peptide) {
  * in hydrophobicity is greater than difference according to the givem index*/
 bool DataManager::IsFragmentOf(const PSMDescription* child, const PSMDescription* parent, const Enzyme* enzyme,
                                const double &diff, const map<string, double> &index) {
-  string peptide_parent = parent->peptide;
-  string ms_peptide_parent = GetMSPeptide(peptide_parent);
-  string peptide_child = child->peptide;
-  string ms_peptide_child = GetMSPeptide(peptide_child);
-
-  // if any of the child of parent include ptms, we dont look at them
-  if (ms_peptide_child.find("[") != string::npos
-      || ms_peptide_parent.find("[") != string::npos) {
-    return false;
-  }
-
-  // the peptide child has to be included in the larger peptide
-  if ((ms_peptide_child.length() >= ms_peptide_parent.length()) ||
-      (ms_peptide_parent.find(ms_peptide_child) == string::npos)) {
-    return false;
-  }
-  // parent enzymatic, child non enzymatic
-  if (peptide_parent != ms_peptide_parent && peptide_child != ms_peptide_child &&
-      enzyme->isEnzymatic(peptide_parent) && (!enzyme->isEnzymatic(peptide_child))) {
-    return true;
-  }
-  // difference in retention sum > diff
-  double sum_parent = RetentionFeatures::IndexSum(ms_peptide_parent, index);
-  double sum_child = RetentionFeatures::IndexSum(ms_peptide_child, index);
-  double retention_difference = sum_child - sum_parent;
-  double my_diff = MYABS(retention_difference);
-  if (my_diff > diff) {
-    return true;
-  } else {
-    return false;
+  string error;
+  int ret = IsInSourceFragment(GetFragmentInfo(child->peptide, enzyme, index),
+                               GetFragmentInfo(parent->peptide, enzyme, index), diff, error);
+  if (ret < 0) {
+    throw MyException(error);
   }
+  return ret == 1;
 }
 
 vector< pair<pair<PSMDescription*, string>, bool> > DataManager::CombineSets(
@@ -279,35 +409,56 @@ vector< pair<PSMDescription*, string> > DataManager::RemoveInSourceFragments(
   sort(combined_psms.begin(), combined_psms.end(), Utilities::ComparePairs);
   int number_psms = combined_psms.size();
 
-  // check in source fragmentation
-  double rt_child, rt_parent;
-  bool is_in_source;
-  int i, j;
+  // check in source fragmentation; the parents of the psm at position i are searched among
+  // the psms at positions lo[i], ..., hi[i] whose retention times are within 5%
+  vector<int> lo(number_psms), hi(number_psms);
+  int i, j = 0, k = 0;
   for (i = 0; i < number_psms; ++i) {
-    rt_child = combined_psms[i].first.first->getRetentionTime();
-    j = i - 1;
-    is_in_source = false;
-    while ((j >= 0) && (((rt_parent =
-        combined_psms[j].first.first->getRetentionTime()) * 1.05) >= rt_child)) {
-      if (IsFragmentOf(combined_psms[i].first.first, combined_psms[j].first.first, enzyme, diff, index)) {
-        combined_psms[i].second = true;
-        is_in_source = true;
-        break;
-      }
-      j--;
+    double rt_child = combined_psms[i].first.first->getRetentionTime();
+    while (j < i && combined_psms[j].first.first->getRetentionTime() * 1.05 < rt_child) {
+      ++j;
     }
-    if (!is_in_source) {
-      j = i + 1;
-      while ((j < number_psms) && (((rt_parent =
-          combined_psms[j].first.first->getRetentionTime()) * 0.95) <= rt_child)) {
-        if (IsFragmentOf(combined_psms[i].first.first, combined_psms[j].first.first, enzyme, diff, index)) {
-          combined_psms[i].second = true;
-          break;
-        }
-        j++;
-      }
+    k = max(k, i);
+    while (k + 1 < number_psms &&
+           combined_psms[k + 1].first.first->getRetentionTime() * 0.95 <= rt_child) {
+      ++k;
+    }
+    lo[i] = j;
+    hi[i] = k;
+  }
+  vector<FragmentInfo> infos(number_psms);
+  for (i = 0; i < number_psms; ++i) {
+    infos[i] = GetFragmentInfo(combined_psms[i].first.first->peptide, enzyme, index);
+  }
+  FragmentIndex fragment_index(infos);
+  vector<int> all_positions(number_psms);
+  for (i = 0; i < number_psms; ++i) {
+    all_positions[i] = i;
+  }
+  vector<int> is_in_source(number_psms, 0);
+  vector<string> errors(number_psms);
+  #pragma omp parallel for schedule(dynamic, 256)
+  for (int n = 0; n < number_psms; ++n) {
+    if (infos[n].has_ptms) {
+      continue;
+    }
+    pair<const int*, const int*> candidates;
+    if (infos[n].ms_peptide.length() >= FragmentIndex::kGramLength) {
+      candidates = fragment_index.Candidates(infos[n].ms_peptide);
+    } else {
+      candidates = make_pair(&all_positions[0], &all_positions[0] + number_psms);
+    }
+    if (candidates.first != candidates.second) {
+      is_in_source[n] = FindParent(infos, n, lo[n], hi[n], candidates.first, candidates.second,
+                                   diff, errors[n]);
     }
   }
+  for (i = 0; i < number_psms; ++i) {
+    if (is_in_source[i] < 0) {
+      throw MyException(errors[i]);
+    }
+    combined_psms[i].second = (is_in_source[i] == 1);
+  }
   // partition the PSMs according to whether they are in source fragments or not
   vector< pair<pair<PSMDescription*, string>, bool> >::iterator it1 =
       partition(combined_psms.begin(), combined_psms.end(), Utilities::IsInSource);
@@ -409,6 +560,17 @@ int DataManager::WriteOutFile(const string &file_name,
     }
     return 1;
   }
+  WriteOutHeader(out, includes_rt);
+  WritePredictions(out, psms, includes_rt);
+  out.close();
+  if (VERB >= 4) {
+    cerr << "Done." << endl << endl;
+  }
+  return 0;
+}
+
+/* write the header of an output file */
+void DataManager::WriteOutHeader(ostream &out, bool includes_rt) {
   out << "# File generated by Elude. Predicted retention times are given below. " << endl;
   out << "# " << __DATE__ << " , " << __TIME__ << endl;
   if (includes_rt) {
@@ -416,15 +578,15 @@ int DataManager::WriteOutFile(const string &file_name,
   } else {
     out<< "Peptide\tPredicted_RT" << endl;
   }
+}
+
+/* write the predicted retention times of a set of peptides, one peptide per line */
+void DataManager::WritePredictions(ostream &out, const vector<PSMDescription*> &psms,
+    bool includes_rt) {
   vector<PSMDescription*>::const_iterator it = psms.begin();
   for ( ; it != psms.end(); ++it) {
     out << (*it)->peptide << "\t" << (*it)->getPredictedRetentionTime();
     if (includes_rt) out << "\t" << (*it)->getRetentionTime();
-    out << endl;
+    out << "\n";
   }
-  out.close();
-  if (VERB >= 4) {
-    cerr << "Done." << endl << endl;
-  }
-  return 0;
 }
@@ -30,6 +30,7 @@
 #include <string>
 #include <utility>
 #include <functional>
+#include <iostream>
 
 #include "Enzyme.h"
 
@@ -45,6 +46,11 @@ class DataManager {
    /* load a set of peptides */
    static int LoadPeptides(const std::string &file_name, const bool includes_rt, const bool includes_context,
                            std::vector<PSMDescription*> &psms, std::set<std::string> &aa_alphabet);
+   /* load the next peptides from a stream, at most max_psms of them (all if max_psms is 0);
+    * return the number of peptides loaded */
+   static int LoadPeptides(std::istream &in, const bool includes_rt, const bool includes_context,
+                           const int &max_psms, std::vector<PSMDescription*> &psms,
+                           std::set<std::string> &aa_alphabet);
    /* memory allocation for the feature table; return a pointer to the feature table*/
    static double* InitFeatureTable(const int &no_features, std::vector<PSMDescription*> &psms);
    /* remove duplicate peptides */
@@ -77,6 +83,11 @@ class DataManager {
    /* write peptides to output file */
    static int WriteOutFile(const std::string &file_name,
        const std::vector<PSMDescription*> &psms, bool includes_rt);
+   /* write the header of an output file */
+   static void WriteOutHeader(std::ostream &out, bool includes_rt);
+   /* write the predicted retention times of a set of peptides, one peptide per line */
+   static void WritePredictions(std::ostream &out, const std::vector<PSMDescription*> &psms,
+       bool includes_rt);
 };
 
 #endif /* DATAMANAGER_H_ */
@@ -20,12 +20,17 @@
  */
 /* This files stores the implementations of the methods for the EludeCaller class */
 #include <math.h>
+#include <stdio.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <algorithm>
 #include <ctime>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "EludeCaller.h"
 #include "Version.h"
@@ -35,16 +40,17 @@
 #include "Globals.h"
 #include "DataManager.h"
 #include "PSMDescriptionDOC.h"
+#include "MyException.h"
 
 const double EludeCaller::kFractionPeptides = 0.95;
 string EludeCaller::library_path_ = ELUDE_MODELS_PATH;
 double EludeCaller::lts_coverage_ = 0.95;
 double EludeCaller::hydrophobicity_diff_ = 5.0;
 
-EludeCaller::EludeCaller():automatic_model_sel_(false), append_model_(false),
+EludeCaller::EludeCaller():stream_chunk_size_(0), automatic_model_sel_(false), append_model_(false),
                            linear_calibration_(true), remove_duplicates_(false),
                            remove_in_source_(false), remove_non_enzymatic_(false),
-                           context_format_(false), test_includes_rt_(false),
+                           context_format_(false), test_includes_rt_(false), save_binary_model_(false),
                            remove_common_peptides_(false), train_features_table_(NULL),
                            test_features_table_(NULL), processed_test_(false),
                            rt_model_(NULL), ignore_ptms_(false), lts(NULL), supress_print_(false), 
@@ -139,6 +145,13 @@ bool EludeCaller::ParseOptions(int argc, char** argv) {
                    "save-model",
                    "Specifies the file in which the model will be saved.",
                    "filename");
+  cmd.defineOption("m",
+                   "binary-model",
+                   "Save the model given by -s with the SVR in a binary format, "
+                   "which is memory mapped when the model is loaded. Models in both "
+                   "formats can be loaded with -l and used in the library of models",
+                   "",
+                   TRUE_IF_SET);
   cmd.defineOption("l",
                    "load-model",
                    "Specifies a file including a SVR model to be loaded.",
@@ -238,6 +251,13 @@ bool EludeCaller::ParseOptions(int argc, char** argv) {
                    "Supress the final printing of the predictions ",
                    "",
                    TRUE_IF_SET);
+  cmd.defineOption("q",
+                   "stream",
+                   "The test peptides are read, predicted and written in chunks of the "
+                   "given number of peptides, so that the memory used does not depend "
+                   "on the size of the test file. This option cannot be combined with "
+                   "the -u, -k, -y, -i and -g options.",
+                   "value");
 
   cmd.parseArgs(argc, argv);
 
@@ -254,6 +274,9 @@ bool EludeCaller::ParseOptions(int argc, char** argv) {
   if (cmd.optionSet("save-model")) {
     save_model_file_ = cmd.options["save-model"];
   }
+  if (cmd.optionSet("binary-model")) {
+    save_binary_model_ = true;
+  }
   if (cmd.optionSet("load-model")) {
     load_model_file_ = cmd.options["load-model"];
   }
@@ -319,6 +342,18 @@ bool EludeCaller::ParseOptions(int argc, char** argv) {
   if (cmd.optionSet("supress-print")) {
      supress_print_ = true;
   }
+  if (cmd.optionSet("stream")) {
+    stream_chunk_size_ = cmd.getInt("stream", 1, 100000000);
+    // these options need all the test peptides at once
+    if (remove_duplicates_ || remove_common_peptides_ || remove_in_source_ ||
+        !in_source_file_.empty() || test_includes_rt_) {
+      if (VERB >= 2) {
+        cerr << "Warning: the test peptides cannot be streamed together with the "
+             << "-u, -k, -y, -i or -g options. All the test peptides will be loaded." << endl;
+      }
+      stream_chunk_size_ = 0;
+    }
+  }
   
   return true;
 }
@@ -350,7 +385,7 @@ int EludeCaller::ProcessTrainData() {
   // remove duplicates
   DataManager::RemoveDuplicates(train_psms_);
   // remove in source fragments
-  if (!test_file_.empty()) {
+  if (!test_file_.empty() && stream_chunk_size_ <= 0) {
     // load the test peptides
     DataManager::LoadPeptides(test_file_, test_includes_rt_, context_format_,
         test_psms_, test_aa_alphabet_);
@@ -558,6 +593,12 @@ int EludeCaller::Run() {
          << "should be carried out. In such a case please use the -j option. "
          << "The model will be trained using the peptides in " << train_file_ << endl;
   }
+  // the test peptides are not loaded when streaming, but their alphabet is needed
+  // to select the models in the library and to check the model before anything
+  // is written
+  if (stream_chunk_size_ > 0 && !test_file_.empty()) {
+    LoadTestAlphabet();
+  }
   // train a retention model
   if (!train_file_.empty()) {
     ProcessTrainData();
@@ -579,7 +620,7 @@ int EludeCaller::Run() {
       TrainRetentionModel();
     }
   } else if (automatic_model_sel_) {
-    if (!test_file_.empty()) {
+    if (!test_file_.empty() && stream_chunk_size_ <= 0) {
       ProcessTestData();
       processed_test_ = true;
     }
@@ -594,7 +635,7 @@ int EludeCaller::Run() {
   // save the model
   if (!save_model_file_.empty()) {
     if (rt_model_ != NULL && !rt_model_->IsModelNull()) {
-      rt_model_->SaveModelToFile(save_model_file_);
+      rt_model_->SaveModelToFile(save_model_file_, save_binary_model_);
     } else if (VERB >= 2) {
       cerr << "Warning: No trained model available. Nothing to save to "
            << save_model_file_ << endl;
@@ -622,6 +663,9 @@ int EludeCaller::Run() {
     SaveIndexToFile(best_model.first);
   }
   // test a model
+  if (!test_file_.empty() && stream_chunk_size_ > 0) {
+    return PredictTestStream(best_model.first);
+  }
   if (!test_file_.empty()) {
     // process the test data
     if (!processed_test_) {
@@ -724,6 +768,164 @@ int EludeCaller::Run() {
   return 0;
 }
 
+/* collect the alphabet of the test peptides without keeping the peptides */
+int EludeCaller::LoadTestAlphabet() {
+  if (VERB >= 4) {
+    cerr << "Loading the alphabet of " << test_file_ << "..." << endl;
+  }
+  ifstream in(test_file_.c_str(), ios::in);
+  if (in.fail()) {
+    ostringstream temp;
+    temp << "Error: Unable to open " << test_file_ << ". Execution aborted. " << endl;
+    throw MyException(temp.str());
+  }
+  vector<PSMDescription*> chunk;
+  while (DataManager::LoadPeptides(in, test_includes_rt_, context_format_,
+      stream_chunk_size_, chunk, test_aa_alphabet_) > 0) {
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      PSMDescription::deletePtr(chunk[i]);
+    }
+    chunk.clear();
+  }
+  if (VERB >= 4) {
+    cerr << "Done." << endl << endl;
+  }
+  return 0;
+}
+
+/* predict the retention times of the test peptides chunk by chunk; each chunk is
+ * written before the next one is read, so the output keeps the order of the input */
+int EludeCaller::PredictTestStream(const int &best_model_index) {
+  RetentionModel *model = automatic_model_sel_ ? NULL : rt_model_;
+  if (automatic_model_sel_ && best_model_index >= 0) {
+    model = rt_models_[best_model_index];
+  }
+  if (model == NULL || model->IsModelNull()) {
+    if (VERB >= 2) {
+      cerr << "Error: No model available to predict rt. Execution aborted." << endl;
+    }
+    return 0;
+  }
+  // the alphabet of the whole test file is known, so no chunk is written if
+  // any of them cannot be predicted
+  if (!model->IsIncludedInAlphabet(test_aa_alphabet_, ignore_ptms_)) {
+    if (VERB >= 2) {
+      cerr << "Error: the amino acids alphabet in the test data does not match "
+           <<"the ones used to train the model. Please use the -p option to ignore the ptms "
+           <<"in the test data data are were not present in the training set " << endl;
+    }
+    return 0;
+  }
+  // the calibration does not depend on the test peptides, so it is done first
+  if (linear_calibration_ && (automatic_model_sel_ || !load_model_file_.empty())) {
+    if (train_psms_.size() < 2) {
+      if (VERB >= 4) {
+        cerr << "Warning: No (enough) calibration peptides. Linear calibration "
+             << "cannot be performed " << endl;
+      }
+    } else {
+      if (model->PredictRT(train_aa_alphabet_, ignore_ptms_, "calibration psms",
+          train_psms_) != 0) {
+        if (VERB >= 2) {
+          cerr << "Error: the amino acids alphabet in training data does not match "
+               <<"the one used to train the model. Please use the -p option to ignore the ptms "
+               <<"that were not present in the set used to train the model " << endl;
+        }
+        return 0;
+      }
+      pair<vector<double> , vector<double> > rts = GetRTs(train_psms_);
+      lts = new LTSRegression();
+      lts->setData(rts.first, rts.second);
+      lts->runLTS();
+    }
+  }
+
+  ifstream in(test_file_.c_str(), ios::in);
+  if (in.fail()) {
+    ostringstream temp;
+    temp << "Error: Unable to open " << test_file_ << ". Execution aborted. " << endl;
+    throw MyException(temp.str());
+  }
+  ofstream out;
+  if (!output_file_.empty()) {
+    out.open(output_file_.c_str());
+    if (out.fail()) {
+      if (VERB >= 2) {
+        cerr << "Warning: Unable to open " << output_file_ << ". The output file cannot "
+             << "be generated. " << endl;
+      }
+      return 1;
+    }
+    DataManager::WriteOutHeader(out, test_includes_rt_);
+  }
+  if (VERB >= 4) {
+    cerr << "Predicting retention time for the test psms in chunks of "
+         << stream_chunk_size_ << " peptides..." << endl;
+  }
+  bool remove_non_enzymatic = remove_non_enzymatic_ && context_format_;
+  if (remove_non_enzymatic_ && !context_format_ && VERB >= 4) {
+    cerr << "Warning: non-enzymatic peptides cannot be detected unless the peptides"
+         << " are give in the format A.XXX.Y. All peptides are included in the"
+         << " subsequent analyses" << endl;
+  }
+  int number_predicted = 0, number_non_enzymatic = 0, ret = 0;
+  vector<PSMDescription*> chunk;
+  vector<double> predicted_rts;
+  while (ret == 0 && DataManager::LoadPeptides(in, test_includes_rt_, context_format_,
+      stream_chunk_size_, chunk, test_aa_alphabet_) > 0) {
+    vector<PSMDescription*> psms;
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      if (!remove_non_enzymatic || enzyme_->isEnzymatic(chunk[i]->peptide)) {
+        psms.push_back(chunk[i]);
+      } else {
+        ++number_non_enzymatic;
+      }
+    }
+    if (!psms.empty()) {
+      ret = model->PredictRT(test_aa_alphabet_, ignore_ptms_, psms, predicted_rts);
+    }
+    if (ret == 0) {
+      for (size_t i = 0; i < psms.size(); ++i) {
+        psms[i]->setPredictedRetentionTime(lts != NULL ?
+            lts->predict(predicted_rts[i]) : predicted_rts[i]);
+      }
+      if (out.is_open()) {
+        DataManager::WritePredictions(out, psms, test_includes_rt_);
+      } else if (VERB >= 2 && !supress_print_) {
+        PrintPredictions(psms);
+      }
+      number_predicted += psms.size();
+    }
+    for (size_t i = 0; i < chunk.size(); ++i) {
+      PSMDescription::deletePtr(chunk[i]);
+    }
+    chunk.clear();
+  }
+  // only if the test file changed after its alphabet was read; the partial output
+  // is removed rather than left truncated
+  if (ret != 0) {
+    if (out.is_open()) {
+      out.close();
+      remove(output_file_.c_str());
+    }
+    if (VERB >= 2) {
+      cerr << "Error: the amino acids alphabet in the test data does not match "
+           <<"the ones used to train the model. Please use the -p option to ignore the ptms "
+           <<"in the test data data are were not present in the training set " << endl;
+    }
+    return 1;
+  }
+  if (VERB >= 4) {
+    if (remove_non_enzymatic) {
+      cerr << number_non_enzymatic << " non-enzymatic peptides were removed from the "
+           << "test data" << endl;
+    }
+    cerr << "Retention time predicted for " << number_predicted << " peptides." << endl
+         << "Done." << endl << endl;
+  }
+  return 0;
+}
+
 void EludeCaller::PrintPredictions(const vector<PSMDescription*> &psms) const {
   vector<PSMDescription*>::const_iterator it = psms.begin();
   for( ; it != psms.end(); ++it)
@@ -749,6 +951,10 @@ int EludeCaller::AdjustLinearly(vector<PSMDescription*> &psms) {
 /* Load the best model from the library; the function returns a pair consisting of
  * the index of this model in the vector of models and the rank correlation
  * obtained on the calibration peptides using this model */
+/* The models of the library are loaded and predict the calibration psms in parallel,
+ * a batch of models at a time. The rank correlations are computed in the order of the
+ * files, as the calibration psms are sorted in the process, and only the best model
+ * found so far is kept. */
 pair<int, double> EludeCaller::AutomaticModelSelection() {
   vector<string> model_files = ListDirFiles(library_path_);
   if (VERB >= 4) {
@@ -762,69 +968,101 @@ pair<int, double> EludeCaller::AutomaticModelSelection() {
     return make_pair(-1, -1.0);
   }
 
-  double rank_correl = -1.0, best_correl = -1.0;
-  int best_index = -1, index = -1, original_index = -1;
-  if (train_psms_.size() <= 2) {
+  bool calibrate = train_psms_.size() > 2;
+  if (!calibrate) {
     if (VERB >= 3) {
       cerr << "Warning: not enough calibration psms available. First suitable"
            << " model available in the library will be selected. "<< endl << endl;
     }
   }
-  RetentionModel *m = new RetentionModel(the_normalizer_);
-  m->LoadModelFromFile(model_files[0]);
-  if (!m->IsIncludedInAlphabet(train_aa_alphabet_, ignore_ptms_) ||
-      !m->IsIncludedInAlphabet(test_aa_alphabet_, ignore_ptms_)) {
-    if (VERB >= 4) {
-      cerr << "Warning: inconsistent alphabet between model and data. "
-           << "Model discarded" << endl << endl;
+  DeleteRTModels();
+  RetentionModel *best_model = NULL;
+  double best_correl = -1.0;
+  int original_index = -1;
+  int number_files = model_files.size();
+  int batch_size = 1;
+#ifdef _OPENMP
+  if (calibrate) {
+    batch_size = omp_get_max_threads();
+  }
+#endif
+  for (int first = 0; first < number_files && (calibrate || best_model == NULL);
+       first += batch_size) {
+    int last = min(first + batch_size, number_files);
+    vector<RetentionModel*> models(last - first, (RetentionModel*) NULL);
+    vector< vector<double> > predicted_rts(last - first);
+    vector<string> errors(last - first);
+    vector<PSMDescription*> calibration_psms(train_psms_);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = first; i < last; ++i) {
+      RetentionModel *m = new RetentionModel(the_normalizer_);
+      try {
+        m->LoadModelFromFile(model_files[i]);
+        if (m->IsIncludedInAlphabet(train_aa_alphabet_, ignore_ptms_) &&
+            m->IsIncludedInAlphabet(test_aa_alphabet_, ignore_ptms_)) {
+          if (calibrate) {
+            m->PredictRT(train_aa_alphabet_, ignore_ptms_, calibration_psms,
+                predicted_rts[i - first]);
+          }
+          models[i - first] = m;
+          m = NULL;
+        }
+      } catch (const std::exception &e) {
+        errors[i - first] = e.what();
+      }
+      delete m;
     }
-  } else if (train_psms_.size() <= 2) {
-    rt_models_.push_back(m);
-    return make_pair(0, -1.0);
-  } else {
-    m->PredictRT(train_aa_alphabet_, ignore_ptms_, "calibration psms", train_psms_);
-    rt_models_.push_back(m);
-    rank_correl = ComputeRankCorrelation(train_psms_);
-    best_correl = rank_correl;
-    best_index = 0;
-    index = 0;
-    original_index = 0;
-  }
-  if (VERB >= 4) {
-    cerr << "-------------" << endl;
-  }
-  for(size_t i = 1; i < model_files.size(); ++i) {
-    m = new RetentionModel(the_normalizer_);
-    m->LoadModelFromFile(model_files[i]);
-    if (m->IsIncludedInAlphabet(train_aa_alphabet_, ignore_ptms_) &&
-        m->IsIncludedInAlphabet(test_aa_alphabet_, ignore_ptms_)) {
-      rt_models_.push_back(m);
-      ++index;
-      if (train_psms_.size() <= 2) {
-        return make_pair(0, -1.0);
+
+    for (int i = first; i < last; ++i) {
+      RetentionModel *m = models[i - first];
+      if (!errors[i - first].empty()) {
+        for (int j = i; j < last; ++j) {
+          delete models[j - first];
+        }
+        delete best_model;
+        throw MyException(errors[i - first]);
       }
-      m->PredictRT(train_aa_alphabet_, ignore_ptms_, "calibration psms", train_psms_);
-      rank_correl = ComputeRankCorrelation(train_psms_);
-      if (rank_correl > best_correl) {
-        best_correl = rank_correl;
-        best_index = index;
-        original_index = i;
+      if (m == NULL) {
+        if (VERB >= 4) {
+          cerr << "Warning: inconsistent alphabet between model and data. "
+               << "Model discarded" << endl << endl;
+        }
+      } else if (!calibrate) {
+        if (best_model == NULL) {
+          best_model = m;
+          original_index = i;
+        } else {
+          delete m;
+        }
+      } else {
+        for (size_t j = 0; j < calibration_psms.size(); ++j) {
+          calibration_psms[j]->setPredictedRetentionTime(predicted_rts[i - first][j]);
+        }
+        double rank_correl = ComputeRankCorrelation(train_psms_);
+        if (i == 0 || rank_correl > best_correl) {
+          delete best_model;
+          best_model = m;
+          best_correl = rank_correl;
+          original_index = i;
+        } else {
+          delete m;
+        }
+      }
+      if (VERB >= 4 && i != number_files - 1) {
+        cerr << "-------------" << endl;
       }
-    } else if (VERB >= 4) {
-        cerr << "Warning: inconsistent alphabet between model and data. "
-             << "Model discarded" << endl << endl;
-    }
-    if (VERB >= 4 &&  i != model_files.size() - 1) {
-       cerr << "-------------" << endl;
     }
   }
 
-  if (VERB >= 4 && best_index != -1.0) {
+  if (best_model == NULL) {
+    return make_pair(-1, best_correl);
+  }
+  rt_models_.push_back(best_model);
+  if (VERB >= 4) {
     cerr << "-------------------------" << endl;
     cerr << "Best model: " << model_files[original_index] << endl << endl;
   }
-
-  return make_pair(best_index, best_correl);
+  return make_pair(0, best_correl);
 }
 
 /* Return a list of files in a directory dir_name*/
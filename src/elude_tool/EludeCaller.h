@@ -55,6 +55,11 @@ class EludeCaller{
    int TrainRetentionModel();
    /* process the test data */
    int ProcessTestData();
+   /* collect the alphabet of the test peptides without keeping them in memory */
+   int LoadTestAlphabet();
+   /* predict the retention times of the test peptides chunk by chunk using the
+    * given model from the library (or the trained/loaded model) and write them out */
+   int PredictTestStream(const int &best_model_index);
    /* Load the best model from the library; the function returns a pair consisting of
     * the index of this model in the vector of models and the rank correlation
     * obtained on the calibration peptides using this model */
@@ -147,10 +152,14 @@ class EludeCaller{
    bool test_includes_rt_;
    /* file to save the model */
    std::string save_model_file_;
+   /* save the svr of the model in the binary format */
+   bool save_binary_model_;
    /* file to load a model from */
    std::string load_model_file_;
    /* the output file */
    std::string output_file_;
+   /* number of test peptides predicted at once; 0 if all are loaded at once */
+   int stream_chunk_size_;
    /* select the file from the library? */
    bool automatic_model_sel_;
    /* append the model to the library */
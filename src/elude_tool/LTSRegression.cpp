@@ -17,7 +17,6 @@
 #include <algorithm>
 #include <iostream>
 #include <stdlib.h>
-#include <time.h>
 #include <cmath>
 #include <float.h>
 #include "Globals.h"
@@ -25,6 +24,7 @@
 
 // initialize static variables
 int LTSRegression::noSubsets = 500;
+int LTSRegression::noBestSubsets = 10;
 // maximum difference between q2 and q1 to achieve convergence
 double LTSRegression::epsilon = 0.0001;
 // cardinal of |H|(percentage of the total number of points used to build the regression line)
@@ -56,149 +56,144 @@ void LTSRegression::setData(vector<double> & x, vector<double> & y) {
 }
 
 // for our case, constructing a random p-subset is equivalent to build the equation of a line through 2 randomly
-// chosen points
-vector<dataPoint> LTSRegression::getInitialHSubset() {
+// chosen points; the points of each start are drawn from its own counters of the stream key
+pair<double, double> LTSRegression::getInitialLine(uint64_t key, int start) const {
   double a, b;
   int i1, i2;
   int n = data.size();
-  // generate two random indices
-  i1 = PseudoRandom::lcg_rand() % n;
-  i2 = PseudoRandom::lcg_rand() % n;
-  while (i2 == i1) {
-    i2 = PseudoRandom::lcg_rand() % n;
+  uint64_t counter = 2 * static_cast<uint64_t>(start);
+  // generate two distinct random indices; the second one is drawn among the other n - 1 points
+  i1 = PseudoRandom::counter_rand(key, counter) % n;
+  i2 = PseudoRandom::counter_rand(key, counter + 1) % (n - 1);
+  if (i2 >= i1) {
+    ++i2;
   }
   // calculate the a and b of the equation of the line going through the two points selected above (y = ax + b)
   a = (data[i2].y - data[i1].y) / (data[i2].x - data[i1].x);
   b = data[i1].y - (data[i1].x * a);
-  // calculate the residuals and sort the data according to these values
-  fillResiduals(make_pair(a, b));
-  partial_sort(data.begin(),
-               data.begin() + h,
-               data.end(),
-               compareDataPoints);
-  return vector<dataPoint> (data.begin(), data.begin() + h);
+  return make_pair(a, b);
 }
 
 // fill the absolute values of the residuals
-void LTSRegression::fillResiduals(pair<double, double> par) {
-  for (int i = 0; i < data.size(); ++i) {
-    data[i].absr = abs(data[i].y - (par.first * data[i].x + par.second));
+void LTSRegression::fillResiduals(const pair<double, double>& par, vector<dataPoint>& buf) const {
+  for (int i = 0; i < buf.size(); ++i) {
+    buf[i].absr = abs(buf[i].y - (par.first * buf[i].x + par.second));
   }
 }
 
-// fit a line to the points in h using the least-squares method
-pair<double, double> LTSRegression::fitLSLine(vector<dataPoint> hdata) {
+// fit a line to the first h points in hdata using the least-squares method
+pair<double, double> LTSRegression::fitLSLine(const vector<dataPoint>& hdata) const {
   double sumxy = 0.0, sumx = 0.0, sumy = 0.0, sumxsq = 0.0;
   double a, b;
   for (int i = 0; i < h; ++i) {
     sumx += hdata[i].x;
     sumy += hdata[i].y;
     sumxy += hdata[i].x * hdata[i].y;
-    sumxsq += pow(hdata[i].x, 2);
+    sumxsq += hdata[i].x * hdata[i].x;
   }
-  a = ((h * sumxy) - (sumx * sumy)) / ((h * sumxsq) - (pow(sumx, 2)));
+  a = ((h * sumxy) - (sumx * sumy)) / ((h * sumxsq) - (sumx * sumx));
   b = (sumy / (double)h) - (a * (sumx / (double)h));
-  //cout << "a , b = " << a << ", " << b <<  endl;
   return make_pair(a, b);
 }
 
-// perform a C step (fit LS line, calculate residuals, return the h points with the lowest abs(residual))
-vector<dataPoint> LTSRegression::performCstep(vector<dataPoint> hOld) {
-  pair<double, double> par;
-  // fit a least-squares regression line using data points from hold
-  par = fitLSLine(hOld);
+// perform a C step (calculate residuals, select the h points with the lowest abs(residual), fit LS line
+// through them); q is set to the sum of squared residuals of the selected points to the new line
+pair<double, double> LTSRegression::performCstep(const pair<double, double>& par,
+    vector<dataPoint>& buf, double& q) const {
   // calculate and fill the residuals for all the data points
-  fillResiduals(par);
-  // sort the data points according to absolute values of residuals
-  partial_sort(data.begin(),
-               data.begin() + h,
-               data.end(),
-               compareDataPoints);
-  return vector<dataPoint> (data.begin(), data.begin() + h);
-}
-
-// calculate the sum of squared residuals
-double LTSRegression::calculateQ() {
-  double res = 0.0;
+  fillResiduals(par, buf);
+  // move the h points with the lowest abs(residuals) to the front; their order does not matter
+  nth_element(buf.begin(), buf.begin() + (h - 1), buf.end(), compareDataPoints);
+  // fit a least-squares regression line using the selected data points
+  pair<double, double> newPar = fitLSLine(buf);
+  q = 0.0;
   for (int i = 0; i < h; ++i) {
-    res += pow(data[i].absr, 2);
+    double r = buf[i].y - (newPar.first * buf[i].x + newPar.second);
+    q += r * r;
   }
-  return res;
+  return newPar;
 }
 
 void LTSRegression::runLTS() {
-  double q1, q2, bestq = DBL_MAX, largestQ = 0.0;
-  pair<double, double> par;
-  vector<dataPoint> hold, hnew, besth(data.begin(), data.begin() + h);
-  vector<vector<dataPoint> > best10Subsets;
-  int noBestSubsets = 0, indexLargestQ = 0;
-  vector<double> Q;
+  int n = data.size();
   if (VERB > 3) {
     cerr << "Regression parameters: " << endl;
     cerr << "   h = " << h << " = " << percentageH * 100
         << "%, no_initial_subsets = " << noSubsets << ", epsilon = "
         << epsilon << endl;
   }
-  srand(time(NULL));
+  // at least two points are needed to draw the initial lines
+  if (n < 2 || h < 1) {
+    return;
+  }
+  // the random starts are independent of each other and of the number of threads
+  uint64_t key = PseudoRandom::lcg_rand();
+  vector<pair<double, double> > lines(noSubsets);
+  vector<double> Q(noSubsets);
+  #pragma omp parallel
+  {
+    // every thread reorders its own copy of the data; the copy is reset for each start, so the
+    // order in which the points are selected and summed does not depend on the previous starts
+    vector<dataPoint> buf(data.size());
+    #pragma omp for schedule(static)
+    for (int i = 0; i < noSubsets; ++i) {
+      double q;
+      buf = data;
+      // get the first subset, apply 2 C-steps and keep the line fitted to the last subset and its Q
+      pair<double, double> par = performCstep(getInitialLine(key, i), buf, q);
+      par = performCstep(par, buf, q);
+      lines[i] = performCstep(par, buf, Q[i]);
+    }
+  }
+  // select the best 10 subsets, in the order of the starts
+  vector<int> best;
+  double largestQ = 0.0;
+  int indexLargestQ = 0;
   for (int i = 0; i < noSubsets; ++i) {
-    // get the first subset (data will be sorted according to abs(residuals)
-    hold = getInitialHSubset();
-    // apply 2 C-steps
-    hnew = performCstep(hold);
-    hold = performCstep(hnew);
-    // compute Q
-    par = fitLSLine(hold);
-    fillResiduals(par);
-    q1 = calculateQ();
-    // include the current subset in the list of best 10 subsets if necessary
-    if (noBestSubsets < 10) {
-      best10Subsets.push_back(hold);
-      Q.push_back(q1);
-      if (q1 > largestQ) {
-        largestQ = q1;
-        indexLargestQ = noBestSubsets;
+    if (best.size() < noBestSubsets) {
+      if (Q[i] > largestQ) {
+        largestQ = Q[i];
+        indexLargestQ = best.size();
       }
-      noBestSubsets++;
-    } else {
-      if (q1 < largestQ) {
-        best10Subsets[indexLargestQ] = hold;
-        Q[indexLargestQ] = q1;
-        largestQ = Q[0];
-        indexLargestQ = 0;
-        for (int i = 1; i < Q.size(); ++i)
-          if (Q[i] > largestQ) {
-            largestQ = Q[i];
-            indexLargestQ = i;
-          }
+      best.push_back(i);
+    } else if (Q[i] < largestQ) {
+      best[indexLargestQ] = i;
+      largestQ = Q[best[0]];
+      indexLargestQ = 0;
+      for (int j = 1; j < best.size(); ++j) {
+        if (Q[best[j]] > largestQ) {
+          largestQ = Q[best[j]];
+          indexLargestQ = j;
+        }
       }
     }
   }
   // for the best 10 h-subset perform C-steps until convergence
-  for (int j = 0; j < best10Subsets.size(); ++j) {
-    hold = best10Subsets[j];
-    par = fitLSLine(hold);
-    fillResiduals(par);
-    q2 = calculateQ();
-    do {
-      q1 = q2;
-      hnew = performCstep(hold);
-      par = fitLSLine(hnew);
-      fillResiduals(par);
-      q2 = calculateQ();
-      hold = hnew;
-    } while (abs(q2 - q1) > epsilon);
-    if (q2 < bestq) {
-      regCoefficients = par;
-      bestq = q2;
-      besth = hnew;
+  vector<pair<double, double> > bestLines(best.size());
+  vector<double> bestQ(best.size());
+  #pragma omp parallel
+  {
+    vector<dataPoint> buf(data.size());
+    #pragma omp for schedule(dynamic, 1)
+    for (int j = 0; j < best.size(); ++j) {
+      buf = data;
+      pair<double, double> par = lines[best[j]];
+      double q1, q2 = Q[best[j]];
+      do {
+        q1 = q2;
+        par = performCstep(par, buf, q2);
+      } while (abs(q2 - q1) > epsilon);
+      bestLines[j] = par;
+      bestQ[j] = q2;
+    }
+  }
+  double bestq = DBL_MAX;
+  for (int j = 0; j < best.size(); ++j) {
+    if (bestQ[j] < bestq) {
+      regCoefficients = bestLines[j];
+      bestq = bestQ[j];
     }
   }
-  /*if (VERB > 3)
-   {
-   cerr << "Data points used to generate the regression line: " << endl;
-   printVector(besth);
-   cerr << "Q = " << bestq << endl;
-   }*/
   if (VERB > 2) {
     cerr << "Final LTS equation: y = " << regCoefficients.first
         << " * x + " << regCoefficients.second << endl;
@@ -25,6 +25,7 @@
 #ifndef LTSREGRESSION_H_
 #define LTSREGRESSION_H_
 
+#include <stdint.h>
 #include <utility>
 #include <vector>
 
@@ -49,21 +50,23 @@ class LTSRegression {
     }
     // set the data points used for regression
     void setData(vector<double> & x, vector<double> & y);
-    // construct an initial random p-subset; data will be sorted, and the first h elements are returned
-    vector<dataPoint> getInitialHSubset();
-    // fill the absolute values of residuals for all the data points using the line ax + b, with a = par.first, b = par.second
-    void fillResiduals(pair<double, double> par);
-    // fit a line using the least-squares method using h; return the a and b of the model
-    pair<double, double> fitLSLine(vector<dataPoint> h);
-    // perform a C-step starting with h (build the regression line, compute abs(residuals), sort data according to abs(residuals))
-    // it returns the new h
-    vector<dataPoint> performCstep(vector<dataPoint> h);
+    // construct an initial random p-subset for the start-th random start; this is equivalent to the line
+    // through two points drawn from the stream key, so the starts do not depend on each other
+    pair<double, double> getInitialLine(uint64_t key, int start) const;
+    // fill the absolute values of residuals for all the data points in buf using the line ax + b, with
+    // a = par.first, b = par.second
+    void fillResiduals(const pair<double, double>& par, vector<dataPoint>& buf) const;
+    // fit a line using the least-squares method using the first h points of hdata; return the a and b of the model
+    pair<double, double> fitLSLine(const vector<dataPoint>& hdata) const;
+    // perform a C-step starting with the line par (compute abs(residuals), move the h points with the lowest
+    // abs(residuals) to the front of buf and build the regression line through them); it returns the new
+    // line and sets q to the sum of squared residuals of the new h-subset
+    pair<double, double> performCstep(const pair<double, double>& par, vector<dataPoint>& buf,
+                                      double& q) const;
     // predict the y values of x
     double predict(double x) {
       return ((regCoefficients.first * x) + regCoefficients.second);
     }
-    // calculate the squares of the residuals
-    double calculateQ();
     // apply LTS regression
     void runLTS();
     // get functions
@@ -81,6 +84,8 @@ class LTSRegression {
   protected:
     // the max number of initial sets H1 generated; be default we use 500 (as suggested in the article)
     static int noSubsets;
+    // the number of best initial sets iterated until convergence; 10 as suggested in the article
+    static int noBestSubsets;
     // maximum difference to acheive convergence
     static double epsilon;
     // cardinal of H (percentage of the total number of points used to build the regression line)
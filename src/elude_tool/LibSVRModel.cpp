@@ -42,19 +42,15 @@ const double LibSVRModel::kLinearGridC[] = {pow(2., -3), pow(2., -2), pow(2., -1
 /* always 3-fold cross-validation */
 const int LibSVRModel::k = 3;
 
-LibSVRModel::LibSVRModel() : svr_(NULL) {
+LibSVRModel::LibSVRModel() {
   InitSVRParameters(RBF_SVR);
 }
 
-LibSVRModel::LibSVRModel(const SVRType &kernel_type) : svr_(NULL) {
+LibSVRModel::LibSVRModel(const SVRType &kernel_type) {
   InitSVRParameters(kernel_type);
 }
 
 LibSVRModel::~LibSVRModel() {
-  if (svr_) {
-    svm_destroy_model(svr_);
-    svr_ = NULL;
-  }
 }
 
 /* initialize the SVR parameter for a RBF kernel*/
@@ -118,17 +114,30 @@ int LibSVRModel::setRBFSVRParam(const double &eps, const double &C, const double
 
 /* train a svr model */
 int LibSVRModel::TrainModel(const std::vector<PSMDescription*> &train_psms, const int &number_features) {
-  if (svr_) {
-    svm_destroy_model(svr_);
-  }
-  svr_ = libsvm_wrapper::TrainModel(train_psms, number_features, svr_parameters_);
+  // the trained model points to the features of the psms; keep a packed copy instead
+  svm_model *svr = libsvm_wrapper::TrainModel(train_psms, number_features, svr_parameters_);
+  svr_ = SharedSVMModel(svr);
+  svm_destroy_model(svr);
   return 0;
 }
 
 /* predict retention time using the trained model */
 double LibSVRModel::PredictRT(const int &number_features, double *features) {
-  if (svr_) {
-    return libsvm_wrapper::PredictRT(svr_, number_features, features);
+  if (!svr_.isNull()) {
+    return libsvm_wrapper::PredictRT(svr_.get(), number_features, features);
+  }
+  else {
+    ostringstream temp;
+    temp << "Error : No SVR model available. Execution aborted." << endl;
+    throw MyException(temp.str());
+  }
+}
+
+/* predict retention times for a set of psms */
+void LibSVRModel::PredictRT(const int &number_features, const std::vector<PSMDescription*> &psms,
+                            std::vector<double> &predictions) {
+  if (!svr_.isNull()) {
+    libsvm_wrapper::PredictRT(svr_.get(), number_features, psms, predictions);
   }
   else {
     ostringstream temp;
@@ -139,12 +148,25 @@ double LibSVRModel::PredictRT(const int &number_features, double *features) {
 
 /* predict rt for a set of peptides and return the value of the error */
 double LibSVRModel::EstimatePredictionError(const int &number_features, const vector<PSMDescription*> &test_psms) {
-  double ms_error = 0.0, predicted_rt = 0.0, deviation;
+  if (svr_.isNull()) {
+    ostringstream temp;
+    temp << "Error : No SVR model available. Execution aborted." << endl;
+    throw MyException(temp.str());
+  }
+  return EstimatePredictionError(svr_.get(), number_features, test_psms);
+}
+
+/* predict rt for a set of peptides using the given svr and return the value of the error */
+double LibSVRModel::EstimatePredictionError(const svm_model *svr, const int &number_features,
+                                            const vector<PSMDescription*> &test_psms) {
+  double ms_error = 0.0, deviation;
+  vector<double> predicted_rts;
+  libsvm_wrapper::PredictRT(svr, number_features, test_psms, predicted_rts);
+  vector<double>::const_iterator predicted_rt = predicted_rts.begin();
   vector<PSMDescription*>::const_iterator it = test_psms.begin();
 
-  for ( ; it != test_psms.end(); ++it) {
-    predicted_rt =  PredictRT(number_features, (*it)->getRetentionFeatures());
-    deviation = predicted_rt - (*it)->getRetentionTime();
+  for ( ; it != test_psms.end(); ++it, ++predicted_rt) {
+    deviation = *predicted_rt - (*it)->getRetentionTime();
     ms_error += deviation * deviation;
   }
   return ms_error / (double)test_psms.size();
@@ -152,27 +174,98 @@ double LibSVRModel::EstimatePredictionError(const int &number_features, const ve
 
 /* perform k-fold cross validation; return error value */
 double LibSVRModel::ComputeKFoldValidation(const std::vector<PSMDescription*> &psms, const int &number_features) {
-  vector<PSMDescription*> train, test;
-  int len = psms.size();
-  // sum of prediction errors
-  double sum_pek = 0.0, pek = 0.0;
+  vector<double> errors;
+  ComputeKFoldValidation(psms, number_features, vector<svm_parameter>(1, svr_parameters_), errors);
+  return errors[0];
+}
 
+/* perform k-fold cross validation for each of the parameters; every parameter and fold
+ * is trained as a separate task on its own view of the psms. The models are not stored in
+ * svr_, and the errors are summed in the order of the folds such that they do not depend
+ * on the number of threads. The parameters are evaluated gamma by gamma; unless there are
+ * too many psms, the kernel matrix of all psms is computed once per gamma and shared by the
+ * folds and the values of C and epsilon */
+void LibSVRModel::ComputeKFoldValidation(const std::vector<PSMDescription*> &psms, const int &number_features,
+                                         const std::vector<svm_parameter> &parameters, std::vector<double> &errors) {
+  vector< vector<int> > train(k);
+  vector< vector<PSMDescription*> > test(k);
+  int len = psms.size();
+  vector<svm_node> x(len);
+  vector<double> y(len);
+  for (int j = 0; j < len; ++j) {
+    x[j].values = psms[j]->getRetentionFeatures();
+    x[j].dim = number_features;
+    y[j] = psms[j]->getRetentionTime();
+  }
+  // get training and testing sets
   for (int i = 0; i < k; ++i) {
-    train.clear();
-    test.clear();
-     // get training and testing sets
-     for (int j = 0; j < len; ++j) {
-       if ((j % k) == i) {
-         test.push_back(psms[j]);
-       } else {
-         train.push_back(psms[j]);
-       }
-     }
-     TrainModel(train, number_features);
-     pek = EstimatePredictionError(number_features, test);
-     sum_pek += pek;
-   }
-  return sum_pek / (double)k;
+    for (int j = 0; j < len; ++j) {
+      if ((j % k) == i) {
+        test[i].push_back(psms[j]);
+      } else {
+        train[i].push_back(j);
+      }
+    }
+  }
+  svm_kernel_matrix *kernel = NULL;
+  if (len > 0 && !parameters.empty()) {
+    kernel = svm_create_kernel_matrix(&x[0], len, parameters[0].kernel_type);
+  }
+  int number_tasks = parameters.size() * k;
+  vector<double> pek(number_tasks, 0.0);
+  vector<string> task_errors(number_tasks);
+  vector<bool> done(parameters.size(), false);
+  for (size_t first = 0; first < parameters.size(); ++first) {
+    if (done[first]) {
+      continue;
+    }
+    // the tasks having the same kernel as the first parameters not evaluated yet
+    vector<int> tasks;
+    for (size_t p = first; p < parameters.size(); ++p) {
+      if (!done[p] && parameters[p].kernel_type == parameters[first].kernel_type &&
+          (parameters[p].kernel_type != RBF || parameters[p].gamma == parameters[first].gamma)) {
+        done[p] = true;
+        for (int i = 0; i < k; ++i) {
+          tasks.push_back(p * k + i);
+        }
+      }
+    }
+    svm_kernel_matrix *task_kernel = NULL;
+    if (kernel != NULL && parameters[first].kernel_type == kernel->kernel_type) {
+      if (kernel->kernel_type == RBF) {
+        svm_set_kernel_matrix_gamma(kernel, parameters[first].gamma);
+      }
+      task_kernel = kernel;
+    }
+    int number_group_tasks = tasks.size();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < number_group_tasks; ++t) {
+      int task = tasks[t];
+      int i = task % k;
+      try {
+        svm_model *svr = libsvm_wrapper::TrainModel(x, y, train[i], task_kernel, parameters[task / k]);
+        pek[task] = EstimatePredictionError(svr, number_features, test[i]);
+        svm_destroy_model(svr);
+      } catch (MyException &e) {
+        task_errors[task] = e.what();
+      }
+    }
+  }
+  svm_destroy_kernel_matrix(kernel);
+  for (int task = 0; task < number_tasks; ++task) {
+    if (!task_errors[task].empty()) {
+      throw MyException(task_errors[task]);
+    }
+  }
+  errors.assign(parameters.size(), 0.0);
+  for (size_t p = 0; p < parameters.size(); ++p) {
+    // sum of prediction errors
+    double sum_pek = 0.0;
+    for (int i = 0; i < k; ++i) {
+      sum_pek += pek[p * k + i];
+    }
+    errors[p] = sum_pek / (double)k;
+  }
 }
 
 /* calibrate the values of the parameters for a linear SVR; the values of the best parameters
@@ -180,25 +273,28 @@ double LibSVRModel::ComputeKFoldValidation(const std::vector<PSMDescription*> &p
 int LibSVRModel::CalibrateLinearModel(const std::vector<PSMDescription*> &calibration_psms,
                                       const int &number_features) {
   double best_c, best_e;
-  double best_error = 1e100, error;
+  double best_error = 1e100;
   int size_grid_c = sizeof(kLinearGridC) / sizeof(kLinearGridC[0]);
   int size_grid_e = sizeof(kGridEpsilon) / sizeof(kGridEpsilon[0]);
-  //int total_steps = grid_c.size() * grid_e.size();
-  //int step = 1;
+  vector<svm_parameter> grid;
+  vector<double> errors;
 
   for(int i = 0; i < size_grid_c; ++i) {
     for(int j = 0; j < size_grid_e; ++j) {
-      //++step;
       svr_parameters_.C = kLinearGridC[i];
       svr_parameters_.p = kGridEpsilon[j];
-      error = ComputeKFoldValidation(calibration_psms, number_features);
-      //cout << "c, epsilon = " << kLinearGridC[i] << ", " << kGridEpsilon[j] << endl;
-      //cout << "err = " << error << "\n" << endl;
-      if (error < best_error) {
-        best_error = error;
-        best_c = kLinearGridC[i];
-        best_e = kGridEpsilon[j];
-      }
+      grid.push_back(svr_parameters_);
+    }
+  }
+  // evaluate all the points of the grid at once
+  ComputeKFoldValidation(calibration_psms, number_features, grid, errors);
+  for(size_t i = 0; i < grid.size(); ++i) {
+    //cout << "c, epsilon = " << grid[i].C << ", " << grid[i].p << endl;
+    //cout << "err = " << errors[i] << "\n" << endl;
+    if (errors[i] < best_error) {
+      best_error = errors[i];
+      best_c = grid[i].C;
+      best_e = grid[i].p;
     }
   }
   svr_parameters_.C = best_c;
@@ -211,32 +307,35 @@ int LibSVRModel::CalibrateLinearModel(const std::vector<PSMDescription*> &calibr
 int LibSVRModel::CalibrateRBFModel(const std::vector<PSMDescription*> &calibration_psms,
                                    const int &number_features) {
   double best_c, best_e, best_g;
-  double best_error = 1e100, error;
+  double best_error = 1e100;
   int size_grid_c = sizeof(kGridC) / sizeof(kGridC[0]);
   int size_grid_e = sizeof(kGridEpsilon) / sizeof(kGridEpsilon[0]);
   int size_grid_g = sizeof(kGridGamma) / sizeof(kGridGamma[0]);
-  //int total_steps = grid_c.size() * grid_e.size();
-  //int step = 1;
+  vector<svm_parameter> grid;
+  vector<double> errors;
 
   for(int i = 0; i < size_grid_c; ++i) {
     for(int j = 0; j < size_grid_e; ++j) {
       for(int p = 0; p < size_grid_g; ++p) {
-        //++step;
         svr_parameters_.C = kGridC[i];
         svr_parameters_.p = kGridEpsilon[j];
         svr_parameters_.gamma = kGridGamma[p];
-        error = ComputeKFoldValidation(calibration_psms, number_features);
-        //cout << "c, epsilon, gamma = " << kGridC[i] << ", " << kGridEpsilon[j] << ", " << kGridGamma[p] << endl;
-        //cout << "err = " << error << "\n" << endl;
-        if (error < best_error) {
-          best_error = error;
-          best_c = kGridC[i];
-          best_e = kGridEpsilon[j];
-          best_g = kGridGamma[p];
-        }
+        grid.push_back(svr_parameters_);
       }
     }
   }
+  // evaluate all the points of the grid at once
+  ComputeKFoldValidation(calibration_psms, number_features, grid, errors);
+  for(size_t i = 0; i < grid.size(); ++i) {
+    //cout << "c, epsilon, gamma = " << grid[i].C << ", " << grid[i].p << ", " << grid[i].gamma << endl;
+    //cout << "err = " << errors[i] << "\n" << endl;
+    if (errors[i] < best_error) {
+      best_error = errors[i];
+      best_c = grid[i].C;
+      best_e = grid[i].p;
+      best_g = grid[i].gamma;
+    }
+  }
   svr_parameters_.C = best_c;
   svr_parameters_.p = best_e;
   svr_parameters_.gamma = best_g;
@@ -258,17 +357,39 @@ int LibSVRModel::CalibrateModel(const std::vector<PSMDescription*> &calibration_
 
 // save a model
 int LibSVRModel::SaveModel(FILE *fp) {
-  libsvm_wrapper::SaveModel(fp, svr_);
+  libsvm_wrapper::SaveModel(fp, svr_.get());
   return 0;
 }
 
+// save a model in the binary format
+int LibSVRModel::SaveBinaryModel(FILE *fp) {
+  return svr_.save(fp);
+}
+
 // load a model
 int LibSVRModel::LoadModel(FILE *fp) {
-  if (svr_ != NULL) {
-    svm_destroy_model(svr_);
+  svm_model *svr = libsvm_wrapper::LoadModel(fp);
+  if (svr == NULL) {
+    ostringstream temp;
+    temp << "Error: Unable to read the SVR model. Execution aborted." << endl;
+    throw MyException(temp.str());
   }
-  svr_ = libsvm_wrapper::LoadModel(fp);
-  svr_parameters_ = svr_->param;
+  svr_ = SharedSVMModel(svr);
+  svr_parameters_ = svr->param;
+  svm_destroy_model(svr);
+  return SetKernelType();
+}
+
+// load a model in the binary format by mapping the file; fp is positioned after the model
+int LibSVRModel::LoadBinaryModel(const std::string &file_name, FILE *fp) {
+  size_t size = svr_.load(file_name);
+  fseek(fp, size, SEEK_SET);
+  svr_parameters_ = svr_.get()->param;
+  return SetKernelType();
+}
+
+// set the kernel type after a model was loaded
+int LibSVRModel::SetKernelType() {
   int type = svr_parameters_.kernel_type;
   if (type == 0) {
     kernel_ = LINEAR_SVR;
@@ -281,4 +402,5 @@ int LibSVRModel::LoadModel(FILE *fp) {
     
     throw MyException(temp.str());
   }
+  return 0;
 }
@@ -27,6 +27,7 @@
 
 #include "Globals.h"
 #include "svm.h"
+#include "SharedSVMModel.h"
 #include "SVRModel.h"
 
 class PSMDescription;
@@ -54,16 +55,24 @@ class LibSVRModel : public SVRModel {
    /* set epsilon, C, gamma */
    int setRBFSVRParam(const double &eps, const double &C, const double &gamma);
    /* check if the model is null */
-   inline bool IsModelNull() const { svr_ == NULL ? true : false; }
+   inline bool IsModelNull() const { return svr_.isNull(); }
    /* train a svr model */
    virtual int TrainModel(const std::vector<PSMDescription*> &train_psms,
                           const int &number_features);
    /* predict retention time using the trained model */
    virtual double PredictRT(const int &number_features, double *features);
+   /* predict retention times for a set of psms */
+   virtual void PredictRT(const int &number_features, const std::vector<PSMDescription*> &psms,
+                          std::vector<double> &predictions);
    /* predict rt for a set of peptides and return the value of the error */
    double EstimatePredictionError(const int &number_features, const std::vector<PSMDescription*> &test_psms);
+   static double EstimatePredictionError(const svm_model *svr, const int &number_features,
+                                         const std::vector<PSMDescription*> &test_psms);
    /* perform k-fold cross validation; return error value */
    double ComputeKFoldValidation(const std::vector<PSMDescription*> &psms, const int &number_features);
+   /* perform k-fold cross validation for several parameters in parallel; errors[i] is the error for parameters[i] */
+   void ComputeKFoldValidation(const std::vector<PSMDescription*> &psms, const int &number_features,
+                               const std::vector<svm_parameter> &parameters, std::vector<double> &errors);
    /* calibrate the values of the parameters for a linear SVR; the values of the best parameters
     * are stored in the svr_parameters_ member */
    int CalibrateLinearModel(const std::vector<PSMDescription*> &calibration_psms, const int &number_features);
@@ -75,8 +84,10 @@ class LibSVRModel : public SVRModel {
                               const int &number_features);
   /* save a svr model */
    virtual int SaveModel(FILE *fp);
+   virtual int SaveBinaryModel(FILE *fp);
    /* load a svr model */
    virtual int LoadModel(FILE *fp);
+   virtual int LoadBinaryModel(const std::string &file_name, FILE *fp);
 
    /* Accessors and mutators */
    inline svm_parameter svr_parameters() { return svr_parameters_; }
@@ -84,8 +95,11 @@ class LibSVRModel : public SVRModel {
  private:
    /* the type of the kernel; could be linear or RBF */
    SVRType kernel_;
-   /* svr structure */
-   svm_model *svr_;
+   /* set kernel_ from the parameters of a loaded model */
+   int SetKernelType();
+
+   /* svr structure; packed, so that it does not depend on the training psms */
+   SharedSVMModel svr_;
    /* parameters of the svr */
    svm_parameter svr_parameters_;
 };
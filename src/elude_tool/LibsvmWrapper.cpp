@@ -54,6 +54,40 @@ svm_model* libsvm_wrapper::TrainModel(const std::vector<PSMDescription*> &psms,
   return svr_model;
 }
 
+svm_model* libsvm_wrapper::TrainModel(const std::vector<svm_node> &x, const std::vector<double> &y,
+                                      const std::vector<int> &indices, const svm_kernel_matrix *kernel,
+                                      const svm_parameter &parameter) {
+  svm_model *svr_model;
+  int number_examples = indices.size();
+  svm_parameter kernel_parameter = parameter;
+  if (kernel != NULL) {
+    kernel_parameter.kernel_type = PRECOMPUTED;
+  }
+  svm_problem data;
+  data.l = number_examples;
+  data.x = new svm_node[number_examples];
+  data.y = new double[number_examples];
+  for (int i = 0; i < number_examples; i++) {
+    data.x[i] = (kernel != NULL) ? kernel->rows[indices[i]] : x[indices[i]];
+    data.y[i] = y[indices[i]];
+  }
+  char const *error_message = svm_check_parameter(&data, &kernel_parameter);
+  if (error_message != NULL) {
+    delete[] data.x;
+    delete[] data.y;
+    ostringstream temp;
+    temp << "Error : Incorrect parameters for the SVR. Execution aborted. " << endl;
+    throw MyException(temp.str());
+  }
+  svr_model = svm_train(&data, &kernel_parameter);
+  delete[] data.x;
+  delete[] data.y;
+  if (kernel != NULL) {
+    svm_restore_kernel_matrix_model(kernel, svr_model);
+  }
+  return svr_model;
+}
+
 double libsvm_wrapper::PredictRT(const svm_model* svr, const int &number_features, double *features) {
   svm_node node;
   node.values = features;
@@ -62,6 +96,19 @@ double libsvm_wrapper::PredictRT(const svm_model* svr, const int &number_feature
   return svm_predict(svr, &node);
 }
 
+void libsvm_wrapper::PredictRT(const svm_model* svr, const int &number_features,
+                               const std::vector<PSMDescription*> &psms, std::vector<double> &predictions) {
+  std::vector<svm_node> nodes(psms.size());
+  for (size_t i = 0; i < psms.size(); i++) {
+    nodes[i].values = psms[i]->getRetentionFeatures();
+    nodes[i].dim = number_features;
+  }
+  predictions.resize(psms.size());
+  if (!psms.empty()) {
+    svm_predict_batch(svr, &nodes[0], nodes.size(), &predictions[0]);
+  }
+}
+
 int libsvm_wrapper::SaveModel(FILE* fp, const svm_model* model) {
   /*FILE* fp = fopen(model_file_name, "w");
    if (fp == NULL) {
@@ -27,12 +27,21 @@
 class PSMDescription;
 struct svm_parameter;
 struct svm_model;
+struct svm_node;
+struct svm_kernel_matrix;
 
 namespace libsvm_wrapper {
   /* train a svr */
   svm_model* TrainModel(const std::vector<PSMDescription*> &psms, const int &number_features, const svm_parameter &parameter);
+  /* train a svr on the vectors x[indices[i]]; if a kernel matrix of x is given, the svr is trained
+   * on its rows and then turned into a model of x */
+  svm_model* TrainModel(const std::vector<svm_node> &x, const std::vector<double> &y, const std::vector<int> &indices,
+                        const svm_kernel_matrix *kernel, const svm_parameter &parameter);
   /* predict the retention time of psm using the provided svr */
   double PredictRT(const svm_model* svr, const int &number_features, double *features);
+  /* predict the retention times of a set of psms at once */
+  void PredictRT(const svm_model* svr, const int &number_features, const std::vector<PSMDescription*> &psms,
+                 std::vector<double> &predictions);
   /* save/load a model to/from a file*/
   int SaveModel(FILE* fp, const svm_model* model);
   svm_model* LoadModel(FILE* fp);
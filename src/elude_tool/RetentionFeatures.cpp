@@ -23,6 +23,7 @@
  */
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <iostream>
 #include <algorithm>
@@ -57,6 +58,31 @@ const string RetentionFeatures::kGroupNames[] = {"No posttranslationally modifie
 /* whenever a modified peptide is not identified, use the unmodified instead? */
 bool RetentionFeatures::ignore_ptms_ = false;
 
+/* the index features are not defined for a peptide without amino acids */
+static void CheckPeptideLength(const string &peptide, const int &len) {
+  if (len == 0) {
+    ostringstream temp;
+    temp << "Error: the peptide " << peptide << " does not contain any amino acid. "
+         << "Execution aborted." << endl;
+    throw MyException(temp.str());
+  }
+}
+
+/* the number of each symbol of the alphabet in an encoded peptide, used by FillAAFeatures
+ * and the feature groups */
+static double* CountAminoAcids(const int *codes, const int &len, const vector<int> &aa_position,
+                               const int &number_aa, double *features) {
+  for(int i = 0; i < number_aa; ++i) {
+    features[i] = 0.0;
+  }
+  for(int i = 0; i < len; ++i) {
+    if (aa_position[codes[i]] >= 0) {
+      ++features[aa_position[codes[i]]];
+    }
+  }
+  return features + number_aa;
+}
+
 RetentionFeatures::RetentionFeatures() {
   string aa_alphabet[] = {"A", "C", "D", "E", "F", "G", "H", "I", "K", "L", "M", "N", "P", "Q", "R", "S", "T", "V", "W", "Y"};
   amino_acids_alphabet_.assign(aa_alphabet, aa_alphabet + 20);
@@ -150,31 +176,22 @@ int RetentionFeatures::GetTotalNumberFeatures() const {
 }
 
 /**************************** INDEX FUNCTIONS **************************************/
-/* fill all the features of an index; return a pointer to the next element in the feature table */
+/* fill all the features of an index; return a pointer to the next element in the feature table.
+ * The peptide is encoded and the features are computed as for a batch of peptides */
 double* RetentionFeatures::ComputeIndexFeatures(const string &peptide, const map<string, double> &index, const set<string> &polar_aa,
                            const set<string> &hydrophobic_aa, double *features) {
-  *(features++) = IndexSum(peptide, index);
-  *(features++) = IndexAvg(peptide, index);
-  *(features++) = IndexN(peptide, index);
-  *(features++) = IndexC(peptide, index);
-  *(features++) = IndexNearestNeigbour(peptide, index, polar_aa);
-  *(features++) = IndexMaxPartialSum(peptide, index, 5);
-  *(features++) = IndexMaxPartialSum(peptide, index, 2);
-  *(features++) = IndexMinPartialSum(peptide, index, 5);
-  *(features++) = IndexMinPartialSum(peptide, index, 2);
-  *(features++) = IndexMaxHydrophobicSideHelix(peptide, index);
-  *(features++) = IndexMinHydrophobicSideHelix(peptide, index);
-  *(features++) = IndexMaxHydrophobicMoment(peptide, index, 100, 11);
-  *(features++) = IndexMaxHydrophobicMoment(peptide, index, 180, 11);
-  *(features++) = IndexMinHydrophobicMoment(peptide, index, 100, 11);
-  *(features++) = IndexMinHydrophobicMoment(peptide, index, 180, 11);
-  *(features++) = IndexSumSquaredDiff(peptide, index);
-  *(features++) = NumberTypeAA(peptide, polar_aa);
-  *(features++) = NumberConsecTypeAA(peptide, polar_aa);
-  *(features++) = NumberTypeAA(peptide, hydrophobic_aa);
-  *(features++) = NumberConsecTypeAA(peptide, hydrophobic_aa);
-
-  return features;
+  map<string, int> symbol_ids;
+  vector<string> symbols;
+  vector<int> codes;
+  EncodePeptide(peptide, symbol_ids, symbols, codes);
+  CheckPeptideLength(peptide, codes.size());
+  pair< set<string>, set<string> > extreme_aa(polar_aa, hydrophobic_aa);
+  IndexTable table;
+  BuildIndexTable(index, symbols, &extreme_aa, table);
+  FeatureTables tables;
+  BuildTrigTables(codes.size(), tables);
+  vector<double> values(codes.size());
+  return ComputeIndexFeatures(&codes[0], codes.size(), table, tables, &values[0], features);
 }
 
 /* get the kPercentageAA*100% AA with the lowest retention and highest retentions*/
@@ -580,138 +597,421 @@ double RetentionFeatures::ComputeBulkinessSum(const string &peptide, const map<s
 /**************************** AMINO ACID FEATURES **************************************/
 /* adds a feature giving the number of each of the symbols in the alphabet found in the peptide */
 double* RetentionFeatures::FillAAFeatures(const string &peptide, double *retention_features) {
-  int number_aa = amino_acids_alphabet_.size();
-  bool found;
+  map<string, int> symbol_ids;
+  vector<string> symbols;
+  vector<int> codes;
+  EncodePeptide(peptide, symbol_ids, symbols, codes);
+  FeatureTables tables;
+  BuildAAPositions(symbols, tables);
+  const int *peptide_codes = codes.empty() ? NULL : &codes[0];
+  return CountAminoAcids(peptide_codes, codes.size(), tables.aa_position, amino_acids_alphabet_.size(),
+                         retention_features);
+}
 
-  for(int i = 0; i < number_aa; ++i) {
-    retention_features[i] = 0.0;
-  }
+/**************************** LENGTH FEATURES **************************************/
+/* compute the features related to length; */
+double* RetentionFeatures::ComputeLengthFeatures(const string &peptide, double *features) {
+  *(features++) = PeptideLength(peptide);
+  return features;
+}
+
+/* calculate the peptide length */
+double RetentionFeatures::PeptideLength(const string &peptide) {
   vector<string> amino_acids = GetAminoAcids(peptide);
-  vector<string>::iterator it_peptide = amino_acids.begin();
-  int i;
-  for( ; it_peptide != amino_acids.end(); ++it_peptide) {
-    found = false;
-    for(i = 0; i < number_aa; ++i) {
-      if (amino_acids_alphabet_[i] == (*it_peptide)) {
-        ++retention_features[i];
-        found = true;
+  return amino_acids.size();
+}
+
+/************* FEATURES FOR GROUPS ***************/
+/* compute the features when no ptms are present in the data */
+double* RetentionFeatures::ComputeNoPTMFeatures(const string &peptide, double *features) {
+  bitset<NUM_FEATURE_GROUPS> groups;
+  groups.set(INDEX_NO_PTMS_GROUP);
+  vector<int> codes;
+  FeatureTables tables;
+  EncodeSinglePeptide(peptide, groups, codes, tables);
+  vector<double> values(codes.size());
+  return ComputeEncodedNoPTMFeatures(&codes[0], codes.size(), tables, &values[0], features);
+}
+
+// [TO DO: implement this]
+/* compute the features when phosphorylations are present in the data */
+double* RetentionFeatures::ComputePhosFeatures(const string &peptide, double *features) {
+  bitset<NUM_FEATURE_GROUPS> groups;
+  groups.set(INDEX_PHOS_GROUP);
+  vector<int> codes;
+  FeatureTables tables;
+  EncodeSinglePeptide(peptide, groups, codes, tables);
+  vector<double> values(codes.size());
+  return ComputeEncodedPhosFeatures(&codes[0], codes.size(), tables, &values[0], features);
+}
+
+/************* ENCODED PEPTIDES ***************/
+/* split a peptide into its symbols; new symbols are added to symbols and the code of each
+ * amino acid is appended to codes */
+void RetentionFeatures::EncodePeptide(const string &peptide, map<string, int> &symbol_ids,
+                                      vector<string> &symbols, vector<int> &codes) {
+  vector<string> amino_acids = GetAminoAcids(peptide);
+  vector<string>::iterator aa = amino_acids.begin();
+  for( ; aa != amino_acids.end(); ++aa) {
+    map<string, int>::iterator symbol = symbol_ids.find(*aa);
+    if (symbol == symbol_ids.end()) {
+      symbol = symbol_ids.insert(make_pair(*aa, (int) symbols.size())).first;
+      symbols.push_back(*aa);
+    }
+    codes.push_back(symbol->second);
+  }
+}
+
+/* evaluate an index for each symbol; if extreme_aa is given, also mark the polar and
+ * hydrophobic symbols and precompute the features of peptides that are too short */
+void RetentionFeatures::BuildIndexTable(const map<string, double> &index, const vector<string> &symbols,
+                                        const pair< set<string>, set<string> > *extreme_aa, IndexTable &table) {
+  int num_symbols = symbols.size();
+  table.values.resize(num_symbols);
+  for(int i = 0; i < num_symbols; ++i) {
+    table.values[i] = GetIndexValue(symbols[i], index);
+  }
+  if (extreme_aa == NULL) {
+    return;
+  }
+  table.polar.resize(num_symbols);
+  table.hydrophobic.resize(num_symbols);
+  for(int i = 0; i < num_symbols; ++i) {
+    table.polar[i] = extreme_aa->first.find(symbols[i]) != extreme_aa->first.end();
+    table.hydrophobic[i] = extreme_aa->second.find(symbols[i]) != extreme_aa->second.end();
+  }
+  double avg_hydrophobicity_index = AvgHydrophobicityIndex(index);
+  double cos300 = cos(300 * M_PI / 180);
+  double cos400 = cos(400 * M_PI / 180);
+  table.short_side_helix = avg_hydrophobicity_index * (1 + 2 * cos300 + 2 * cos400);
+  double angles[2] = {100, 180};
+  for(int a = 0; a < 2; ++a) {
+    double sin_sum = 0.0, cos_sum = 0.0;
+    double angle_radians = angles[a] * M_PI / 180;
+    for(int i = 1; i <= 11; ++i) {
+      cos_sum += cos(i * angle_radians);
+      sin_sum += sin(i * angle_radians);
+    }
+    cos_sum *= avg_hydrophobicity_index;
+    sin_sum *= avg_hydrophobicity_index;
+    table.short_hmoment[a] = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+  }
+}
+
+/* cos(i * angle) and sin(i * angle) for the angles of the hydrophobic moments */
+void RetentionFeatures::BuildTrigTables(const int &max_length, FeatureTables &tables) {
+  double angles[2] = {100, 180};
+  for(int a = 0; a < 2; ++a) {
+    double angle_radians = angles[a] * M_PI / 180;
+    tables.cos_table[a].resize(max_length + 1);
+    tables.sin_table[a].resize(max_length + 1);
+    for(int i = 0; i <= max_length; ++i) {
+      tables.cos_table[a][i] = cos(i * angle_radians);
+      tables.sin_table[a][i] = sin(i * angle_radians);
+    }
+  }
+}
+
+/* position of each symbol in the amino acids alphabet; when ptms are ignored, a modified
+ * symbol that is not in the alphabet is counted as its unmodified amino acid */
+void RetentionFeatures::BuildAAPositions(const vector<string> &symbols, FeatureTables &tables) const {
+  int num_symbols = symbols.size();
+  int number_aa = amino_acids_alphabet_.size();
+  tables.aa_position.assign(num_symbols, -1);
+  for(int s = 0; s < num_symbols; ++s) {
+    for(int i = 0; i < number_aa; ++i) {
+      if (amino_acids_alphabet_[i] == symbols[s]) {
+        tables.aa_position[s] = i;
         break;
       }
     }
-    if (!found && ignore_ptms_) {
+    if (tables.aa_position[s] == -1 && ignore_ptms_) {
       if (VERB >= 4) {
-        cerr << "Unable to find " << (*it_peptide) << " in the alphabet. We use "
-             << (*it_peptide)[0] << " instead. " << endl;
+        cerr << "Unable to find " << symbols[s] << " in the alphabet. We use "
+             << symbols[s][0] << " instead. " << endl;
       }
-      for(i = 0; i < number_aa; ++i) {
-        if (amino_acids_alphabet_[i] == it_peptide->substr(0,1)) {
-          ++retention_features[i];
-          found = true;
+      for(int i = 0; i < number_aa; ++i) {
+        if (amino_acids_alphabet_[i] == symbols[s].substr(0,1)) {
+          tables.aa_position[s] = i;
           break;
         }
       }
-      if (!found) {
-        if (VERB >= 2) {
-          cerr << "Unable to find " << (*it_peptide) << " and " << (*it_peptide)[0]
-               << "in the alphabet. " << endl;
-        }
+      if (tables.aa_position[s] == -1 && VERB >= 2) {
+        cerr << "Unable to find " << symbols[s] << " and " << symbols[s][0]
+             << "in the alphabet. " << endl;
       }
     }
   }
-  return retention_features + amino_acids_alphabet_.size();
 }
 
-/**************************** LENGTH FEATURES **************************************/
-/* compute the features related to length; */
-double* RetentionFeatures::ComputeLengthFeatures(const string &peptide, double *features) {
-  *(features++) = PeptideLength(peptide);
-  return features;
+/* build the tables for the given feature groups */
+void RetentionFeatures::BuildFeatureTables(const vector<string> &symbols, const int &max_length,
+                                           const bitset<NUM_FEATURE_GROUPS> &groups,
+                                           FeatureTables &tables) const {
+  if (groups.test(INDEX_NO_PTMS_GROUP)) {
+    pair< set<string>, set<string> > extreme_aa = GetExtremeRetentionAA(kKyteDoolittle);
+    BuildIndexTable(kKyteDoolittle, symbols, &extreme_aa, tables.kyte_doolittle);
+    BuildIndexTable(kBulkiness, symbols, NULL, tables.bulkiness);
+  }
+  if (groups.test(INDEX_NO_PTMS_GROUP) || groups.test(INDEX_PHOS_GROUP)) {
+    pair< set<string>, set<string> > extreme_aa = GetExtremeRetentionAA(svr_index_);
+    BuildIndexTable(svr_index_, symbols, &extreme_aa, tables.svr);
+    BuildTrigTables(max_length, tables);
+  }
+  BuildAAPositions(symbols, tables);
 }
 
-/* calculate the peptide length */
-double RetentionFeatures::PeptideLength(const string &peptide) {
-  vector<string> amino_acids = GetAminoAcids(peptide);
-  return amino_acids.size();
+/* encode a single peptide and build the tables of the given groups for its symbols */
+void RetentionFeatures::EncodeSinglePeptide(const string &peptide, const bitset<NUM_FEATURE_GROUPS> &groups,
+                                            vector<int> &codes, FeatureTables &tables) const {
+  map<string, int> symbol_ids;
+  vector<string> symbols;
+  EncodePeptide(peptide, symbol_ids, symbols, codes);
+  if (groups.test(INDEX_NO_PTMS_GROUP) || groups.test(INDEX_PHOS_GROUP)) {
+    CheckPeptideLength(peptide, codes.size());
+  }
+  BuildFeatureTables(symbols, codes.size(), groups, tables);
 }
 
-/************* FEATURES FOR GROUPS ***************/
-/* compute the features when no ptms are present in the data */
-double* RetentionFeatures::ComputeNoPTMFeatures(const string &peptide, double *features) {
-  // we always compute: kyte and doo little index, svr index, bulkiness, peptide length and amino acid features
-  // compute the kyte and doolittle features
-  pair< set<string>, set<string> > extreme_aa = GetExtremeRetentionAA(kKyteDoolittle);
-  set<string> polar_aa = extreme_aa.first;
-  set<string> hydrophobic_aa = extreme_aa.second;
-  features = ComputeIndexFeatures(peptide, kKyteDoolittle, polar_aa, hydrophobic_aa, features);
+/* the most and least hydrophobic windows, computed as in IndexMaxPartialSum */
+static void PartialSums(const double *values, const int &len, const int &win,
+                        double &max_sum, double &min_sum) {
+  int window_size = min(win, len - 1);
+  double sum = 0.0;
+  int lead = 0;
+  for( ; lead < window_size; ++lead) {
+    sum += values[lead];
+  }
+  max_sum = sum;
+  min_sum = sum;
+  for( ; lead < len; ++lead) {
+    sum -= values[lead - window_size];
+    sum += values[lead];
+    max_sum = max(max_sum, sum);
+    min_sum = min(min_sum, sum);
+  }
+}
+
+/* the maximum and minimum hydrophobic moment, computed as in IndexMaxHydrophobicMoment */
+static void HydrophobicMoments(const double *values, const int &len, const int &win,
+                               const vector<double> &cos_table, const vector<double> &sin_table,
+                               const double &short_hmoment, double &max_hmoment, double &min_hmoment) {
+  if (len < win) {
+    max_hmoment = short_hmoment;
+    min_hmoment = short_hmoment;
+    return;
+  }
+  double sin_sum = 0.0, cos_sum = 0.0, window_hmoment;
+  int lead = 0, i = 1;
+  for( ; lead < win; ++lead, ++i) {
+    cos_sum += values[lead] * cos_table[i];
+    sin_sum += values[lead] * sin_table[i];
+  }
+  max_hmoment = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+  min_hmoment = max_hmoment;
+  for( ; lead < len; ++lead, ++i) {
+    cos_sum += values[lead] * cos_table[i];
+    cos_sum -= values[lead - win] * cos_table[i - win];
+    sin_sum += values[lead] * sin_table[i];
+    sin_sum -= values[lead - win] * sin_table[i - win];
+    window_hmoment = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+    max_hmoment = max(max_hmoment, window_hmoment);
+    min_hmoment = min(min_hmoment, window_hmoment);
+  }
+}
 
-  // compute the svr features
-  extreme_aa = GetExtremeRetentionAA(svr_index_);
-  polar_aa = extreme_aa.first;
-  hydrophobic_aa = extreme_aa.second;
-  features = ComputeIndexFeatures(peptide, svr_index_, polar_aa, hydrophobic_aa, features);
+/* fill all the features of an index for an encoded peptide. The features are the same, and
+ * are accumulated in the same order, as in the string version of ComputeIndexFeatures */
+double* RetentionFeatures::ComputeIndexFeatures(const int *codes, const int &len, const IndexTable &table,
+                                                const FeatureTables &tables, double *values, double *features) {
+  int i;
+  for(i = 0; i < len; ++i) {
+    values[i] = table.values[codes[i]];
+  }
+  double sum = 0.0, neighbour_sum = 0.0;
+  double num_polar = 0.0, num_consec_polar = 0.0;
+  double num_hydrophobic = 0.0, num_consec_hydrophobic = 0.0;
+  for(i = 0; i < len; ++i) {
+    sum += values[i];
+    if (table.polar[codes[i]]) {
+      ++num_polar;
+      if (i > 0) {
+        neighbour_sum += max(0.0, values[i - 1]);
+      }
+      if (i < len - 1) {
+        neighbour_sum += max(0.0, values[i + 1]);
+        if (table.polar[codes[i + 1]]) {
+          ++num_consec_polar;
+        }
+      }
+    }
+    if (table.hydrophobic[codes[i]]) {
+      ++num_hydrophobic;
+      if (i < len - 1 && table.hydrophobic[codes[i + 1]]) {
+        ++num_consec_hydrophobic;
+      }
+    }
+  }
+  double max_sum5, min_sum5, max_sum2, min_sum2;
+  PartialSums(values, len, 5, max_sum5, min_sum5);
+  PartialSums(values, len, 2, max_sum2, min_sum2);
 
-  // bulkiness
-  features = ComputeBulkinessFeatures(peptide, kBulkiness, features);
+  double max_side_helix, min_side_helix;
+  if (len < 9) {
+    max_side_helix = table.short_side_helix;
+    min_side_helix = table.short_side_helix;
+  } else {
+    double cos300 = cos(300 * M_PI / 180);
+    double cos400 = cos(400 * M_PI / 180);
+    max_side_helix = values[4] + cos300 * (values[1] + values[7]) +
+                     cos400 * (values[0] + values[8]);
+    min_side_helix = max_side_helix;
+    for(i = 5; i <= len - 5; ++i) {
+      double side_helix = values[i] + cos300 * (values[i - 3] + values[i + 3]) +
+                          cos400 * (values[i - 4] + values[i + 4]);
+      max_side_helix = max(max_side_helix, side_helix);
+      min_side_helix = min(min_side_helix, side_helix);
+    }
+  }
 
-  // peptide length
-  features = ComputeLengthFeatures(peptide, features);
+  double max_hmoment[2], min_hmoment[2];
+  for(int a = 0; a < 2; ++a) {
+    HydrophobicMoments(values, len, 11, tables.cos_table[a], tables.sin_table[a],
+                       table.short_hmoment[a], max_hmoment[a], min_hmoment[a]);
+  }
 
-  // amino acid features
-  features = FillAAFeatures(peptide, features);
+  double squared_diff_sum = 0.0, diff;
+  for(i = 0; i < len - 1; ++i) {
+    diff = values[i] - values[i + 1];
+    squared_diff_sum += diff * diff;
+  }
 
+  *(features++) = sum;
+  *(features++) = sum / (double) len;
+  *(features++) = values[0];
+  *(features++) = values[len - 1];
+  *(features++) = neighbour_sum;
+  *(features++) = max_sum5;
+  *(features++) = max_sum2;
+  *(features++) = min_sum5;
+  *(features++) = min_sum2;
+  *(features++) = max_side_helix;
+  *(features++) = min_side_helix;
+  *(features++) = max_hmoment[0];
+  *(features++) = max_hmoment[1];
+  *(features++) = min_hmoment[0];
+  *(features++) = min_hmoment[1];
+  *(features++) = squared_diff_sum;
+  *(features++) = num_polar;
+  *(features++) = num_consec_polar;
+  *(features++) = num_hydrophobic;
+  *(features++) = num_consec_hydrophobic;
   return features;
 }
 
-// [TO DO: implement this]
-/* compute the features when phosphorylations are present in the data */
-double* RetentionFeatures::ComputePhosFeatures(const string &peptide, double *features) {
-  pair< set<string>, set<string> > extreme_aa = GetExtremeRetentionAA(svr_index_);
-  set<string> polar_aa = extreme_aa.first;
-  set<string> hydrophobic_aa = extreme_aa.second;
-  features = ComputeIndexFeatures(peptide, svr_index_, polar_aa, hydrophobic_aa, features);
-
-  // peptide length
-  features = ComputeLengthFeatures(peptide, features);
+/* the counterpart of ComputeNoPTMFeatures for an encoded peptide */
+double* RetentionFeatures::ComputeEncodedNoPTMFeatures(const int *codes, const int &len, const FeatureTables &tables,
+                                                       double *values, double *features) const {
+  features = ComputeIndexFeatures(codes, len, tables.kyte_doolittle, tables, values, features);
+  features = ComputeIndexFeatures(codes, len, tables.svr, tables, values, features);
+  double bulkiness_sum = 0.0;
+  for(int i = 0; i < len; ++i) {
+    bulkiness_sum += tables.bulkiness.values[codes[i]];
+  }
+  *(features++) = bulkiness_sum;
+  *(features++) = len;
+  return CountAminoAcids(codes, len, tables.aa_position, amino_acids_alphabet_.size(), features);
+}
 
-  // amino acid features
-  features = FillAAFeatures(peptide, features);
+/* the counterpart of ComputePhosFeatures for an encoded peptide */
+double* RetentionFeatures::ComputeEncodedPhosFeatures(const int *codes, const int &len, const FeatureTables &tables,
+                                                      double *values, double *features) const {
+  features = ComputeIndexFeatures(codes, len, tables.svr, tables, values, features);
+  *(features++) = len;
+  return CountAminoAcids(codes, len, tables.aa_position, amino_acids_alphabet_.size(), features);
+}
 
+/* compute all the features of the active groups for an encoded peptide, in the order of
+ * ComputeRetentionFeatures */
+double* RetentionFeatures::ComputeEncodedFeatures(const int *codes, const int &len, const FeatureTables &tables,
+                                                  double *values, double *features) const {
+  if (active_feature_groups_.test(INDEX_NO_PTMS_GROUP)) {
+    features = ComputeEncodedNoPTMFeatures(codes, len, tables, values, features);
+  }
+  if (active_feature_groups_.test(INDEX_PHOS_GROUP)) {
+    features = ComputeEncodedPhosFeatures(codes, len, tables, values, features);
+  }
+  if (active_feature_groups_.test(AA_GROUP)) {
+    features = CountAminoAcids(codes, len, tables.aa_position, amino_acids_alphabet_.size(), features);
+  }
   return features;
 }
 
 /************* RETENTION FEATURES FOR PSMS **************/
-/* computes the retention features for a set of peptides; return 0 if success */
+/* computes the retention features for a set of peptides; return 0 if success. Most PSMs
+ * share their peptide, so the peptides are first encoded as arrays of symbol codes, and
+ * the features are computed in parallel for each distinct peptide from lookup tables */
 int RetentionFeatures::ComputeRetentionFeatures(vector<PSMDescription*> &psms) {
-  vector<PSMDescription*>::iterator it= psms.begin();
-  for( ; it != psms.end(); ++it) {
-    ComputeRetentionFeatures(*it);
+  int num_psms = psms.size();
+  map<string, int> peptide_ids, symbol_ids;
+  vector<string> symbols;
+  vector<int> psm_peptide(num_psms), codes;
+  vector<size_t> offsets(1, 0);
+  int max_length = 0;
+  bool index_groups = active_feature_groups_.test(INDEX_NO_PTMS_GROUP) ||
+                      active_feature_groups_.test(INDEX_PHOS_GROUP);
+
+  for(int i = 0; i < num_psms; ++i) {
+    if (psms[i]->getRetentionFeatures() == NULL) {
+      ostringstream temp;
+      temp << "Error: Memory not allocated for the retention features. Execution aborted." << endl;
+      throw MyException(temp.str());
+    }
+    string peptide = psms[i]->getFullPeptideSequence();
+    string::size_type pos1 = peptide.find('.');
+    string::size_type pos2 = peptide.find('.', ++pos1);
+    string pep = peptide.substr(pos1, pos2 - pos1);
+    map<string, int>::iterator it = peptide_ids.find(pep);
+    if (it != peptide_ids.end()) {
+      psm_peptide[i] = it->second;
+      continue;
+    }
+    psm_peptide[i] = peptide_ids.size();
+    peptide_ids[pep] = psm_peptide[i];
+    EncodePeptide(pep, symbol_ids, symbols, codes);
+    int len = codes.size() - offsets.back();
+    if (index_groups) {
+      CheckPeptideLength(peptide, len);
+    }
+    offsets.push_back(codes.size());
+    max_length = max(max_length, len);
+  }
+
+  FeatureTables tables;
+  BuildFeatureTables(symbols, max_length, active_feature_groups_, tables);
+  const int *all_codes = codes.empty() ? NULL : &codes[0];
+
+  int num_peptides = peptide_ids.size();
+  int num_features = GetTotalNumberFeatures();
+  vector<double> peptide_features((size_t) num_peptides * num_features);
+  #pragma omp parallel
+  {
+    vector<double> values(max_length + 1);
+    #pragma omp for schedule(dynamic, 64)
+    for(int p = 0; p < num_peptides; ++p) {
+      ComputeEncodedFeatures(all_codes + offsets[p], (int) (offsets[p + 1] - offsets[p]), tables,
+                             &values[0], &peptide_features[(size_t) p * num_features]);
+    }
+  }
+  for(int i = 0; i < num_psms; ++i) {
+    memcpy(psms[i]->getRetentionFeatures(), &peptide_features[(size_t) psm_peptide[i] * num_features],
+           num_features * sizeof(double));
   }
   return 0; //NOTE why returns value if its not used?
 }
 
 /* computes the retention features for one psm */
 int RetentionFeatures::ComputeRetentionFeatures(PSMDescription* psm) {
-  string peptide = psm->getFullPeptideSequence();
-  string::size_type pos1 = peptide.find('.');
-  string::size_type pos2 = peptide.find('.', ++pos1);
-  string pep = peptide.substr(pos1, pos2 - pos1);
-  double* features = psm->getRetentionFeatures();
-
-  // if there is memory allocated
-  if (features != NULL) {
-    if (active_feature_groups_.test(INDEX_NO_PTMS_GROUP)) {
-      features = ComputeNoPTMFeatures(pep, features);
-    }
-    if (active_feature_groups_.test(INDEX_PHOS_GROUP)) {
-      features = ComputePhosFeatures(pep, features);
-    }
-    if (active_feature_groups_.test(AA_GROUP)) {
-      features = FillAAFeatures(pep, features);
-    }
-  } else {
-    ostringstream temp;
-    temp << "Error: Memory not allocated for the retention features. Execution aborted." << endl;
-    throw MyException(temp.str());
-  }
-  return 0;
+  vector<PSMDescription*> psms(1, psm);
+  return ComputeRetentionFeatures(psms);
 }
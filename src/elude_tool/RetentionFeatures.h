@@ -165,7 +165,8 @@ class RetentionFeatures {
    double* ComputePhosFeatures(const std::string &peptide, double *features);
 
    /************* RETENTION FEATURES FOR PSMS **************/
-   /* computes the retention features for a set of peptides; return 0 if success */
+   /* computes the retention features for a set of peptides; return 0 if success. The features
+    * are computed once per distinct peptide, from lookup tables built for the batch */
    int ComputeRetentionFeatures(std::vector<PSMDescription*> &psms);
    /* computes the retention features for one psm */
    int ComputeRetentionFeatures(PSMDescription* psm);
@@ -189,6 +190,61 @@ class RetentionFeatures {
    static inline void set_ignore_ptms(const bool ignore_ptms) { ignore_ptms_ = ignore_ptms; }
 
  private:
+   /* an index evaluated for every amino acid (symbol) that occurs in a batch of peptides */
+   struct IndexTable {
+     std::vector<double> values;
+     std::vector<char> polar;
+     std::vector<char> hydrophobic;
+     /* helix features and hydrophobic moments (100 and 180 degrees) of too short peptides */
+     double short_side_helix;
+     double short_hmoment[2];
+   };
+   /* lookup tables for a batch of peptides encoded as arrays of symbol codes */
+   struct FeatureTables {
+     IndexTable kyte_doolittle;
+     IndexTable svr;
+     IndexTable bulkiness;
+     /* position of each symbol in the amino acids alphabet, -1 if not found */
+     std::vector<int> aa_position;
+     /* cos(i * angle) and sin(i * angle) for the angles of the hydrophobic moments */
+     std::vector<double> cos_table[2];
+     std::vector<double> sin_table[2];
+   };
+
+   /* split a peptide into its symbols; new symbols are added to symbols and the code of
+    * each amino acid is appended to codes */
+   static void EncodePeptide(const std::string &peptide, std::map<std::string, int> &symbol_ids,
+       std::vector<std::string> &symbols, std::vector<int> &codes);
+   /* evaluate an index for each symbol; throws if a symbol is not found in the index. The
+    * polar and hydrophobic symbols are marked only if extreme_aa is given */
+   static void BuildIndexTable(const std::map<std::string, double> &index,
+       const std::vector<std::string> &symbols,
+       const std::pair< std::set<std::string>, std::set<std::string> > *extreme_aa,
+       IndexTable &table);
+   /* build the cos and sin tables of the hydrophobic moments */
+   static void BuildTrigTables(const int &max_length, FeatureTables &tables);
+   /* find the position of each symbol in the amino acids alphabet */
+   void BuildAAPositions(const std::vector<std::string> &symbols, FeatureTables &tables) const;
+   /* build the tables for the given feature groups */
+   void BuildFeatureTables(const std::vector<std::string> &symbols, const int &max_length,
+       const std::bitset<NUM_FEATURE_GROUPS> &groups, FeatureTables &tables) const;
+   /* encode a single peptide and build the tables of the given groups for its symbols */
+   void EncodeSinglePeptide(const std::string &peptide,
+       const std::bitset<NUM_FEATURE_GROUPS> &groups, std::vector<int> &codes,
+       FeatureTables &tables) const;
+   /* the counterpart of ComputeIndexFeatures for an encoded peptide of len > 0 amino acids;
+    * values is scratch space for len elements */
+   static double* ComputeIndexFeatures(const int *codes, const int &len, const IndexTable &table,
+       const FeatureTables &tables, double *values, double *features);
+   /* the counterparts of ComputeNoPTMFeatures and ComputePhosFeatures for an encoded peptide */
+   double* ComputeEncodedNoPTMFeatures(const int *codes, const int &len,
+       const FeatureTables &tables, double *values, double *features) const;
+   double* ComputeEncodedPhosFeatures(const int *codes, const int &len,
+       const FeatureTables &tables, double *values, double *features) const;
+   /* compute all the features of the active groups for an encoded peptide */
+   double* ComputeEncodedFeatures(const int *codes, const int &len, const FeatureTables &tables,
+       double *values, double *features) const;
+
    /* whenever a modified peptide is not identified, use the unmodified instead? */
    static bool ignore_ptms_;
    /* every bit set corresponds to an active group of features (the indices are defined at
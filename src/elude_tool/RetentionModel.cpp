@@ -25,6 +25,7 @@
 #include "PSMDescription.h"
 #include "PSMDescriptionDOC.h"
 #include "LibSVRModel.h"
+#include "SharedSVMModel.h"
 #include "Normalizer.h"
 
 RetentionModel::RetentionModel(Normalizer *norm) : the_normalizer_(norm),
@@ -258,14 +259,13 @@ int RetentionModel::PredictRT(const set<string> &aa_alphabet, const bool ignore_
   retention_features_.ComputeRetentionFeatures(psms);
     // normalize the features
   NormalizeFeatures(false, psms);
-  double predicted_rt;
+  vector<double> predicted_rts;
   PSMDescriptionDOC::normDivRT_ = div_;
   PSMDescriptionDOC::normSubRT_ = sub_;
   int number_features = retention_features_.GetTotalNumberFeatures();
-  vector<PSMDescription*>::iterator it = psms.begin();
-  for( ; it != psms.end(); ++it) {
-    predicted_rt = svr_model_->PredictRT(number_features, (*it)->getRetentionFeatures());
-    (*it)->setPredictedRetentionTime(PSMDescriptionDOC::unnormalize(predicted_rt));
+  svr_model_->PredictRT(number_features, psms, predicted_rts);
+  for (size_t i = 0; i < psms.size(); ++i) {
+    psms[i]->setPredictedRetentionTime(PSMDescriptionDOC::unnormalize(predicted_rts[i]));
   }
   if (VERB >= 4) {
     cerr << "Done." << endl << endl;
@@ -273,8 +273,48 @@ int RetentionModel::PredictRT(const set<string> &aa_alphabet, const bool ignore_
   return 0;
 }
 
-int RetentionModel::SaveModelToFile(const string &file_name) {
-  FILE* fp = fopen(file_name.c_str(), "w");
+/* predict rt for a vector of psms without modifying them. The features of the copies
+ * are scaled with the sub and div of the model directly instead of through the shared
+ * normalizer, and the predictions are unnormalized with the sub and div of the model */
+int RetentionModel::PredictRT(const set<string> &aa_alphabet, const bool ignore_ptms,
+    const vector<PSMDescription*> &psms, vector<double> &predicted_rts) {
+  if (!IsSetIncluded(aa_alphabet, retention_features_.amino_acids_alphabet(),
+      ignore_ptms)) {
+    return 1;
+  }
+  if (!svr_model_) {
+    if (VERB >= 2) {
+      cerr << "Warning: no svr model available to predict retention time. "<< endl;
+    }
+    return 1;
+  }
+  int number_psms = psms.size();
+  int number_features = retention_features_.GetTotalNumberFeatures();
+  vector<PSMDescriptionDOC> copies(number_psms);
+  vector<PSMDescription*> copy_ptrs(number_psms);
+  vector<double> feature_table((size_t) number_psms * number_features);
+  for (int i = 0; i < number_psms; ++i) {
+    copies[i].peptide = psms[i]->peptide;
+    copies[i].setRetentionFeatures(&feature_table[(size_t) i * number_features]);
+    copy_ptrs[i] = &copies[i];
+  }
+  retention_features_.ComputeRetentionFeatures(copy_ptrs);
+  int number_scaled = vsub_.size();
+  for (int i = 0; i < number_psms; ++i) {
+    double *features = copy_ptrs[i]->getRetentionFeatures();
+    for (int j = 0; j < number_scaled; ++j) {
+      features[j] = (features[j] - vsub_[j]) / vdiv_[j];
+    }
+  }
+  svr_model_->PredictRT(number_features, copy_ptrs, predicted_rts);
+  for (int i = 0; i < number_psms; ++i) {
+    predicted_rts[i] = predicted_rts[i] * div_ + sub_;
+  }
+  return 0;
+}
+
+int RetentionModel::SaveModelToFile(const string &file_name, const bool binary) {
+  FILE* fp = fopen(file_name.c_str(), binary ? "wb" : "w");
   if (VERB >= 4) {
     cerr << "Saving model to file " << file_name << "..." << endl;
   }
@@ -285,7 +325,11 @@ int RetentionModel::SaveModelToFile(const string &file_name) {
     }
     return 1;
   }
-  svr_model_->SaveModel(fp);
+  if (binary) {
+    svr_model_->SaveBinaryModel(fp);
+  } else {
+    svr_model_->SaveModel(fp);
+  }
   // number of features
   int number_features = retention_features_.GetTotalNumberFeatures();
   if (vsub_.size() !=  number_features) {
@@ -356,14 +400,18 @@ int RetentionModel::LoadModelFromFile(const std::string &file_name) {
     delete svr_model_;
   }
   svr_model_ = new LibSVRModel();
-  svr_model_->LoadModel(fp);
+  if (SharedSVMModel::isBinary(fp)) {
+    svr_model_->LoadBinaryModel(file_name, fp);
+  } else {
+    svr_model_->LoadModel(fp);
+  }
   // load the number of features
 
   char dummy[50];
   int number_features, ret;
   ret = fscanf(fp, "%s %d", dummy, &number_features);
   // active features groups
-  char active_groups[RetentionFeatures::NUM_FEATURE_GROUPS];
+  char active_groups[RetentionFeatures::NUM_FEATURE_GROUPS + 1];
   ret = fscanf(fp, "%s %s", dummy, active_groups);
   retention_features_.set_active_feature_groups(
       bitset<RetentionFeatures::NUM_FEATURE_GROUPS>(string(active_groups)));
@@ -65,9 +65,13 @@ class RetentionModel {
     * but it assumes that the feature table is initialized */
    int PredictRT(const std::set<std::string> &aa_alphabet, const bool ignore_ptms,
        const std::string &text, std::vector<PSMDescription*> &psms);
-   /* save the model to a file */
-   int SaveModelToFile(const std::string &file_name);
-   /* load the model from a file */
+   /* predict rt for a vector of psms without modifying them; the retention features are
+    * computed for copies of the psms, so several models can predict the same psms at once */
+   int PredictRT(const std::set<std::string> &aa_alphabet, const bool ignore_ptms,
+       const std::vector<PSMDescription*> &psms, std::vector<double> &predicted_rts);
+   /* save the model to a file; the svr is saved in the binary format if binary is true */
+   int SaveModelToFile(const std::string &file_name, const bool binary = false);
+   /* load the model from a file; the format of the svr is detected */
    int LoadModelFromFile(const std::string &file_name);
    /* save the retention index to a file */
    int SaveRetentionIndexToFile(const std::string &file_name);
@@ -28,21 +28,31 @@
 #include <vector>
 #include <ostream>
 #include <istream>
+#include <string>
 
 class PSMDescription;
 
 class SVRModel {
  public:
+   virtual ~SVRModel() {}
     /* calibrate the values of the parameters */
    virtual int CalibrateModel(const std::vector<PSMDescription*>& calibration_psms, const int &number_features) = 0;
    /* train a svr model */
    virtual int TrainModel(const std::vector<PSMDescription*>& train_psms, const int &number_features) = 0;
    /* predict retention time using the trained model */
    virtual double PredictRT(const int &number_features, double *features) = 0;
+   /* predict retention times for a set of psms */
+   virtual void PredictRT(const int &number_features, const std::vector<PSMDescription*> &psms,
+                          std::vector<double> &predictions) = 0;
    /* save a svr model */
    virtual int SaveModel(FILE *fp) = 0;
+   /* save a svr model in a binary format */
+   virtual int SaveBinaryModel(FILE *fp) = 0;
    /* load a svr model */
    virtual int LoadModel(FILE *fp) = 0;
+   /* load a svr model in the binary format from the beginning of file_name; fp is
+    * the same file, positioned after the svr model on return */
+   virtual int LoadBinaryModel(const std::string &file_name, FILE *fp) = 0;
 };
 
 #endif /* ELUDE_SVRMODEL_H_ */
@@ -24,11 +24,14 @@
 #include <stdio.h>  /* defines FILENAME_MAX */
 #include "DataManager.h"
 #include "PSMDescription.h"
+#include "PSMDescriptionDOC.h"
 #include "Globals.h"
 #include "Enzyme.h"
 
+#ifndef PATH_TO_DATA
 #define PATH_TO_DATA string("@pathToData@")
 #define PATH_TO_WRITABLE string("@pathToWritable@")
+#endif
 
 class DataManagerTest : public ::testing::Test {
  protected:
@@ -42,24 +45,32 @@ class DataManagerTest : public ::testing::Test {
      Globals::getInstance()->setVerbose(1);
      //Enzyme::setEnzyme(Enzyme::TRYPSIN);
    }
-   virtual void TearDown() { }
+   virtual void TearDown() {
+     for_each(psms_.begin(), psms_.end(), PSMDescription::deletePtr);
+   }
+   // psm that is deleted when the test ends
+   PSMDescription* NewPSM(const string &peptide, const double rt) {
+     psms_.push_back(new PSMDescriptionDOC(peptide, rt));
+     return psms_.back();
+   }
 
    DataManager dm;
    string train_file1, train_file2, test_file1, tmp_file;
    set<string> basic_alphabet;
+   vector<PSMDescription*> psms_;
 };
 
 TEST_F(DataManagerTest, TestLoadPeptidesRTContext) {
-  vector<PSMDescription> psms;
+  vector<PSMDescription*>& psms = psms_;
   set<string> aa_alphabet;
   // case 1: includes rt, context, but no ptms; the alphabet should be just the 20 aa
   DataManager::LoadPeptides( train_file1, true, true, psms, aa_alphabet);
   // check that the number of peptides is correct and test some of them
   EXPECT_EQ(101, psms.size()) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
-  EXPECT_EQ("K.IIGPDADFFGELVVDAAEAVR.V", psms[32].peptide) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl ;
-  EXPECT_NEAR(62.97, psms[32].getRetentionTime(), 0.01) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
-  EXPECT_EQ("K.QIEQGEAELEAAHTVAR.I", psms[100].peptide) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
-  EXPECT_NEAR(21.3787, psms[100].getRetentionTime(), 0.01) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
+  EXPECT_EQ("K.IIGPDADFFGELVVDAAEAVR.V", psms[32]->peptide) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl ;
+  EXPECT_NEAR(62.97, psms[32]->getRetentionTime(), 0.01) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
+  EXPECT_EQ("K.QIEQGEAELEAAHTVAR.I", psms[100]->peptide) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
+  EXPECT_NEAR(21.3787, psms[100]->getRetentionTime(), 0.01) << "TestLoadPeptidesRTContext does not give the correct results for " << train_file1 << endl;
   // check the alphabet
   EXPECT_EQ(aa_alphabet.size(), basic_alphabet.size());
   set<string>::iterator it = aa_alphabet.begin();
@@ -70,17 +81,17 @@ TEST_F(DataManagerTest, TestLoadPeptidesRTContext) {
 } 
 
 TEST_F(DataManagerTest, TestLoadPeptidesRTNoContext) {
-  vector<PSMDescription> psms;
+  vector<PSMDescription*>& psms = psms_;
   set<string> aa_alphabet;
   // case 2: includes rt, no context, no ptms; the alphabet should be just the 20 aa
   
   DataManager::LoadPeptides(train_file2, true, false, psms, aa_alphabet);
   // check that the number of peptides is correct and test some of them
   EXPECT_EQ(139, psms.size()) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
-  EXPECT_EQ("LTNPTYGDLNHLVSLTMSGVTTCLR", psms[32].peptide) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl ;
-  EXPECT_NEAR(64.7802, psms[32].getRetentionTime(), 0.01) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
-  EXPECT_EQ("EIGGIFTPASVTSEEEVR", psms[138].peptide) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
-  EXPECT_NEAR(44.4893, psms[138].getRetentionTime(), 0.01) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
+  EXPECT_EQ("LTNPTYGDLNHLVSLTMSGVTTCLR", psms[32]->peptide) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl ;
+  EXPECT_NEAR(64.7802, psms[32]->getRetentionTime(), 0.01) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
+  EXPECT_EQ("EIGGIFTPASVTSEEEVR", psms[138]->peptide) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
+  EXPECT_NEAR(44.4893, psms[138]->getRetentionTime(), 0.01) << "TestLoadPeptidesRTNoContext does not give the correct results for " << train_file2 << endl;
   // check the alphabet
   EXPECT_EQ(aa_alphabet.size(), basic_alphabet.size());
   set<string>::iterator it = aa_alphabet.begin();
@@ -91,14 +102,14 @@ TEST_F(DataManagerTest, TestLoadPeptidesRTNoContext) {
 } 
 
 TEST_F(DataManagerTest, TestLoadPeptidesPtmsNoRTContext) {
-  vector<PSMDescription> psms;
+  vector<PSMDescription*>& psms = psms_;
   set<string> aa_alphabet;
   // case 3: no rt, with context, with ptms; the alphabet should be the 20 aa + [PHOS]
    DataManager::LoadPeptides(test_file1, false, true, psms, aa_alphabet);
   // check that the number of peptides is correct and test some of them
   EXPECT_EQ(1251, psms.size()) << "TestLoadPeptidesNoRTContext does not give the correct results for " << test_file1 << endl;
-  EXPECT_EQ("K.TMEGDCEVAYTIVQEGEK.T", psms[1250].peptide) << "TestLoadPeptidesNoRTContext does not give the correct results for " << test_file1 << endl ;
-  EXPECT_NEAR(-1.0, psms[1250].getRetentionTime(), 0.001) << "TestLoadPeptidesNoRTContext does not give the correct results for " << test_file1 << endl ;
+  EXPECT_EQ("K.TMEGDCEVAYTIVQEGEK.T", psms[1250]->peptide) << "TestLoadPeptidesNoRTContext does not give the correct results for " << test_file1 << endl ;
+  EXPECT_NEAR(-1.0, psms[1250]->getRetentionTime(), 0.001) << "TestLoadPeptidesNoRTContext does not give the correct results for " << test_file1 << endl ;
   // check the alphabet
   basic_alphabet.insert("S[unimod:21]");
   basic_alphabet.insert("Y[unimod:21]");
@@ -112,58 +123,58 @@ TEST_F(DataManagerTest, TestLoadPeptidesPtmsNoRTContext) {
 }
 
 TEST_F(DataManagerTest, TestInitCleanFeatureTable) {
-  vector<PSMDescription> psms;
+  vector<PSMDescription*>& psms = psms_;
   set<string> aa_alphabet;
   DataManager::LoadPeptides(test_file1, false, true, psms, aa_alphabet);
   double *feat = NULL;
   feat = dm.InitFeatureTable(10, psms);
   ASSERT_TRUE(feat != NULL) << "TestInitCleanFeatureTable (Init step) error" << endl;;
-  vector<PSMDescription>::iterator it = psms.begin();
+  vector<PSMDescription*>::iterator it = psms.begin();
   for( ; it != psms.end(); ++it) {
-    EXPECT_TRUE(it->getRetentionFeatures() != NULL) << "TestInitCleanFeatureTable (Init step) error" << endl;
+    EXPECT_TRUE((*it)->getRetentionFeatures() != NULL) << "TestInitCleanFeatureTable (Init step) error" << endl;
   }
   dm.CleanUpTable(psms, feat);
   for(it = psms.begin(); it != psms.end(); ++it) {
-    EXPECT_TRUE(it->getRetentionFeatures() == NULL) << "TestInitCleanFeatureTable (Clean up step) error" << endl;
+    EXPECT_TRUE((*it)->getRetentionFeatures() == NULL) << "TestInitCleanFeatureTable (Clean up step) error" << endl;
   }
 }
 
 TEST_F(DataManagerTest, TestRemoveDuplicates) {
-  vector<PSMDescription> psms;
+  vector<PSMDescription*> psms;
 
-  PSMDescription psm1("IAMAPEPTIDE", 10.0);
-  PSMDescription psm2("PEPTIDE", 20.0);
-  PSMDescription psm3("IAMAPEPTIDE", 9.0);
-  PSMDescription psm4("IAMAPEPTIDE", 12.0);
-  psms.push_back(psm1);
-  psms.push_back(psm2);
-  psms.push_back(psm3);
-  psms.push_back(psm4);
+  PSMDescriptionDOC psm1(string("IAMAPEPTIDE"), 10.0);
+  PSMDescriptionDOC psm2(string("PEPTIDE"), 20.0);
+  PSMDescriptionDOC psm3(string("IAMAPEPTIDE"), 9.0);
+  PSMDescriptionDOC psm4(string("IAMAPEPTIDE"), 12.0);
+  psms.push_back(&psm1);
+  psms.push_back(&psm2);
+  psms.push_back(&psm3);
+  psms.push_back(&psm4);
 
   DataManager::RemoveDuplicates(psms);
 
   EXPECT_EQ(2, psms.size()) << "TestRemoveDuplicates error (incorrect size). " << endl;
-  EXPECT_EQ(string("IAMAPEPTIDE"), psms[0].peptide) << "TestRemoveDuplicates error. " << endl;
-  EXPECT_EQ(9.0, psms[0].getRetentionTime()) << "TestRemoveDuplicates error (incorrect rt) " << endl ;
-  EXPECT_EQ(string("PEPTIDE"), psms[1].peptide) << "TestRemoveDuplicates error." << endl;
+  EXPECT_EQ(string("IAMAPEPTIDE"), psms[0]->peptide) << "TestRemoveDuplicates error. " << endl;
+  EXPECT_EQ(9.0, psms[0]->getRetentionTime()) << "TestRemoveDuplicates error (incorrect rt) " << endl ;
+  EXPECT_EQ(string("PEPTIDE"), psms[1]->peptide) << "TestRemoveDuplicates error." << endl;
 }
 
 TEST_F(DataManagerTest, TestRemoveCommonPeptides) {
-  vector<PSMDescription> psms1;
-  PSMDescription psm1("IAMAPEPTIDE", 10.0);
-  PSMDescription psm2("PEPTIDE", 20.0);
-  PSMDescription psm3("IAMAPEPTIDE", 9.0);
-  psms1.push_back(psm1);
-  psms1.push_back(psm2);
-  vector<PSMDescription> psms2;
-  PSMDescription psm4("IAMAPEPTIDE", 10.0);
-  psms2.push_back(psm4);
+  vector<PSMDescription*> psms1;
+  PSMDescriptionDOC psm1(string("IAMAPEPTIDE"), 10.0);
+  PSMDescriptionDOC psm2(string("PEPTIDE"), 20.0);
+  PSMDescriptionDOC psm3(string("IAMAPEPTIDE"), 9.0);
+  psms1.push_back(&psm1);
+  psms1.push_back(&psm2);
+  vector<PSMDescription*> psms2;
+  PSMDescriptionDOC psm4(string("IAMAPEPTIDE"), 10.0);
+  psms2.push_back(&psm4);
 
   DataManager::RemoveCommonPeptides(psms2, psms1);
 
   EXPECT_EQ(1, psms1.size()) << "TestRemoveCommonPeptides error (incorrect size)." << endl;
-  EXPECT_EQ(string("PEPTIDE"), psms1[0].peptide) << "TestRemoveCommonPeptides error" << endl;
-  EXPECT_EQ(20.0, psms1[0].getRetentionTime()) << "TestRemoveCommonPeptides error (incorrect rt)" << endl;
+  EXPECT_EQ(string("PEPTIDE"), psms1[0]->peptide) << "TestRemoveCommonPeptides error" << endl;
+  EXPECT_EQ(20.0, psms1[0]->getRetentionTime()) << "TestRemoveCommonPeptides error (incorrect rt)" << endl;
 }
 
 TEST_F(DataManagerTest, TestIsFragmentOf) {
@@ -173,26 +184,30 @@ TEST_F(DataManagerTest, TestIsFragmentOf) {
   idx["S"] = 3.0;
   idx["R"] = 5.0;
 
+  Enzyme* enzyme = Enzyme::createEnzyme(Enzyme::TRYPSIN);
+
   // child is not included in parent
-  PSMDescription child("A.AAAAYS.A", 10.0);
-  PSMDescription parent("Y.YASSS.A", 20.0);
-  EXPECT_FALSE(DataManager::IsFragmentOf(child, parent, 1.0, idx))
+  PSMDescriptionDOC child(string("A.AAAAYS.A"), 10.0);
+  PSMDescriptionDOC parent(string("Y.YASSS.A"), 20.0);
+  EXPECT_FALSE(DataManager::IsFragmentOf(&child, &parent, enzyme, 1.0, idx))
     << "TestIsFragmentOf error (child not included in parent)" << endl;
 
   // child included in parent and nontryptic
   child.peptide = "R.AAA.A";
   parent.peptide = "R.AAAR.A";
-  EXPECT_TRUE(DataManager::IsFragmentOf(child, parent, 1.0, idx))
+  EXPECT_TRUE(DataManager::IsFragmentOf(&child, &parent, enzyme, 1.0, idx))
      << "TestIsFragmentOf error (child nontryptic" << endl;
 
   // child in parent, but too small difference in retention
   child.peptide = "R.AAR.A";
-  EXPECT_FALSE(DataManager::IsFragmentOf(child, parent, 30.0, idx))
+  EXPECT_FALSE(DataManager::IsFragmentOf(&child, &parent, enzyme, 30.0, idx))
     << "TestIsFragmentOf error (child included in parent, small difference)" << endl;
 
   // child in parent, sufficient difference in retention
-  EXPECT_TRUE(DataManager::IsFragmentOf(child, parent, 0.05, idx))
+  EXPECT_TRUE(DataManager::IsFragmentOf(&child, &parent, enzyme, 0.05, idx))
     << "TestIsFragmentOf error (child included in parent, large difference)" << endl;
+
+  delete enzyme;
 }
 
 TEST_F(DataManagerTest, TestRemoveInSourceFragments) {
@@ -202,80 +217,84 @@ TEST_F(DataManagerTest, TestRemoveInSourceFragments) {
   idx["S"] = 3.0;
   idx["R"] = 5.0;
 
-  vector<PSMDescription> train;
-  vector<PSMDescription> test;
-  train.push_back(PSMDescription("R.AAA.A", 10.0));
-  test.push_back(PSMDescription("R.AAAR.A", 10.1));
-  train.push_back(PSMDescription("R.YYYYYYY.A", 11.0));
-  test.push_back(PSMDescription("R.YYY.A", 11.1));
+  vector<PSMDescription*> train;
+  vector<PSMDescription*> test;
+  train.push_back(NewPSM("R.AAA.A", 10.0));
+  test.push_back(NewPSM("R.AAAR.A", 10.1));
+  train.push_back(NewPSM("R.YYYYYYY.A", 11.0));
+  test.push_back(NewPSM("R.YYY.A", 11.1));
   Enzyme* enzyme = Enzyme::createEnzyme(Enzyme::TRYPSIN);
   
   // Case 1: we only delete from the train data
-  vector< pair<PSMDescription, string> > fragments =
+  vector< pair<PSMDescription*, string> > fragments =
       DataManager::RemoveInSourceFragments(enzyme, 1.0, idx, false, train, test);
   EXPECT_EQ(2, test.size()) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
   EXPECT_EQ(1, train.size()) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
   EXPECT_EQ(2, fragments.size()) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
-  EXPECT_EQ("R.YYYYYYY.A", train[0].peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
-  EXPECT_EQ("R.AAA.A",fragments[0].first.peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
-  EXPECT_EQ("R.YYY.A",fragments[1].first.peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
+  EXPECT_EQ("R.YYYYYYY.A", train[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
+  EXPECT_EQ("R.AAA.A",fragments[0].first->peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
+  EXPECT_EQ("R.YYY.A",fragments[1].first->peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
   EXPECT_EQ("train",fragments[0].second) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
   EXPECT_EQ("test",fragments[1].second) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
-  EXPECT_EQ("R.YYY.A",test[0].peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
-  EXPECT_EQ("R.AAAR.A", test[1].peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
+  EXPECT_EQ("R.YYY.A",test[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
+  EXPECT_EQ("R.AAAR.A", test[1]->peptide) <<"TestRemoveInSourceFragments error, CASE 1" << endl;
 
   // Case 1: we delete from both train and test
-  train.push_back(PSMDescription("R.AAA.A", 10.0));
+  train.push_back(NewPSM("R.AAA.A", 10.0));
   fragments = DataManager::RemoveInSourceFragments(enzyme, 1.0, idx, true, train, test);
   EXPECT_EQ(1, test.size()) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
   EXPECT_EQ(1, train.size()) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
   EXPECT_EQ(2, fragments.size()) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
-  EXPECT_EQ("R.YYYYYYY.A", train[0].peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
-  EXPECT_EQ("R.AAA.A",fragments[0].first.peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
-  EXPECT_EQ("R.YYY.A",fragments[1].first.peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
+  EXPECT_EQ("R.YYYYYYY.A", train[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
+  EXPECT_EQ("R.AAA.A",fragments[0].first->peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
+  EXPECT_EQ("R.YYY.A",fragments[1].first->peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
   EXPECT_EQ("train",fragments[0].second) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
   EXPECT_EQ("test",fragments[1].second) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
-  EXPECT_EQ("R.AAAR.A", test[0].peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
+  EXPECT_EQ("R.AAAR.A", test[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 2" << endl;
 
   // CASE 3: too large difference in rt between parent and child
-  train.push_back(PSMDescription("R.AAA.A", 30.0));
-  test.push_back(PSMDescription("R.YYY.A", 11.1));
-  test.push_back(PSMDescription("R.Y.A", 11.1));
+  train.push_back(NewPSM("R.AAA.A", 30.0));
+  test.push_back(NewPSM("R.YYY.A", 11.1));
+  test.push_back(NewPSM("R.Y.A", 11.1));
   fragments = DataManager::RemoveInSourceFragments(enzyme, 1.0, idx, true, train, test);
   EXPECT_EQ(1, test.size()) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
   EXPECT_EQ(2, train.size()) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
   EXPECT_EQ(2, fragments.size()) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
-  EXPECT_EQ("R.YYYYYYY.A", train[0].peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
-  EXPECT_EQ("R.AAA.A", train[1].peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
-  EXPECT_EQ("R.Y.A",fragments[0].first.peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
-  EXPECT_EQ("R.YYY.A",fragments[1].first.peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
+  EXPECT_EQ("R.YYYYYYY.A", train[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
+  EXPECT_EQ("R.AAA.A", train[1]->peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
+  // R.Y.A and R.YYY.A have the same retention time, so their order is not defined
+  set<string> fragment_peptides;
+  fragment_peptides.insert(fragments[0].first->peptide);
+  fragment_peptides.insert(fragments[1].first->peptide);
+  EXPECT_EQ(1, fragment_peptides.count("R.Y.A")) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
+  EXPECT_EQ(1, fragment_peptides.count("R.YYY.A")) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
   EXPECT_EQ("test",fragments[0].second) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
   EXPECT_EQ("test",fragments[1].second) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
-  EXPECT_EQ("R.AAAR.A", test[0].peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
+  EXPECT_EQ("R.AAAR.A", test[0]->peptide) <<"TestRemoveInSourceFragments error, CASE 3" << endl;
   
   delete enzyme;
 }
 
 TEST_F(DataManagerTest, TestRemoveNonEnzymatic) {
-  vector<PSMDescription> psms;
-  psms.push_back(PSMDescription("R.AAK.A", 10.0));
-  psms.push_back(PSMDescription("R.AAA.-", 10.1));
-  psms.push_back(PSMDescription("Z.YYYYYYR.A", 11.0));
-  psms.push_back(PSMDescription("R.YYY.A", 11.1));
-  psms.push_back(PSMDescription("R.Y[unimod:21]YK.A", 11.1));
-  psms.push_back(PSMDescription("-.Y[unimod:21]YK.A", 11.1));
+  vector<PSMDescription*> psms;
+  psms.push_back(NewPSM("R.AAK.A", 10.0));
+  psms.push_back(NewPSM("R.AAA.-", 10.1));
+  psms.push_back(NewPSM("Z.YYYYYYR.A", 11.0));
+  psms.push_back(NewPSM("R.YYY.A", 11.1));
+  psms.push_back(NewPSM("R.Y[unimod:21]YK.A", 11.1));
+  psms.push_back(NewPSM("-.Y[unimod:21]YK.A", 11.1));
   
   Enzyme* enzyme = Enzyme::createEnzyme(Enzyme::TRYPSIN);
   
-  vector<PSMDescription> nze= DataManager::RemoveNonEnzymatic(enzyme, psms, "test");
+  vector<PSMDescription*> nze= DataManager::RemoveNonEnzymatic(enzyme, psms, "test");
   EXPECT_EQ(2, nze.size()) <<"TestRemoveNonEnzymatic error, incorrect non enzymatic set" << endl;
-  EXPECT_EQ("R.YYY.A", nze[0].peptide) <<"TestRemoveNonEnzymatic error, incorrect non enzymatic set" << endl;
-  EXPECT_EQ("Z.YYYYYYR.A", nze[1].peptide) <<"TestRemoveNonEnzymatic error, incorrect non enzymatic set" << endl;
+  EXPECT_EQ("R.YYY.A", nze[0]->peptide) <<"TestRemoveNonEnzymatic error, incorrect non enzymatic set" << endl;
+  EXPECT_EQ("Z.YYYYYYR.A", nze[1]->peptide) <<"TestRemoveNonEnzymatic error, incorrect non enzymatic set" << endl;
   EXPECT_EQ(4, psms.size()) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
-  EXPECT_EQ("R.AAK.A", psms[0].peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
-  EXPECT_EQ("R.AAA.-", psms[1].peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
-  EXPECT_EQ("-.Y[unimod:21]YK.A", psms[2].peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
-  EXPECT_EQ("R.Y[unimod:21]YK.A", psms[3].peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
+  EXPECT_EQ("R.AAK.A", psms[0]->peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
+  EXPECT_EQ("R.AAA.-", psms[1]->peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
+  EXPECT_EQ("-.Y[unimod:21]YK.A", psms[2]->peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
+  EXPECT_EQ("R.Y[unimod:21]YK.A", psms[3]->peptide) <<"TestRemoveNonEnzymatic error, incorrect psms set" << endl;
   
   delete enzyme;
 }
@@ -287,12 +306,12 @@ TEST_F(DataManagerTest, TestWriteInSourceToFile) {
   idx["S"] = 3.0;
   idx["R"] = 5.0;
 
-  vector<PSMDescription> train;
-  vector<PSMDescription> test;
-  train.push_back(PSMDescription("R.AAA.A", 10.0));
-  test.push_back(PSMDescription("R.AAAR.A", 10.1));
-  train.push_back(PSMDescription("R.YYYYYYY.A", 11.0));
-  test.push_back(PSMDescription("R.YYY.A", 11.1));
+  vector<PSMDescription*> train;
+  vector<PSMDescription*> test;
+  train.push_back(NewPSM("R.AAA.A", 10.0));
+  test.push_back(NewPSM("R.AAAR.A", 10.1));
+  train.push_back(NewPSM("R.YYYYYYY.A", 11.0));
+  test.push_back(NewPSM("R.YYY.A", 11.1));
   Enzyme* enzyme = Enzyme::createEnzyme(Enzyme::TRYPSIN);
   // Case 1: we only delete from the train data
   DataManager::WriteInSourceToFile(tmp_file,
@@ -318,13 +337,13 @@ TEST_F(DataManagerTest, TestWriteInSourceToFile) {
 }
 
 TEST_F(DataManagerTest, TestWriteOutFile) {
-  vector<PSMDescription> psms;
-  PSMDescription psm1("R.AAA.A", 10.0);
-  psm1.getPredictedRetentionTime() = 15.0;
-  PSMDescription psm2("R.YYYYYYY.A", 11.0);
-  psm2.getPredictedRetentionTime() = 16.0;
-  psms.push_back(psm1);
-  psms.push_back(psm2);
+  vector<PSMDescription*> psms;
+  PSMDescriptionDOC psm1(string("R.AAA.A"), 10.0);
+  psm1.setPredictedRetentionTime(15.0);
+  PSMDescriptionDOC psm2(string("R.YYYYYYY.A"), 11.0);
+  psm2.setPredictedRetentionTime(16.0);
+  psms.push_back(&psm1);
+  psms.push_back(&psm2);
 
   // no observed rt
   DataManager::WriteOutFile(tmp_file, psms, false);
@@ -372,3 +391,76 @@ TEST_F(DataManagerTest, TestWriteOutFile) {
     remove(tmp_file.c_str());
   }
 }
+
+TEST_F(DataManagerTest, TestRemoveInSourceFragmentsMatchesPairwiseScan) {
+  map<string, double> idx;
+  idx["A"] = 1.0;
+  idx["Y"] = 2.0;
+  idx["R"] = 5.0;
+  Enzyme* enzyme = Enzyme::createEnzyme(Enzyme::TRYPSIN);
+
+  // all the peptides of 1 to 4 residues over A, Y, R, half of them enzymatic, with
+  // overlapping retention time windows, plus some peptides with ptms
+  vector<string> peptides;
+  string residues = "AYR";
+  peptides.push_back("");
+  for (size_t start = 0, length = 1; length <= 4; ++length) {
+    size_t end = peptides.size();
+    for (size_t k = start; k < end; ++k) {
+      for (size_t r = 0; r < residues.size(); ++r) {
+        peptides.push_back(peptides[k] + residues[r]);
+      }
+    }
+    start = end;
+  }
+  peptides.erase(peptides.begin());
+  peptides.push_back("AY[unimod:21]Y");
+  peptides.push_back("AY[unimod:21]YR");
+  peptides.push_back("Y[unimod:21]");
+  vector<PSMDescription*> train, test;
+  for (size_t k = 0; k < peptides.size(); ++k) {
+    string context = (k % 2 == 0) ? "R." + peptides[k] + ".A" : "A." + peptides[k] + ".A";
+    PSMDescription* psm = new PSMDescriptionDOC(context, 10.0 + (k % 7) * 0.2);
+    if (k % 3 == 0) {
+      test.push_back(psm);
+    } else {
+      train.push_back(psm);
+    }
+  }
+  vector<PSMDescription*> all_psms(train);
+  all_psms.insert(all_psms.end(), test.begin(), test.end());
+
+  // the pairwise scan: a psm is a fragment if it is a fragment of any psm within 5% of
+  // its retention time
+  set<PSMDescription*> expected;
+  for (size_t i = 0; i < all_psms.size(); ++i) {
+    double rt_child = all_psms[i]->getRetentionTime();
+    for (size_t j = 0; j < all_psms.size(); ++j) {
+      double rt_parent = all_psms[j]->getRetentionTime();
+      bool in_window = (rt_parent <= rt_child) ? rt_parent * 1.05 >= rt_child :
+                                                 rt_parent * 0.95 <= rt_child;
+      if (i != j && in_window &&
+          DataManager::IsFragmentOf(all_psms[i], all_psms[j], enzyme, 1.0, idx)) {
+        expected.insert(all_psms[i]);
+        break;
+      }
+    }
+  }
+
+  vector< pair<PSMDescription*, string> > fragments =
+      DataManager::RemoveInSourceFragments(enzyme, 1.0, idx, true, train, test);
+  set<PSMDescription*> found;
+  for (size_t k = 0; k < fragments.size(); ++k) {
+    found.insert(fragments[k].first);
+  }
+  EXPECT_FALSE(expected.empty()) << "TestRemoveInSourceFragmentsMatchesPairwiseScan error" << endl;
+  EXPECT_TRUE(expected == found) << "TestRemoveInSourceFragmentsMatchesPairwiseScan error: "
+      << found.size() << " fragments found instead of " << expected.size() << endl;
+  EXPECT_EQ(all_psms.size(), train.size() + test.size() + fragments.size())
+      << "TestRemoveInSourceFragmentsMatchesPairwiseScan error" << endl;
+
+  for (size_t k = 0; k < all_psms.size(); ++k) {
+    delete all_psms[k];
+  }
+  delete enzyme;
+}
@@ -25,10 +25,13 @@
 #include <algorithm>
 #include <fstream>
 #include "EludeCaller.h"
+#include "PSMDescriptionDOC.h"
 #include "Globals.h"
 
+#ifndef PATH_TO_DATA
 #define PATH_TO_DATA string("@pathToData@")
 #define PATH_TO_WRITABLE string("@pathToWritable@")
+#endif
 
 class EludeCallerTest : public ::testing::Test {
  protected:
@@ -41,28 +44,38 @@ class EludeCallerTest : public ::testing::Test {
      calibration_file = PATH_TO_DATA + "elude/calibrate_data/calibrate.txt";
      lib_path = PATH_TO_DATA + "elude/calibrate_data/test_lib";
      test_calibration =  PATH_TO_DATA + "elude/calibrate_data/test.txt";
-     psms_.push_back(PSMDescription(10, 1));
-     psms_.push_back(PSMDescription(10, 3));
-     psms_.push_back(PSMDescription(10, 12));
-     psms_.push_back(PSMDescription(10, 15));
-     psms_.push_back(PSMDescription(8, 10));
-     psms_.push_back(PSMDescription(6, 7));
-     psms_.push_back(PSMDescription(10, 30));
-     psms_.push_back(PSMDescription(10, 8));
-     psms_.push_back(PSMDescription(10, 17));
-     psms_.push_back(PSMDescription(10, 20));
-     psms_.push_back(PSMDescription(10, 21));
+     psms_.push_back(NewPSM(10, 1));
+     psms_.push_back(NewPSM(10, 3));
+     psms_.push_back(NewPSM(10, 12));
+     psms_.push_back(NewPSM(10, 15));
+     psms_.push_back(NewPSM(8, 10));
+     psms_.push_back(NewPSM(6, 7));
+     psms_.push_back(NewPSM(10, 30));
+     psms_.push_back(NewPSM(10, 8));
+     psms_.push_back(NewPSM(10, 17));
+     psms_.push_back(NewPSM(10, 20));
+     psms_.push_back(NewPSM(10, 21));
+     // the enzyme ParseOptions sets by default
+     caller.SetEnzyme("trypsin");
      Globals::getInstance()->setVerbose(1);
    }
 
    virtual void TearDown() {
+     for_each(psms_.begin(), psms_.end(), PSMDescription::deletePtr);
+   }
+   // psm with an observed and a predicted retention time
+   static PSMDescription* NewPSM(const double rt, const double predicted_rt) {
+     PSMDescription* psm = new PSMDescriptionDOC();
+     psm->setRetentionTime(rt);
+     psm->setPredictedRetentionTime(predicted_rt);
+     return psm;
    }
    EludeCaller caller;
    string train_file1, train_file2;
    string test_file1, test_file2;
    string calibration_file, lib_path, test_calibration;
    string tmp;
-   vector<PSMDescription> psms_;
+   vector<PSMDescription*> psms_;
 };
 
 TEST_F(EludeCallerTest, TestProcessTrainDataContext) {
@@ -73,8 +86,8 @@ TEST_F(EludeCallerTest, TestProcessTrainDataContext) {
 
   // no special argument
   caller.ProcessTrainData();
-  vector<PSMDescription> train = caller.train_psms();
-  vector<PSMDescription> test = caller.test_psms();
+  vector<PSMDescription*> train = caller.train_psms();
+  vector<PSMDescription*> test = caller.test_psms();
   EXPECT_EQ(99, train.size());
   EXPECT_EQ(1252, test.size());
 
@@ -137,15 +150,15 @@ TEST_F(EludeCallerTest, TestProcessTrainDataNoContext)  {
   caller.ProcessTrainData();
   EXPECT_EQ(135, caller.train_psms().size());
   EXPECT_EQ(53, caller.test_psms().size());
-  vector<PSMDescription> psms = caller.train_psms();
-  vector<PSMDescription>::iterator it = psms.begin();
+  vector<PSMDescription*> psms = caller.train_psms();
+  vector<PSMDescription*>::iterator it = psms.begin();
   int count = 0;
   for( ; it != psms.end(); ++it)
   {
-    if (it->peptide == "SNYNFEKPFLWLAR") {
+    if ((*it)->peptide == "SNYNFEKPFLWLAR") {
       ++count;
     }
-    EXPECT_FALSE("DEGWMAEHMLIMGVTRPCGR" == it->peptide);
+    EXPECT_FALSE("DEGWMAEHMLIMGVTRPCGR" == (*it)->peptide);
   }
   EXPECT_EQ(1, count);
   remove(tmp.c_str());
@@ -176,10 +189,10 @@ TEST_F(EludeCallerTest, TestTrainTestModel) {
 
   caller.Run();
   EXPECT_EQ(99, caller.train_psms().size());
-  vector<PSMDescription> test_psms = caller.test_psms();
+  vector<PSMDescription*> test_psms = caller.test_psms();
   EXPECT_EQ(1252, test_psms.size());
-  sort(test_psms.begin(), test_psms.end());
-  EXPECT_NEAR(28.3021, test_psms[9].getPredictedRetentionTime(), 2.0);
+  sort(test_psms.begin(), test_psms.end(), PSMDescription::ptrLess);
+  EXPECT_NEAR(28.3021, test_psms[9]->getPredictedRetentionTime(), 2.0);
 }
 
 TEST_F(EludeCallerTest, TestComputeWindow) {
@@ -206,6 +219,7 @@ TEST_F(EludeCallerTest, TestSaveLoadModel) {
   caller.Run();
 
   EludeCaller caller2;
+  caller2.SetEnzyme("trypsin");
   caller2.set_load_model_file(tmp);
   caller2.set_test_file(test_file1);
   caller2.set_remove_common_peptides(false);
@@ -214,10 +228,10 @@ TEST_F(EludeCallerTest, TestSaveLoadModel) {
   caller2.set_non_enzymatic(false);
   caller2.set_context_format(true);
   caller2.Run();
-  vector<PSMDescription> test_psms = caller2.test_psms();
+  vector<PSMDescription*> test_psms = caller2.test_psms();
   EXPECT_EQ(1252, test_psms.size());
-  sort(test_psms.begin(), test_psms.end());
-  EXPECT_NEAR(29.6867, test_psms[9].getPredictedRetentionTime(), 2.0);
+  sort(test_psms.begin(), test_psms.end(), PSMDescription::ptrLess);
+  EXPECT_NEAR(29.6867, test_psms[9]->getPredictedRetentionTime(), 2.0);
   remove(tmp.c_str());
 }
 
@@ -249,23 +263,24 @@ TEST_F(EludeCallerTest, TestAutomaticModelSelection) {
   caller.set_linear_calibration(false);
   caller.Run();
 
-  vector<PSMDescription> test_psms = caller.test_psms();
+  vector<PSMDescription*> test_psms = caller.test_psms();
   EXPECT_EQ(1740, test_psms.size());
-  sort(test_psms.begin(), test_psms.end());
-  EXPECT_NEAR(51.6007, test_psms[0].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(27.528, test_psms[1000].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(39.1311, test_psms[1739].getPredictedRetentionTime(), 0.01);
+  sort(test_psms.begin(), test_psms.end(), PSMDescription::ptrLess);
+  EXPECT_NEAR(51.6007, test_psms[0]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(27.528, test_psms[1000]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(39.1311, test_psms[1739]->getPredictedRetentionTime(), 0.01);
 }
 
 TEST_F(EludeCallerTest, TestFindLeastSquaresSolution) {
-  vector<PSMDescription> psms2;
-  psms2.push_back(PSMDescription(3, 1));
-  psms2.push_back(PSMDescription(5, 2));
-  psms2.push_back(PSMDescription(7, 3));
+  vector<PSMDescription*> psms2;
+  psms2.push_back(NewPSM(3, 1));
+  psms2.push_back(NewPSM(5, 2));
+  psms2.push_back(NewPSM(7, 3));
   double a = 0.0, b = 0.0;
   EludeCaller::FindLeastSquaresSolution(psms2, a, b);
   EXPECT_NEAR(2.0, a, 0.01);
   EXPECT_NEAR(1.0, b, 0.01);
+  for_each(psms2.begin(), psms2.end(), PSMDescription::deletePtr);
 }
 
 TEST_F(EludeCallerTest, TestAutomaticModelSelectionWithCalibration) {
@@ -283,17 +298,17 @@ TEST_F(EludeCallerTest, TestAutomaticModelSelectionWithCalibration) {
   LTSRegression::setCoverage(cov);
   caller.Run();
   pair<double, double> coeff = caller.lts_coefficients();
-  vector<PSMDescription> train_psms = caller.train_psms();
+  vector<PSMDescription*> train_psms = caller.train_psms();
   double a = 0.0, b = 0.0;
   EludeCaller::FindLeastSquaresSolution(train_psms, a, b);
   EXPECT_NEAR(a, coeff.first, 0.01);
   EXPECT_NEAR(b, coeff.second, 0.01);
-  vector<PSMDescription> test_psms = caller.test_psms();
+  vector<PSMDescription*> test_psms = caller.test_psms();
   EXPECT_EQ(1740, test_psms.size());
-  sort(test_psms.begin(), test_psms.end());
-  EXPECT_NEAR(51.6007 * a + b, test_psms[0].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(27.528 * a + b, test_psms[1000].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(39.1311 * a + b , test_psms[1739].getPredictedRetentionTime(), 0.01);
+  sort(test_psms.begin(), test_psms.end(), PSMDescription::ptrLess);
+  EXPECT_NEAR(51.6007 * a + b, test_psms[0]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(27.528 * a + b, test_psms[1000]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(39.1311 * a + b , test_psms[1739]->getPredictedRetentionTime(), 0.01);
 }
 
 TEST_F(EludeCallerTest, TestGetFileName) {
@@ -436,12 +451,12 @@ TEST_F(EludeCallerTest, TestLoadModel) {
   caller.set_context_format(true);
   caller.set_test_includes_rt(true);
   caller.Run();
-  vector<PSMDescription> test_psms = caller.test_psms();
-  sort(test_psms.begin(), test_psms.end());
+  vector<PSMDescription*> test_psms = caller.test_psms();
+  sort(test_psms.begin(), test_psms.end(), PSMDescription::ptrLess);
   EXPECT_EQ(1740, test_psms.size());
-  cout << test_psms[0].peptide << " " << test_psms[0].getPredictedRetentionTime() << endl;
-  cout << test_psms[1000].peptide << " " << test_psms[1000].getPredictedRetentionTime() << endl;
-  cout << test_psms[1739].peptide << " " << test_psms[1739].getPredictedRetentionTime() << endl;
+  cout << test_psms[0].peptide << " " << test_psms[0]->getPredictedRetentionTime() << endl;
+  cout << test_psms[1000].peptide << " " << test_psms[1000]->getPredictedRetentionTime() << endl;
+  cout << test_psms[1739].peptide << " " << test_psms[1739]->getPredictedRetentionTime() << endl;
 }*/
 
 
@@ -23,8 +23,10 @@
 
 #include "LibSVRModel.h"
 
+#ifndef PATH_TO_DATA
 #define PATH_TO_DATA string("")
 #define PATH_TO_WRITABLE string("")
+#endif
 
 class LibSVRModelTest : public ::testing::Test {
  protected:
@@ -41,11 +43,12 @@ class LibSVRModelTest : public ::testing::Test {
    virtual void TearDown() {
      DataManager::CleanUpTable(psms, feature_table);
      feature_table = NULL;
+     for_each(psms.begin(), psms.end(), PSMDescription::deletePtr);
    }
 
    LibSVRModel model;
    RetentionFeatures rf;
-   vector<PSMDescription> psms;
+   vector<PSMDescription*> psms;
    set<string> aa_alphabet;
    string train_file;
    double *feature_table;
@@ -58,22 +61,22 @@ TEST_F(LibSVRModelTest, TrainAndPredictBasicTest) {
   model.TrainModel(psms, no_features);
   EXPECT_FALSE(model.IsModelNull()) << "TrainAndPredictBasicTest error. Null model." << endl; ;
   int len = psms.size();
-  EXPECT_FLOAT_EQ(0.0, psms[len - 1].getPredictedRetentionTime());
-  psms[len - 1].getPredictedRetentionTime() = model.PredictRT(no_features, psms[len - 1].getRetentionFeatures());
+  EXPECT_FLOAT_EQ(0.0, psms[len - 1]->getPredictedRetentionTime());
+  psms[len - 1]->setPredictedRetentionTime(model.PredictRT(no_features, psms[len - 1]->getRetentionFeatures()));
   // TO DO: double check that this is correct
-  EXPECT_NEAR(35.5, psms[len - 1].getPredictedRetentionTime(), 0.5);
+  EXPECT_NEAR(35.5, psms[len - 1]->getPredictedRetentionTime(), 0.5);
 }
 
 TEST_F(LibSVRModelTest, EstimatePredictionErrorTest) {
-  vector<PSMDescription> test_psms;
+  vector<PSMDescription*> test_psms;
   int len = psms.size();
   test_psms.push_back(psms[0]);
   test_psms.push_back(psms[len - 1]);
 
   model.setRBFSVRParam(0.01, 0.05, 5);
   model.TrainModel(psms, no_features);
-  double pred1 =  psms[0].getRetentionTime() - model.PredictRT(no_features, psms[0].getRetentionFeatures());
-  double pred2 =  psms[len - 1].getRetentionTime() - model.PredictRT(no_features, psms[len - 1].getRetentionFeatures());
+  double pred1 =  psms[0]->getRetentionTime() - model.PredictRT(no_features, psms[0]->getRetentionFeatures());
+  double pred2 =  psms[len - 1]->getRetentionTime() - model.PredictRT(no_features, psms[len - 1]->getRetentionFeatures());
   double error = model.EstimatePredictionError(no_features, test_psms);
   EXPECT_NEAR((pred1*pred1 + pred2*pred2) / 2.0, error, 0.01) << "EstimatePredictionErrorTest does not give the correct results" << endl;
 }
@@ -23,6 +23,8 @@
 
 #include "RetentionFeatures.h"
 #include "PSMDescription.h"
+#include "PSMDescriptionDOC.h"
+#include "MyException.h"
 #include "Globals.h"
 
 class RetentionFeaturesTest: public ::testing::Test {
@@ -600,36 +602,84 @@ TEST_F(RetentionFeaturesTest, TestComputeNoPTMFeatures)
 TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesNoPtms)
 {
   rf.set_svr_index(RetentionFeatures::k_kyte_doolittle());
-  PSMDescription psm1("AAAA[unimod:21]", 10.0);
-  PSMDescription psm2("R.YY[unimod:21]YY.R", 11.0);
+  PSMDescriptionDOC psm1(string("AAAA[unimod:21]"), 10.0);
+  PSMDescriptionDOC psm2(string("R.YY[unimod:21]YY.R"), 11.0);
   int n_features = rf.GetTotalNumberFeatures();
-  psm1.getRetentionFeatures() = new double[n_features];
-  psm2.getRetentionFeatures() = new double[n_features];
-  vector<PSMDescription> psms;
-  psms.push_back(psm1);
-  psms.push_back(psm2);
+  psm1.setRetentionFeatures(new double[n_features]);
+  psm2.setRetentionFeatures(new double[n_features]);
+  vector<PSMDescription*> psms;
+  psms.push_back(&psm1);
+  psms.push_back(&psm2);
 
   rf.ComputeRetentionFeatures(psms);
   for (int i = 0; i < n_features; ++i) {
     if (i == 0) {
-      EXPECT_NEAR(RetentionFeatures::IndexSum(psm1.peptide, RetentionFeatures::k_kyte_doolittle()), psms[0].getRetentionFeatures()[i], 0.01) << " i = 0";
-      EXPECT_NEAR(RetentionFeatures::IndexSum(psm2.peptide.substr(2,15), RetentionFeatures::k_kyte_doolittle()), psms[1].getRetentionFeatures()[i], 0.01)  << " i = 0";
+      EXPECT_NEAR(RetentionFeatures::IndexSum(psm1.peptide, RetentionFeatures::k_kyte_doolittle()), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 0";
+      EXPECT_NEAR(RetentionFeatures::IndexSum(psm2.peptide.substr(2,15), RetentionFeatures::k_kyte_doolittle()), psms[1]->getRetentionFeatures()[i], 0.01)  << " i = 0";
     } if (i == 39) {
       set<string> hydrophobic_aa = RetentionFeatures::GetExtremeRetentionAA(RetentionFeatures::k_kyte_doolittle()).second;
-      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm1.peptide, hydrophobic_aa), psms[0].getRetentionFeatures()[i], 0.01)  << " i = 39";
-      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm2.peptide.substr(2,15), hydrophobic_aa), psms[1].getRetentionFeatures()[i], 0.01) << " i = 39";
+      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm1.peptide, hydrophobic_aa), psms[0]->getRetentionFeatures()[i], 0.01)  << " i = 39";
+      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm2.peptide.substr(2,15), hydrophobic_aa), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 39";
     }if (i == 40) {
-      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm1.peptide, RetentionFeatures::k_bulkiness()), psms[0].getRetentionFeatures()[i], 0.01) << " i = 40";
-      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm2.peptide.substr(2,15), RetentionFeatures::k_bulkiness()), psms[1].getRetentionFeatures()[i], 0.01) << " i = 40";
+      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm1.peptide, RetentionFeatures::k_bulkiness()), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 40";
+      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm2.peptide.substr(2,15), RetentionFeatures::k_bulkiness()), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 40";
     }if (i == 41) {
-      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm1.peptide), psms[0].getRetentionFeatures()[i], 0.01) << " i = 41";
-      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm2.peptide.substr(2,15)), psms[1].getRetentionFeatures()[i], 0.01) << " i = 41";
+      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm1.peptide), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 41";
+      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm2.peptide.substr(2,15)), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 41";
     }if (i == 42) {
-      EXPECT_NEAR(4.0, psms[0].getRetentionFeatures()[i], 0.01) << " i = 42";
-      EXPECT_FLOAT_EQ(0, psms[1].getRetentionFeatures()[i]) << " i = 42";
+      EXPECT_NEAR(4.0, psms[0]->getRetentionFeatures()[i], 0.01) << " i = 42";
+      EXPECT_FLOAT_EQ(0, psms[1]->getRetentionFeatures()[i]) << " i = 42";
     }if (i == 61) {
-      EXPECT_NEAR(4.0, psms[1].getRetentionFeatures()[i], 0.01) << " i = 61";
-      EXPECT_FLOAT_EQ(0, psms[0].getRetentionFeatures()[i]) << " i = 61";
+      EXPECT_NEAR(4.0, psms[1]->getRetentionFeatures()[i], 0.01) << " i = 61";
+      EXPECT_FLOAT_EQ(0, psms[0]->getRetentionFeatures()[i]) << " i = 61";
     }
   }
+  psm1.deleteRetentionFeatures();
+  psm2.deleteRetentionFeatures();
+}
+
+TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesSharedPeptides)
+{
+  rf.set_svr_index(RetentionFeatures::k_kyte_doolittle());
+  int n_features = rf.GetTotalNumberFeatures();
+  double *buf1 = new double[n_features];
+  double *buf2 = new double[n_features];
+  double *buf3 = new double[n_features];
+  PSMDescriptionDOC psm1(string("K.AAAAAAKDDDDAAAAAADD.R"), 10.0);
+  PSMDescriptionDOC psm2(string("R.YYYYEEK.R"), 11.0);
+  PSMDescriptionDOC psm3(string("-.AAAAAAKDDDDAAAAAADD.-"), 12.0);
+  psm1.setRetentionFeatures(buf1);
+  psm2.setRetentionFeatures(buf2);
+  psm3.setRetentionFeatures(buf3);
+  vector<PSMDescription*> psms;
+  psms.push_back(&psm1);
+  psms.push_back(&psm2);
+  psms.push_back(&psm3);
+
+  rf.ComputeRetentionFeatures(psms);
+  double *expected = new double[n_features];
+  rf.ComputeNoPTMFeatures("AAAAAAKDDDDAAAAAADD", expected);
+  for (int i = 0; i < n_features; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i], buf1[i]) << " i = " << i;
+    EXPECT_DOUBLE_EQ(expected[i], buf3[i]) << " i = " << i;
+  }
+  rf.ComputeNoPTMFeatures("YYYYEEK", expected);
+  for (int i = 0; i < n_features; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i], buf2[i]) << " i = " << i;
+  }
+  delete[] expected;
+  delete[] buf1;
+  delete[] buf2;
+  delete[] buf3;
+}
+
+TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesEmptyPeptide)
+{
+  rf.set_svr_index(RetentionFeatures::k_kyte_doolittle());
+  double *buf = new double[rf.GetTotalNumberFeatures()];
+  PSMDescriptionDOC psm(string("K..R"), 10.0);
+  psm.setRetentionFeatures(buf);
+  EXPECT_THROW(rf.ComputeRetentionFeatures(&psm), MyException);
+  EXPECT_THROW(rf.ComputeNoPTMFeatures("", buf), MyException);
+  delete[] buf;
 }
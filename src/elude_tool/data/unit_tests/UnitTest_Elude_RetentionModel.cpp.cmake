@@ -23,12 +23,15 @@
 
 #include "RetentionModel.h"
 #include "PSMDescription.h"
+#include "PSMDescriptionDOC.h"
 #include "DataManager.h"
 #include "Normalizer.h"
 #include "Globals.h"
 
+#ifndef PATH_TO_DATA
 #define PATH_TO_DATA string("@pathToData@")
 #define PATH_TO_WRITABLE string("@pathToWritable@")
+#endif
 
 class RetentionModelTest : public ::testing::Test {
  protected:
@@ -53,20 +56,17 @@ class RetentionModelTest : public ::testing::Test {
 
    virtual void TearDown() {
      delete rtmodel;
-     if (feature_table) {
-       delete[] feature_table;
-     }
-     if (feature_table_ptms) {
-       delete[] feature_table_ptms;
-     }
-     if (feature_table_test) {
-       delete[] feature_table_test;
-     }
+     DataManager::CleanUpTable(psms, feature_table);
+     DataManager::CleanUpTable(psms_ptms, feature_table_ptms);
+     DataManager::CleanUpTable(test_psms, feature_table_test);
+     for_each(psms.begin(), psms.end(), PSMDescription::deletePtr);
+     for_each(psms_ptms.begin(), psms_ptms.end(), PSMDescription::deletePtr);
+     for_each(test_psms.begin(), test_psms.end(), PSMDescription::deletePtr);
    }
 
    RetentionModel* rtmodel;
    string train_file, train_file_ptms, test_file;
-   vector<PSMDescription> psms, psms_ptms, test_psms;
+   vector<PSMDescription*> psms, psms_ptms, test_psms;
    set<string> aa_alphabet, aa_alphabet_ptms, aa_alphabet_test;
    double *feature_table, *feature_table_ptms, *feature_table_test;
  };
@@ -79,7 +79,7 @@ TEST_F(RetentionModelTest, NormalizeFeaturesTest) {
   no_features = rf.GetTotalNumberFeatures();
   rf.ComputeRetentionFeatures(psms);
 
-  vector<PSMDescription> tmp;
+  vector<PSMDescription*> tmp;
   int last = psms.size()-1;
 
   tmp.push_back(psms[0]);
@@ -88,18 +88,18 @@ TEST_F(RetentionModelTest, NormalizeFeaturesTest) {
 
   rtmodel->NormalizeFeatures(true, tmp);
 
-  EXPECT_FLOAT_EQ(0.0, tmp[0].getRetentionFeatures()[0]);
-  EXPECT_FLOAT_EQ(1.0, tmp[1].getRetentionFeatures()[0]);
-  EXPECT_NEAR(0.17948718, tmp[2].getRetentionFeatures()[0], 0.001);
+  EXPECT_FLOAT_EQ(0.0, tmp[0]->getRetentionFeatures()[0]);
+  EXPECT_FLOAT_EQ(1.0, tmp[1]->getRetentionFeatures()[0]);
+  EXPECT_NEAR(0.17948718, tmp[2]->getRetentionFeatures()[0], 0.001);
 
-  EXPECT_FLOAT_EQ(1.0, tmp[0].getRetentionFeatures()[no_features - 1]);
-  EXPECT_FLOAT_EQ(0.0, tmp[1].getRetentionFeatures()[no_features - 1]);
-  EXPECT_FLOAT_EQ(0.0, tmp[2].getRetentionFeatures()[no_features - 1]);
+  EXPECT_FLOAT_EQ(1.0, tmp[0]->getRetentionFeatures()[no_features - 1]);
+  EXPECT_FLOAT_EQ(0.0, tmp[1]->getRetentionFeatures()[no_features - 1]);
+  EXPECT_FLOAT_EQ(0.0, tmp[2]->getRetentionFeatures()[no_features - 1]);
 }
 
 TEST_F(RetentionModelTest, BuildRetentionIndexNoPtmsTest) {
-  PSMDescription::setPSMSet(psms);
-  PSMDescription::normalizeRetentionTimes(psms);
+  PSMDescriptionDOC::setPSMSet(psms);
+  PSMDescriptionDOC::normalizeRetentionTimes(psms);
   map<string, double> index = rtmodel->BuildRetentionIndex(aa_alphabet, true, psms);
   EXPECT_NEAR(0.0194839, index["A"], 0.01);
   EXPECT_NEAR(0.884652, index["L"], 0.01);
@@ -122,16 +122,16 @@ TEST_F(RetentionModelTest, TrainRetentionModelNoPtmsTest) {
 
 TEST_F(RetentionModelTest, TrainRetentionModelPtmsTest) {
   EXPECT_TRUE(rtmodel->IsModelNull());
-  PSMDescription::setPSMSet(psms_ptms);
-  PSMDescription::normalizeRetentionTimes(psms_ptms);
+  PSMDescriptionDOC::setPSMSet(psms_ptms);
+  PSMDescriptionDOC::normalizeRetentionTimes(psms_ptms);
   map<string, double> index = rtmodel->BuildRetentionIndex(aa_alphabet_ptms, true, psms_ptms);
   rtmodel->TrainRetentionModel(aa_alphabet_ptms, index, true, psms_ptms);
   EXPECT_FALSE(rtmodel->IsModelNull());
 }
 
 TEST_F(RetentionModelTest, IsSetIncludedTest) {
-  PSMDescription::setPSMSet(psms);
-  PSMDescription::normalizeRetentionTimes(psms);
+  PSMDescriptionDOC::setPSMSet(psms);
+  PSMDescriptionDOC::normalizeRetentionTimes(psms);
   map<string, double> index = rtmodel->BuildRetentionIndex(aa_alphabet, true, psms);
   RetentionFeatures rf = rtmodel->retention_features();
   EXPECT_TRUE(rtmodel->IsSetIncluded(aa_alphabet, rf.amino_acids_alphabet(), false));
@@ -148,10 +148,10 @@ TEST_F(RetentionModelTest, PredictRTTest) {
   map<string, double> index = rtmodel->BuildRetentionIndex(aa_alphabet_ptms, false, psms_ptms);
   rtmodel->TrainRetentionModel(aa_alphabet_ptms, index, true, psms_ptms);
   EXPECT_EQ(0,rtmodel->PredictRT(aa_alphabet, false, "", psms));
-  EXPECT_NEAR(40.3878, psms[22].getRetentionTime(), 0.01);
-  EXPECT_NEAR(39.3343, psms[22].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(21.3787, psms[100].getRetentionTime(), 0.01);
-  EXPECT_NEAR(23.2295, psms[100].getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(40.3878, psms[22]->getRetentionTime(), 0.01);
+  EXPECT_NEAR(39.3343, psms[22]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(21.3787, psms[100]->getRetentionTime(), 0.01);
+  EXPECT_NEAR(23.2295, psms[100]->getPredictedRetentionTime(), 0.01);
 }
 
 TEST_F(RetentionModelTest, PredictRTTestPtms) {
@@ -159,11 +159,11 @@ TEST_F(RetentionModelTest, PredictRTTestPtms) {
   map<string, double> index = rtmodel->BuildRetentionIndex(aa_alphabet, false, psms);
   rtmodel->TrainRetentionModel(aa_alphabet, index, true, psms);
   EXPECT_EQ(0,rtmodel->PredictRT(aa_alphabet_ptms, true, "", psms_ptms));
-  EXPECT_NEAR(31.9043, psms_ptms[0].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(33.2027, psms_ptms[10].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(22.6466, psms_ptms[psms_ptms.size() - 1].getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(31.9043, psms_ptms[0]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(33.2027, psms_ptms[10]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(22.6466, psms_ptms[psms_ptms.size() - 1]->getPredictedRetentionTime(), 0.01);
   EXPECT_EQ(0,rtmodel->PredictRT(aa_alphabet_test, false, "", test_psms));
-  EXPECT_NEAR(22.062, test_psms[9].getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(22.062, test_psms[9]->getPredictedRetentionTime(), 0.01);
 }
 
 TEST_F(RetentionModelTest, SaveModelToFileTest) {
@@ -226,9 +226,9 @@ TEST_F(RetentionModelTest, LoadModelFromFileTest) {
   rtmodel = new RetentionModel(Normalizer::getNormalizer());
   rtmodel->LoadModelFromFile(tmp);
   EXPECT_EQ(0,rtmodel->PredictRT(aa_alphabet, false, "", psms));
-  EXPECT_NEAR(40.3878, psms[22].getRetentionTime(), 0.01);
-  EXPECT_NEAR(39.3343, psms[22].getPredictedRetentionTime(), 0.01);
-  EXPECT_NEAR(21.3787, psms[100].getRetentionTime(), 0.01);
+  EXPECT_NEAR(40.3878, psms[22]->getRetentionTime(), 0.01);
+  EXPECT_NEAR(39.3343, psms[22]->getPredictedRetentionTime(), 0.01);
+  EXPECT_NEAR(21.3787, psms[100]->getRetentionTime(), 0.01);
   remove(tmp.c_str());
 }
 
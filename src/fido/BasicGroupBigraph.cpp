@@ -173,6 +173,17 @@ double BasicGroupBigraph::probabilityN(const Model & m, const Array<Counter> & n
   return prod;
 }
 
+double BasicGroupBigraph::logProbabilityN(const Model & m, const Array<Counter> & n) const {
+  double logProd = 0.0;
+
+  for (int k=0; k<n.size(); k++)
+    {
+      logProd += m.logProbabilityProteins(n[k].size, n[k].state);
+    }
+
+  return logProd;
+}
+
 double BasicGroupBigraph::logNumberOfConfigurations() const {
   double result = 0.0;
 
@@ -188,7 +199,7 @@ double BasicGroupBigraph::probabilityNNu(const Model & m, const Counter & nNu) c
 }
 
 double BasicGroupBigraph::probabilityNGivenD(const Model & m, const Array<Counter> & n) const {
-  double logLike= logLikelihoodNGivenD(m,n) + log2(probabilityN(m,n)) - logLikelihoodConstantCachedFunctor(m,this);
+  double logLike= logLikelihoodNGivenD(m,n) + logProbabilityN(m,n) - logLikelihoodConstantCachedFunctor(m,this);
   return pow(2.0, logLike);
 }
 
@@ -200,7 +211,7 @@ double BasicGroupBigraph::logLikelihoodConstant(const Model & m) const {
 
   for (Counter::start(n); Counter::inRange(n); Counter::advance(n)) {
     double L = logLikelihoodNGivenD(m, n);
-    double p = log2(probabilityN(m, n));
+    double p = logProbabilityN(m, n);
     double logLikeTerm = L+p;
 
     if ( starting ) {
@@ -143,6 +143,7 @@ class BasicGroupBigraph : public BasicBigraph {
   double logLikelihoodNGivenD(const Model& m, const Array<Counter> & n) const;
 
   double probabilityN(const Model& m, const Array<Counter> & n) const;
+  double logProbabilityN(const Model& m, const Array<Counter> & n) const;
   double probabilityNNu(const Model& m, const Counter & nNu) const;
   double probabilityNGivenD(const Model& m, const Array<Counter> & n) const;
 
@@ -7,6 +7,7 @@
 using namespace std;
 
 #include <cmath>
+#include <vector>
 #include "Combinatorics.h"
 
 #include <iostream>
@@ -25,8 +26,8 @@ class Model {
  protected:
  public:
   double alpha, beta, gamma;
-  Model() { alpha = beta = gamma = -1; }
-  Model(double a, double b, double g) : alpha(a), beta(b), gamma(g) { }
+  Model() { alpha = beta = gamma = -1; initTables(); }
+  Model(double a, double b, double g) : alpha(a), beta(b), gamma(g) { initTables(); }
 
   friend bool operator ==(const Model & lhs, const Model & rhs) {
     return lhs.alpha == rhs.alpha && lhs.beta == rhs.beta && lhs.gamma == rhs.gamma;
@@ -48,20 +49,91 @@ class Model {
   
   // probability that a peptide is not emitted, given @numActivProts
   double probabilityNoEmissionFrom(int numActiveProts) const {
-    // using log for greater precision
-    return pow(2.0, log2( 1-beta )+numActiveProts * log2(1-alpha) );
+    checkTables();
+    if (numActiveProts >= static_cast<int>(noEmissionTable_.size())) {
+      extendNoEmissionTable(numActiveProts);
+    }
+    return noEmissionTable_[numActiveProts];
   }
   
   // probability that @activeProts are present, given @totalProts
   double probabilityProteins(int totalProts, int activeProts) const {
-    // using log for greater precision
-    return pow(2.0, Combinatorics::logBinomial(totalProts, activeProts) + activeProts*log2(gamma) + (totalProts-activeProts) * log2(1-gamma) );
+    return proteinsRow(totalProts)[activeProts];
+  }
+  
+  // log2 of the probability that @activeProts are present, given @totalProts
+  double logProbabilityProteins(int totalProts, int activeProts) const {
+    return logProteinsRow(totalProts)[activeProts];
   }
 
   friend ostream & operator <<(ostream & os, const Model & m) {
     os << "alpha = " << m.alpha << ", \t beta = " << m.beta << ", \t gamma = " << m.gamma << endl;
     return os;
   }
+  
+ private:
+  // The probabilities above are called for every configuration of every
+  // protein group, but only depend on the number of (active) proteins.
+  // They are therefore tabulated for the alpha, beta and gamma values the
+  // tables were filled for, and the tables are cleared when these change.
+  mutable double tableAlpha_, tableBeta_, tableGamma_;
+  mutable std::vector<double> noEmissionTable_; // indexed by active proteins
+  mutable std::vector<std::vector<double> > proteinsTable_, logProteinsTable_; // indexed by (total, active)
+  
+  void initTables() {
+    tableAlpha_ = alpha;
+    tableBeta_ = beta;
+    tableGamma_ = gamma;
+  }
+  
+  void checkTables() const {
+    if (tableAlpha_ != alpha || tableBeta_ != beta || tableGamma_ != gamma) {
+      noEmissionTable_.clear();
+      if (tableGamma_ != gamma) {
+        proteinsTable_.clear();
+        logProteinsTable_.clear();
+      }
+      tableAlpha_ = alpha;
+      tableBeta_ = beta;
+      tableGamma_ = gamma;
+    }
+  }
+  
+  void extendNoEmissionTable(int numActiveProts) const {
+    for (int k = noEmissionTable_.size(); k <= numActiveProts; ++k) {
+      // using log for greater precision
+      noEmissionTable_.push_back(pow(2.0, log2( 1-beta )+k * log2(1-alpha) ));
+    }
+  }
+  
+  const std::vector<double>& logProteinsRow(int totalProts) const {
+    checkTables();
+    if (totalProts >= static_cast<int>(logProteinsTable_.size())) {
+      extendProteinsTable(totalProts);
+    }
+    return logProteinsTable_[totalProts];
+  }
+  
+  const std::vector<double>& proteinsRow(int totalProts) const {
+    checkTables();
+    if (totalProts >= static_cast<int>(proteinsTable_.size())) {
+      extendProteinsTable(totalProts);
+    }
+    return proteinsTable_[totalProts];
+  }
+  
+  void extendProteinsTable(int totalProts) const {
+    double logGamma = log2(gamma), logNotGamma = log2(1-gamma);
+    for (int total = logProteinsTable_.size(); total <= totalProts; ++total) {
+      std::vector<double> logRow(total + 1), row(total + 1);
+      for (int active = 0; active <= total; ++active) {
+        logRow[active] = Combinatorics::logBinomial(total, active) + active*logGamma + (total-active) * logNotGamma;
+        row[active] = pow(2.0, logRow[active]);
+      }
+      logProteinsTable_.push_back(logRow);
+      proteinsTable_.push_back(row);
+    }
+  }
 };
 
 /*
@@ -19,6 +19,7 @@
 #include <errno.h>
 #endif
 #include "Database.h"
+#include "FastaReader.h"
 
 #include <map>
 #include <vector>
@@ -228,81 +229,57 @@ void Database::addProtein(
 /**
  * Parses a database from the text based fasta file in the filename
  * member variable
- * reads in all proteins in the fasta file and creates a protein object
+ * indexes the fasta file and creates a protein object for each record,
+ * which copies its sequence out of the mapped file,
  * and adds them to the database protein array
- * total proteins in fasta file must not exceed MAX_PROTEIN constant
  * IF using light_protein functionality will not read in the sequence or id.
  * \returns true if success. false if failure.
  */
 bool Database::parseTextFasta()
 {
-  unsigned long working_index;
-  FILE* file = NULL;
-  char* new_line = NULL;
-  int line_length;
-  size_t buf_length = 0;
-  Protein* new_protein;
-  unsigned int protein_idx;
-
   //carp(CARP_DEBUG, "Parsing text fasta file '%s'", fasta_filename_.c_str());
   // check if already parsed
   if(is_parsed_){
     return true;
   }
   
-  // open file and 
-  file = fopen(fasta_filename_.c_str(), "rb");
-  
-  // check if succesfully opened file
-  if(file == NULL){
+  // map and index the file
+  FastaReader fasta_reader;
+  if(!fasta_reader.open(fasta_filename_)){
     //carp(CARP_ERROR, "Failed to open fasta file %s", fasta_filename_.c_str());
     return false;
   }
-   
-  working_index = ftell(file);
-  // check each line until reach '>' line
-  while((line_length =  getline(&new_line, &buf_length, file)) != -1){
-    if(new_line[0] == '>'){
-      // the new protein to be added
-      new_protein = new Protein();
-      
-      // do not parse the protein sequence if using light/heavy functionality
-      if(use_light_protein_){
-        // set light and offset
-        new_protein->setOffset(working_index);
-        new_protein->setIsLight(true);
-      }
-      else{
-        // rewind to the beginning of the protein to include ">" line
-        fseek(file, working_index, SEEK_SET);
-        
-        // failed to parse the protein from fasta file
-        // protein offset is set in the parse_protein_fasta_file method
-        if(!new_protein->parseProteinFastaFile(file)){
-          fclose(file);
-          delete new_protein;
-          for(protein_idx=0;protein_idx<proteins_->size();protein_idx++){
-            delete (proteins_->at(protein_idx));
-          }
-          proteins_->clear();
-          //carp(CARP_ERROR, "Failed to parse fasta file");
-          return false;
-        }
-        new_protein->setIsLight(false);
-      }
-      // add protein to database
-      proteins_->push_back(new_protein);
-      // set protein index, database
-      new_protein->setProteinIdx(proteins_->size()-1);
-      new_protein->setDatabase(this);
+  
+  int num_proteins = static_cast<int>(fasta_reader.size());
+  proteins_->resize(num_proteins);
+  #pragma omp parallel for schedule(dynamic, 256)
+  for(int protein_idx = 0; protein_idx < num_proteins; ++protein_idx){
+    Protein* new_protein = new Protein();
+    
+    // do not parse the protein sequence if using light/heavy functionality
+    if(use_light_protein_){
+      // set light and offset
+      new_protein->setOffset(fasta_reader[protein_idx].offset);
+      new_protein->setIsLight(true);
     }
-    working_index = ftell(file);
+    else{
+      new_protein->parseProteinFastaRecord(fasta_reader[protein_idx]);
+      new_protein->setIsLight(false);
+    }
+    new_protein->setProteinIdx(protein_idx);
+    (*proteins_)[protein_idx] = new_protein;
   }
-  free(new_line);
+  
+  // set database, this updates the pointer count and is done serially
+  for(int protein_idx = 0; protein_idx < num_proteins; ++protein_idx){
+    (*proteins_)[protein_idx]->setDatabase(this);
+  }
+  
+  // keep a handle to the file, light proteins are read from their offsets
+  file_ = fopen(fasta_filename_.c_str(), "rb");
   
   // yes the database is paresed now..!!
   is_parsed_ = true;
-  file_ = file;
   return true;
 }
 
@@ -59,9 +59,9 @@ class Database {
   /**
    * Parses a database from the text based fasta file in the filename
    * member variable
-   * reads in all proteins in the fasta file and creates a protein object
+   * memory maps the fasta file and creates a protein object for each
+   * record, which copies its sequence out of the mapped file,
    * and adds them to the database protein array
-   * total proteins in fasta file must not exceed MAX_PROTEIN constant
    * IF using light_protein functionality will not read in the sequence or id.
    * \returns true if success. false if failure.
    */
@@ -0,0 +1,245 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "DigestCache.h"
+#include "Globals.h"
+
+using namespace std;
+using namespace PercolatorCrux;
+
+const string DigestCache::cache_suffix = "-digest-cache";
+
+/* the trailing byte is the version of the file format */
+static const char kCacheMagic[8] = { 'P', 'P', 'D', 'I', 'G', 'E', 'S', 1 };
+
+static const unsigned long long kFnvOffset = 14695981039346656037ULL;
+static const unsigned long long kFnvPrime = 1099511628211ULL;
+
+static unsigned long long fnv1a(const char* data, size_t len,
+                                unsigned long long hash = kFnvOffset) {
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= (unsigned char)data[i];
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+static void writeUint(FILE* fp, unsigned long long value, size_t numBytes) {
+  fwrite(&value, numBytes, 1, fp);
+}
+
+static void writeString(FILE* fp, const std::string& str) {
+  writeUint(fp, str.size(), sizeof(unsigned int));
+  fwrite(str.data(), 1, str.size(), fp);
+}
+
+/* bounds checked sequential reader over the cache file; a length field can
+ * never make it read or allocate beyond the end of the file */
+class CacheReader {
+ public:
+  CacheReader(std::istream& in, unsigned long long size) : in_(in), remaining_(size) {}
+  bool readUint(unsigned long long& value, size_t numBytes) {
+    if (numBytes > remaining_) return false;
+    value = 0;
+    in_.read(reinterpret_cast<char*>(&value), numBytes);
+    remaining_ -= numBytes;
+    return in_.good();
+  }
+  bool readString(std::string& str) {
+    unsigned long long len;
+    if (!readUint(len, sizeof(unsigned int)) || len > remaining_) return false;
+    str.resize(len);
+    if (len > 0) in_.read(&str[0], len);
+    remaining_ -= len;
+    return in_.good();
+  }
+  bool readMagic() {
+    char magic[sizeof(kCacheMagic)];
+    if (sizeof(magic) > remaining_) return false;
+    in_.read(magic, sizeof(magic));
+    remaining_ -= sizeof(magic);
+    return in_.good() && memcmp(magic, kCacheMagic, sizeof(kCacheMagic)) == 0;
+  }
+ private:
+  std::istream& in_;
+  unsigned long long remaining_;
+};
+
+DigestCache::DigestCache(const std::string& cacheDirectory) :
+    cacheDirectory_(cacheDirectory) {}
+
+bool DigestCache::checksumFile(const std::string& fileName,
+    unsigned long long& checksum, unsigned long long& fileSize) {
+  FILE* fp = fopen(fileName.c_str(), "rb");
+  if (fp == NULL) return false;
+
+  std::vector<char> buffer(1 << 20);
+  checksum = kFnvOffset;
+  fileSize = 0;
+  size_t numRead;
+  while ((numRead = fread(&buffer[0], 1, buffer.size(), fp)) > 0) {
+    checksum = fnv1a(&buffer[0], numRead, checksum);
+    fileSize += numRead;
+  }
+  bool success = (ferror(fp) == 0);
+  fclose(fp);
+  return success;
+}
+
+bool DigestCache::initKey(const std::string& fastaFile,
+    ENZYME_T enzyme, DIGEST_T digestion,
+    int minPeptideLength, int maxPeptideLength, int maxMiscleavages,
+    const std::string& decoyPattern, bool reverseProteinSeqs) {
+  unsigned long long checksum, fileSize;
+  if (!checksumFile(fastaFile, checksum, fileSize)) {
+    return false;
+  }
+
+  std::ostringstream oss;
+  oss << "fasta_size=" << fileSize << ";fasta_fnv1a=" << std::hex << checksum
+      << std::dec << ";enzyme=" << enzyme << ";digestion=" << digestion
+      << ";min_length=" << minPeptideLength
+      << ";max_length=" << maxPeptideLength
+      << ";max_miscleavages=" << maxMiscleavages
+      << ";decoy_pattern=" << decoyPattern
+      << ";reverse=" << reverseProteinSeqs;
+  key_ = oss.str();
+
+  std::ostringstream fileName;
+  fileName << cacheDirectory_;
+  if (!cacheDirectory_.empty() && cacheDirectory_[cacheDirectory_.size() - 1] != '/'
+        && cacheDirectory_[cacheDirectory_.size() - 1] != '\\') {
+    fileName << '/';
+  }
+  fileName << std::hex << fnv1a(key_.data(), key_.size()) << cache_suffix;
+  cacheFile_ = fileName.str();
+  return true;
+}
+
+bool DigestCache::load(std::map<std::string, std::string>& fragmentMap,
+    std::map<std::string, std::string>& duplicateMap,
+    bool& fastaHasDecoys) const {
+  if (key_.empty()) return false;
+
+  std::ifstream file(cacheFile_.c_str(), std::ios::in | std::ios::binary);
+  if (!file) return false;
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  file.seekg(0, std::ios::beg);
+  if (size <= 0) return false;
+
+  CacheReader in(file, size);
+  std::string storedKey;
+  unsigned long long hasDecoys = 0, numFragments = 0, numDuplicates = 0;
+  bool success = in.readMagic() && in.readString(storedKey) && storedKey == key_
+      && in.readUint(hasDecoys, 1) && in.readUint(numFragments, 8)
+      && in.readUint(numDuplicates, 8);
+
+  // the entries were written in key order, so each insert is hinted at the end
+  std::map<std::string, std::string> fragments, duplicates;
+  std::string that, me;
+  for (unsigned long long i = 0; success && i < numFragments; ++i) {
+    success = in.readString(that) && in.readString(me);
+    if (success) fragments.insert(fragments.end(), std::make_pair(that, me));
+  }
+  for (unsigned long long i = 0; success && i < numDuplicates; ++i) {
+    success = in.readString(that) && in.readString(me);
+    if (success) duplicates.insert(duplicates.end(), std::make_pair(that, me));
+  }
+  success = success && in.readMagic();
+
+  if (!success) {
+    if (VERB > 1) {
+      std::cerr << "Warning: ignoring invalid or outdated digest cache file "
+                << cacheFile_ << std::endl;
+    }
+    return false;
+  }
+
+  if (fragmentMap.empty()) {
+    fragmentMap.swap(fragments);
+  } else {
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = fragments.begin(); it != fragments.end(); ++it) {
+      fragmentMap[it->first] = it->second;
+    }
+  }
+  if (duplicateMap.empty()) {
+    duplicateMap.swap(duplicates);
+  } else {
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = duplicates.begin(); it != duplicates.end(); ++it) {
+      duplicateMap[it->first] = it->second;
+    }
+  }
+  fastaHasDecoys = (hasDecoys != 0);
+  return true;
+}
+
+bool DigestCache::store(const std::map<std::string, std::string>& fragmentMap,
+    const std::map<std::string, std::string>& duplicateMap,
+    bool fastaHasDecoys) const {
+  if (key_.empty()) return false;
+
+  std::string tmpFile = cacheFile_ + ".tmp";
+  FILE* fp = fopen(tmpFile.c_str(), "wb");
+  if (fp == NULL) {
+    if (VERB > 1) {
+      std::cerr << "Warning: could not write digest cache file " << cacheFile_
+                << ", check if the cache directory exists and is writable." << std::endl;
+    }
+    return false;
+  }
+
+  fwrite(kCacheMagic, 1, sizeof(kCacheMagic), fp);
+  writeString(fp, key_);
+  writeUint(fp, fastaHasDecoys ? 1u : 0u, 1);
+  writeUint(fp, fragmentMap.size(), 8);
+  writeUint(fp, duplicateMap.size(), 8);
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = fragmentMap.begin(); it != fragmentMap.end(); ++it) {
+    writeString(fp, it->first);
+    writeString(fp, it->second);
+  }
+  for (it = duplicateMap.begin(); it != duplicateMap.end(); ++it) {
+    writeString(fp, it->first);
+    writeString(fp, it->second);
+  }
+  fwrite(kCacheMagic, 1, sizeof(kCacheMagic), fp);
+
+  bool success = (ferror(fp) == 0);
+  success = (fclose(fp) == 0) && success;
+  if (success) {
+    remove(cacheFile_.c_str()); // rename does not overwrite on Windows
+    success = (rename(tmpFile.c_str(), cacheFile_.c_str()) == 0);
+  }
+  if (!success) {
+    remove(tmpFile.c_str());
+    if (VERB > 1) {
+      std::cerr << "Warning: could not write digest cache file " << cacheFile_
+                << std::endl;
+    }
+  }
+  return success;
+}
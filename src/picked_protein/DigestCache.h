@@ -0,0 +1,82 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class DigestCache, which persists the result of the
+ * in-silico digest used for picked-protein grouping, i.e. the fragment and
+ * duplicate protein maps, such that subsequent runs on the same fasta file
+ * with the same digestion parameters can skip parsing and digesting.
+ */
+
+#ifndef PICKED_PROTEIN_DIGEST_CACHE_H_
+#define PICKED_PROTEIN_DIGEST_CACHE_H_
+
+#include <string>
+#include <map>
+
+#include "objects.h"
+
+class DigestCache {
+ public:
+  /**
+   * The suffix of the cache files, which are named by the cache key
+   */
+  static const std::string cache_suffix;
+
+  DigestCache(const std::string& cacheDirectory);
+  ~DigestCache() {}
+
+  /**
+   * Computes the cache key from the contents of the fasta file and all
+   * parameters that influence the digest.
+   * \returns false if the fasta file could not be read.
+   */
+  bool initKey(const std::string& fastaFile,
+      PercolatorCrux::ENZYME_T enzyme, PercolatorCrux::DIGEST_T digestion,
+      int minPeptideLength, int maxPeptideLength, int maxMiscleavages,
+      const std::string& decoyPattern, bool reverseProteinSeqs);
+
+  /**
+   * Reads the cache file matching the current key, if it exists, and adds
+   * its fragment and duplicate entries to the maps. The maps are left
+   * untouched if the file is missing, truncated or written for another key.
+   * \returns true if a valid cache file was found.
+   */
+  bool load(std::map<std::string, std::string>& fragmentMap,
+      std::map<std::string, std::string>& duplicateMap,
+      bool& fastaHasDecoys) const;
+
+  /**
+   * Writes the fragment and duplicate maps to the cache file matching the
+   * current key. The file is first written to a temporary file and then
+   * renamed, such that concurrent runs never see a partially written cache.
+   * \returns true if the cache file was written successfully.
+   */
+  bool store(const std::map<std::string, std::string>& fragmentMap,
+      const std::map<std::string, std::string>& duplicateMap,
+      bool fastaHasDecoys) const;
+
+  const std::string& getCacheFile() const { return cacheFile_; }
+
+ private:
+  std::string cacheDirectory_, cacheFile_;
+  std::string key_; // textual key, stored verbatim in the header and compared on load
+
+  static bool checksumFile(const std::string& fileName,
+    unsigned long long& checksum, unsigned long long& fileSize);
+};
+
+#endif /* PICKED_PROTEIN_DIGEST_CACHE_H_ */
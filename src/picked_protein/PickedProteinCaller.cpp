@@ -343,10 +343,63 @@ void PickedProteinCaller::findFragmentsAndDuplicatesNonSpecificDigest(
   }
 }
 
+//! looks up the fragment and duplicate maps in the digest cache if a cache
+//! directory was set, otherwise or on a cache miss, digests the fasta 
+//! database and stores the result in the cache for subsequent runs
 bool PickedProteinCaller::getProteinFragmentsAndDuplicates(
     std::map<std::string, std::string>& fragment_map,
     std::map<std::string, std::string>& duplicate_map,
     bool reverseProteinSeqs) {
+  if (digest_cache_dir_.empty()) {
+    return digestProteinFragmentsAndDuplicates(fragment_map, duplicate_map, 
+                                               reverseProteinSeqs);
+  }
+  
+  DigestCache cache(digest_cache_dir_);
+  if (!cache.initKey(protein_db_file_, enzyme_, digestion_, min_peptide_length_,
+                     max_peptide_length_, max_miscleavages_, decoyPattern_,
+                     reverseProteinSeqs)) {
+    std::cerr << "Failed to read database " << protein_db_file_ << std::endl;
+    return EXIT_FAILURE;
+  }
+  
+  bool cache_has_decoys = false;
+  if (cache.load(fragment_map, duplicate_map, cache_has_decoys)) {
+    if (VERB > 1) {
+      std::cerr << "Read protein fragments/duplicates from digest cache " 
+                << cache.getCacheFile() << std::endl;
+    }
+    fasta_has_decoys_ = fasta_has_decoys_ || cache_has_decoys;
+    return EXIT_SUCCESS;
+  }
+  
+  // collect the results of this digest separately, as the output maps might
+  // already contain the results of a previous digest
+  std::map<std::string, std::string> fragment_map_local, duplicate_map_local;
+  bool fail = digestProteinFragmentsAndDuplicates(fragment_map_local, 
+                  duplicate_map_local, reverseProteinSeqs);
+  if (fail) return fail;
+  
+  if (cache.store(fragment_map_local, duplicate_map_local, fasta_has_decoys_) 
+        && VERB > 2) {
+    std::cerr << "Wrote protein fragments/duplicates to digest cache " 
+              << cache.getCacheFile() << std::endl;
+  }
+  
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = fragment_map_local.begin(); it != fragment_map_local.end(); ++it) {
+    fragment_map[it->first] = it->second;
+  }
+  for (it = duplicate_map_local.begin(); it != duplicate_map_local.end(); ++it) {
+    duplicate_map[it->first] = it->second;
+  }
+  return EXIT_SUCCESS;
+}
+
+bool PickedProteinCaller::digestProteinFragmentsAndDuplicates(
+    std::map<std::string, std::string>& fragment_map,
+    std::map<std::string, std::string>& duplicate_map,
+    bool reverseProteinSeqs) {
   time_t startTime;
   time(&startTime);
   clock_t startClock = clock();
@@ -35,6 +35,7 @@
 #include "PeptideConstraint.h"
 #include "ProteinPeptideIterator.h"
 #include "Protein.h"
+#include "DigestCache.h"
 
 class PickedProteinCaller{
  public:
@@ -57,12 +58,21 @@ class PickedProteinCaller{
     decoyPattern_ = decoyPattern;
   }
   
+  void setDigestCacheDirectory(const std::string& digest_cache_dir) {
+    digest_cache_dir_ = digest_cache_dir;
+  }
+  
   bool getProteinFragmentsAndDuplicates(
       std::map<std::string, std::string>& fragment_map,
       std::map<std::string, std::string>& duplicate_map,
       bool reverseProteinSeqs);
   
  private:
+  bool digestProteinFragmentsAndDuplicates(
+      std::map<std::string, std::string>& fragment_map,
+      std::map<std::string, std::string>& duplicate_map,
+      bool reverseProteinSeqs);
+  
   PercolatorCrux::ENZYME_T enzyme_;
   PercolatorCrux::DIGEST_T digestion_;
   int min_peptide_length_, max_peptide_length_, max_miscleavages_;
@@ -70,6 +80,7 @@ class PickedProteinCaller{
   bool fasta_has_decoys_;
   
   std::string protein_db_file_, peptide_input_file_, protein_output_file_;
+  std::string digest_cache_dir_; // empty if the digest should not be cached
   
   void addToPeptideProteinMap(PercolatorCrux::Database& db, 
     size_t protein_idx, PercolatorCrux::PeptideConstraint& peptide_constraint,
@@ -41,6 +41,7 @@ void Protein::init() {
   is_light_ = false;
   is_memmap_ = false;
   id_ = NULL;
+  owns_id_ = false;
   sequence_ = NULL;
   length_ = 0;
   annotation_ = NULL;
@@ -104,10 +105,10 @@ Protein* Protein::newLightProtein(
 Protein::~Protein() 
 {
   // FIXME what is the point of checking this?
+  if (owns_id_){
+    free(id_);
+  }
   if(!is_memmap_ && !is_light_){ 
-    if (id_ != NULL){
-      free(id_);
-    }
     if (sequence_ != NULL){
       free(sequence_);
     }
@@ -377,6 +378,49 @@ bool Protein::parseProteinFastaFile(
 
 }
 
+/**
+ * Sets the protein to a record of a text fasta file indexed by a FastaReader.
+ * The sequence lines are copied out of the mapped file with the same rules
+ * as readRawSequence, i.e. non-alphabetic characters, which includes the
+ * line breaks of wrapped lines, are skipped and the remaining ones are
+ * converted to upper case.
+ */
+void Protein::parseProteinFastaRecord(
+  const FastaRecord& record ///< record of the fasta file -in
+  )
+{
+  char* sequence = (char*)malloc(sizeof(char) * (record.bodyLength + 1));
+  unsigned int sequence_length = 0;
+  for (size_t i = 0; i < record.bodyLength; ++i) {
+    int a_char = (unsigned char)record.body[i];
+    if (a_char >= 'A' && a_char <= 'Z') {
+      // fast path for the common case of a valid upper case residue
+      sequence[sequence_length++] = a_char;
+    } else if (isalpha(a_char)) {
+      a_char = toupper(a_char);
+      if (a_char < 65 || a_char > 90) {
+        a_char = 'X';
+      }
+      sequence[sequence_length++] = a_char;
+    }
+  }
+  sequence[sequence_length] = '\0';
+
+  char* id = (char*)malloc(sizeof(char) * (record.idLength + 1));
+  memcpy(id, record.id, record.idLength);
+  id[record.idLength] = '\0';
+  if (owns_id_) {
+    free(id_);
+  }
+  id_ = id;
+  owns_id_ = true;
+
+  free(sequence_);
+  sequence_ = sequence;
+  length_ = sequence_length;
+  offset_ = record.offset;
+}
+
 /**************************************************/
 
 /**
@@ -592,12 +636,15 @@ void Protein::setId(
   const char* id ///< the sequence to add -in
   )
 {
-  free(id_);
+  if (owns_id_) {
+    free(id_);
+  }
   int id_length = strlen(id) +1; // +\0
   char* copy_id = 
     (char *)malloc(sizeof(char)*id_length);
   id_ =
     strncpy(copy_id, id, id_length);  
+  owns_id_ = true;
 }
 
 /**
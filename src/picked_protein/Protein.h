@@ -16,6 +16,7 @@
 #include <algorithm>
 #include "objects.h"
 #include "Database.h"
+#include "FastaReader.h"
 
 namespace PercolatorCrux {
 
@@ -27,6 +28,7 @@ class Protein {
   bool    is_light_; ///< is the protein a light protein?
   bool    is_memmap_; ///< is the protein produced from memory mapped file
   char*              id_; ///< The protein sequence id.
+  bool          owns_id_; ///< was id_ allocated by setId
   char*        sequence_; ///< The protein sequence.
   unsigned int   length_; ///< The length of the protein sequence.
   char*      annotation_; ///< Optional protein annotation.
@@ -151,6 +153,15 @@ class Protein {
     FILE* file ///< fasta file -in
   );
 
+  /**
+   * Sets the protein to a record of a text fasta file indexed by a FastaReader.
+   * The id and the sequence are copied, the sequence is cleaned up like in
+   * parseProteinFastaFile. The FastaReader may be closed afterwards.
+   */
+  void parseProteinFastaRecord(
+    const FastaRecord& record ///< record of the fasta file -in
+  );
+
   /**
    * Parses a protein from an memory mapped binary fasta file
    * the protein_idx field of the protein must be added before or
@@ -40,6 +40,114 @@ inline double powi(double base, int times) {
 #define INF HUGE_VAL
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+//
+// Dense kernel rows
+//
+// The kernel of one vector against many is computed feature by feature, updating one
+// accumulator per vector, such that every accumulator is still summed in the order of
+// the features, as in Kernel::dot and Kernel::k_function. The loops over the vectors are
+// vectorized, with AVX2 if the CPU supports it.
+//
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SVM_SIMD
+#include <immintrin.h>
+#endif
+
+// acc[j] += a * b[j]
+static void axpy_generic(double a, const double* b, double* acc, int n) {
+  for (int j = 0; j < n; j++) {
+    acc[j] += a * b[j];
+  }
+}
+
+// acc[j] += (a - b[j])^2
+static void sqdiff_generic(double a, const double* b, double* acc, int n) {
+  for (int j = 0; j < n; j++) {
+    double d = a - b[j];
+    acc[j] += d * d;
+  }
+}
+
+#ifdef SVM_SIMD
+__attribute__((target("avx2")))
+static void axpy_avx2(double a, const double* b, double* acc, int n) {
+  __m256d va = _mm256_set1_pd(a);
+  int j = 0;
+  for (; j + 8 <= n; j += 8) {
+    __m256d p0 = _mm256_mul_pd(va, _mm256_loadu_pd(b + j));
+    __m256d p1 = _mm256_mul_pd(va, _mm256_loadu_pd(b + j + 4));
+    _mm256_storeu_pd(acc + j, _mm256_add_pd(_mm256_loadu_pd(acc + j), p0));
+    _mm256_storeu_pd(acc + j + 4, _mm256_add_pd(_mm256_loadu_pd(acc + j + 4), p1));
+  }
+  for (; j < n; j++) {
+    acc[j] += a * b[j];
+  }
+}
+
+__attribute__((target("avx2")))
+static void sqdiff_avx2(double a, const double* b, double* acc, int n) {
+  __m256d va = _mm256_set1_pd(a);
+  int j = 0;
+  for (; j + 8 <= n; j += 8) {
+    __m256d d0 = _mm256_sub_pd(va, _mm256_loadu_pd(b + j));
+    __m256d d1 = _mm256_sub_pd(va, _mm256_loadu_pd(b + j + 4));
+    _mm256_storeu_pd(acc + j, _mm256_add_pd(_mm256_loadu_pd(acc + j), _mm256_mul_pd(d0, d0)));
+    _mm256_storeu_pd(acc + j + 4, _mm256_add_pd(_mm256_loadu_pd(acc + j + 4), _mm256_mul_pd(d1, d1)));
+  }
+  for (; j < n; j++) {
+    double d = a - b[j];
+    acc[j] += d * d;
+  }
+}
+
+static bool use_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif
+
+static void axpy(double a, const double* b, double* acc, int n) {
+#ifdef SVM_SIMD
+  if (use_avx2()) {
+    axpy_avx2(a, b, acc, n);
+    return;
+  }
+#endif
+  axpy_generic(a, b, acc, n);
+}
+
+static void sqdiff(double a, const double* b, double* acc, int n) {
+#ifdef SVM_SIMD
+  if (use_avx2()) {
+    sqdiff_avx2(a, b, acc, n);
+    return;
+  }
+#endif
+  sqdiff_generic(a, b, acc, n);
+}
+
+// dots[j] = x . xt[.][j] for the vectors j of a dim x ld matrix holding one vector per column
+static void dense_dots(const double* x, const double* xt, int dim, int ld,
+                       int n, double* dots) {
+  for (int j = 0; j < n; j++) {
+    dots[j] = 0;
+  }
+  for (int k = 0; k < dim; k++) {
+    axpy(x[k], xt + (size_t)k * ld, dots, n);
+  }
+}
+
+// dist[j] = |x - xt[.][j]|^2
+static void dense_distances(const double* x, const double* xt, int dim,
+                            int ld, int n, double* dist) {
+  for (int j = 0; j < n; j++) {
+    dist[j] = 0;
+  }
+  for (int k = 0; k < dim; k++) {
+    sqdiff(x[k], xt + (size_t)k * ld, dist, n);
+  }
+}
 #if 0
 void info(const char* fmt, ...) {
   va_list ap;
@@ -215,10 +323,17 @@ class Kernel : public QMatrix {
       if (x_square) {
         swap(x_square[i], x_square[j]);
       }
+      if (xt) {
+        for (int k = 0; k < dim; k++) {
+          swap(xt[(size_t)k * l + i], xt[(size_t)k * l + j]);
+        }
+      }
     }
   protected:
 
     double(Kernel::*kernel_function)(int i, int j) const;
+    // K(x[i], x[j]) for start <= j < end, in row[j]
+    const double* kernel_row(int i, int start, int end) const;
 
   private:
 #ifdef _DENSE_REP
@@ -227,6 +342,12 @@ class Kernel : public QMatrix {
     const svm_node** x;
 #endif
     double* x_square;
+    // for dense linear and rbf kernels: the features of x[j] in column j of a dim x l matrix
+    double* xt;
+    int dim;
+    int l;
+    // kernel row, followed by the features of the vector of the row
+    double* row;
 
     // svm_parameter
     const int kernel_type;
@@ -295,11 +416,54 @@ Kernel::Kernel(int l, svm_node* const* x_, const svm_parameter& param)
   } else {
     x_square = 0;
   }
+  this->l = l;
+  xt = 0;
+  dim = 0;
+#ifdef _DENSE_REP
+  if ((kernel_type == LINEAR || kernel_type == RBF) && l > 0) {
+    bool same_dim = true;
+    for (int i = 1; i < l; i++) {
+      same_dim = same_dim && (x[i].dim == x[0].dim);
+    }
+    if (same_dim) {
+      dim = x[0].dim;
+      xt = new double[(size_t)dim * l];
+      for (int i = 0; i < l; i++) {
+        for (int k = 0; k < dim; k++) {
+          xt[(size_t)k * l + i] = x[i].values[k];
+        }
+      }
+    }
+  }
+#endif
+  row = new double[l + dim];
 }
 
 Kernel::~Kernel() {
   delete[] x;
   delete[] x_square;
+  delete[] xt;
+  delete[] row;
+}
+
+const double* Kernel::kernel_row(int i, int start, int end) const {
+  if (xt == 0) {
+    for (int j = start; j < end; j++) {
+      row[j] = (this->*kernel_function)(i, j);
+    }
+    return row;
+  }
+  double* xi = row + l;
+  for (int k = 0; k < dim; k++) {
+    xi[k] = xt[(size_t)k * l + i];
+  }
+  dense_dots(xi, xt + start, dim, l, end - start, row + start);
+  if (kernel_type == RBF) {
+    for (int j = start; j < end; j++) {
+      row[j] = exp(-gamma * (x_square[i] + x_square[j] - 2 * row[j]));
+    }
+  }
+  return row;
 }
 
 #ifdef _DENSE_REP
@@ -1184,8 +1348,9 @@ class SVC_Q : public Kernel {
       Qfloat* data;
       int start;
       if ((start = cache->get_data(i, &data, len)) < len) {
+        const double* k_row = kernel_row(i, start, len);
         for (int j = start; j < len; j++) {
-          data[j] = (Qfloat)(y[i] * y[j] * (this->*kernel_function)(i, j));
+          data[j] = (Qfloat)(y[i] * y[j] * k_row[j]);
         }
       }
       return data;
@@ -1228,8 +1393,9 @@ class ONE_CLASS_Q : public Kernel {
       Qfloat* data;
       int start;
       if ((start = cache->get_data(i, &data, len)) < len) {
+        const double* k_row = kernel_row(i, start, len);
         for (int j = start; j < len; j++) {
-          data[j] = (Qfloat)(this->*kernel_function)(i, j);
+          data[j] = (Qfloat)k_row[j];
         }
       }
       return data;
@@ -1286,8 +1452,9 @@ class SVR_Q : public Kernel {
       Qfloat* data;
       int real_i = index[i];
       if (cache->get_data(real_i, &data, l) < l) {
+        const double* k_row = kernel_row(real_i, 0, l);
         for (int j = 0; j < l; j++) {
-          data[j] = (Qfloat)(this->*kernel_function)(real_i, j);
+          data[j] = (Qfloat)k_row[j];
         }
       }
       // reorder and copy
@@ -2415,6 +2582,71 @@ double svm_predict(const svm_model* model, const svm_node* x) {
   }
 }
 
+// The support vectors of regression and one-class models with a dense linear or rbf
+// kernel are stored as the columns of one matrix, and the kernel of each vector against
+// all of them is computed at once. The kernel values are summed in the order of the
+// support vectors, such that the results are those of svm_predict.
+void svm_predict_batch(const svm_model* model, const svm_node* x, int n,
+                       double* results) {
+  const svm_parameter& param = model->param;
+  bool dense = (param.svm_type == ONE_CLASS || param.svm_type == EPSILON_SVR
+      || param.svm_type == NU_SVR) && (param.kernel_type == LINEAR
+      || param.kernel_type == RBF) && model->l > 0;
+#ifdef _DENSE_REP
+  const int dim = (model->l > 0) ? model->SV[0].dim : 0;
+  for (int i = 0; dense && i < model->l; i++) {
+    dense = (model->SV[i].dim == dim);
+  }
+  for (int q = 0; dense && q < n; q++) {
+    dense = (x[q].dim == dim);
+  }
+#else
+  dense = false;
+#endif
+  if (!dense) {
+    for (int q = 0; q < n; q++) {
+      results[q] = svm_predict(model, x + q);
+    }
+    return;
+  }
+#ifdef _DENSE_REP
+  const int l = model->l;
+  double* svt = Malloc(double, (size_t)dim * l);
+  for (int i = 0; i < l; i++) {
+    for (int k = 0; k < dim; k++) {
+      svt[(size_t)k * l + i] = model->SV[i].values[k];
+    }
+  }
+  const double* sv_coef = model->sv_coef[0];
+  #pragma omp parallel
+  {
+    double* kvalue = Malloc(double, l);
+    #pragma omp for schedule(dynamic, 64)
+    for (int q = 0; q < n; q++) {
+      if (param.kernel_type == RBF) {
+        dense_distances(x[q].values, svt, dim, l, l, kvalue);
+      } else {
+        dense_dots(x[q].values, svt, dim, l, l, kvalue);
+      }
+      double sum = 0;
+      for (int i = 0; i < l; i++) {
+        double k = (param.kernel_type == RBF) ? exp(-param.gamma * kvalue[i])
+            : kvalue[i];
+        sum += sv_coef[i] * k;
+      }
+      sum -= model->rho[0];
+      if (param.svm_type == ONE_CLASS) {
+        results[q] = (sum > 0) ? 1 : -1;
+      } else {
+        results[q] = sum;
+      }
+    }
+    free(kvalue);
+  }
+  free(svt);
+#endif
+}
+
 double svm_predict_probability(const svm_model* model, const svm_node* x,
                                double* prob_estimates) {
   if ((model->param.svm_type == C_SVC || model->param.svm_type == NU_SVC)
@@ -2934,3 +3166,150 @@ int svm_check_probability_model(const svm_model* model) {
       || ((model->param.svm_type == EPSILON_SVR || model->param.svm_type
           == NU_SVR) && model->probA != NULL);
 }
+
+//
+// Kernel matrix shared by the trainings of a parameter calibration
+//
+// All models are trained with a PRECOMPUTED kernel on rows of one matrix holding the
+// kernel values of every pair of vectors. Row i starts with the serial number i + 1 of
+// vector i, so any subset of the rows is a valid precomputed problem without remapping.
+//
+static const int KERNEL_BLOCK = 32;
+
+#ifdef _DENSE_REP
+// bytes of the kernel matrices that currently exist, at most SVM_KERNEL_MATRIX_BUDGET
+static size_t kernel_matrix_bytes = 0;
+
+static size_t kernel_matrix_size(int l) {
+  return sizeof(double) * (size_t)l * (l + 1);
+}
+
+svm_kernel_matrix* svm_create_kernel_matrix(const svm_node* x, int l,
+                                            int kernel_type) {
+  if (l <= 0 || l > SVM_KERNEL_MATRIX_MAX_L || (kernel_type != LINEAR
+      && kernel_type != RBF)) {
+    return NULL;
+  }
+  for (int i = 1; i < l; i++) {
+    if (x[i].dim != x[0].dim) {
+      return NULL;
+    }
+  }
+  // models may be trained concurrently (e.g. the cross validation folds of DOC), each
+  // creating its own matrix, so the size of all the matrices together is limited
+  bool reserved;
+  #pragma omp critical (svm_kernel_matrix_budget)
+  {
+    reserved = kernel_matrix_bytes + kernel_matrix_size(l) <= SVM_KERNEL_MATRIX_BUDGET;
+    if (reserved) {
+      kernel_matrix_bytes += kernel_matrix_size(l);
+    }
+  }
+  if (!reserved) {
+    return NULL;
+  }
+  svm_kernel_matrix* km = Malloc(svm_kernel_matrix, 1);
+  km->l = l;
+  km->values = Malloc(double, (size_t)l * (l + 1));
+  km->rows = Malloc(svm_node, l);
+  km->x_square = Malloc(double, l);
+  if (km->values == NULL || km->rows == NULL || km->x_square == NULL) {
+    svm_destroy_kernel_matrix(km);
+    return NULL;
+  }
+  km->kernel_type = kernel_type;
+  km->gamma = 0;
+  km->x = x;
+  for (int i = 0; i < l; i++) {
+    km->rows[i].dim = l + 1;
+    km->rows[i].values = km->values + (size_t)i * (l + 1);
+    km->rows[i].values[0] = i + 1;
+    double sum = 0;
+    for (int k = 0; k < x[i].dim; k++) {
+      sum += x[i].values[k] * x[i].values[k];
+    }
+    km->x_square[i] = sum;
+  }
+  if (kernel_type == LINEAR) {
+    svm_set_kernel_matrix_gamma(km, 0);
+  }
+  return km;
+}
+
+// The dot products are computed for blocks of KERNEL_BLOCK x KERNEL_BLOCK vectors. The
+// features of the column block are transposed such that the innermost loop runs over the
+// columns and is vectorized, while each dot product is still summed in the order of the
+// features, as in Kernel::dot.
+void svm_set_kernel_matrix_gamma(svm_kernel_matrix* km, double gamma) {
+  const int l = km->l, dim = km->x[0].dim;
+  const int nr_block = (l + KERNEL_BLOCK - 1) / KERNEL_BLOCK;
+  const int nr_pair = nr_block * (nr_block + 1) / 2;
+  km->gamma = gamma;
+  #pragma omp parallel
+  {
+    double* xt = (double*)calloc((size_t)dim * KERNEL_BLOCK, sizeof(double));
+    double dots[KERNEL_BLOCK];
+    #pragma omp for schedule(dynamic, 1)
+    for (int pair = 0; pair < nr_pair; pair++) {
+      // upper triangle of blocks, (bi, bj) with bi <= bj
+      int bi = 0, rest = pair;
+      while (rest >= nr_block - bi) {
+        rest -= nr_block - bi;
+        bi++;
+      }
+      int bj = bi + rest;
+      int j0 = bj * KERNEL_BLOCK, nj = min(KERNEL_BLOCK, l - j0);
+      for (int k = 0; k < dim; k++) {
+        for (int jj = 0; jj < nj; jj++) {
+          xt[k * KERNEL_BLOCK + jj] = km->x[j0 + jj].values[k];
+        }
+      }
+      for (int i = bi * KERNEL_BLOCK; i < min((bi + 1) * KERNEL_BLOCK, l); i++) {
+        const double* xi = km->x[i].values;
+        for (int jj = 0; jj < KERNEL_BLOCK; jj++) {
+          dots[jj] = 0;
+        }
+        for (int k = 0; k < dim; k++) {
+          const double xik = xi[k];
+          const double* xtk = xt + k * KERNEL_BLOCK;
+          for (int jj = 0; jj < KERNEL_BLOCK; jj++) {
+            dots[jj] += xik * xtk[jj];
+          }
+        }
+        double* row_i = km->rows[i].values + 1;
+        for (int jj = 0; jj < nj; jj++) {
+          int j = j0 + jj;
+          double value = dots[jj];
+          if (km->kernel_type == RBF) {
+            value = exp(-gamma * (km->x_square[i] + km->x_square[j] - 2 * value));
+          }
+          row_i[j] = value;
+          km->rows[j].values[1 + i] = value;
+        }
+      }
+    }
+    free(xt);
+  }
+}
+
+void svm_restore_kernel_matrix_model(const svm_kernel_matrix* km,
+                                     svm_model* model) {
+  for (int i = 0; i < model->l; i++) {
+    model->SV[i] = km->x[(int)model->SV[i].values[0] - 1];
+  }
+  model->param.kernel_type = km->kernel_type;
+  model->param.gamma = km->gamma;
+}
+
+void svm_destroy_kernel_matrix(svm_kernel_matrix* km) {
+  if (km == NULL) {
+    return;
+  }
+  free(km->values);
+  free(km->rows);
+  free(km->x_square);
+  #pragma omp critical (svm_kernel_matrix_budget)
+  kernel_matrix_bytes -= kernel_matrix_size(km->l);
+  free(km);
+}
+#endif
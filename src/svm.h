@@ -107,6 +107,9 @@ void svm_predict_values(const struct svm_model* model,
                         const struct svm_node* x, double* dec_values);
 double
 svm_predict(const struct svm_model* model, const struct svm_node* x);
+// predictions for the n vectors x[0..n-1]
+void svm_predict_batch(const struct svm_model* model,
+                       const struct svm_node* x, int n, double* results);
 double svm_predict_probability(const struct svm_model* model,
                                const struct svm_node* x,
                                double* prob_estimates);
@@ -118,6 +121,42 @@ const char* svm_check_parameter(const struct svm_problem* prob,
                                 const struct svm_parameter* param);
 int svm_check_probability_model(const struct svm_model* model);
 
+#ifdef _DENSE_REP
+// largest number of vectors for which a kernel matrix is stored (8 * l * l bytes)
+#define SVM_KERNEL_MATRIX_MAX_L 4096
+// largest total size in bytes of the kernel matrices that exist at the same time, shared
+// by all threads; it holds one matrix of SVM_KERNEL_MATRIX_MAX_L vectors
+#define SVM_KERNEL_MATRIX_BUDGET \
+    (sizeof(double) * (size_t)SVM_KERNEL_MATRIX_MAX_L * (SVM_KERNEL_MATRIX_MAX_L + 1))
+
+//
+// svm_kernel_matrix
+//
+// kernel values of every pair of a set of vectors, for training many models on subsets
+// of the set; rows[i] is the PRECOMPUTED node of vector i
+//
+struct svm_kernel_matrix {
+    int l; // number of vectors
+    int kernel_type; // LINEAR or RBF
+    double gamma; // for rbf
+    const struct svm_node* x; // the vectors (x[l])
+    double* values; // row i is i + 1 followed by K(x[i], x[j]) for j = 0..l-1
+    struct svm_node* rows; // rows[l]
+    double* x_square;
+};
+
+// returns NULL if the matrix would be too large, if the matrices that exist already use
+// up SVM_KERNEL_MATRIX_BUDGET or if the kernel is not supported
+struct svm_kernel_matrix* svm_create_kernel_matrix(const struct svm_node* x,
+                                                   int l, int kernel_type);
+// compute the kernel values for the given gamma
+void svm_set_kernel_matrix_gamma(struct svm_kernel_matrix* km, double gamma);
+// turn a model trained on rows of the matrix into a model of the original vectors and kernel
+void svm_restore_kernel_matrix_model(const struct svm_kernel_matrix* km,
+                                     struct svm_model* model);
+void svm_destroy_kernel_matrix(struct svm_kernel_matrix* km);
+#endif
+
 #ifdef __cplusplus
 }
 #endif